@@ -0,0 +1,589 @@
+/*
+ * Cursive Bootstrap Compiler - Calling Convention Lowering
+ *
+ * Maps the lowered signature of a procedure or extern function onto what
+ * the platform's C calling convention passes in registers and memory, so
+ * Cursive code and C code can call each other with records by value:
+ *
+ *   x86-64 System V  Aggregates up to 16 bytes are split into eightbytes,
+ *                    each classified INTEGER or SSE and passed as one
+ *                    register (i64/iN, double/float/<2 x float>) while
+ *                    registers of its class remain; larger ones, or ones
+ *                    with misaligned fields, are copied to the stack
+ *                    (byval) and returned through a hidden pointer (sret).
+ *   Windows x64      Aggregates of 1, 2, 4 or 8 bytes travel as an integer
+ *                    of that size; others by the address of a copy the
+ *                    caller makes, and are returned through sret.
+ *   AArch64 AAPCS64  Homogeneous aggregates of up to four floats or
+ *                    doubles use floating point registers; others up to
+ *                    16 bytes one or two general registers; larger ones
+ *                    the address of a copy, and sret (x8) when returned.
+ *
+ * So a slice or string@View, { ptr, i64 }, is two integer registers
+ * everywhere but Windows. Scalars, and the addresses of receivers and
+ * views, are passed as they are. Values that change shape are moved
+ * through a stack slot, which SROA removes once the function is optimized.
+ *
+ * The signature of every function declared here is remembered, and
+ * parameters, returns and calls go through it.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+
+/* Register classes of an eightbyte (System V) */
+typedef enum EightbyteClass {
+    CLASS_NONE,
+    CLASS_INTEGER,
+    CLASS_SSE,
+    CLASS_MEMORY
+} EightbyteClass;
+
+/* Summary of the scalars making up an aggregate */
+typedef struct AggregateShape {
+    EightbyteClass classes[2];  /* System V class of each eightbyte */
+    uint64_t sse_bytes[2];      /* End of the floating point data in each eightbyte */
+    bool has_double[2];         /* Eightbyte holds a double */
+    LLVMTypeRef float_type;     /* Common type of all scalars if floating point, */
+    unsigned float_count;       /* and how many (homogeneous aggregates) */
+    bool mixed;                 /* Some scalar is not float_type */
+    bool misaligned;            /* Some scalar is not at its natural alignment */
+} AggregateShape;
+
+/* Registers still free for arguments */
+typedef struct RegisterBudget {
+    unsigned integer;
+    unsigned sse;
+} RegisterBudget;
+
+static bool is_aggregate(LLVMTypeRef type) {
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    return kind == LLVMStructTypeKind || kind == LLVMArrayTypeKind;
+}
+
+static bool is_float(LLVMTypeRef type) {
+    LLVMTypeKind kind = LLVMGetTypeKind(type);
+    return kind == LLVMFloatTypeKind || kind == LLVMDoubleTypeKind || kind == LLVMHalfTypeKind;
+}
+
+/* Record a scalar at `offset` in the shape */
+static void shape_scalar(CodegenContext *ctx, AggregateShape *shape, LLVMTypeRef type,
+                         uint64_t offset) {
+    uint64_t size = LLVMABISizeOfType(ctx->target_data, type);
+    if (size == 0) return;
+    if (offset % LLVMABIAlignmentOfType(ctx->target_data, type) != 0) {
+        shape->misaligned = true;
+    }
+
+    if (is_float(type) && (!shape->float_type || shape->float_type == type)) {
+        shape->float_type = type;
+        shape->float_count++;
+    } else {
+        shape->mixed = true;
+    }
+
+    for (uint64_t at = offset; at < offset + size && at < 16; at = (at / 8 + 1) * 8) {
+        unsigned eightbyte = (unsigned)(at / 8);
+        if (is_float(type) && size <= 8) {
+            if (shape->classes[eightbyte] == CLASS_NONE) {
+                shape->classes[eightbyte] = CLASS_SSE;
+            }
+            uint64_t end = offset + size - 8 * eightbyte;
+            if (end > shape->sse_bytes[eightbyte]) shape->sse_bytes[eightbyte] = end;
+            if (LLVMGetTypeKind(type) == LLVMDoubleTypeKind) shape->has_double[eightbyte] = true;
+        } else {
+            shape->classes[eightbyte] = CLASS_INTEGER;
+        }
+    }
+}
+
+/* Walk the scalars of a lowered type */
+static void shape_walk(CodegenContext *ctx, AggregateShape *shape, LLVMTypeRef type,
+                       uint64_t offset) {
+    switch (LLVMGetTypeKind(type)) {
+        case LLVMStructTypeKind: {
+            unsigned count = LLVMCountStructElementTypes(type);
+            for (unsigned i = 0; i < count; i++) {
+                LLVMTypeRef element = LLVMStructGetTypeAtIndex(type, i);
+                shape_walk(ctx, shape, element,
+                    offset + LLVMOffsetOfElement(ctx->target_data, type, i));
+            }
+            break;
+        }
+
+        case LLVMArrayTypeKind: {
+            LLVMTypeRef element = LLVMGetElementType(type);
+            uint64_t stride = LLVMABISizeOfType(ctx->target_data, element);
+            unsigned count = LLVMGetArrayLength(type);
+            for (unsigned i = 0; i < count; i++) {
+                shape_walk(ctx, shape, element, offset + i * stride);
+            }
+            break;
+        }
+
+        default:
+            shape_scalar(ctx, shape, type, offset);
+            break;
+    }
+}
+
+/* Register type of System V eightbyte `i` of an aggregate of `size` bytes */
+static LLVMTypeRef sysv_part(CodegenContext *ctx, const AggregateShape *shape, unsigned i,
+                             uint64_t size) {
+    uint64_t bytes = size - 8 * i < 8 ? size - 8 * i : 8;
+    if (shape->classes[i] == CLASS_SSE) {
+        if (shape->has_double[i]) return LLVMDoubleTypeInContext(ctx->llvm_ctx);
+        if (shape->sse_bytes[i] <= 4) return LLVMFloatTypeInContext(ctx->llvm_ctx);
+        return LLVMVectorType(LLVMFloatTypeInContext(ctx->llvm_ctx), 2);
+    }
+    return LLVMIntTypeInContext(ctx->llvm_ctx, (unsigned)(bytes * 8));
+}
+
+/* Registers a scalar takes (System V) */
+static void sysv_scalar(LLVMTypeRef type, RegisterBudget *budget) {
+    unsigned *bank = is_float(type) ? &budget->sse : &budget->integer;
+    unsigned need = LLVMGetTypeKind(type) == LLVMIntegerTypeKind &&
+        LLVMGetIntTypeWidth(type) > 64 ? 2 : 1;
+    *bank = *bank >= need ? *bank - need : 0;
+}
+
+static void sysv_classify(CodegenContext *ctx, AbiArg *arg, bool is_return,
+                          RegisterBudget *budget) {
+    uint64_t size = LLVMABISizeOfType(ctx->target_data, arg->type);
+    AggregateShape shape = {0};
+    shape_walk(ctx, &shape, arg->type, 0);
+
+    if (size <= 16 && !shape.misaligned) {
+        unsigned count = size > 8 ? 2 : 1;
+        unsigned need_int = 0;
+        unsigned need_sse = 0;
+        for (unsigned i = 0; i < count; i++) {
+            if (shape.classes[i] == CLASS_SSE) need_sse++;
+            else need_int++;
+        }
+        /* Returns have registers of their own; arguments must fit whole */
+        if (is_return || (need_int <= budget->integer && need_sse <= budget->sse)) {
+            if (!is_return) {
+                budget->integer -= need_int;
+                budget->sse -= need_sse;
+            }
+            arg->kind = ABI_COERCE;
+            arg->part_count = count;
+            for (unsigned i = 0; i < count; i++) {
+                arg->parts[i] = sysv_part(ctx, &shape, i, size);
+            }
+            return;
+        }
+    }
+
+    arg->kind = ABI_INDIRECT;
+    arg->byval = !is_return;
+    if (arg->align < 8) arg->align = 8;
+}
+
+static void win64_classify(CodegenContext *ctx, AbiArg *arg) {
+    uint64_t size = LLVMABISizeOfType(ctx->target_data, arg->type);
+    if (size == 1 || size == 2 || size == 4 || size == 8) {
+        arg->kind = ABI_COERCE;
+        arg->part_count = 1;
+        arg->parts[0] = LLVMIntTypeInContext(ctx->llvm_ctx, (unsigned)(size * 8));
+        return;
+    }
+    arg->kind = ABI_INDIRECT;
+}
+
+static void aarch64_classify(CodegenContext *ctx, AbiArg *arg) {
+    uint64_t size = LLVMABISizeOfType(ctx->target_data, arg->type);
+    AggregateShape shape = {0};
+    shape_walk(ctx, &shape, arg->type, 0);
+
+    /* Homogeneous floating point aggregate, without padding */
+    if (!shape.mixed && shape.float_count >= 1 && shape.float_count <= 4 &&
+        shape.float_count * LLVMABISizeOfType(ctx->target_data, shape.float_type) == size) {
+        arg->kind = ABI_COERCE;
+        arg->part_count = 1;
+        arg->parts[0] = LLVMArrayType(shape.float_type, shape.float_count);
+        return;
+    }
+
+    if (size <= 16) {
+        LLVMTypeRef i64 = LLVMInt64TypeInContext(ctx->llvm_ctx);
+        arg->kind = ABI_COERCE;
+        arg->part_count = 1;
+        arg->parts[0] = size <= 8 ? i64 : LLVMArrayType(i64, 2);
+        return;
+    }
+    arg->kind = ABI_INDIRECT;
+}
+
+/* Decide how one value travels; `budget` is NULL for returns */
+static void classify(CodegenContext *ctx, AbiArg *arg, LLVMTypeRef type,
+                     RegisterBudget *budget) {
+    memset(arg, 0, sizeof(*arg));
+    arg->type = type;
+    arg->kind = ABI_DIRECT;
+
+    if (!is_aggregate(type)) {
+        if (budget && ctx->target.os != TARGET_OS_WINDOWS &&
+            ctx->target.arch == TARGET_ARCH_X86_64) {
+            sysv_scalar(type, budget);
+        }
+        return;
+    }
+    if (LLVMABISizeOfType(ctx->target_data, type) == 0) {
+        arg->kind = ABI_IGNORE;
+        return;
+    }
+    arg->align = LLVMABIAlignmentOfType(ctx->target_data, type);
+
+    if (ctx->target.arch == TARGET_ARCH_AARCH64) {
+        aarch64_classify(ctx, arg);
+    } else if (ctx->target.os == TARGET_OS_WINDOWS) {
+        win64_classify(ctx, arg);
+    } else {
+        RegisterBudget none = {0, 0};
+        sysv_classify(ctx, arg, budget == NULL, budget ? budget : &none);
+    }
+}
+
+/* Type of the registers of a coerced value, as one value */
+static LLVMTypeRef coerced_type(CodegenContext *ctx, const AbiArg *arg) {
+    if (arg->part_count == 1) return arg->parts[0];
+    return LLVMStructTypeInContext(ctx->llvm_ctx, (LLVMTypeRef *)arg->parts, 2, 0);
+}
+
+/* Stack slot large and aligned enough for both shapes of a coerced value */
+static LLVMValueRef coercion_slot(CodegenContext *ctx, const AbiArg *arg, LLVMTypeRef coerced) {
+    LLVMTypeRef slot_type = LLVMABISizeOfType(ctx->target_data, coerced) >
+        LLVMABISizeOfType(ctx->target_data, arg->type) ? coerced : arg->type;
+    LLVMBasicBlockRef current = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef entry = LLVMGetEntryBasicBlock(LLVMGetBasicBlockParent(current));
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx->llvm_ctx);
+    LLVMValueRef first = LLVMGetFirstInstruction(entry);
+    if (first) {
+        LLVMPositionBuilderBefore(builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(builder, entry);
+    }
+    LLVMValueRef slot = LLVMBuildAlloca(builder, slot_type, "abi");
+    LLVMDisposeBuilder(builder);
+
+    unsigned align = LLVMABIAlignmentOfType(ctx->target_data, coerced);
+    if (arg->align > align) align = arg->align;
+    LLVMSetAlignment(slot, align);
+    return slot;
+}
+
+/* Registers carrying `value` */
+static void coerce_out(CodegenContext *ctx, const AbiArg *arg, LLVMValueRef value,
+                       LLVMValueRef *parts) {
+    LLVMTypeRef coerced = coerced_type(ctx, arg);
+    LLVMValueRef slot = coercion_slot(ctx, arg, coerced);
+    LLVMBuildStore(ctx->builder,
+        value, LLVMBuildPointerCast(ctx->builder, slot, LLVMPointerType(arg->type, 0), ""));
+    LLVMValueRef addr = LLVMBuildPointerCast(ctx->builder, slot,
+        LLVMPointerType(coerced, 0), "");
+    if (arg->part_count == 1) {
+        parts[0] = LLVMBuildLoad2(ctx->builder, coerced, addr, "");
+        return;
+    }
+    for (unsigned i = 0; i < arg->part_count; i++) {
+        parts[i] = LLVMBuildLoad2(ctx->builder, arg->parts[i],
+            LLVMBuildStructGEP2(ctx->builder, coerced, addr, i, ""), "");
+    }
+}
+
+/* Value carried by registers */
+static LLVMValueRef coerce_in(CodegenContext *ctx, const AbiArg *arg, LLVMValueRef *parts) {
+    LLVMTypeRef coerced = coerced_type(ctx, arg);
+    LLVMValueRef slot = coercion_slot(ctx, arg, coerced);
+    LLVMValueRef addr = LLVMBuildPointerCast(ctx->builder, slot,
+        LLVMPointerType(coerced, 0), "");
+    if (arg->part_count == 1) {
+        LLVMBuildStore(ctx->builder, parts[0], addr);
+    } else {
+        for (unsigned i = 0; i < arg->part_count; i++) {
+            LLVMBuildStore(ctx->builder, parts[i],
+                LLVMBuildStructGEP2(ctx->builder, coerced, addr, i, ""));
+        }
+    }
+    return LLVMBuildLoad2(ctx->builder, arg->type,
+        LLVMBuildPointerCast(ctx->builder, slot, LLVMPointerType(arg->type, 0), ""), "");
+}
+
+/* Type attribute (sret, byval) or enum attribute with an integer value */
+static LLVMAttributeRef type_attribute(CodegenContext *ctx, const char *name, LLVMTypeRef type) {
+    return LLVMCreateTypeAttribute(ctx->llvm_ctx,
+        LLVMGetEnumAttributeKindForName(name, strlen(name)), type);
+}
+
+static LLVMAttributeRef enum_attribute(CodegenContext *ctx, const char *name, uint64_t value) {
+    return LLVMCreateEnumAttribute(ctx->llvm_ctx,
+        LLVMGetEnumAttributeKindForName(name, strlen(name)), value);
+}
+
+/* Attributes of the hidden and copied parameters, on a function or a call */
+static void add_abi_attributes(CodegenContext *ctx, const AbiSignature *sig,
+                               LLVMValueRef value, bool is_call) {
+    void (*add)(LLVMValueRef, LLVMAttributeIndex, LLVMAttributeRef) =
+        is_call ? LLVMAddCallSiteAttribute : LLVMAddAttributeAtIndex;
+
+    if (sig->ret.kind == ABI_INDIRECT) {
+        add(value, 1, type_attribute(ctx, "sret", sig->ret.type));
+        add(value, 1, enum_attribute(ctx, "align", sig->ret.align));
+        if (!is_call) {
+            add(value, 1, enum_attribute(ctx, "noalias", 0));
+        }
+    }
+    for (unsigned i = 0; i < sig->param_count; i++) {
+        const AbiArg *param = &sig->params[i];
+        if (param->kind == ABI_INDIRECT && param->byval) {
+            add(value, param->index + 1, type_attribute(ctx, "byval", param->type));
+            add(value, param->index + 1, enum_attribute(ctx, "align", param->align));
+        }
+    }
+}
+
+/*
+ * Declare a function taking and returning values of the given lowered
+ * types, passed the way the target's C calling convention passes them
+ */
+LLVMValueRef abi_declare(CodegenContext *ctx, const char *name, LLVMTypeRef ret,
+                         LLVMTypeRef *params, unsigned count) {
+    AbiSignature *sig = ARENA_ALLOC(ctx->arena, AbiSignature);
+    sig->param_count = count;
+    sig->params = ARENA_ALLOC_ARRAY(ctx->arena, AbiArg, count ? count : 1);
+
+    RegisterBudget budget = ctx->target.arch == TARGET_ARCH_AARCH64
+        ? (RegisterBudget){8, 8} : (RegisterBudget){6, 8};
+    classify(ctx, &sig->ret, ret, NULL);
+    if (LLVMGetTypeKind(ret) == LLVMVoidTypeKind) {
+        sig->ret.kind = ABI_IGNORE;
+    }
+
+    /* The hidden return pointer comes first and takes a register */
+    LLVMTypeRef *types = vec_new(LLVMTypeRef);
+    LLVMTypeRef abi_ret = ret;
+    if (sig->ret.kind == ABI_INDIRECT) {
+        vec_push(types, LLVMPointerType(ret, 0));
+        abi_ret = LLVMVoidTypeInContext(ctx->llvm_ctx);
+        if (budget.integer > 0 && ctx->target.arch == TARGET_ARCH_X86_64) {
+            budget.integer--;
+        }
+    } else if (sig->ret.kind == ABI_COERCE) {
+        abi_ret = coerced_type(ctx, &sig->ret);
+    } else if (sig->ret.kind == ABI_IGNORE) {
+        abi_ret = LLVMVoidTypeInContext(ctx->llvm_ctx);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        AbiArg *param = &sig->params[i];
+        classify(ctx, param, params[i], &budget);
+        param->index = (unsigned)vec_len(types);
+        switch (param->kind) {
+            case ABI_DIRECT:
+                vec_push(types, param->type);
+                break;
+            case ABI_COERCE:
+                for (unsigned k = 0; k < param->part_count; k++) {
+                    vec_push(types, param->parts[k]);
+                }
+                break;
+            case ABI_INDIRECT:
+                vec_push(types, LLVMPointerType(param->type, 0));
+                break;
+            case ABI_IGNORE:
+                break;
+        }
+    }
+
+    LLVMTypeRef fn_type = LLVMFunctionType(abi_ret, types, (unsigned)vec_len(types), 0);
+    vec_free(types);
+    LLVMValueRef fn = LLVMAddFunction(ctx->module, name, fn_type);
+    add_abi_attributes(ctx, sig, fn, false);
+    ptr_map_set(&ctx->abi_signatures, fn, sig);
+    return fn;
+}
+
+/*
+ * Signature of a function declared with abi_declare, NULL for others
+ */
+const AbiSignature *abi_signature(CodegenContext *ctx, LLVMValueRef fn) {
+    return ptr_map_get(&ctx->abi_signatures, fn);
+}
+
+/*
+ * Value of parameter `index` of the function being generated
+ */
+LLVMValueRef abi_param(CodegenContext *ctx, LLVMValueRef fn, unsigned index) {
+    const AbiSignature *sig = abi_signature(ctx, fn);
+    if (!sig) {
+        return LLVMGetParam(fn, index);
+    }
+
+    const AbiArg *param = &sig->params[index];
+    switch (param->kind) {
+        case ABI_DIRECT:
+            return LLVMGetParam(fn, param->index);
+
+        case ABI_COERCE: {
+            LLVMValueRef parts[2];
+            for (unsigned i = 0; i < param->part_count; i++) {
+                parts[i] = LLVMGetParam(fn, param->index + i);
+            }
+            return coerce_in(ctx, param, parts);
+        }
+
+        case ABI_INDIRECT: {
+            LLVMValueRef value = LLVMBuildLoad2(ctx->builder, param->type,
+                LLVMGetParam(fn, param->index), "");
+            LLVMSetAlignment(value, param->align);
+            return value;
+        }
+
+        case ABI_IGNORE:
+            break;
+    }
+    return LLVMConstNull(param->type);
+}
+
+/*
+ * Return `value` from the function being generated; NULL (or a value of
+ * the wrong type, after an error) returns undef
+ */
+void abi_return(CodegenContext *ctx, LLVMValueRef value) {
+    const AbiSignature *sig = abi_signature(ctx, ctx->current_func);
+    LLVMTypeRef ret_type = sig ? sig->ret.type
+        : LLVMGetReturnType(LLVMGlobalGetValueType(ctx->current_func));
+    if (LLVMGetTypeKind(ret_type) == LLVMVoidTypeKind) {
+        LLVMBuildRetVoid(ctx->builder);
+        return;
+    }
+    if (!value || LLVMTypeOf(value) != ret_type) {
+        value = LLVMGetUndef(ret_type);
+    }
+
+    switch (sig ? sig->ret.kind : ABI_DIRECT) {
+        case ABI_DIRECT:
+            LLVMBuildRet(ctx->builder, value);
+            break;
+
+        case ABI_COERCE: {
+            LLVMValueRef parts[2];
+            coerce_out(ctx, &sig->ret, value, parts);
+            if (sig->ret.part_count == 1) {
+                LLVMBuildRet(ctx->builder, parts[0]);
+            } else {
+                LLVMBuildAggregateRet(ctx->builder, parts, 2);
+            }
+            break;
+        }
+
+        case ABI_INDIRECT: {
+            LLVMValueRef store = LLVMBuildStore(ctx->builder, value,
+                LLVMGetParam(ctx->current_func, 0));
+            LLVMSetAlignment(store, sig->ret.align);
+            LLVMBuildRetVoid(ctx->builder);
+            break;
+        }
+
+        case ABI_IGNORE:
+            LLVMBuildRetVoid(ctx->builder);
+            break;
+    }
+}
+
+/*
+ * Call a function with argument values of its lowered parameter types;
+ * returns the result, NULL if the function returns nothing
+ */
+LLVMValueRef abi_call(CodegenContext *ctx, LLVMValueRef fn, LLVMValueRef *args,
+                      unsigned count) {
+    LLVMTypeRef fn_type = LLVMGlobalGetValueType(fn);
+    const AbiSignature *sig = abi_signature(ctx, fn);
+    if (!sig || sig->param_count != count) {
+        bool returns_void = LLVMGetTypeKind(LLVMGetReturnType(fn_type)) == LLVMVoidTypeKind;
+        LLVMValueRef call = LLVMBuildCall2(ctx->builder, fn_type, fn, args, count,
+            returns_void ? "" : "call");
+        return returns_void ? NULL : call;
+    }
+
+    LLVMValueRef *values = vec_new(LLVMValueRef);
+    LLVMValueRef result_slot = NULL;
+    if (sig->ret.kind == ABI_INDIRECT) {
+        result_slot = coercion_slot(ctx, &sig->ret, sig->ret.type);
+        vec_push(values, result_slot);
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        const AbiArg *param = &sig->params[i];
+        switch (param->kind) {
+            case ABI_DIRECT:
+                vec_push(values, args[i]);
+                break;
+
+            case ABI_COERCE: {
+                LLVMValueRef parts[2];
+                coerce_out(ctx, param, args[i], parts);
+                for (unsigned k = 0; k < param->part_count; k++) {
+                    vec_push(values, parts[k]);
+                }
+                break;
+            }
+
+            case ABI_INDIRECT: {
+                /* The callee may write its copy, so it is always a fresh one */
+                LLVMValueRef copy = coercion_slot(ctx, param, param->type);
+                LLVMBuildStore(ctx->builder, args[i], copy);
+                vec_push(values, copy);
+                break;
+            }
+
+            case ABI_IGNORE:
+                break;
+        }
+    }
+
+    bool returns_value = LLVMGetTypeKind(LLVMGetReturnType(fn_type)) != LLVMVoidTypeKind;
+    LLVMValueRef call = LLVMBuildCall2(ctx->builder, fn_type, fn, values,
+        (unsigned)vec_len(values), returns_value ? "call" : "");
+    vec_free(values);
+    add_abi_attributes(ctx, sig, call, true);
+
+    switch (sig->ret.kind) {
+        case ABI_DIRECT:
+            return call;
+
+        case ABI_COERCE: {
+            LLVMValueRef parts[2] = { call, NULL };
+            if (sig->ret.part_count == 2) {
+                parts[0] = LLVMBuildExtractValue(ctx->builder, call, 0, "");
+                parts[1] = LLVMBuildExtractValue(ctx->builder, call, 1, "");
+            }
+            return coerce_in(ctx, &sig->ret, parts);
+        }
+
+        case ABI_INDIRECT:
+            return LLVMBuildLoad2(ctx->builder, sig->ret.type, result_slot, "call");
+
+        case ABI_IGNORE:
+            break;
+    }
+    return LLVMGetTypeKind(sig->ret.type) == LLVMVoidTypeKind
+        ? NULL : LLVMConstNull(sig->ret.type);
+}
+
+/*
+ * Give a call that forwards a function's own parameters the attributes
+ * the function's signature needs at call sites
+ */
+void abi_forward_attributes(CodegenContext *ctx, LLVMValueRef fn, LLVMValueRef call) {
+    const AbiSignature *sig = abi_signature(ctx, fn);
+    if (sig) {
+        add_abi_attributes(ctx, sig, call, true);
+    }
+}
+
+#endif /* HAVE_LLVM */
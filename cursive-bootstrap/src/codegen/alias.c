@@ -0,0 +1,83 @@
+/*
+ * Cursive Bootstrap Compiler - Alias Information
+ *
+ * Hands what the permission system proves about aliasing to LLVM. Values
+ * reached through a pointer parameter - receivers, and non-`move`
+ * parameters too large to pass in registers, which are views of the
+ * caller's place - carry their permission: a `unique` path is the only
+ * path to its object, so the pointer is `noalias`; a `const` path is
+ * never written through, so it is `readonly`. Both are nonnull and
+ * dereferenceable for the size of their type. Once a body is generated,
+ * a parameter whose address is only ever loaded from is `nocapture`
+ * (and `readonly`, whatever its permission).
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+
+/* Add an enum attribute, with an integer value or 0, to a function parameter */
+static void add_param_attribute(CodegenContext *ctx, LLVMValueRef fn, unsigned index,
+                                const char *name, uint64_t value) {
+    unsigned kind = LLVMGetEnumAttributeKindForName(name, strlen(name));
+    LLVMAddAttributeAtIndex(fn, index + 1,
+        LLVMCreateEnumAttribute(ctx->llvm_ctx, kind, value));
+}
+
+/*
+ * Attributes of a parameter passed by address
+ */
+void alias_view_param(CodegenContext *ctx, LLVMValueRef fn, unsigned index,
+                      Permission perm, Type *type) {
+    switch (perm) {
+        case PERM_UNIQUE: add_param_attribute(ctx, fn, index, "noalias", 0); break;
+        case PERM_CONST:  add_param_attribute(ctx, fn, index, "readonly", 0); break;
+        case PERM_SHARED: break;    /* Aliased and mutable: nothing to promise */
+    }
+
+    add_param_attribute(ctx, fn, index, "nonnull", 0);
+    uint64_t size;
+    uint32_t align;
+    if (type && layout_size_align(&ctx->sema->layout, mono_subst(ctx, type), &size, &align)) {
+        if (size > 0) {
+            add_param_attribute(ctx, fn, index, "dereferenceable", size);
+        }
+        add_param_attribute(ctx, fn, index, "align", align);
+    }
+}
+
+/*
+ * Mark pointer parameters of a generated body that do not escape it
+ */
+void alias_infer_captures(CodegenContext *ctx, LLVMValueRef fn) {
+    unsigned count = LLVMCountParams(fn);
+    for (unsigned i = 0; i < count; i++) {
+        LLVMValueRef param = LLVMGetParam(fn, i);
+        if (LLVMGetTypeKind(LLVMTypeOf(param)) != LLVMPointerTypeKind) continue;
+
+        /* Loading from the address or storing to it keeps it inside */
+        bool captured = false;
+        bool written = false;
+        for (LLVMUseRef use = LLVMGetFirstUse(param); use && !captured;
+             use = LLVMGetNextUse(use)) {
+            LLVMValueRef user = LLVMGetUser(use);
+            if (LLVMIsALoadInst(user)) continue;
+            if (LLVMIsAStoreInst(user) && LLVMGetOperand(user, 1) == param &&
+                LLVMGetOperand(user, 0) != param) {
+                written = true;
+                continue;
+            }
+            captured = true;
+        }
+
+        if (!captured) {
+            add_param_attribute(ctx, fn, i, "nocapture", 0);
+            if (!written) {
+                add_param_attribute(ctx, fn, i, "readonly", 0);
+            }
+        }
+    }
+}
+
+#endif /* HAVE_LLVM */
@@ -6,6 +6,8 @@
  */
 
 #include "codegen.h"
+#include "sema/match.h"
+#include "sema/consteval.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -17,21 +19,28 @@
  * Initialize code generation context
  */
 bool codegen_init(CodegenContext *ctx, Arena *arena, SemaContext *sema,
-                  DiagContext *diag, const char *module_name) {
+                  DiagContext *diag, const char *module_name,
+                  const CodegenOptions *options) {
     memset(ctx, 0, sizeof(CodegenContext));
     ctx->arena = arena;
     ctx->sema = sema;
     ctx->strings = sema->strings;
     ctx->diag = diag;
+    if (options) {
+        ctx->options = *options;
+    }
 
     /* Initialize target info */
     target_init_host(&ctx->target);
+    target_set_cpu(&ctx->target, arena, ctx->options.cpu, ctx->options.features);
 
     /* Initialize maps */
-    map_init(&ctx->type_cache);
-    map_init(&ctx->func_cache);
-    map_init(&ctx->global_cache);
-    map_init(&ctx->locals);
+    ptr_map_init(&ctx->type_cache);
+    ptr_map_init(&ctx->func_cache);
+    ptr_map_init(&ctx->global_cache);
+    ptr_map_init(&ctx->drop_glue);
+    ptr_map_init(&ctx->field_slots);
+    ptr_map_init(&ctx->abi_signatures);
 
 #ifdef HAVE_LLVM
     /* Initialize LLVM */
@@ -48,7 +57,7 @@ bool codegen_init(CodegenContext *ctx, Arena *arena, SemaContext *sema,
     char *error = NULL;
     LLVMTargetRef target;
     if (LLVMGetTargetFromTriple(ctx->target.triple, &target, &error) != 0) {
-        diag_emit(diag, DIAG_ERROR, (SourceSpan){0},
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
             "Failed to get target: %s", error);
         LLVMDisposeMessage(error);
         return false;
@@ -57,14 +66,22 @@ bool codegen_init(CodegenContext *ctx, Arena *arena, SemaContext *sema,
     ctx->target_machine = LLVMCreateTargetMachine(
         target,
         ctx->target.triple,
-        "generic",  /* CPU */
-        "",         /* Features */
-        LLVMCodeGenLevelDefault,
+        ctx->target.cpu,
+        ctx->target.features,
+        codegen_machine_level(ctx->options.opt_level),
         LLVMRelocDefault,
         LLVMCodeModelDefault);
 
     ctx->target_data = LLVMCreateTargetDataLayout(ctx->target_machine);
     LLVMSetModuleDataLayout(ctx->module, ctx->target_data);
+
+    /* Lay types out for this target, so lowered structs agree with sema */
+    LayoutTarget layout_target = {
+        .pointer_size = LLVMPointerSize(ctx->target_data),
+        .max_scalar_align = LLVMABIAlignmentOfType(ctx->target_data,
+            LLVMInt128TypeInContext(ctx->llvm_ctx)),
+    };
+    layout_set_target(&sema->layout, layout_target);
     LLVMSetTarget(ctx->module, ctx->target.triple);
 #endif
 
@@ -92,7 +109,13 @@ void codegen_destroy(CodegenContext *ctx) {
         LLVMContextDispose(ctx->llvm_ctx);
     }
 #endif
-    (void)ctx;
+    ptr_map_destroy(&ctx->type_cache);
+    ptr_map_destroy(&ctx->func_cache);
+    ptr_map_destroy(&ctx->global_cache);
+    ptr_map_destroy(&ctx->drop_glue);
+    ptr_map_destroy(&ctx->field_slots);
+    ptr_map_destroy(&ctx->abi_signatures);
+    mono_destroy(&ctx->mono);
 }
 
 #ifdef HAVE_LLVM
@@ -103,17 +126,114 @@ void codegen_destroy(CodegenContext *ctx) {
 static LLVMValueRef codegen_expr_internal(CodegenContext *ctx, Expr *expr);
 static void codegen_stmt_internal(CodegenContext *ctx, Stmt *stmt);
 
+/*
+ * Semantic type of an expression under the current substitution
+ */
+static Type *expr_type(CodegenContext *ctx, Expr *expr) {
+    return mono_subst(ctx, expr->type);
+}
+
+/*
+ * LLVM type of an expression, or `fallback` if it has no usable type
+ */
+static LLVMTypeRef expr_llvm_type(CodegenContext *ctx, Expr *expr, LLVMTypeRef fallback) {
+    Type *type = expr_type(ctx, expr);
+    if (!type || type->kind == TYPE_ERROR || type->kind == TYPE_INFER) {
+        return fallback;
+    }
+    LLVMTypeRef llvm_type = lower_type(ctx, type);
+    return LLVMGetTypeKind(llvm_type) == LLVMVoidTypeKind ? fallback : llvm_type;
+}
+
+/*
+ * Is this an unsigned integer type?
+ */
+static bool type_is_unsigned(Type *type) {
+    return type && type->kind >= TYPE_PRIM_U8 && type->kind <= TYPE_PRIM_U128;
+}
+
+/*
+ * Has the current block already been terminated (return/branch)?
+ */
+static bool block_terminated(CodegenContext *ctx) {
+    return LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder)) != NULL;
+}
+
+/*
+ * Create a stack slot in the entry block, so loops do not grow the stack
+ */
+static LLVMValueRef entry_alloca(CodegenContext *ctx, LLVMTypeRef type, const char *name) {
+    LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx->llvm_ctx);
+    LLVMValueRef first = LLVMGetFirstInstruction(ctx->entry_block);
+    if (first) {
+        LLVMPositionBuilderBefore(builder, first);
+    } else {
+        LLVMPositionBuilderAtEnd(builder, ctx->entry_block);
+    }
+    LLVMValueRef slot = LLVMBuildAlloca(builder, type, name);
+    LLVMDisposeBuilder(builder);
+    return slot;
+}
+
+/*
+ * Raise a stack slot to the alignment of its type's layout, which align(N)
+ * can put above the alignment of the LLVM struct
+ */
+static void align_slot(CodegenContext *ctx, LLVMValueRef slot, Type *type) {
+    uint64_t size;
+    uint32_t align;
+    if (type && layout_size_align(&ctx->sema->layout, mono_subst(ctx, type), &size, &align) &&
+        align > LLVMGetAlignment(slot)) {
+        LLVMSetAlignment(slot, align);
+    }
+}
+
+/*
+ * Is a parameter of this (concrete) type passed by address? Parameters
+ * without `move` are views of the caller's place; those larger than two
+ * pointers are passed as its address instead of being copied into the
+ * argument list.
+ */
+static bool passed_by_address(CodegenContext *ctx, Type *type, bool is_move) {
+    uint64_t size;
+    uint32_t align;
+    return !is_move && type &&
+        layout_size_align(&ctx->sema->layout, type, &size, &align) &&
+        size > 2 * (uint64_t)ctx->target.pointer_size;
+}
+
+/* Permission of the receiver of a method */
+static Permission receiver_permission(ProcDecl *proc) {
+    switch (proc->receiver) {
+        case RECV_UNIQUE: return PERM_UNIQUE;
+        case RECV_SHARED: return PERM_SHARED;
+        default:          return PERM_CONST;
+    }
+}
+
+/*
+ * string@View of a string constant: its bytes (NUL-terminated, for C)
+ * and their count
+ */
+static LLVMValueRef string_view(CodegenContext *ctx, InternedString str) {
+    LLVMValueRef parts[2] = {
+        LLVMBuildGlobalStringPtr(ctx->builder, str.data, "str"),
+        LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm_ctx), str.len, 0)
+    };
+    return LLVMConstStructInContext(ctx->llvm_ctx, parts, 2, 0);
+}
+
 /*
  * Generate code for a literal expression
  */
 static LLVMValueRef codegen_literal(CodegenContext *ctx, Expr *expr) {
     switch (expr->kind) {
         case EXPR_INT_LIT:
-            return LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm_ctx),
+            return LLVMConstInt(expr_llvm_type(ctx, expr, LLVMInt64TypeInContext(ctx->llvm_ctx)),
                 expr->int_lit.value, 0);
 
         case EXPR_FLOAT_LIT:
-            return LLVMConstReal(LLVMDoubleTypeInContext(ctx->llvm_ctx),
+            return LLVMConstReal(expr_llvm_type(ctx, expr, LLVMDoubleTypeInContext(ctx->llvm_ctx)),
                 expr->float_lit.value);
 
         case EXPR_BOOL_LIT:
@@ -125,40 +245,293 @@ static LLVMValueRef codegen_literal(CodegenContext *ctx, Expr *expr) {
                 expr->char_lit.value, 0);
 
         case EXPR_STRING_LIT:
-            return LLVMBuildGlobalStringPtr(ctx->builder,
-                expr->string_lit.value.data, "str");
+            return string_view(ctx, expr->string_lit.value);
 
         default:
             return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
     }
 }
 
+/*
+ * Lower a value computed at compile time to an LLVM constant
+ */
+static LLVMValueRef codegen_const(CodegenContext *ctx, const ConstValue *value) {
+    Type *type = mono_subst(ctx, value->type);
+
+    switch (value->kind) {
+        case CONST_UNIT:
+            return NULL;
+
+        case CONST_BOOL:
+            return LLVMConstInt(LLVMInt1TypeInContext(ctx->llvm_ctx), value->b ? 1 : 0, 0);
+
+        case CONST_INT:
+            return LLVMConstInt(lower_type(ctx, type), value->bits, !type_is_unsigned(type));
+
+        case CONST_FLOAT:
+            return LLVMConstReal(lower_type(ctx, type), value->f);
+
+        case CONST_CHAR:
+            return LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm_ctx), value->ch, 0);
+
+        case CONST_STRING:
+            return string_view(ctx, value->str);
+
+        case CONST_AGGREGATE:
+            break;
+    }
+
+    LLVMTypeRef llvm_type = lower_type(ctx, type);
+    bool is_array = LLVMGetTypeKind(llvm_type) == LLVMArrayTypeKind;
+    if (!is_array && LLVMGetTypeKind(llvm_type) != LLVMStructTypeKind) {
+        return LLVMGetUndef(llvm_type);
+    }
+
+    /* Struct fields go to their slots; padding stays zero */
+    size_t count = value->aggregate.count;
+    size_t slot_count = is_array ? count : LLVMCountStructElementTypes(llvm_type);
+    LLVMValueRef *elements = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef,
+        slot_count ? slot_count : 1);
+    for (size_t i = 0; i < slot_count; i++) {
+        elements[i] = NULL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        unsigned slot = is_array ? (unsigned)i : lower_field_index(ctx, type, (uint32_t)i);
+        if (slot < slot_count) {
+            elements[slot] = codegen_const(ctx, &value->aggregate.elements[i]);
+        }
+    }
+    for (size_t i = 0; i < slot_count; i++) {
+        if (!elements[i]) {
+            elements[i] = LLVMConstNull(is_array ? LLVMGetElementType(llvm_type)
+                : LLVMStructGetTypeAtIndex(llvm_type, (unsigned)i));
+        }
+    }
+
+    if (is_array) {
+        return LLVMConstArray(LLVMGetElementType(llvm_type), elements, (unsigned)count);
+    }
+    if (LLVMIsLiteralStruct(llvm_type)) {
+        return LLVMConstStructInContext(ctx->llvm_ctx, elements, (unsigned)slot_count,
+            LLVMIsPackedStruct(llvm_type));
+    }
+    return LLVMConstNamedStruct(llvm_type, elements, (unsigned)slot_count);
+}
+
+/*
+ * Symbol name of a procedure; methods are qualified by their type
+ */
+InternedString codegen_proc_name(CodegenContext *ctx, ProcDecl *proc) {
+    Decl *owner = proc->owner;
+    if (!owner) {
+        return proc->name;
+    }
+
+    InternedString type_name;
+    switch (owner->kind) {
+        case DECL_RECORD: type_name = owner->record.name; break;
+        case DECL_ENUM:   type_name = owner->enum_.name; break;
+        case DECL_MODAL:  type_name = owner->modal.name; break;
+        case DECL_CLASS:  type_name = owner->class_.name; break;
+        default:          return proc->name;
+    }
+
+    size_t len = type_name.len + 1 + proc->name.len;
+    char *buf = ARENA_ALLOC_ARRAY(ctx->arena, char, len + 1);
+    snprintf(buf, len + 1, "%s.%s", type_name.data, proc->name.data);
+    return string_pool_intern_len(ctx->strings, buf, len);
+}
+
+/*
+ * Get the function for a non-generic procedure, declaring it on first use
+ */
+static LLVMValueRef proc_function(CodegenContext *ctx, ProcDecl *proc) {
+    LLVMValueRef fn = ptr_map_get(&ctx->func_cache, proc);
+    if (!fn) {
+        fn = codegen_declare_proc(ctx, proc, codegen_proc_name(ctx, proc).data);
+        ptr_map_set(&ctx->func_cache, proc, fn);
+    }
+    return fn;
+}
+
+/*
+ * Get the function of `name` in an extern block, declaring it on first
+ * use. Parameters are C values: nothing is passed as a view.
+ */
+static LLVMValueRef extern_function(CodegenContext *ctx, ExternBlock *block,
+                                    InternedString name) {
+    for (size_t i = 0; i < vec_len(block->funcs); i++) {
+        ExternFuncDecl *func = &block->funcs[i];
+        if (!interned_eq(func->name, name)) continue;
+
+        LLVMValueRef fn = ptr_map_get(&ctx->func_cache, func);
+        if (fn) return fn;
+
+        Type *sig = func->signature;
+        if (!sig || sig->kind != TYPE_FUNCTION) return NULL;
+        size_t count = vec_len(sig->function.params);
+        LLVMTypeRef *params = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef, count ? count : 1);
+        for (size_t k = 0; k < count; k++) {
+            params[k] = lower_type(ctx, sig->function.params[k]);
+        }
+        const char *symbol = func->link_name.data ? func->link_name.data : func->name.data;
+        fn = LLVMGetNamedFunction(ctx->module, symbol);
+        if (!fn) {
+            fn = abi_declare(ctx, symbol, lower_type(ctx, sig->function.return_type),
+                params, (unsigned)count);
+        }
+        ptr_map_set(&ctx->func_cache, func, fn);
+        return fn;
+    }
+    return NULL;
+}
+
+/*
+ * Get the stack slot of a local binding, or NULL if the symbol is not a
+ * local of the body being generated
+ */
+static LLVMValueRef local_slot(CodegenContext *ctx, Symbol *sym) {
+    if (sym->kind != SYM_VAR && sym->kind != SYM_PARAM) {
+        return NULL;
+    }
+    return sym->slot < ctx->local_count ? ctx->locals[sym->slot] : NULL;
+}
+
+/*
+ * Mark the start or end of a stack slot's lifetime, so slots of bindings
+ * that are never live at the same time can share stack space
+ */
+static void emit_lifetime(CodegenContext *ctx, LLVMValueRef slot, bool start) {
+    if (!ctx->target_data) {
+        return;
+    }
+
+    const char *name = start ? "llvm.lifetime.start" : "llvm.lifetime.end";
+    unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+    LLVMTypeRef ptr_type = LLVMTypeOf(slot);
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(ctx->module, id, &ptr_type, 1);
+    LLVMTypeRef fn_type = LLVMIntrinsicGetType(ctx->llvm_ctx, id, &ptr_type, 1);
+
+    unsigned long long size = LLVMABISizeOfType(ctx->target_data,
+        LLVMGetAllocatedType(slot));
+    LLVMValueRef args[] = {
+        LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm_ctx), size, 0),
+        slot
+    };
+    LLVMBuildCall2(ctx->builder, fn_type, fn, args, 2, "");
+}
+
+/*
+ * Drop flag of a binding whose drop depends on the path taken (see
+ * drops.c), created false on first use; NULL for every other binding
+ */
+static LLVMValueRef drop_flag(CodegenContext *ctx, Symbol *sym) {
+    if (!sym || !sym->drop_flag || sym->slot >= ctx->local_count) {
+        return NULL;
+    }
+    if (!ctx->drop_flags[sym->slot]) {
+        LLVMTypeRef i1 = LLVMInt1TypeInContext(ctx->llvm_ctx);
+        LLVMValueRef flag = entry_alloca(ctx, i1, "drop.flag");
+
+        /* Cleared before anything else in the entry block runs */
+        LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx->llvm_ctx);
+        LLVMValueRef next = LLVMGetNextInstruction(flag);
+        if (next) {
+            LLVMPositionBuilderBefore(builder, next);
+        } else {
+            LLVMPositionBuilderAtEnd(builder, ctx->entry_block);
+        }
+        LLVMBuildStore(builder, LLVMConstInt(i1, 0, 0), flag);
+        LLVMDisposeBuilder(builder);
+        ctx->drop_flags[sym->slot] = flag;
+    }
+    return ctx->drop_flags[sym->slot];
+}
+
+/* Record whether a binding owns a value on the current path */
+static void set_drop_flag(CodegenContext *ctx, Symbol *sym, bool owns) {
+    LLVMValueRef flag = drop_flag(ctx, sym);
+    if (flag) {
+        LLVMBuildStore(ctx->builder,
+            LLVMConstInt(LLVMInt1TypeInContext(ctx->llvm_ctx), owns, 0), flag);
+    }
+}
+
+/*
+ * Run the cleanups of the scopes being left (see drops.c), innermost first
+ */
+static void emit_cleanups(CodegenContext *ctx, Vec(Cleanup) cleanups) {
+    for (size_t i = 0; i < vec_len(cleanups) && !block_terminated(ctx); i++) {
+        Cleanup *cleanup = &cleanups[i];
+        if (cleanup->kind == CLEANUP_DEFER) {
+            codegen_expr_internal(ctx, cleanup->deferred);
+            continue;
+        }
+        if (cleanup->kind == CLEANUP_ELIDED) {
+            continue;
+        }
+
+        LLVMValueRef slot = local_slot(ctx, cleanup->sym);
+        if (!slot) {
+            continue;
+        }
+        if (cleanup->kind == CLEANUP_DROP) {
+            drop_in_place(ctx, cleanup->sym->type, slot);
+            continue;
+        }
+
+        /* CLEANUP_DROP_FLAGGED */
+        LLVMValueRef flag = drop_flag(ctx, cleanup->sym);
+        LLVMBasicBlockRef drop = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+            ctx->current_func, "drop");
+        LLVMBasicBlockRef next = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+            ctx->current_func, "dropped");
+        LLVMBuildCondBr(ctx->builder, LLVMBuildLoad2(ctx->builder,
+            LLVMInt1TypeInContext(ctx->llvm_ctx), flag, ""), drop, next);
+        LLVMPositionBuilderAtEnd(ctx->builder, drop);
+        drop_in_place(ctx, cleanup->sym->type, slot);
+        LLVMBuildBr(ctx->builder, next);
+        LLVMPositionBuilderAtEnd(ctx->builder, next);
+    }
+}
+
 /*
  * Generate code for an identifier
  */
 static LLVMValueRef codegen_ident(CodegenContext *ctx, Expr *expr) {
-    /* Look up in locals */
-    uintptr_t val;
     InternedString name = expr->ident.name;
+    Symbol *sym = expr->ident.resolved;
 
-    /* Check local variables */
-    Symbol *sym = scope_lookup_from(ctx->sema->current_scope, name);
     if (sym) {
-        if (map_get(&ctx->locals, (uintptr_t)sym, &val)) {
-            /* Load from alloca */
-            return LLVMBuildLoad2(ctx->builder,
-                LLVMGetAllocatedType((LLVMValueRef)val),
-                (LLVMValueRef)val, name.data);
+        /* Local variables and parameters: load from their stack slot */
+        LLVMValueRef slot = local_slot(ctx, sym);
+        if (slot) {
+            LLVMValueRef value = LLVMBuildLoad2(ctx->builder,
+                LLVMGetAllocatedType(slot), slot, name.data);
+            if (expr->ident.is_move) {
+                set_drop_flag(ctx, sym, false);
+            }
+            if (expr->ident.is_last_use) {
+                /* The binding is dead from here on this path */
+                emit_lifetime(ctx, slot, false);
+            }
+            return value;
         }
 
-        /* Check function cache */
-        if (map_get(&ctx->func_cache, (uintptr_t)sym, &val)) {
-            return (LLVMValueRef)val;
+        /* Procedures (generic ones are only reachable through calls) */
+        if (sym->kind == SYM_PROC && sym->decl && sym->decl->kind == DECL_PROC &&
+            vec_len(sym->decl->proc.generics) == 0) {
+            return proc_function(ctx, &sym->decl->proc);
+        }
+        if (sym->kind == SYM_PROC && sym->decl && sym->decl->kind == DECL_EXTERN) {
+            LLVMValueRef fn = extern_function(ctx, &sym->decl->extern_, sym->name);
+            if (fn) return fn;
         }
 
         /* Check global cache */
-        if (map_get(&ctx->global_cache, (uintptr_t)sym, &val)) {
-            return (LLVMValueRef)val;
+        LLVMValueRef global = ptr_map_get(&ctx->global_cache, sym);
+        if (global) {
+            return global;
         }
     }
 
@@ -166,6 +539,157 @@ static LLVMValueRef codegen_ident(CodegenContext *ctx, Expr *expr) {
     return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
 }
 
+/*
+ * Generate code for a field read. Fields are found by the member indices
+ * assigned when the record's member table was built, and stored at the
+ * slot the layout gives them.
+ */
+static LLVMValueRef codegen_field(CodegenContext *ctx, Expr *expr) {
+    LLVMValueRef object = codegen_expr_internal(ctx, expr->field.object);
+    Type *type = expr_type(ctx, expr->field.object);
+    Type *decl_type = (type && type->kind == TYPE_GENERIC_INST) ? type->generic_inst.base : type;
+
+    if (object && decl_type && decl_type->kind == TYPE_RECORD && decl_type->nominal.sym &&
+        LLVMGetTypeKind(LLVMTypeOf(object)) == LLVMStructTypeKind) {
+        Member *field = member_field(decl_members(decl_type->nominal.sym->decl),
+            expr->field.field);
+        if (field) {
+            return LLVMBuildExtractValue(ctx->builder, object,
+                lower_field_index(ctx, type, field->index), expr->field.field.data);
+        }
+    }
+
+    /* TODO: Tuple fields and field access through pointers */
+    return LLVMGetUndef(expr_llvm_type(ctx, expr, LLVMInt32TypeInContext(ctx->llvm_ctx)));
+}
+
+/*
+ * Address of an indexed array element. A local array is indexed in its
+ * stack slot; with `spill`, any other array value is copied to one first.
+ * Returns NULL if the element has no address.
+ */
+static LLVMValueRef index_addr(CodegenContext *ctx, Expr *expr, bool spill) {
+    Type *type = expr_type(ctx, expr->index.object);
+    if (!type || type->kind != TYPE_ARRAY) {
+        return NULL;
+    }
+
+    LLVMTypeRef array_type = lower_type(ctx, type);
+    Expr *object = expr->index.object;
+    LLVMValueRef base = object->kind == EXPR_IDENT && object->ident.resolved
+        ? local_slot(ctx, object->ident.resolved) : NULL;
+    if (!base) {
+        if (!spill) return NULL;
+        LLVMValueRef value = codegen_expr_internal(ctx, object);
+        if (!value) return NULL;
+        base = entry_alloca(ctx, array_type, "array");
+        LLVMBuildStore(ctx->builder, value, base);
+    }
+
+    LLVMValueRef indices[2] = {
+        LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm_ctx), 0, 0),
+        codegen_expr_internal(ctx, expr->index.index)
+    };
+    return LLVMBuildInBoundsGEP2(ctx->builder, array_type, base, indices, 2, "elem.addr");
+}
+
+/*
+ * Generate code for an array literal, `[a, b, c]` or `[value; count]`
+ */
+static LLVMValueRef codegen_array(CodegenContext *ctx, Expr *expr) {
+    Type *type = expr_type(ctx, expr);
+    LLVMTypeRef llvm_type = expr_llvm_type(ctx, expr, NULL);
+    if (!type || type->kind != TYPE_ARRAY || !llvm_type) {
+        return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
+    }
+
+    LLVMValueRef value = LLVMGetUndef(llvm_type);
+    if (!expr->array.repeat_value) {
+        for (size_t i = 0; i < vec_len(expr->array.elements); i++) {
+            LLVMValueRef elem = codegen_expr_internal(ctx, expr->array.elements[i]);
+            if (elem) {
+                value = LLVMBuildInsertValue(ctx->builder, value, elem, (unsigned)i, "");
+            }
+        }
+        return value;
+    }
+
+    LLVMValueRef elem = codegen_expr_internal(ctx, expr->array.repeat_value);
+    size_t count = type->array.size;
+    if (!elem || count == 0) {
+        return value;
+    }
+    if (LLVMIsConstant(elem)) {
+        LLVMValueRef *elements = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef, count);
+        for (size_t i = 0; i < count; i++) {
+            elements[i] = elem;
+        }
+        return LLVMConstArray(LLVMTypeOf(elem), elements, (unsigned)count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        value = LLVMBuildInsertValue(ctx->builder, value, elem, (unsigned)i, "");
+    }
+    return value;
+}
+
+/*
+ * Generate code for an array element read
+ */
+static LLVMValueRef codegen_index(CodegenContext *ctx, Expr *expr) {
+    LLVMTypeRef elem_type = expr_llvm_type(ctx, expr, NULL);
+    LLVMValueRef addr = elem_type ? index_addr(ctx, expr, true) : NULL;
+    if (!addr) {
+        return LLVMGetUndef(elem_type ? elem_type : LLVMInt32TypeInContext(ctx->llvm_ctx));
+    }
+    return LLVMBuildLoad2(ctx->builder, elem_type, addr, "elem");
+}
+
+/*
+ * Generate code for a record literal, inserting each field at its slot
+ */
+static LLVMValueRef codegen_record(CodegenContext *ctx, Expr *expr) {
+    Type *type = expr_type(ctx, expr);
+    LLVMTypeRef llvm_type = expr_llvm_type(ctx, expr, NULL);
+    Type *decl_type = (type && type->kind == TYPE_GENERIC_INST) ? type->generic_inst.base : type;
+
+    if (!llvm_type || !decl_type || decl_type->kind != TYPE_RECORD || !decl_type->nominal.sym) {
+        return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
+    }
+
+    MemberTable *members = decl_members(decl_type->nominal.sym->decl);
+    LLVMValueRef value = LLVMGetUndef(llvm_type);
+    for (size_t i = 0; i < vec_len(expr->record.field_names); i++) {
+        Member *field = member_field(members, expr->record.field_names[i]);
+        LLVMValueRef init = codegen_expr_internal(ctx, expr->record.field_values[i]);
+        if (field && init) {
+            value = LLVMBuildInsertValue(ctx->builder, value, init,
+                lower_field_index(ctx, type, field->index), "");
+        }
+    }
+    return value;
+}
+
+/*
+ * Generate code for a tuple expression
+ */
+static LLVMValueRef codegen_tuple(CodegenContext *ctx, Expr *expr) {
+    Type *type = expr_type(ctx, expr);
+    LLVMTypeRef llvm_type = expr_llvm_type(ctx, expr, NULL);
+    if (!llvm_type || LLVMGetTypeKind(llvm_type) != LLVMStructTypeKind) {
+        return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
+    }
+
+    LLVMValueRef value = LLVMGetUndef(llvm_type);
+    for (size_t i = 0; i < vec_len(expr->tuple.elements); i++) {
+        LLVMValueRef elem = codegen_expr_internal(ctx, expr->tuple.elements[i]);
+        if (elem) {
+            value = LLVMBuildInsertValue(ctx->builder, value, elem,
+                lower_field_index(ctx, type, (uint32_t)i), "");
+        }
+    }
+    return value;
+}
+
 /*
  * Generate code for a binary expression
  */
@@ -182,27 +706,30 @@ static LLVMValueRef codegen_binary(CodegenContext *ctx, Expr *expr) {
     bool is_float = (LLVMGetTypeKind(left_type) == LLVMFloatTypeKind ||
                      LLVMGetTypeKind(left_type) == LLVMDoubleTypeKind ||
                      LLVMGetTypeKind(left_type) == LLVMHalfTypeKind);
+    bool is_unsigned = type_is_unsigned(expr_type(ctx, expr->binary.left));
 
     switch (expr->binary.op) {
         /* Arithmetic */
         case BINOP_ADD:
             if (is_float) return LLVMBuildFAdd(ctx->builder, left, right, "fadd");
-            return LLVMBuildAdd(ctx->builder, left, right, "add");
+            return overflow_arith(ctx, expr->binary.op, is_unsigned, left, right, expr->span);
 
         case BINOP_SUB:
             if (is_float) return LLVMBuildFSub(ctx->builder, left, right, "fsub");
-            return LLVMBuildSub(ctx->builder, left, right, "sub");
+            return overflow_arith(ctx, expr->binary.op, is_unsigned, left, right, expr->span);
 
         case BINOP_MUL:
             if (is_float) return LLVMBuildFMul(ctx->builder, left, right, "fmul");
-            return LLVMBuildMul(ctx->builder, left, right, "mul");
+            return overflow_arith(ctx, expr->binary.op, is_unsigned, left, right, expr->span);
 
         case BINOP_DIV:
             if (is_float) return LLVMBuildFDiv(ctx->builder, left, right, "fdiv");
+            if (is_unsigned) return LLVMBuildUDiv(ctx->builder, left, right, "udiv");
             return LLVMBuildSDiv(ctx->builder, left, right, "sdiv");
 
         case BINOP_MOD:
             if (is_float) return LLVMBuildFRem(ctx->builder, left, right, "frem");
+            if (is_unsigned) return LLVMBuildURem(ctx->builder, left, right, "urem");
             return LLVMBuildSRem(ctx->builder, left, right, "srem");
 
         /* Comparison */
@@ -216,19 +743,23 @@ static LLVMValueRef codegen_binary(CodegenContext *ctx, Expr *expr) {
 
         case BINOP_LT:
             if (is_float) return LLVMBuildFCmp(ctx->builder, LLVMRealOLT, left, right, "flt");
-            return LLVMBuildICmp(ctx->builder, LLVMIntSLT, left, right, "slt");
+            return LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntULT : LLVMIntSLT,
+                left, right, "lt");
 
         case BINOP_LE:
             if (is_float) return LLVMBuildFCmp(ctx->builder, LLVMRealOLE, left, right, "fle");
-            return LLVMBuildICmp(ctx->builder, LLVMIntSLE, left, right, "sle");
+            return LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntULE : LLVMIntSLE,
+                left, right, "le");
 
         case BINOP_GT:
             if (is_float) return LLVMBuildFCmp(ctx->builder, LLVMRealOGT, left, right, "fgt");
-            return LLVMBuildICmp(ctx->builder, LLVMIntSGT, left, right, "sgt");
+            return LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntUGT : LLVMIntSGT,
+                left, right, "gt");
 
         case BINOP_GE:
             if (is_float) return LLVMBuildFCmp(ctx->builder, LLVMRealOGE, left, right, "fge");
-            return LLVMBuildICmp(ctx->builder, LLVMIntSGE, left, right, "sge");
+            return LLVMBuildICmp(ctx->builder, is_unsigned ? LLVMIntUGE : LLVMIntSGE,
+                left, right, "ge");
 
         /* Logical */
         case BINOP_AND:
@@ -251,6 +782,7 @@ static LLVMValueRef codegen_binary(CodegenContext *ctx, Expr *expr) {
             return LLVMBuildShl(ctx->builder, left, right, "shl");
 
         case BINOP_SHR:
+            if (is_unsigned) return LLVMBuildLShr(ctx->builder, left, right, "shr");
             return LLVMBuildAShr(ctx->builder, left, right, "shr");
 
         /* Power - use llvm.pow intrinsic for floats */
@@ -287,7 +819,12 @@ static LLVMValueRef codegen_unary(CodegenContext *ctx, Expr *expr) {
     switch (expr->unary.op) {
         case UNOP_NEG:
             if (is_float) return LLVMBuildFNeg(ctx->builder, operand, "fneg");
-            return LLVMBuildNeg(ctx->builder, operand, "neg");
+            /* `-128` is the i8 minimum, not a negation that overflows */
+            if (expr->unary.operand->kind == EXPR_INT_LIT) {
+                return LLVMBuildNeg(ctx->builder, operand, "neg");
+            }
+            return overflow_neg(ctx, type_is_unsigned(expr_type(ctx, expr->unary.operand)),
+                operand, expr->span);
 
         case UNOP_NOT:
             return LLVMBuildNot(ctx->builder, operand, "not");
@@ -296,9 +833,10 @@ static LLVMValueRef codegen_unary(CodegenContext *ctx, Expr *expr) {
             return LLVMBuildNot(ctx->builder, operand, "bitnot");
 
         case UNOP_DEREF:
-            /* Dereference pointer */
+            /* Dereference pointer (the loaded type is the expression's type) */
             return LLVMBuildLoad2(ctx->builder,
-                LLVMGetElementType(type), operand, "deref");
+                expr_llvm_type(ctx, expr, LLVMInt32TypeInContext(ctx->llvm_ctx)),
+                operand, "deref");
 
         case UNOP_ADDR:
         case UNOP_ADDR_MUT:
@@ -310,26 +848,93 @@ static LLVMValueRef codegen_unary(CodegenContext *ctx, Expr *expr) {
     }
 }
 
+/*
+ * Get the callee of a call, instantiating generic procedures for the
+ * call's (substituted) type arguments
+ */
+static LLVMValueRef call_target(CodegenContext *ctx, Expr *expr) {
+    Expr *callee = expr->call.callee;
+    Symbol *sym = callee->kind == EXPR_IDENT ? callee->ident.resolved : NULL;
+
+    if (sym && sym->kind == SYM_PROC && sym->decl && sym->decl->kind == DECL_PROC &&
+        vec_len(expr->call.type_args) > 0) {
+        Vec(Type *) args = vec_new(Type *);
+        for (size_t i = 0; i < vec_len(expr->call.type_args); i++) {
+            vec_push(args, mono_subst(ctx, expr->call.type_args[i]));
+        }
+        LLVMValueRef fn = mono_instantiate(ctx, &sym->decl->proc, args);
+        vec_free(args);
+        return fn;
+    }
+
+    return codegen_expr_internal(ctx, callee);
+}
+
+/*
+ * Address to pass for an argument passed by address: a local binding is
+ * passed in place, any other value through a temporary
+ */
+static LLVMValueRef view_argument(CodegenContext *ctx, Expr *arg, Type *type,
+                                  LLVMTypeRef param_type) {
+    LLVMValueRef addr = NULL;
+    if (arg->kind == EXPR_IDENT && arg->ident.resolved) {
+        LLVMValueRef slot = local_slot(ctx, arg->ident.resolved);
+        if (slot && LLVMGetAllocatedType(slot) == lower_type(ctx, type)) {
+            addr = slot;
+        }
+    }
+    if (!addr) {
+        LLVMValueRef value = codegen_expr_internal(ctx, arg);
+        addr = entry_alloca(ctx, LLVMTypeOf(value), "arg");
+        align_slot(ctx, addr, type);
+        LLVMBuildStore(ctx->builder, value, addr);
+    }
+    return LLVMBuildPointerCast(ctx->builder, addr, param_type, "");
+}
+
 /*
  * Generate code for a call expression
  */
 static LLVMValueRef codegen_call(CodegenContext *ctx, Expr *expr) {
-    LLVMValueRef callee = codegen_expr_internal(ctx, expr->call.callee);
-    if (!callee) {
+    LLVMValueRef callee = call_target(ctx, expr);
+    if (!callee || !LLVMIsAFunction(callee)) {
         return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
     }
 
+    /* The called procedure and its parameter types, for views */
+    Symbol *sym = expr->call.callee->kind == EXPR_IDENT ? expr->call.callee->ident.resolved : NULL;
+    ProcDecl *proc = sym && sym->kind == SYM_PROC && sym->decl && sym->decl->kind == DECL_PROC
+        ? &sym->decl->proc : NULL;
+    Type *sig = proc ? proc->signature : NULL;
+    Vec(Type *) type_args = NULL;
+    if (sig && sig->kind == TYPE_FUNCTION && vec_len(expr->call.type_args) > 0) {
+        type_args = vec_new(Type *);
+        for (size_t i = 0; i < vec_len(expr->call.type_args); i++) {
+            vec_push(type_args, mono_subst(ctx, expr->call.type_args[i]));
+        }
+    }
+
+    const AbiSignature *abi = abi_signature(ctx, callee);
     size_t arg_count = vec_len(expr->call.args);
-    LLVMValueRef *args = arena_alloc(ctx->arena,
-        arg_count * sizeof(LLVMValueRef), _Alignof(LLVMValueRef));
+    LLVMValueRef *args = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef, arg_count ? arg_count : 1);
+    bool typed = abi && abi->param_count == arg_count;
 
     for (size_t i = 0; i < arg_count; i++) {
-        args[i] = codegen_expr_internal(ctx, expr->call.args[i]);
+        Type *param = NULL;
+        if (typed && sig && sig->kind == TYPE_FUNCTION && i < vec_len(proc->params)) {
+            param = sig->function.params[i];
+            param = type_args ? type_substitute(&ctx->sema->type_ctx, param, type_args)
+                              : mono_subst(ctx, param);
+        }
+        if (param && passed_by_address(ctx, param, proc->params[i].is_move)) {
+            args[i] = view_argument(ctx, expr->call.args[i], param, abi->params[i].type);
+        } else {
+            args[i] = codegen_expr_internal(ctx, expr->call.args[i]);
+        }
     }
+    vec_free(type_args);
 
-    LLVMTypeRef fn_type = LLVMGlobalGetValueType(callee);
-    return LLVMBuildCall2(ctx->builder, fn_type, callee, args,
-        (unsigned)arg_count, "call");
+    return abi_call(ctx, callee, args, (unsigned)arg_count);
 }
 
 /*
@@ -354,7 +959,10 @@ static LLVMValueRef codegen_if(CodegenContext *ctx, Expr *expr) {
     /* Then block */
     LLVMPositionBuilderAtEnd(ctx->builder, then_bb);
     LLVMValueRef then_val = codegen_expr_internal(ctx, expr->if_.then_branch);
-    LLVMBuildBr(ctx->builder, merge_bb);
+    bool then_falls_through = !block_terminated(ctx);
+    if (then_falls_through) {
+        LLVMBuildBr(ctx->builder, merge_bb);
+    }
     then_bb = LLVMGetInsertBlock(ctx->builder);
 
     /* Else block */
@@ -362,18 +970,19 @@ static LLVMValueRef codegen_if(CodegenContext *ctx, Expr *expr) {
     LLVMValueRef else_val = NULL;
     if (expr->if_.else_branch) {
         else_val = codegen_expr_internal(ctx, expr->if_.else_branch);
-    } else {
-        else_val = LLVMConstNull(LLVMTypeOf(then_val));
     }
-    LLVMBuildBr(ctx->builder, merge_bb);
+    bool else_falls_through = !block_terminated(ctx);
+    if (else_falls_through) {
+        LLVMBuildBr(ctx->builder, merge_bb);
+    }
     else_bb = LLVMGetInsertBlock(ctx->builder);
 
     /* Merge block */
     LLVMPositionBuilderAtEnd(ctx->builder, merge_bb);
 
-    /* Create PHI node for result */
-    if (then_val && else_val &&
-        LLVMGetTypeKind(LLVMTypeOf(then_val)) != LLVMVoidTypeKind) {
+    /* Create PHI node for result when both branches produce a value */
+    if (then_falls_through && else_falls_through && then_val && else_val &&
+        LLVMTypeOf(then_val) == LLVMTypeOf(else_val)) {
         LLVMValueRef phi = LLVMBuildPhi(ctx->builder,
             LLVMTypeOf(then_val), "iftmp");
         LLVMValueRef incoming_vals[] = { then_val, else_val };
@@ -382,24 +991,367 @@ static LLVMValueRef codegen_if(CodegenContext *ctx, Expr *expr) {
         return phi;
     }
 
-    return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
+    /* Only one branch reaches the merge block */
+    if (then_falls_through && !else_falls_through) return then_val;
+    if (else_falls_through && !then_falls_through) return else_val;
+    return NULL;
+}
+
+/*
+ * Match lowering state: the scrutinee's stack slot and the block of each
+ * arm body, which every leaf that runs the arm branches to
+ */
+typedef struct MatchLowering {
+    LLVMValueRef root;              /* Scrutinee slot (NULL if it has no layout) */
+    LLVMBasicBlockRef *arm_blocks;  /* Created by the first leaf of each arm */
+} MatchLowering;
+
+/* A fresh block in the current function */
+static LLVMBasicBlockRef new_block(CodegenContext *ctx, const char *name) {
+    return LLVMAppendBasicBlockInContext(ctx->llvm_ctx, ctx->current_func, name);
+}
+
+/*
+ * Address of a sub-value of the scrutinee, or NULL if it has no memory
+ * layout (modal states lower to nothing yet)
+ */
+static LLVMValueRef match_path_addr(CodegenContext *ctx, MatchLowering *m, MatchPath *path) {
+    if (path->kind == MATCH_PATH_ROOT) {
+        return m->root;
+    }
+    if (path->kind == MATCH_PATH_FIELD || !path->type) {
+        return NULL;
+    }
+
+    LLVMValueRef parent = match_path_addr(ctx, m, path->parent);
+    if (!parent) {
+        return NULL;
+    }
+    LLVMTypeRef parent_type = lower_type(ctx, mono_subst(ctx, path->parent->type));
+    if (LLVMGetTypeKind(parent_type) != LLVMStructTypeKind) {
+        return NULL;
+    }
+
+    if (path->kind == MATCH_PATH_ELEMENT) {
+        return LLVMBuildStructGEP2(ctx->builder, parent_type, parent,
+            lower_field_index(ctx, path->parent->type, path->index), "elem");
+    }
+
+    return lower_payload_addr(ctx, path->parent->type, parent, path->type);
+}
+
+static LLVMValueRef match_path_load(CodegenContext *ctx, MatchLowering *m, MatchPath *path) {
+    LLVMValueRef addr = match_path_addr(ctx, m, path);
+    if (!addr) {
+        return NULL;
+    }
+    LLVMTypeRef type = lower_type(ctx, mono_subst(ctx, path->type));
+    if (LLVMGetTypeKind(type) == LLVMVoidTypeKind) {
+        return NULL;
+    }
+
+    /* Payloads are stored aligned for the most aligned alternative */
+    return LLVMBuildLoad2(ctx->builder, type, addr, "");
+}
+
+/* Constant of a range key in the value's type */
+static LLVMValueRef range_key(LLVMTypeRef type, const Decision *d, uint64_t key) {
+    return LLVMConstInt(type, key ^ d->switch_.key_bias, 0);
+}
+
+/*
+ * Lower an integer, char or bool switch. Small case sets become one
+ * `switch` over every value (a jump table); otherwise single values stay
+ * in the `switch` and ranges are tested in its default block with one
+ * unsigned compare each ((v - lo) <= (hi - lo)).
+ */
+static void lower_range_switch(CodegenContext *ctx, Decision *d, LLVMValueRef value,
+                               LLVMBasicBlockRef *case_blocks, LLVMBasicBlockRef fallback) {
+    const uint64_t table_limit = 64;
+    LLVMTypeRef type = LLVMTypeOf(value);
+
+    uint64_t total = 0;
+    uint32_t singles = 0;
+    for (uint32_t i = 0; i < d->switch_.case_count; i++) {
+        DecisionCase *c = &d->switch_.cases[i];
+        uint64_t width = c->hi - c->lo;
+        total += width < table_limit ? width + 1 : table_limit + 1;
+        singles += c->lo == c->hi;
+    }
+
+    if (total <= table_limit) {
+        LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, value, fallback, (unsigned)total);
+        for (uint32_t i = 0; i < d->switch_.case_count; i++) {
+            DecisionCase *c = &d->switch_.cases[i];
+            for (uint64_t key = c->lo;; key++) {
+                LLVMAddCase(sw, range_key(type, d, key), case_blocks[i]);
+                if (key == c->hi) break;
+            }
+        }
+        return;
+    }
+
+    LLVMBasicBlockRef ranges = singles < d->switch_.case_count
+        ? new_block(ctx, "match.ranges") : fallback;
+    LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, value, ranges, singles);
+    for (uint32_t i = 0; i < d->switch_.case_count; i++) {
+        DecisionCase *c = &d->switch_.cases[i];
+        if (c->lo == c->hi) {
+            LLVMAddCase(sw, range_key(type, d, c->lo), case_blocks[i]);
+        }
+    }
+    if (ranges == fallback) {
+        return;
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, ranges);
+    for (uint32_t i = 0; i < d->switch_.case_count; i++) {
+        DecisionCase *c = &d->switch_.cases[i];
+        if (c->lo == c->hi) continue;
+        LLVMValueRef offset = LLVMBuildSub(ctx->builder, value, range_key(type, d, c->lo), "");
+        LLVMValueRef inside = LLVMBuildICmp(ctx->builder, LLVMIntULE, offset,
+            LLVMConstInt(type, c->hi - c->lo, 0), "inrange");
+        LLVMBasicBlockRef next = new_block(ctx, "match.ranges");
+        LLVMBuildCondBr(ctx->builder, inside, case_blocks[i], next);
+        LLVMPositionBuilderAtEnd(ctx->builder, next);
+    }
+    LLVMBuildBr(ctx->builder, fallback);
+}
+
+/* `value == literal` for float and string literals */
+static LLVMValueRef literal_equals(CodegenContext *ctx, LLVMValueRef value, Expr *literal) {
+    if (literal->kind == EXPR_FLOAT_LIT) {
+        return LLVMBuildFCmp(ctx->builder, LLVMRealOEQ, value,
+            LLVMConstReal(LLVMTypeOf(value), literal->float_lit.value), "");
+    }
+
+    LLVMValueRef expected = codegen_literal(ctx, literal);
+    if (literal->kind != EXPR_STRING_LIT ||
+        LLVMGetTypeKind(LLVMTypeOf(value)) != LLVMStructTypeKind) {
+        return LLVMBuildICmp(ctx->builder, LLVMIntEQ, value, expected, "");
+    }
+
+    /* string views: equal lengths and equal bytes */
+    LLVMTypeRef i64 = LLVMInt64TypeInContext(ctx->llvm_ctx);
+    LLVMTypeRef ptr = LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm_ctx), 0);
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, "memcmp");
+    LLVMTypeRef params[] = { ptr, ptr, i64 };
+    LLVMTypeRef fn_type = LLVMFunctionType(LLVMInt32TypeInContext(ctx->llvm_ctx), params, 3, 0);
+    if (!fn) {
+        fn = LLVMAddFunction(ctx->module, "memcmp", fn_type);
+    }
+
+    size_t len = literal->string_lit.value.len;
+    LLVMValueRef data = LLVMBuildExtractValue(ctx->builder, value, 0, "");
+    LLVMValueRef same_len = LLVMBuildICmp(ctx->builder, LLVMIntEQ,
+        LLVMBuildExtractValue(ctx->builder, value, 1, ""), LLVMConstInt(i64, len, 0), "");
+    LLVMBasicBlockRef entry = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef bytes = new_block(ctx, "match.bytes");
+    LLVMBasicBlockRef done = new_block(ctx, "match.streq");
+    LLVMBuildCondBr(ctx->builder, same_len, bytes, done);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, bytes);
+    LLVMValueRef args[] = {
+        LLVMBuildPointerCast(ctx->builder, data, ptr, ""),
+        LLVMBuildPointerCast(ctx->builder,
+            LLVMBuildExtractValue(ctx->builder, expected, 0, ""), ptr, ""),
+        LLVMConstInt(i64, len, 0)
+    };
+    LLVMValueRef cmp = LLVMBuildCall2(ctx->builder, fn_type, fn, args, 3, "");
+    LLVMValueRef same_bytes = LLVMBuildICmp(ctx->builder, LLVMIntEQ, cmp,
+        LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm_ctx), 0, 0), "");
+    LLVMBuildBr(ctx->builder, done);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, done);
+    LLVMValueRef phi = LLVMBuildPhi(ctx->builder, LLVMInt1TypeInContext(ctx->llvm_ctx), "streq");
+    LLVMValueRef incoming_vals[] = { LLVMConstInt(LLVMInt1TypeInContext(ctx->llvm_ctx), 0, 0),
+                                     same_bytes };
+    LLVMBasicBlockRef incoming_blocks[] = { entry, bytes };
+    LLVMAddIncoming(phi, incoming_vals, incoming_blocks, 2);
+    return phi;
+}
+
+/*
+ * Lower a decision tree node at the current insertion point
+ */
+static void lower_decision(CodegenContext *ctx, MatchLowering *m, Decision *d) {
+    switch (d->kind) {
+        case DECISION_FAIL:
+            LLVMBuildUnreachable(ctx->builder);
+            return;
+
+        case DECISION_LEAF: {
+            /* Copy each bound sub-value into its binding's slot */
+            for (uint32_t i = 0; i < d->leaf.binding_count; i++) {
+                Symbol *sym = d->leaf.bindings[i].sym;
+                LLVMValueRef value = match_path_load(ctx, m, d->leaf.bindings[i].path);
+                if (!value || sym->slot >= ctx->local_count) continue;
+                if (!ctx->locals[sym->slot]) {
+                    ctx->locals[sym->slot] = entry_alloca(ctx, LLVMTypeOf(value), sym->name.data);
+                }
+                LLVMBuildStore(ctx->builder, value, ctx->locals[sym->slot]);
+                set_drop_flag(ctx, sym, true);
+            }
+
+            uint32_t arm = d->leaf.arm;
+            if (!m->arm_blocks[arm]) {
+                m->arm_blocks[arm] = new_block(ctx, "match.arm");
+            }
+            if (!d->leaf.guard) {
+                LLVMBuildBr(ctx->builder, m->arm_blocks[arm]);
+                return;
+            }
+
+            LLVMValueRef cond = codegen_expr_internal(ctx, d->leaf.guard);
+            LLVMBasicBlockRef failed = new_block(ctx, "match.guardfail");
+            LLVMBuildCondBr(ctx->builder, cond, m->arm_blocks[arm], failed);
+            LLVMPositionBuilderAtEnd(ctx->builder, failed);
+            lower_decision(ctx, m, d->leaf.guard_failed);
+            return;
+        }
+
+        case DECISION_SWITCH:
+            break;
+    }
+
+    uint32_t count = d->switch_.case_count;
+    LLVMBasicBlockRef *case_blocks = ARENA_ALLOC_ARRAY(ctx->arena, LLVMBasicBlockRef,
+        count ? count : 1);
+    for (uint32_t i = 0; i < count; i++) {
+        case_blocks[i] = new_block(ctx, "match.case");
+    }
+    LLVMBasicBlockRef fallback = new_block(ctx, d->switch_.fallback ? "match.default" : "match.none");
+
+    MatchPath *path = d->switch_.path;
+    LLVMValueRef value = NULL;
+    if (d->switch_.test == SWITCH_VARIANT) {
+        LLVMValueRef addr = match_path_addr(ctx, m, path);
+        if (addr) {
+            value = lower_load_tag(ctx, path->type, addr);
+        }
+    } else if (d->switch_.test != SWITCH_STATE) {
+        value = match_path_load(ctx, m, path);
+    }
+
+    if (!value) {
+        /* No runtime representation to test */
+        LLVMBuildUnreachable(ctx->builder);
+    } else if (d->switch_.test == SWITCH_VARIANT) {
+        LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, value, fallback, count);
+        for (uint32_t i = 0; i < count; i++) {
+            LLVMAddCase(sw, LLVMConstInt(LLVMTypeOf(value),
+                lower_tag_value(ctx, path->type, (uint32_t)d->switch_.cases[i].lo), 0),
+                case_blocks[i]);
+        }
+    } else if (d->switch_.test == SWITCH_RANGE) {
+        lower_range_switch(ctx, d, value, case_blocks, fallback);
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            LLVMValueRef eq = literal_equals(ctx, value, d->switch_.cases[i].value);
+            LLVMBasicBlockRef next = new_block(ctx, "match.next");
+            LLVMBuildCondBr(ctx->builder, eq, case_blocks[i], next);
+            LLVMPositionBuilderAtEnd(ctx->builder, next);
+        }
+        LLVMBuildBr(ctx->builder, fallback);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        LLVMPositionBuilderAtEnd(ctx->builder, case_blocks[i]);
+        lower_decision(ctx, m, d->switch_.cases[i].next);
+    }
+    LLVMPositionBuilderAtEnd(ctx->builder, fallback);
+    if (d->switch_.fallback) {
+        lower_decision(ctx, m, d->switch_.fallback);
+    } else {
+        LLVMBuildUnreachable(ctx->builder);
+    }
+}
+
+/*
+ * Generate code for a match expression from its decision tree (see
+ * sema/match.h). The tests are lowered first; each arm body is then
+ * generated once, in the block its leaves branch to, and the arm results
+ * are merged with a phi.
+ */
+static LLVMValueRef codegen_match(CodegenContext *ctx, Expr *expr) {
+    Decision *tree = expr->match.decision;
+    size_t arm_count = vec_len(expr->match.arms_bodies);
+    LLVMValueRef scrutinee = codegen_expr_internal(ctx, expr->match.scrutinee);
+    if (!tree || block_terminated(ctx)) {
+        return NULL;
+    }
+
+    MatchLowering m;
+    m.root = NULL;
+    m.arm_blocks = arena_calloc(ctx->arena, arm_count ? arm_count : 1, sizeof(LLVMBasicBlockRef));
+
+    LLVMTypeRef root_type = expr_llvm_type(ctx, expr->match.scrutinee, NULL);
+    if (root_type && scrutinee && LLVMTypeOf(scrutinee) == root_type) {
+        m.root = entry_alloca(ctx, root_type, "scrutinee");
+        LLVMBuildStore(ctx->builder, scrutinee, m.root);
+    }
+
+    lower_decision(ctx, &m, tree);
+
+    /* Arm bodies */
+    LLVMBasicBlockRef merge_bb = new_block(ctx, "match.end");
+    LLVMValueRef *values = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef, arm_count ? arm_count : 1);
+    LLVMBasicBlockRef *blocks = ARENA_ALLOC_ARRAY(ctx->arena, LLVMBasicBlockRef,
+        arm_count ? arm_count : 1);
+    unsigned incoming = 0;
+    bool all_values = true;
+    for (size_t i = 0; i < arm_count; i++) {
+        if (!m.arm_blocks[i]) continue;
+        LLVMPositionBuilderAtEnd(ctx->builder, m.arm_blocks[i]);
+        LLVMValueRef value = codegen_expr_internal(ctx, expr->match.arms_bodies[i]);
+        if (expr->match.arms_cleanups) {
+            emit_cleanups(ctx, expr->match.arms_cleanups[i]);
+        }
+        if (block_terminated(ctx)) continue;
+        LLVMBuildBr(ctx->builder, merge_bb);
+
+        values[incoming] = value;
+        blocks[incoming] = LLVMGetInsertBlock(ctx->builder);
+        all_values &= value && (incoming == 0 || LLVMTypeOf(value) == LLVMTypeOf(values[0]));
+        incoming++;
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, merge_bb);
+    if (incoming == 0) {
+        LLVMBuildUnreachable(ctx->builder);
+        return NULL;
+    }
+    if (!all_values) {
+        return NULL;
+    }
+    if (incoming == 1) {
+        return values[0];
+    }
+    LLVMValueRef phi = LLVMBuildPhi(ctx->builder, LLVMTypeOf(values[0]), "matchtmp");
+    LLVMAddIncoming(phi, values, blocks, incoming);
+    return phi;
 }
 
 /*
  * Generate code for a block expression
  */
 static LLVMValueRef codegen_block(CodegenContext *ctx, Expr *expr) {
-    /* Generate statements */
+    /* Generate statements (nothing after a return/break is reachable) */
     for (size_t i = 0; i < vec_len(expr->block.stmts); i++) {
         codegen_stmt_internal(ctx, expr->block.stmts[i]);
+        if (block_terminated(ctx)) {
+            return NULL;
+        }
     }
 
-    /* Generate result expression */
-    if (expr->block.result) {
-        return codegen_expr_internal(ctx, expr->block.result);
+    /* The scope's bindings are dropped after its result is computed */
+    LLVMValueRef result = expr->block.result
+        ? codegen_expr_internal(ctx, expr->block.result)
+        : NULL;
+    if (!block_terminated(ctx)) {
+        emit_cleanups(ctx, expr->block.cleanups);
     }
-
-    return LLVMConstNull(LLVMVoidTypeInContext(ctx->llvm_ctx));
+    return result;
 }
 
 /*
@@ -438,7 +1390,9 @@ static LLVMValueRef codegen_loop(CodegenContext *ctx, Expr *expr) {
     if (expr->loop.body) {
         codegen_expr_internal(ctx, expr->loop.body);
     }
-    LLVMBuildBr(ctx->builder, loop_header);
+    if (!block_terminated(ctx)) {
+        LLVMBuildBr(ctx->builder, loop_header);
+    }
 
     /* Loop exit */
     LLVMPositionBuilderAtEnd(ctx->builder, loop_exit);
@@ -447,7 +1401,7 @@ static LLVMValueRef codegen_loop(CodegenContext *ctx, Expr *expr) {
     ctx->loop_break_block = saved_break;
     ctx->loop_continue_block = saved_continue;
 
-    return LLVMConstNull(LLVMVoidTypeInContext(ctx->llvm_ctx));
+    return NULL;
 }
 
 /*
@@ -476,9 +1430,27 @@ static LLVMValueRef codegen_expr_internal(CodegenContext *ctx, Expr *expr) {
         case EXPR_CALL:
             return codegen_call(ctx, expr);
 
+        case EXPR_FIELD:
+            return codegen_field(ctx, expr);
+
+        case EXPR_INDEX:
+            return codegen_index(ctx, expr);
+
+        case EXPR_ARRAY:
+            return codegen_array(ctx, expr);
+
+        case EXPR_RECORD:
+            return codegen_record(ctx, expr);
+
+        case EXPR_TUPLE:
+            return codegen_tuple(ctx, expr);
+
         case EXPR_IF:
             return codegen_if(ctx, expr);
 
+        case EXPR_MATCH:
+            return codegen_match(ctx, expr);
+
         case EXPR_BLOCK:
             return codegen_block(ctx, expr);
 
@@ -492,6 +1464,10 @@ static LLVMValueRef codegen_expr_internal(CodegenContext *ctx, Expr *expr) {
         case EXPR_WIDEN:
             return codegen_expr_internal(ctx, expr->widen.operand);
 
+        case EXPR_COMPTIME:
+            /* Evaluated by the type checker */
+            return expr->comptime.value ? codegen_const(ctx, expr->comptime.value) : NULL;
+
         default:
             return LLVMConstNull(LLVMInt32TypeInContext(ctx->llvm_ctx));
     }
@@ -504,66 +1480,124 @@ static void codegen_stmt_internal(CodegenContext *ctx, Stmt *stmt) {
     if (!stmt) return;
 
     switch (stmt->kind) {
-        case STMT_EXPR:
-            codegen_expr_internal(ctx, stmt->expr.expr);
+        case STMT_EXPR: {
+            Expr *expr = stmt->expr.expr;
+            LLVMValueRef val = codegen_expr_internal(ctx, expr);
+
+            /* A discarded temporary that owns something is dropped here */
+            bool is_place = expr && (expr->kind == EXPR_IDENT || expr->kind == EXPR_FIELD ||
+                                     expr->kind == EXPR_INDEX);
+            if (val && !is_place && !block_terminated(ctx) &&
+                drop_glue(ctx, expr_type(ctx, expr))) {
+                LLVMValueRef temp = entry_alloca(ctx, LLVMTypeOf(val), "discarded");
+                LLVMBuildStore(ctx->builder, val, temp);
+                drop_in_place(ctx, expr->type, temp);
+            }
             break;
+        }
 
         case STMT_LET:
         case STMT_VAR: {
-            /* Create alloca for binding */
-            LLVMTypeRef var_type = LLVMInt32TypeInContext(ctx->llvm_ctx);
-            LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder, var_type, "var");
-
-            /* Store initial value if present */
+            Pattern *pat = (stmt->kind == STMT_LET) ? stmt->let.pattern : stmt->var.pattern;
             Expr *init = (stmt->kind == STMT_LET) ? stmt->let.init : stmt->var.init;
-            if (init) {
-                LLVMValueRef val = codegen_expr_internal(ctx, init);
-                if (val) {
-                    LLVMBuildStore(ctx->builder, val, alloca);
-                }
+
+            /* Initializing from the last use of another binding of the same
+             * type takes over its stack slot instead of copying the value */
+            Expr *source = init;
+            while (source && source->kind == EXPR_MOVE) {
+                source = source->move.operand;
             }
+            Symbol *from = source && source->kind == EXPR_IDENT && source->ident.is_last_use
+                ? source->ident.resolved : NULL;
+            LLVMValueRef from_slot = from ? local_slot(ctx, from) : NULL;
+            if (pat && pat->kind == PAT_BINDING && pat->binding.resolved &&
+                from_slot && LLVMIsAAllocaInst(from_slot) &&
+                type_equals(mono_subst(ctx, pat->binding.resolved->type),
+                            mono_subst(ctx, from->type))) {
+                ctx->locals[pat->binding.resolved->slot] = from_slot;
+                set_drop_flag(ctx, from, false);
+                set_drop_flag(ctx, pat->binding.resolved, true);
+                break;
+            }
+
+            LLVMValueRef val = init ? codegen_expr_internal(ctx, init) : NULL;
 
-            /* TODO: Register in locals map based on pattern symbol */
+            if (!pat || pat->kind != PAT_BINDING || !pat->binding.resolved) {
+                /* TODO: Destructuring patterns */
+                break;
+            }
+
+            /* Create stack slot for binding */
+            Symbol *sym = pat->binding.resolved;
+            Type *type = mono_subst(ctx, sym->type);
+            LLVMTypeRef var_type = type && type->kind != TYPE_ERROR
+                ? lower_type(ctx, type)
+                : LLVMInt32TypeInContext(ctx->llvm_ctx);
+            if (val) {
+                var_type = LLVMTypeOf(val);
+            }
+            LLVMValueRef alloca = entry_alloca(ctx, var_type, sym->name.data);
+            align_slot(ctx, alloca, type);
+            ctx->locals[sym->slot] = alloca;
+
+            /* Store initial value if present */
+            if (val) {
+                emit_lifetime(ctx, alloca, true);
+                LLVMBuildStore(ctx->builder, val, alloca);
+            }
+            set_drop_flag(ctx, sym, val != NULL);
             break;
         }
 
         case STMT_ASSIGN: {
             LLVMValueRef val = codegen_expr_internal(ctx, stmt->assign.value);
-            /* TODO: Get alloca for target and store */
-            (void)val;
+            Expr *target = stmt->assign.target;
+            if (val && target->kind == EXPR_IDENT && target->ident.resolved) {
+                LLVMValueRef slot = local_slot(ctx, target->ident.resolved);
+                if (slot) {
+                    /* The old value is dropped once the new one exists */
+                    emit_cleanups(ctx, stmt->cleanups);
+                    LLVMBuildStore(ctx->builder, val, slot);
+                    set_drop_flag(ctx, target->ident.resolved, true);
+                }
+            } else if (val && target->kind == EXPR_INDEX) {
+                LLVMValueRef addr = index_addr(ctx, target, false);
+                if (addr) {
+                    LLVMBuildStore(ctx->builder, val, addr);
+                }
+            }
+            /* TODO: Field and dereference targets */
             break;
         }
 
         case STMT_RETURN:
-            if (stmt->return_.value) {
-                LLVMValueRef val = codegen_expr_internal(ctx, stmt->return_.value);
-                LLVMBuildRet(ctx->builder, val);
-            } else {
-                LLVMBuildRetVoid(ctx->builder);
-            }
-            break;
-
-        case STMT_RESULT:
-            if (stmt->result.value) {
-                LLVMValueRef val = codegen_expr_internal(ctx, stmt->result.value);
-                LLVMBuildRet(ctx->builder, val);
+        case STMT_RESULT: {
+            Expr *value = (stmt->kind == STMT_RETURN) ? stmt->return_.value : stmt->result.value;
+            LLVMValueRef val = value ? codegen_expr_internal(ctx, value) : NULL;
+            emit_cleanups(ctx, stmt->cleanups);
+            if (block_terminated(ctx)) {
+                break;
             }
+            abi_return(ctx, val);
             break;
+        }
 
         case STMT_BREAK:
+            emit_cleanups(ctx, stmt->cleanups);
             if (ctx->loop_break_block) {
                 LLVMBuildBr(ctx->builder, ctx->loop_break_block);
             }
             break;
 
         case STMT_CONTINUE:
+            emit_cleanups(ctx, stmt->cleanups);
             if (ctx->loop_continue_block) {
                 LLVMBuildBr(ctx->builder, ctx->loop_continue_block);
             }
             break;
 
         case STMT_DEFER:
-            /* Defer is handled at scope exit */
+            /* Runs with the cleanups of every exit from its scope */
             break;
 
         case STMT_UNSAFE:
@@ -575,72 +1609,154 @@ static void codegen_stmt_internal(CodegenContext *ctx, Stmt *stmt) {
 }
 
 /*
- * Generate code for procedure
+ * Declare a procedure (no body) with the given symbol name, lowering its
+ * signature under the current substitution
  */
-LLVMValueRef codegen_proc(CodegenContext *ctx, ProcDecl *proc, Symbol *sym) {
-    /* Get or create function */
-    uintptr_t cached;
-    if (map_get(&ctx->func_cache, (uintptr_t)sym, &cached)) {
-        return (LLVMValueRef)cached;
-    }
-
-    /* Build function type */
-    size_t param_count = vec_len(proc->params);
-    LLVMTypeRef *param_types = arena_alloc(ctx->arena,
-        param_count * sizeof(LLVMTypeRef), _Alignof(LLVMTypeRef));
-
-    for (size_t i = 0; i < param_count; i++) {
-        param_types[i] = LLVMInt32TypeInContext(ctx->llvm_ctx);  /* Placeholder */
-    }
-
-    LLVMTypeRef ret_type = LLVMInt32TypeInContext(ctx->llvm_ctx);  /* Placeholder */
-    LLVMTypeRef fn_type = LLVMFunctionType(ret_type, param_types,
-        (unsigned)param_count, 0);
-
-    /* Create function */
-    LLVMValueRef fn = LLVMAddFunction(ctx->module, proc->name.data, fn_type);
-    map_put(&ctx->func_cache, (uintptr_t)sym, (uintptr_t)fn);
-
-    /* Generate body if present */
-    if (proc->body) {
-        ctx->current_func = fn;
-
-        /* Create entry block */
-        LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(
-            ctx->llvm_ctx, fn, "entry");
-        LLVMPositionBuilderAtEnd(ctx->builder, entry);
-
-        /* Create allocas for parameters */
-        for (size_t i = 0; i < param_count; i++) {
-            ParamDecl *param = &proc->params[i];
-            LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder,
-                param_types[i], param->name.data);
-            LLVMBuildStore(ctx->builder, LLVMGetParam(fn, (unsigned)i), alloca);
-
-            /* Register in locals */
-            Symbol *param_sym = scope_lookup_from(ctx->sema->current_scope,
-                param->name);
-            if (param_sym) {
-                map_put(&ctx->locals, (uintptr_t)param_sym, (uintptr_t)alloca);
-            }
+LLVMValueRef codegen_declare_proc(CodegenContext *ctx, ProcDecl *proc, const char *name) {
+    Type *sig = mono_subst(ctx, proc->signature);
+    size_t receiver = proc->self_param ? 1 : 0;
+    size_t param_count = receiver + vec_len(proc->params);
+    LLVMTypeRef *param_types = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef, param_count);
+
+    /* The receiver is passed by address */
+    if (receiver) {
+        param_types[0] = LLVMPointerType(lower_type(ctx, proc->self_param->type), 0);
+    }
+    bool *views = ARENA_ALLOC_ARRAY(ctx->arena, bool, param_count);
+    for (size_t i = 0; i < vec_len(proc->params); i++) {
+        Type *param = (sig && sig->kind == TYPE_FUNCTION) ? sig->function.params[i] : NULL;
+        views[i] = passed_by_address(ctx, param, proc->params[i].is_move);
+        param_types[receiver + i] = !param ? LLVMInt32TypeInContext(ctx->llvm_ctx)
+            : views[i] ? LLVMPointerType(lower_type(ctx, param), 0)
+            : lower_type(ctx, param);
+    }
+
+    LLVMTypeRef ret_type = (sig && sig->kind == TYPE_FUNCTION)
+        ? lower_type(ctx, sig->function.return_type)
+        : LLVMVoidTypeInContext(ctx->llvm_ctx);
+    LLVMValueRef fn = abi_declare(ctx, name, ret_type, param_types, (unsigned)param_count);
+
+    /* What the permissions of pointer parameters promise */
+    const AbiSignature *abi = abi_signature(ctx, fn);
+    if (receiver) {
+        alias_view_param(ctx, fn, abi->params[0].index, receiver_permission(proc),
+            proc->self_param->type);
+    }
+    for (size_t i = 0; i < vec_len(proc->params); i++) {
+        if (views[i]) {
+            alias_view_param(ctx, fn, abi->params[receiver + i].index, proc->params[i].perm,
+                sig->function.params[i]);
         }
+    }
+    return fn;
+}
 
-        /* Generate body */
-        LLVMValueRef result = codegen_expr_internal(ctx, proc->body);
+/*
+ * Generate the body of a declared procedure under the current substitution
+ */
+void codegen_proc_body(CodegenContext *ctx, ProcDecl *proc, LLVMValueRef fn) {
+    if (!proc->body) {
+        return;
+    }
 
-        /* Add return if not already terminated */
-        if (!LLVMGetBasicBlockTerminator(LLVMGetInsertBlock(ctx->builder))) {
-            if (result && LLVMGetTypeKind(LLVMTypeOf(result)) != LLVMVoidTypeKind) {
-                LLVMBuildRet(ctx->builder, result);
-            } else {
-                LLVMBuildRetVoid(ctx->builder);
-            }
+    LLVMBasicBlockRef saved_block = LLVMGetInsertBlock(ctx->builder);
+    LLVMValueRef saved_func = ctx->current_func;
+    LLVMBasicBlockRef saved_entry = ctx->entry_block;
+    LLVMValueRef *saved_locals = ctx->locals;
+    LLVMValueRef *saved_flags = ctx->drop_flags;
+    uint32_t saved_local_count = ctx->local_count;
+    LLVMBasicBlockRef saved_overflow = ctx->overflow_block;
+    LLVMValueRef saved_message = ctx->overflow_message;
+    LLVMValueRef saved_line = ctx->overflow_line;
+    ctx->current_func = fn;
+    ctx->overflow_block = NULL;
+    ctx->local_count = proc->local_count;
+    ctx->locals = proc->local_count
+        ? calloc(proc->local_count, sizeof(LLVMValueRef))
+        : NULL;
+    ctx->drop_flags = proc->local_count
+        ? calloc(proc->local_count, sizeof(LLVMValueRef))
+        : NULL;
+
+    /* Create entry block */
+    ctx->entry_block = LLVMAppendBasicBlockInContext(ctx->llvm_ctx, fn, "entry");
+    LLVMPositionBuilderAtEnd(ctx->builder, ctx->entry_block);
+
+    /* The receiver is read through its address into a slot of its own */
+    unsigned receiver = 0;
+    if (proc->self_param) {
+        LLVMValueRef self = abi_param(ctx, fn, receiver++);
+        LLVMTypeRef self_type = lower_type(ctx, proc->self_param->type);
+        LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder, self_type, "self");
+        LLVMValueRef value = LLVMBuildLoad2(ctx->builder, self_type, self, "");
+        LLVMBuildStore(ctx->builder, value, alloca);
+        if (proc->self_param->slot < proc->local_count) {
+            ctx->locals[proc->self_param->slot] = alloca;
+        }
+    }
+
+    /* Create allocas for parameters; views are read through their address
+       like the receiver */
+    Type *sig = mono_subst(ctx, proc->signature);
+    for (size_t i = 0; i < vec_len(proc->params); i++) {
+        ParamDecl *param = &proc->params[i];
+        Type *param_type = (sig && sig->kind == TYPE_FUNCTION) ? sig->function.params[i] : NULL;
+        LLVMValueRef value = abi_param(ctx, fn, receiver + (unsigned)i);
+        if (passed_by_address(ctx, param_type, param->is_move)) {
+            value = LLVMBuildLoad2(ctx->builder, lower_type(ctx, param_type), value, "");
+        }
+        LLVMValueRef alloca = LLVMBuildAlloca(ctx->builder,
+            LLVMTypeOf(value), param->name.data);
+        align_slot(ctx, alloca, param->resolved ? param->resolved->type : NULL);
+        emit_lifetime(ctx, alloca, true);
+        LLVMBuildStore(ctx->builder, value, alloca);
+
+        /* Register in locals */
+        if (param->resolved) {
+            ctx->locals[param->resolved->slot] = alloca;
+            set_drop_flag(ctx, param->resolved, true);
         }
+    }
+
+    /* Generate body */
+    LLVMValueRef result = codegen_expr_internal(ctx, proc->body);
+
+    /* Add return if not already terminated */
+    if (!block_terminated(ctx)) {
+        abi_return(ctx, result);
+    }
 
-        /* Clear locals for next function */
-        map_init(&ctx->locals);
+    alias_infer_captures(ctx, fn);
+
+    free(ctx->locals);
+    free(ctx->drop_flags);
+    ctx->locals = saved_locals;
+    ctx->drop_flags = saved_flags;
+    ctx->local_count = saved_local_count;
+    ctx->overflow_block = saved_overflow;
+    ctx->overflow_message = saved_message;
+    ctx->overflow_line = saved_line;
+
+    ctx->current_func = saved_func;
+    ctx->entry_block = saved_entry;
+    if (saved_block) {
+        LLVMPositionBuilderAtEnd(ctx->builder, saved_block);
     }
+}
 
+/*
+ * Generate code for procedure
+ */
+LLVMValueRef codegen_proc(CodegenContext *ctx, ProcDecl *proc, Symbol *sym) {
+    (void)sym;
+    LLVMValueRef fn = proc_function(ctx, proc);
+    if (LLVMCountBasicBlocks(fn) == 0) {
+        if (vec_len(proc->target_clones) > 0) {
+            multiversion_define(ctx, proc, fn);
+        } else {
+            codegen_proc_body(ctx, proc, fn);
+        }
+    }
     return fn;
 }
 
@@ -665,17 +1781,25 @@ void codegen_stmt(CodegenContext *ctx, Stmt *stmt) {
  */
 bool codegen_module(CodegenContext *ctx, Module *mod) {
 #ifdef HAVE_LLVM
+    /* Declare all non-generic procedures first so bodies can call forward */
+    for (size_t i = 0; i < vec_len(mod->decls); i++) {
+        Decl *decl = mod->decls[i];
+        if (decl->kind == DECL_PROC && vec_len(decl->proc.generics) == 0) {
+            proc_function(ctx, &decl->proc);
+        }
+    }
+
     /* Generate all declarations */
     for (size_t i = 0; i < vec_len(mod->decls); i++) {
         Decl *decl = mod->decls[i];
 
         switch (decl->kind) {
-            case DECL_PROC: {
-                Symbol *sym = scope_lookup_from(ctx->sema->current_scope,
-                    decl->proc.name);
-                codegen_proc(ctx, &decl->proc, sym);
+            case DECL_PROC:
+                /* Generic procedures are emitted per instantiation */
+                if (vec_len(decl->proc.generics) == 0) {
+                    codegen_proc(ctx, &decl->proc, NULL);
+                }
                 break;
-            }
 
             case DECL_RECORD:
             case DECL_ENUM:
@@ -684,19 +1808,9 @@ bool codegen_module(CodegenContext *ctx, Module *mod) {
                 break;
 
             case DECL_EXTERN:
-                /* Generate extern declarations */
+                /* Declared even when nothing here calls them */
                 for (size_t j = 0; j < vec_len(decl->extern_.funcs); j++) {
-                    ExternFuncDecl *ext = &decl->extern_.funcs[j];
-                    size_t param_count = vec_len(ext->params);
-                    LLVMTypeRef *param_types = arena_alloc(ctx->arena,
-                        param_count * sizeof(LLVMTypeRef), _Alignof(LLVMTypeRef));
-                    for (size_t k = 0; k < param_count; k++) {
-                        param_types[k] = LLVMInt32TypeInContext(ctx->llvm_ctx);
-                    }
-                    LLVMTypeRef ret_type = LLVMInt32TypeInContext(ctx->llvm_ctx);
-                    LLVMTypeRef fn_type = LLVMFunctionType(ret_type, param_types,
-                        (unsigned)param_count, 0);
-                    LLVMAddFunction(ctx->module, ext->name.data, fn_type);
+                    extern_function(ctx, &decl->extern_, decl->extern_.funcs[j].name);
                 }
                 break;
 
@@ -705,10 +1819,14 @@ bool codegen_module(CodegenContext *ctx, Module *mod) {
         }
     }
 
+    /* Specializations requested by the bodies above (and by each other) */
+    mono_emit_pending(ctx);
+    multiversion_stamp_target(ctx);
+
     /* Verify module */
     char *error = NULL;
     if (LLVMVerifyModule(ctx->module, LLVMReturnStatusAction, &error) != 0) {
-        diag_emit(ctx->diag, DIAG_ERROR, (SourceSpan){0},
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
             "LLVM verification failed: %s", error);
         LLVMDisposeMessage(error);
         return false;
@@ -730,7 +1848,7 @@ bool codegen_write_object(CodegenContext *ctx, const char *filename) {
     char *error = NULL;
     if (LLVMTargetMachineEmitToFile(ctx->target_machine, ctx->module,
             (char *)filename, LLVMObjectFile, &error) != 0) {
-        diag_emit(ctx->diag, DIAG_ERROR, (SourceSpan){0},
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
             "Failed to write object file: %s", error);
         LLVMDisposeMessage(error);
         return false;
@@ -750,7 +1868,7 @@ bool codegen_write_ir(CodegenContext *ctx, const char *filename) {
 #ifdef HAVE_LLVM
     char *error = NULL;
     if (LLVMPrintModuleToFile(ctx->module, filename, &error) != 0) {
-        diag_emit(ctx->diag, DIAG_ERROR, (SourceSpan){0},
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
             "Failed to write IR: %s", error);
         LLVMDisposeMessage(error);
         return false;
@@ -768,8 +1886,27 @@ bool codegen_write_ir(CodegenContext *ctx, const char *filename) {
  */
 bool codegen_write_bitcode(CodegenContext *ctx, const char *filename) {
 #ifdef HAVE_LLVM
+    if (ctx->options.thin_lto) {
+        /* ThinLTO bitcode also carries the module summary */
+        LLVMMemoryBufferRef bitcode = lto_thin_bitcode(&ctx->options, ctx->diag, ctx->module);
+        if (!bitcode) {
+            return false;
+        }
+        size_t size = LLVMGetBufferSize(bitcode);
+        FILE *f = fopen(filename, "wb");
+        bool written = f && fwrite(LLVMGetBufferStart(bitcode), 1, size, f) == size;
+        if (f && fclose(f) != 0) {
+            written = false;
+        }
+        LLVMDisposeMemoryBuffer(bitcode);
+        if (!written) {
+            diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+                "Failed to write bitcode");
+        }
+        return written;
+    }
     if (LLVMWriteBitcodeToFile(ctx->module, filename) != 0) {
-        diag_emit(ctx->diag, DIAG_ERROR, (SourceSpan){0},
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
             "Failed to write bitcode");
         return false;
     }
@@ -14,6 +14,7 @@
 #include "common/string_pool.h"
 #include "parser/ast.h"
 #include "sema/sema.h"
+#include <stdio.h>
 
 #ifdef HAVE_LLVM
 #include <llvm-c/Core.h>
@@ -41,8 +42,106 @@ typedef struct TargetInfo {
     const char *triple;           /* LLVM target triple */
     size_t pointer_size;          /* Pointer size in bytes */
     size_t max_align;             /* Maximum alignment */
+    const char *cpu;              /* LLVM CPU name, "generic" by default */
+    const char *features;         /* LLVM feature string, e.g. "+avx2,-bmi" */
 } TargetInfo;
 
+/*
+ * Optimization level (-O0..-O3, -Os, -Oz)
+ */
+typedef enum OptLevel {
+    OPT_O0,
+    OPT_O1,
+    OPT_O2,
+    OPT_O3,
+    OPT_OS,                       /* -O2 favoring size */
+    OPT_OZ                        /* Size above all */
+} OptLevel;
+
+/*
+ * What integer `+`, `-`, `*` and negation do when the result does not fit
+ * (-overflow=)
+ */
+typedef enum OverflowMode {
+    OVERFLOW_CHECKED,             /* Panic with the operation and source line */
+    OVERFLOW_WRAPPING,            /* Wrap around, no checks */
+    OVERFLOW_TRAP                 /* Trap instruction, no message */
+} OverflowMode;
+
+/*
+ * Code generation options from the command line
+ */
+typedef struct CodegenOptions {
+    OptLevel opt_level;
+    const char *passes;           /* Pass pipeline replacing the standard one */
+    bool time_passes;             /* Report time spent in each LLVM pass */
+    const char *cpu;              /* -march=/-mcpu=: CPU name or "native", NULL for generic */
+    const char *features;         /* -mattr=: features added to the CPU's */
+    unsigned codegen_units;       /* -codegen-units=: object files to split into, 0 or 1 for one */
+    bool thin_lto;                /* -flto=thin: pre-link pipeline, bitcode with summaries */
+    const char *jit_cache;        /* -jit-cache=: directory of objects -run reuses, NULL for none */
+    OverflowMode overflow;        /* -overflow=: checked by default */
+} CodegenOptions;
+
+/*
+ * A specialization of a generic procedure for concrete type arguments.
+ * Instances are keyed by (declaration, canonical argument tuple); since
+ * types are hash-consed the key compares by pointer.
+ */
+typedef struct MonoInstance {
+    ProcDecl *proc;               /* Generic declaration */
+    Type *key;                    /* Canonical tuple of the type arguments */
+    Vec(Type *) args;             /* Type arguments, by generic parameter index */
+    const char *name;             /* Mangled symbol name */
+#ifdef HAVE_LLVM
+    LLVMValueRef fn;              /* Specialized function */
+#endif
+    size_t instructions;          /* IR instructions in the specialized body */
+} MonoInstance;
+
+/*
+ * Monomorphization state: the instance table (open addressing) plus the
+ * queue of instances whose bodies have not been generated yet
+ */
+typedef struct MonoCache {
+    MonoInstance **slots;
+    size_t capacity;
+    Vec(MonoInstance *) instances;  /* All instances, in creation order */
+    size_t next_pending;            /* First instance whose body is not emitted */
+    size_t requests;                /* Instantiation requests (cache hits + misses) */
+} MonoCache;
+
+#ifdef HAVE_LLVM
+/*
+ * How a value crosses a call under the platform calling convention
+ */
+typedef enum AbiKind {
+    ABI_DIRECT,                   /* As lowered */
+    ABI_COERCE,                   /* Reinterpreted as one or two registers */
+    ABI_INDIRECT,                 /* Address of a copy (byval, sret for returns) */
+    ABI_IGNORE                    /* Zero-sized: not passed at all */
+} AbiKind;
+
+typedef struct AbiArg {
+    AbiKind kind;
+    LLVMTypeRef type;             /* Lowered type of the value */
+    LLVMTypeRef parts[2];         /* Register types of ABI_COERCE */
+    unsigned part_count;
+    unsigned index;               /* First LLVM parameter carrying it */
+    unsigned align;               /* Alignment of the memory ABI_INDIRECT points to */
+    bool byval;                   /* ABI_INDIRECT copy made by the call itself */
+} AbiArg;
+
+/*
+ * Signature of a function declared with abi_declare (abi.c)
+ */
+typedef struct AbiSignature {
+    AbiArg ret;                   /* ABI_INDIRECT: sret pointer is parameter 0 */
+    AbiArg *params;
+    unsigned param_count;
+} AbiSignature;
+#endif
+
 /*
  * Code generation context
  */
@@ -59,9 +158,16 @@ typedef struct CodegenContext {
     SemaContext *sema;            /* Semantic context */
     StringPool *strings;          /* String pool */
 
-    Map type_cache;               /* Type* -> LLVMTypeRef */
-    Map func_cache;               /* Symbol* -> LLVMValueRef */
-    Map global_cache;             /* Symbol* -> LLVMValueRef */
+    PtrMap type_cache;            /* canonical Type* -> LLVMTypeRef */
+    PtrMap func_cache;            /* ProcDecl* or ExternFuncDecl* -> LLVMValueRef */
+    PtrMap global_cache;          /* Symbol* -> LLVMValueRef */
+    PtrMap drop_glue;             /* canonical Type* -> drop function (drop.c) */
+    PtrMap field_slots;           /* canonical Type* -> struct index per field (lower.c) */
+    PtrMap abi_signatures;        /* LLVM function -> AbiSignature (abi.c) */
+
+    /* Generic instantiation */
+    MonoCache mono;               /* Specializations of generic procedures */
+    Vec(Type *) subst;            /* Type arguments of the instance being generated */
 
     /* Current function context */
 #ifdef HAVE_LLVM
@@ -69,10 +175,18 @@ typedef struct CodegenContext {
     LLVMBasicBlockRef entry_block; /* Function entry block */
     LLVMBasicBlockRef return_block; /* Return block for cleanup */
     LLVMValueRef return_value;    /* Alloca for return value */
-#endif
 
-    /* Local variables map: Symbol* -> LLVMValueRef (stack alloca) */
-    Map locals;
+    /* Stack allocas of the current body, indexed by Symbol.slot */
+    LLVMValueRef *locals;
+    LLVMValueRef *drop_flags;     /* i1 allocas of bindings with Symbol.drop_flag */
+    uint32_t local_count;
+
+    /* Shared failure block of the body's overflow checks (overflow.c) and
+       its phis of the failing operation's message and line */
+    LLVMBasicBlockRef overflow_block;
+    LLVMValueRef overflow_message;
+    LLVMValueRef overflow_line;
+#endif
 
     /* Loop context for break/continue */
 #ifdef HAVE_LLVM
@@ -82,16 +196,18 @@ typedef struct CodegenContext {
 
     /* Target information */
     TargetInfo target;
+    CodegenOptions options;
 
     /* Diagnostic context */
     DiagContext *diag;
 } CodegenContext;
 
 /*
- * Initialize code generation context
+ * Initialize code generation context; `options` may be NULL for -O0
  */
 bool codegen_init(CodegenContext *ctx, Arena *arena, SemaContext *sema,
-                  DiagContext *diag, const char *module_name);
+                  DiagContext *diag, const char *module_name,
+                  const CodegenOptions *options);
 
 /*
  * Cleanup code generation context
@@ -103,6 +219,68 @@ void codegen_destroy(CodegenContext *ctx);
  */
 bool codegen_module(CodegenContext *ctx, Module *mod);
 
+#ifdef HAVE_LLVM
+/*
+ * Run the optimization pipeline the options select (optimize.c)
+ */
+bool codegen_optimize(CodegenContext *ctx);
+
+/* Machine code optimization level matching an IR level */
+LLVMCodeGenOptLevel codegen_machine_level(OptLevel level);
+
+/* Pipeline the options select (-passes= or the -O level's), NULL if none */
+const char *codegen_pipeline(const CodegenOptions *opts);
+
+/* Run `pipeline` over any module; returns NULL, or LLVM's error message
+ * to be freed with LLVMDisposeErrorMessage. Safe to call from several
+ * threads on modules of different LLVM contexts. */
+char *codegen_run_passes(const CodegenOptions *opts, LLVMModuleRef module,
+                         LLVMTargetMachineRef machine, const char *pipeline);
+
+/*
+ * Split the generated module into up to options.codegen_units units, then
+ * optimize each and write it to its own object file, in parallel (units.c).
+ * Unit i is written to codegen_unit_filename(filename, i). Returns the
+ * number of units, 0 on failure.
+ */
+unsigned codegen_write_units(CodegenContext *ctx, const char *filename);
+
+/* Is `fn` an external definition, the functions units are split by? */
+bool codegen_is_partitioned(LLVMValueRef fn);
+
+/* In a copy of the module, keep the bodies of the functions `owners`
+ * (unit of each function in module order, or -1) assigns to `unit`, and
+ * declare the other partitioned functions; unit 0 keeps external variables */
+void codegen_extract_unit(LLVMModuleRef module, const unsigned *owners, unsigned unit);
+
+/*
+ * Compile the module in-process, function by function as they are first
+ * called, and run its `main` (jit.c). `result` receives main's return
+ * value, 0 if it returns nothing.
+ */
+bool codegen_jit_run(CodegenContext *ctx, int *result);
+
+/* Name every global and serialize `module` as ThinLTO bitcode with its
+ * module summary (lto.c); NULL on failure */
+LLVMMemoryBufferRef lto_thin_bitcode(const CodegenOptions *opts, DiagContext *diag,
+                                     LLVMModuleRef module);
+
+/*
+ * ThinLTO link (lto.c): `module` (may be NULL), the bitcode files `inputs`
+ * and the runtime's bitcode `runtime` (may be NULL) are optimized with
+ * cross-module imports and written one object per module, module i to
+ * codegen_unit_filename(filename, i). Returns the number of objects, 0 on
+ * failure.
+ */
+unsigned codegen_thin_link(const CodegenOptions *opts, Arena *arena, DiagContext *diag,
+                           LLVMModuleRef module, const char *const *inputs,
+                           size_t input_count, const char *runtime, const char *filename);
+#endif
+
+/* Object file of codegen unit `unit`: `filename` itself for unit 0,
+ * otherwise `out.o` -> `out.1.o` */
+const char *codegen_unit_filename(Arena *arena, const char *filename, unsigned unit);
+
 /*
  * Write generated code to file
  */
@@ -116,6 +294,29 @@ bool codegen_write_bitcode(CodegenContext *ctx, const char *filename);
 #ifdef HAVE_LLVM
 LLVMTypeRef lower_type(CodegenContext *ctx, Type *type);
 
+/*
+ * Struct element index of field (or element) `index` of a record or tuple.
+ * Fields are stored in layout order, with padding elements where needed,
+ * so this differs from the declaration index.
+ */
+unsigned lower_field_index(CodegenContext *ctx, Type *type, uint32_t index);
+
+/*
+ * Load which alternative of the enum or union at `addr` is active, as a
+ * value lower_tag_value gives for it. NULL if the type has no layout.
+ */
+LLVMValueRef lower_load_tag(CodegenContext *ctx, Type *type, LLVMValueRef addr);
+
+/* Tag of alternative `index`: the discriminant when stored directly */
+uint64_t lower_tag_value(CodegenContext *ctx, Type *type, uint32_t index);
+
+/*
+ * Address of the payload of type `payload` in the enum or union at
+ * `addr`, or NULL if no alternative stores data
+ */
+LLVMValueRef lower_payload_addr(CodegenContext *ctx, Type *type, LLVMValueRef addr,
+                                Type *payload);
+
 /*
  * Expression code generation
  */
@@ -130,8 +331,128 @@ void codegen_stmt(CodegenContext *ctx, Stmt *stmt);
  * Procedure code generation
  */
 LLVMValueRef codegen_proc(CodegenContext *ctx, ProcDecl *proc, Symbol *sym);
+
+/*
+ * Declare a procedure (no body) with the given symbol name, lowering its
+ * signature under the current substitution
+ */
+LLVMValueRef codegen_declare_proc(CodegenContext *ctx, ProcDecl *proc, const char *name);
+
+/*
+ * Generate the body of a declared procedure under the current substitution.
+ * The builder is left where it was, so a body may be generated on demand
+ * in the middle of another one.
+ */
+void codegen_proc_body(CodegenContext *ctx, ProcDecl *proc, LLVMValueRef fn);
+
+/*
+ * Symbol name of a procedure; methods are qualified by their type
+ * (`Type.name`)
+ */
+InternedString codegen_proc_name(CodegenContext *ctx, ProcDecl *proc);
+
+/*
+ * Drop glue (drop.c)
+ */
+
+/* Get the drop function of a concrete type, generating it on first use;
+ * NULL for types whose destruction does nothing */
+LLVMValueRef drop_glue(CodegenContext *ctx, Type *type);
+
+/* Drop the value stored at `addr`, if its type (under the current
+ * substitution) needs it */
+void drop_in_place(CodegenContext *ctx, Type *type, LLVMValueRef addr);
+
+/*
+ * Monomorphization (mono.c)
+ */
+
+/* Get the specialization of a generic procedure for concrete type arguments,
+ * declaring it (and queueing its body) on first request */
+LLVMValueRef mono_instantiate(CodegenContext *ctx, ProcDecl *proc, Vec(Type *) args);
+
+/* Generate bodies for all queued instances (including ones they request) */
+void mono_emit_pending(CodegenContext *ctx);
+
+/* Apply the current instance's type arguments to a type */
+Type *mono_subst(CodegenContext *ctx, Type *type);
+
+/* Mangled name of a generic declaration applied to type arguments */
+const char *mono_mangle(CodegenContext *ctx, InternedString base, Vec(Type *) args);
+
+/*
+ * Alias information (alias.c)
+ */
+
+/* Attributes of parameter `index`, passed by address with permission
+ * `perm`: noalias if unique, readonly if const, dereferenceable for `type` */
+void alias_view_param(CodegenContext *ctx, LLVMValueRef fn, unsigned index,
+                      Permission perm, Type *type);
+
+/* After generating a body, mark pointer parameters that only serve as
+ * load (or store) addresses nocapture, and readonly if never stored to */
+void alias_infer_captures(CodegenContext *ctx, LLVMValueRef fn);
+
+/*
+ * Calling convention lowering (abi.c)
+ */
+
+/* Declare a function taking and returning values of the given lowered
+ * types, passed as the target's C calling convention passes them */
+LLVMValueRef abi_declare(CodegenContext *ctx, const char *name, LLVMTypeRef ret,
+                         LLVMTypeRef *params, unsigned count);
+
+/* Signature of a function declared with abi_declare, NULL for others */
+const AbiSignature *abi_signature(CodegenContext *ctx, LLVMValueRef fn);
+
+/* Value of parameter `index` (of the lowered signature) of `fn`, emitted
+ * at the builder in the body being generated */
+LLVMValueRef abi_param(CodegenContext *ctx, LLVMValueRef fn, unsigned index);
+
+/* Return `value` from the current function; NULL returns undef */
+void abi_return(CodegenContext *ctx, LLVMValueRef value);
+
+/* Call `fn` with values of its lowered parameter types; returns the
+ * result, NULL for functions returning nothing */
+LLVMValueRef abi_call(CodegenContext *ctx, LLVMValueRef fn, LLVMValueRef *args,
+                      unsigned count);
+
+/* Attributes (sret, byval) a call forwarding `fn`'s own parameters needs */
+void abi_forward_attributes(CodegenContext *ctx, LLVMValueRef fn, LLVMValueRef call);
+
+/*
+ * Function multiversioning (multiversion.c)
+ */
+
+/* Define a procedure with [[bootstrap.target_clones]]: one clone per
+ * feature set plus the baseline, and `fn` dispatching to the best one the
+ * running CPU supports */
+void multiversion_define(CodegenContext *ctx, ProcDecl *proc, LLVMValueRef fn);
+
+/* Stamp target-cpu and target-features on every defined function that
+ * does not carry its own */
+void multiversion_stamp_target(CodegenContext *ctx);
+
+/*
+ * Overflow-checked arithmetic (overflow.c)
+ */
+
+/* Integer `left + right`, `left - right` or `left * right`, checked as
+ * the -overflow= mode says */
+LLVMValueRef overflow_arith(CodegenContext *ctx, BinaryOp op, bool is_unsigned,
+                            LLVMValueRef left, LLVMValueRef right, SourceSpan span);
+
+/* Integer `-operand`, checked as the -overflow= mode says */
+LLVMValueRef overflow_neg(CodegenContext *ctx, bool is_unsigned, LLVMValueRef operand,
+                          SourceSpan span);
 #endif
 
+/* Release monomorphization state */
+void mono_destroy(MonoCache *mono);
+
+/* Print instance counts and specialized code size */
+void mono_report_stats(const MonoCache *mono, FILE *out);
+
 /*
  * Target detection and configuration
  */
@@ -139,4 +460,11 @@ void target_init_host(TargetInfo *target);
 void target_init(TargetInfo *target, TargetOS os, TargetArch arch);
 const char *target_get_triple(TargetInfo *target);
 
+/*
+ * Select the CPU and features code is generated for. A NULL `cpu` keeps
+ * "generic"; "native" is the host CPU with the features it reports.
+ * `features` is appended to the CPU's, adding or removing single ones.
+ */
+void target_set_cpu(TargetInfo *target, Arena *arena, const char *cpu, const char *features);
+
 #endif /* CURSIVE_CODEGEN_H */
@@ -0,0 +1,252 @@
+/*
+ * Cursive Bootstrap Compiler - Drop Glue
+ *
+ * Every type whose destruction runs code (type_needs_drop) gets one drop
+ * function, `void cursive.drop<T>(T *)`, generated on first request and
+ * cached per canonical type. The function calls the type's own `drop`
+ * method, if it implements Drop, and then drops the parts that need it:
+ * record fields and tuple elements in declaration order, each array element, and the
+ * payload of the active enum variant or union member. Parts without glue
+ * are skipped entirely, so the glue of a record with one owning field is a
+ * single call.
+ *
+ * Like generic instances, glue has linkonce_odr linkage in a comdat of its
+ * name, so modules that drop the same type share one definition.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/Comdat.h>
+
+/* Type of a record field or enum payload in an instance with `args` */
+static Type *member_type(CodegenContext *ctx, TypeExpr *texpr, Vec(Type *) args) {
+    Type *type = texpr ? texpr->resolved : NULL;
+    if (type && vec_len(args) > 0) {
+        type = type_substitute(&ctx->sema->type_ctx, type, args);
+    }
+    return type;
+}
+
+/* Call the drop glue of `type` on `addr`, if it has any */
+static void call_glue(CodegenContext *ctx, Type *type, LLVMValueRef addr) {
+    LLVMValueRef glue = drop_glue(ctx, type);
+    if (!glue) return;
+
+    LLVMTypeRef fn_type = LLVMGlobalGetValueType(glue);
+    LLVMTypeRef param_type;
+    LLVMGetParamTypes(fn_type, &param_type);
+    addr = LLVMBuildPointerCast(ctx->builder, addr, param_type, "");
+    LLVMBuildCall2(ctx->builder, fn_type, glue, &addr, 1, "");
+}
+
+/*
+ * Function of a type's `drop` method: a specialization for an instance of
+ * a generic type, otherwise the method itself, generated on first use
+ */
+static LLVMValueRef drop_method_function(CodegenContext *ctx, Type *type, ProcDecl *method) {
+    if (type->kind == TYPE_GENERIC_INST) {
+        return mono_instantiate(ctx, method, type->generic_inst.args);
+    }
+
+    LLVMValueRef fn = ptr_map_get(&ctx->func_cache, method);
+    if (!fn) {
+        fn = codegen_declare_proc(ctx, method, codegen_proc_name(ctx, method).data);
+        ptr_map_set(&ctx->func_cache, method, fn);
+        codegen_proc_body(ctx, method, fn);
+    }
+    return fn;
+}
+
+/* Drop each element of an array in place */
+static void drop_elements(CodegenContext *ctx, Type *type, LLVMValueRef self,
+                          LLVMTypeRef llvm_type) {
+    LLVMTypeRef index_type = LLVMInt64TypeInContext(ctx->llvm_ctx);
+    LLVMValueRef zero = LLVMConstInt(index_type, 0, 0);
+    LLVMValueRef count = LLVMConstInt(index_type, type->array.size, 0);
+
+    LLVMBasicBlockRef entry = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef body = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+        ctx->current_func, "element");
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+        ctx->current_func, "done");
+    LLVMBuildBr(ctx->builder, body);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, body);
+    LLVMValueRef index = LLVMBuildPhi(ctx->builder, index_type, "i");
+    LLVMValueRef indices[2] = { zero, index };
+    LLVMValueRef element = LLVMBuildInBoundsGEP2(ctx->builder, llvm_type, self,
+        indices, 2, "element");
+    call_glue(ctx, type->array.element, element);
+
+    LLVMValueRef next = LLVMBuildAdd(ctx->builder, index,
+        LLVMConstInt(index_type, 1, 0), "next");
+    LLVMBuildCondBr(ctx->builder,
+        LLVMBuildICmp(ctx->builder, LLVMIntULT, next, count, ""), body, done);
+
+    LLVMValueRef incoming[2] = { zero, next };
+    LLVMBasicBlockRef from[2] = { entry, LLVMGetInsertBlock(ctx->builder) };
+    LLVMAddIncoming(index, incoming, from, 2);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, done);
+}
+
+/*
+ * Drop the payload of the active alternative of an enum or union.
+ * `payloads[i]` is the type of alternative i, NULL without one.
+ */
+static void drop_alternatives(CodegenContext *ctx, Type *type, LLVMValueRef self,
+                              Type **payloads, size_t count) {
+    LLVMValueRef tag = lower_load_tag(ctx, type, self);
+    if (!tag) return;
+
+    LLVMBasicBlockRef done = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+        ctx->current_func, "done");
+    LLVMValueRef sw = LLVMBuildSwitch(ctx->builder, tag, done, (unsigned)count);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!payloads[i] || !drop_glue(ctx, payloads[i])) continue;
+
+        LLVMBasicBlockRef arm = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+            ctx->current_func, "alt");
+        LLVMAddCase(sw, LLVMConstInt(LLVMTypeOf(tag),
+            lower_tag_value(ctx, type, (uint32_t)i), 0), arm);
+        LLVMPositionBuilderAtEnd(ctx->builder, arm);
+        LLVMValueRef data = lower_payload_addr(ctx, type, self, payloads[i]);
+        if (data) {
+            call_glue(ctx, payloads[i], data);
+        }
+        LLVMBuildBr(ctx->builder, done);
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, done);
+}
+
+/* Drop the parts of a value after its own `drop` method has run */
+static void drop_parts(CodegenContext *ctx, Type *type, LLVMValueRef self,
+                       LLVMTypeRef llvm_type) {
+    Vec(Type *) args = NULL;
+    Type *nominal = type;
+    if (type->kind == TYPE_GENERIC_INST) {
+        args = type->generic_inst.args;
+        nominal = type->generic_inst.base;
+    }
+
+    switch (nominal->kind) {
+        case TYPE_RECORD: {
+            RecordDecl *record = &nominal->nominal.sym->decl->record;
+            for (size_t i = 0; i < vec_len(record->fields); i++) {
+                Type *field = member_type(ctx, record->fields[i].type, args);
+                if (!field || !drop_glue(ctx, field)) continue;
+                call_glue(ctx, field, LLVMBuildStructGEP2(ctx->builder, llvm_type,
+                    self, lower_field_index(ctx, type, (uint32_t)i),
+                    record->fields[i].name.data));
+            }
+            break;
+        }
+
+        case TYPE_ENUM: {
+            EnumDecl *en = &nominal->nominal.sym->decl->enum_;
+            size_t count = vec_len(en->variants);
+            Type **payloads = ARENA_ALLOC_ARRAY(ctx->arena, Type *, count ? count : 1);
+            for (size_t i = 0; i < count; i++) {
+                payloads[i] = member_type(ctx, en->variants[i].payload, args);
+            }
+            drop_alternatives(ctx, type, self, payloads, count);
+            break;
+        }
+
+        case TYPE_UNION:
+            drop_alternatives(ctx, type, self, type->union_.members,
+                vec_len(type->union_.members));
+            break;
+
+        case TYPE_TUPLE:
+            for (size_t i = 0; i < vec_len(type->tuple.elements); i++) {
+                Type *element = type->tuple.elements[i];
+                if (!drop_glue(ctx, element)) continue;
+                call_glue(ctx, element, LLVMBuildStructGEP2(ctx->builder, llvm_type,
+                    self, lower_field_index(ctx, type, (uint32_t)i), ""));
+            }
+            break;
+
+        case TYPE_ARRAY:
+            drop_elements(ctx, type, self, llvm_type);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Get the drop function of a concrete type, generating it on first use.
+ * Returns NULL for types whose destruction does nothing.
+ */
+LLVMValueRef drop_glue(CodegenContext *ctx, Type *type) {
+    TypeContext *types = &ctx->sema->type_ctx;
+    if (!type) return NULL;
+    if (type->perm != PERM_CONST) {
+        type = type_with_permission(types, type, PERM_CONST);
+    }
+
+    LLVMValueRef fn = ptr_map_get(&ctx->drop_glue, type);
+    if (fn) return fn;
+    if (type->has_params || !type_needs_drop(types, type)) return NULL;
+
+    LLVMTypeRef llvm_type = lower_type(ctx, type);
+    LLVMTypeRef param_type = LLVMPointerType(llvm_type, 0);
+    LLVMTypeRef fn_type = LLVMFunctionType(LLVMVoidTypeInContext(ctx->llvm_ctx),
+        &param_type, 1, 0);
+
+    Vec(Type *) key = vec_new(Type *);
+    vec_push(key, type);
+    const char *name = mono_mangle(ctx, string_pool_intern(ctx->strings, "cursive.drop"), key);
+    vec_free(key);
+
+    fn = LLVMAddFunction(ctx->module, name, fn_type);
+    LLVMSetLinkage(fn, LLVMLinkOnceODRLinkage);
+    LLVMSetComdat(fn, LLVMGetOrInsertComdat(ctx->module, name));
+    /* Cached before the body, so glue of parts can refer back to it */
+    ptr_map_set(&ctx->drop_glue, type, fn);
+
+    /* The glue is built between two statements of some other body */
+    LLVMBasicBlockRef saved_block = LLVMGetInsertBlock(ctx->builder);
+    LLVMValueRef saved_func = ctx->current_func;
+    Vec(Type *) saved_subst = ctx->subst;
+    ctx->current_func = fn;
+    ctx->subst = NULL;
+
+    LLVMPositionBuilderAtEnd(ctx->builder,
+        LLVMAppendBasicBlockInContext(ctx->llvm_ctx, fn, "entry"));
+    LLVMValueRef self = LLVMGetParam(fn, 0);
+
+    ProcDecl *method = type_drop_method(type);
+    if (method) {
+        LLVMValueRef user = drop_method_function(ctx, type, method);
+        LLVMTypeRef user_type = LLVMGlobalGetValueType(user);
+        LLVMTypeRef self_type;
+        LLVMGetParamTypes(user_type, &self_type);
+        LLVMValueRef arg = LLVMBuildPointerCast(ctx->builder, self, self_type, "");
+        LLVMBuildCall2(ctx->builder, user_type, user, &arg, 1, "");
+    }
+    drop_parts(ctx, type, self, llvm_type);
+    LLVMBuildRetVoid(ctx->builder);
+
+    ctx->current_func = saved_func;
+    ctx->subst = saved_subst;
+    if (saved_block) {
+        LLVMPositionBuilderAtEnd(ctx->builder, saved_block);
+    }
+    return fn;
+}
+
+/*
+ * Drop the value stored at `addr`, if its type needs it
+ */
+void drop_in_place(CodegenContext *ctx, Type *type, LLVMValueRef addr) {
+    call_glue(ctx, mono_subst(ctx, type), addr);
+}
+
+#endif /* HAVE_LLVM */
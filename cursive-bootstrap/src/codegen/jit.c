@@ -0,0 +1,560 @@
+/*
+ * Cursive Bootstrap Compiler - JIT Execution
+ *
+ * `cursivec -run` compiles the module in-process with ORC's LLJIT and
+ * calls its `main`, so tests and scripts run without an object file, a
+ * linker or a runtime library on disk.
+ *
+ * Compilation is lazy and per function. Each external definition becomes
+ * a unit of its own, split off the way codegen units are (units.c), with
+ * its body renamed `name$body`; `name` itself is a lazy re-export, a stub
+ * that compiles the unit on the first call and then jumps straight to the
+ * body. Calls between functions go through the stubs, so a run compiles
+ * only what it reaches. Local and linkonce definitions are copied into
+ * every unit that uses them, privately.
+ *
+ * With -jit-cache=<dir>, the object of each unit is kept in <dir> under a
+ * hash of the unit's bitcode and of the target, and loaded from there the
+ * next time the same unit is needed, skipping code generation.
+ *
+ * Runtime functions resolve to the copy of cursive_rt linked into the
+ * compiler; anything else, to the symbols of the compiler's process (the
+ * C library).
+ */
+
+#include "codegen.h"
+#include "runtime/cursive_rt.h"
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Error.h>
+#include <llvm-c/LLJIT.h>
+#include <llvm-c/Orc.h>
+
+#ifdef CURSIVE_PLATFORM_WINDOWS
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+/* State of one JIT run, shared by the units */
+typedef struct JitSession {
+    const CodegenContext *ctx;
+    LLVMOrcLLJITRef jit;
+    LLVMTargetMachineRef machine;
+    const char *bitcode;          /* The whole module */
+    size_t bitcode_size;
+    const unsigned *owners;       /* Unit of each function in module order, or -1 */
+    const char *cache_dir;        /* NULL when not caching */
+    uint64_t target_hash;         /* Hash of what besides the IR shapes an object */
+    unsigned compiled;            /* Units generated */
+    unsigned cached;              /* Units loaded from the cache */
+    double milliseconds;          /* Wall time spent materializing units */
+} JitSession;
+
+/* One unit: an external definition and what it alone uses */
+typedef struct JitUnit {
+    JitSession *session;
+    unsigned unit;
+    size_t function;              /* Index of its function in module order */
+} JitUnit;
+
+/* Reached from a lazy stub when compiling its unit failed */
+static JitSession *failed_session;
+
+/* Wall clock time in milliseconds */
+static double wall_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return 1000.0 * (double)ts.tv_sec + (double)ts.tv_nsec / 1e6;
+}
+
+/* FNV-1a, continued from `hash` */
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *s) {
+    return hash_bytes(hash, s, strlen(s) + 1);
+}
+
+/* Report a failure while the program runs: the stub cannot return */
+static void report_unit_error(JitSession *session, const char *what, const char *message) {
+    diag_report(session->ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+        "JIT: %s: %s", what, message);
+    failed_session = session;
+}
+
+/* Called by a lazy stub whose unit failed to compile */
+static void lazy_compile_failed(void) {
+    if (failed_session) {
+        diag_print_all(failed_session->ctx->diag);
+    }
+    fprintf(stderr, "Error: JIT compilation failed; cannot continue.\n");
+    exit(1);
+}
+
+/* Path of a cached object */
+static void cache_path(const JitSession *session, uint64_t hash, char *out, size_t size) {
+    snprintf(out, size, "%s/%016" PRIx64 ".o", session->cache_dir, hash);
+}
+
+/* Store an object in the cache; a failure only costs the next run time */
+static void cache_store(const JitSession *session, uint64_t hash, LLVMMemoryBufferRef object) {
+    char path[4096];
+    char temp[4096 + 8];
+    cache_path(session, hash, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    /* Written aside, then renamed, so no run reads half an object */
+    FILE *f = fopen(temp, "wb");
+    if (!f) return;
+    size_t size = LLVMGetBufferSize(object);
+    bool written = fwrite(LLVMGetBufferStart(object), 1, size, f) == size;
+    if (fclose(f) != 0) written = false;
+    remove(path);
+    if (!written || rename(temp, path) != 0) {
+        remove(temp);
+    }
+}
+
+/*
+ * Split unit `u` off the module: keep its function as `name$body`, make
+ * local every definition it shares with other units, drop what it does
+ * not use
+ */
+static LLVMModuleRef extract(JitUnit *u, LLVMContextRef llvm_ctx, char **error) {
+    JitSession *session = u->session;
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+        session->bitcode, session->bitcode_size, "unit", 0);
+    LLVMModuleRef module = NULL;
+    bool failed = LLVMParseBitcodeInContext2(llvm_ctx, buffer, &module);
+    LLVMDisposeMemoryBuffer(buffer);
+    if (failed) {
+        *error = NULL;
+        return NULL;
+    }
+    codegen_extract_unit(module, session->owners, u->unit);
+
+    size_t index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (index++ == u->function) {
+            size_t len;
+            const char *name = LLVMGetValueName2(fn, &len);
+            char *body = malloc(len + sizeof("$body"));
+            if (body) {
+                memcpy(body, name, len);
+                memcpy(body + len, "$body", sizeof("$body"));
+                LLVMSetValueName2(fn, body, len + sizeof("$body") - 1);
+                free(body);
+            }
+        } else if (!LLVMIsDeclaration(fn) && LLVMGetLinkage(fn) != LLVMExternalLinkage) {
+            LLVMSetLinkage(fn, LLVMInternalLinkage);
+        }
+    }
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global;
+         global = LLVMGetNextGlobal(global)) {
+        if (!LLVMIsDeclaration(global) && LLVMGetLinkage(global) != LLVMExternalLinkage) {
+            LLVMSetLinkage(global, LLVMInternalLinkage);
+        }
+    }
+
+    *error = codegen_run_passes(&session->ctx->options, module, session->machine, "globaldce");
+    return module;
+}
+
+/* Object code of a unit, from the cache or freshly generated */
+static LLVMMemoryBufferRef unit_object(JitUnit *u, LLVMModuleRef module) {
+    JitSession *session = u->session;
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(module);
+    uint64_t hash = hash_bytes(session->target_hash, LLVMGetBufferStart(bitcode),
+        LLVMGetBufferSize(bitcode));
+    LLVMDisposeMemoryBuffer(bitcode);
+
+    LLVMMemoryBufferRef object = NULL;
+    char *message = NULL;
+    if (session->cache_dir) {
+        char path[4096];
+        cache_path(session, hash, path, sizeof(path));
+        if (LLVMCreateMemoryBufferWithContentsOfFile(path, &object, &message) == 0) {
+            session->cached++;
+            return object;
+        }
+        LLVMDisposeMessage(message);
+        message = NULL;
+    }
+
+    if (LLVMTargetMachineEmitToMemoryBuffer(session->machine, module, LLVMObjectFile,
+            &message, &object) != 0) {
+        report_unit_error(session, "code generation failed", message);
+        LLVMDisposeMessage(message);
+        return NULL;
+    }
+    session->compiled++;
+    if (session->cache_dir) {
+        cache_store(session, hash, object);
+    }
+    return object;
+}
+
+/* Compile a unit the first time one of its symbols is needed */
+static void materialize_unit(void *ctx, LLVMOrcMaterializationResponsibilityRef mr) {
+    JitUnit *u = ctx;
+    JitSession *session = u->session;
+    double start = wall_ms();
+
+    LLVMContextRef llvm_ctx = LLVMContextCreate();
+    char *error = NULL;
+    LLVMModuleRef module = extract(u, llvm_ctx, &error);
+    LLVMMemoryBufferRef object = NULL;
+    if (!module) {
+        report_unit_error(session, "cannot read module bitcode", "");
+    } else if (error) {
+        report_unit_error(session, "cannot split module", error);
+        LLVMDisposeErrorMessage(error);
+    } else {
+        object = unit_object(u, module);
+    }
+    if (module) LLVMDisposeModule(module);
+    LLVMContextDispose(llvm_ctx);
+    session->milliseconds += wall_ms() - start;
+
+    if (!object) {
+        LLVMOrcMaterializationResponsibilityFailMaterialization(mr);
+        LLVMOrcDisposeMaterializationResponsibility(mr);
+        return;
+    }
+    LLVMOrcObjectLayerEmit(LLVMOrcLLJITGetObjLinkingLayer(session->jit), mr, object);
+}
+
+/* Units define each symbol once, so nothing is ever overridden */
+static void discard_symbol(void *ctx, LLVMOrcJITDylibRef dylib,
+                           LLVMOrcSymbolStringPoolEntryRef symbol) {
+    (void)ctx;
+    (void)dylib;
+    (void)symbol;
+}
+
+/* Units live in the code generator's arena */
+static void destroy_unit(void *ctx) {
+    (void)ctx;
+}
+
+/* `name` + suffix, mangled and interned */
+static LLVMOrcSymbolStringPoolEntryRef intern(JitSession *session, const char *name,
+                                              size_t len, const char *suffix) {
+    size_t suffix_len = strlen(suffix);
+    char *full = malloc(len + suffix_len + 1);
+    if (!full) return NULL;
+    memcpy(full, name, len);
+    memcpy(full + len, suffix, suffix_len + 1);
+    LLVMOrcSymbolStringPoolEntryRef entry = LLVMOrcLLJITMangleAndIntern(session->jit, full);
+    free(full);
+    return entry;
+}
+
+static LLVMJITSymbolFlags symbol_flags(bool callable) {
+    LLVMJITSymbolFlags flags = {
+        .GenericFlags = LLVMJITSymbolGenericFlagsExported |
+                        (callable ? LLVMJITSymbolGenericFlagsCallable : 0),
+        .TargetFlags = 0,
+    };
+    return flags;
+}
+
+/*
+ * Define every unit in the main JITDylib, each behind a lazy stub
+ */
+static LLVMErrorRef define_units(JitSession *session, CodegenContext *ctx,
+                                 LLVMOrcLazyCallThroughManagerRef lctm,
+                                 LLVMOrcIndirectStubsManagerRef ism) {
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(session->jit);
+    size_t function_count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        function_count++;
+    }
+    unsigned *owners = ARENA_ALLOC_ARRAY(ctx->arena, unsigned, function_count ? function_count : 1);
+    LLVMOrcCSymbolAliasMapPair *stubs = ARENA_ALLOC_ARRAY(ctx->arena,
+        LLVMOrcCSymbolAliasMapPair, function_count ? function_count : 1);
+    session->owners = owners;
+
+    size_t globals = 0;
+    for (LLVMValueRef global = LLVMGetFirstGlobal(ctx->module); global;
+         global = LLVMGetNextGlobal(global)) {
+        globals++;
+    }
+
+    unsigned unit_count = 0;
+    size_t index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        owners[index] = codegen_is_partitioned(fn) ? unit_count++ : (unsigned)-1;
+        index++;
+    }
+
+    index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        unsigned unit = owners[index];
+        if (unit == (unsigned)-1) {
+            index++;
+            continue;
+        }
+        size_t len;
+        const char *name = LLVMGetValueName2(fn, &len);
+
+        /* The body, plus (in unit 0) the external variables */
+        size_t max_symbols = 1 + (unit == 0 ? globals : 0);
+        LLVMOrcCSymbolFlagsMapPair *symbols = ARENA_ALLOC_ARRAY(ctx->arena,
+            LLVMOrcCSymbolFlagsMapPair, max_symbols);
+        size_t symbol_count = 0;
+        symbols[symbol_count++] = (LLVMOrcCSymbolFlagsMapPair){
+            intern(session, name, len, "$body"), symbol_flags(true)
+        };
+        if (unit == 0) {
+            for (LLVMValueRef global = LLVMGetFirstGlobal(ctx->module); global;
+                 global = LLVMGetNextGlobal(global)) {
+                if (LLVMIsDeclaration(global) ||
+                    LLVMGetLinkage(global) != LLVMExternalLinkage) {
+                    continue;
+                }
+                size_t global_len;
+                const char *global_name = LLVMGetValueName2(global, &global_len);
+                symbols[symbol_count++] = (LLVMOrcCSymbolFlagsMapPair){
+                    intern(session, global_name, global_len, ""), symbol_flags(false)
+                };
+            }
+        }
+
+        JitUnit *u = ARENA_ALLOC(ctx->arena, JitUnit);
+        u->session = session;
+        u->unit = unit;
+        u->function = index;
+        LLVMOrcMaterializationUnitRef mu = LLVMOrcCreateCustomMaterializationUnit(
+            name, u, symbols, symbol_count, NULL, materialize_unit, discard_symbol,
+            destroy_unit);
+        LLVMErrorRef error = LLVMOrcJITDylibDefine(dylib, mu);
+        if (error) {
+            LLVMOrcDisposeMaterializationUnit(mu);
+            return error;
+        }
+
+        stubs[unit] = (LLVMOrcCSymbolAliasMapPair){
+            intern(session, name, len, ""),
+            { intern(session, name, len, "$body"), symbol_flags(true) }
+        };
+        index++;
+    }
+
+    LLVMOrcMaterializationUnitRef reexports = LLVMOrcLazyReexports(lctm, ism, dylib,
+        stubs, unit_count);
+    LLVMErrorRef error = LLVMOrcJITDylibDefine(dylib, reexports);
+    if (error) {
+        LLVMOrcDisposeMaterializationUnit(reexports);
+    }
+    return error;
+}
+
+/* Runtime functions JIT'd code calls, at their addresses in this process */
+#define RUNTIME_SYMBOL(name) { #name, (LLVMOrcExecutorAddress)(uintptr_t)name }
+static const struct {
+    const char *name;
+    LLVMOrcExecutorAddress address;
+} runtime_symbols[] = {
+    RUNTIME_SYMBOL(cursive_panic),
+    RUNTIME_SYMBOL(cursive_alloc),
+    RUNTIME_SYMBOL(cursive_dealloc),
+    RUNTIME_SYMBOL(cursive_realloc),
+    RUNTIME_SYMBOL(cursive_alloc_zeroed),
+    RUNTIME_SYMBOL(cursive_string_from_view),
+    RUNTIME_SYMBOL(cursive_string_from_cstr),
+    RUNTIME_SYMBOL(cursive_string_as_view),
+    RUNTIME_SYMBOL(cursive_string_view_from_cstr),
+    RUNTIME_SYMBOL(cursive_string_to_cstr),
+    RUNTIME_SYMBOL(cursive_string_drop),
+    RUNTIME_SYMBOL(cursive_string_append),
+    RUNTIME_SYMBOL(cursive_string_eq),
+    RUNTIME_SYMBOL(cursive_fs_open),
+    RUNTIME_SYMBOL(cursive_fs_read),
+    RUNTIME_SYMBOL(cursive_fs_write),
+    RUNTIME_SYMBOL(cursive_fs_close),
+    RUNTIME_SYMBOL(cursive_fs_write_stdout),
+    RUNTIME_SYMBOL(cursive_fs_write_stderr),
+    RUNTIME_SYMBOL(cursive_fs_read_stdin),
+    RUNTIME_SYMBOL(cursive_add_overflow_i32),
+    RUNTIME_SYMBOL(cursive_add_overflow_i64),
+    RUNTIME_SYMBOL(cursive_sub_overflow_i32),
+    RUNTIME_SYMBOL(cursive_sub_overflow_i64),
+    RUNTIME_SYMBOL(cursive_mul_overflow_i32),
+    RUNTIME_SYMBOL(cursive_mul_overflow_i64),
+    RUNTIME_SYMBOL(cursive_cpu_supports),
+};
+#undef RUNTIME_SYMBOL
+
+/*
+ * Resolve the runtime to the linked-in cursive_rt and everything else to
+ * the process
+ */
+static LLVMErrorRef define_runtime(JitSession *session) {
+    LLVMOrcJITDylibRef dylib = LLVMOrcLLJITGetMainJITDylib(session->jit);
+    size_t count = sizeof(runtime_symbols) / sizeof(runtime_symbols[0]);
+    LLVMJITCSymbolMapPair pairs[sizeof(runtime_symbols) / sizeof(runtime_symbols[0])];
+    for (size_t i = 0; i < count; i++) {
+        pairs[i].Name = LLVMOrcLLJITMangleAndIntern(session->jit, runtime_symbols[i].name);
+        pairs[i].Sym.Address = runtime_symbols[i].address;
+        pairs[i].Sym.Flags = symbol_flags(true);
+    }
+    LLVMOrcMaterializationUnitRef mu = LLVMOrcAbsoluteSymbols(pairs, count);
+    LLVMErrorRef error = LLVMOrcJITDylibDefine(dylib, mu);
+    if (error) {
+        LLVMOrcDisposeMaterializationUnit(mu);
+        return error;
+    }
+
+    LLVMOrcDefinitionGeneratorRef process;
+    error = LLVMOrcCreateDynamicLibrarySearchGeneratorForProcess(&process,
+        LLVMOrcLLJITGetGlobalPrefix(session->jit), NULL, NULL);
+    if (!error) {
+        LLVMOrcJITDylibAddGenerator(dylib, process);
+    }
+    return error;
+}
+
+/* Create the cache directory if it is missing */
+static void make_cache_dir(const char *dir) {
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+}
+
+/* Report an LLVM error and consume it */
+static bool jit_error(CodegenContext *ctx, const char *what, LLVMErrorRef error) {
+    char *message = LLVMGetErrorMessage(error);
+    diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+        "JIT: %s: %s", what, message);
+    LLVMDisposeErrorMessage(message);
+    return false;
+}
+
+/* Call the program's `main`, which returns an i32 or nothing */
+static bool call_main(CodegenContext *ctx, JitSession *session, int *result) {
+    LLVMValueRef main_fn = LLVMGetNamedFunction(ctx->module, "main");
+    if (!main_fn || LLVMIsDeclaration(main_fn)) {
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "JIT: the program has no main procedure");
+        return false;
+    }
+    LLVMTypeRef ret = LLVMGetReturnType(LLVMGlobalGetValueType(main_fn));
+    bool returns_void = LLVMGetTypeKind(ret) == LLVMVoidTypeKind;
+    if (!returns_void && (LLVMGetTypeKind(ret) != LLVMIntegerTypeKind ||
+                          LLVMGetIntTypeWidth(ret) != 32)) {
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "JIT: main must return i32 or nothing");
+        return false;
+    }
+
+    LLVMOrcExecutorAddress address;
+    LLVMErrorRef error = LLVMOrcLLJITLookup(session->jit, &address, "main");
+    if (error) {
+        return jit_error(ctx, "cannot find main", error);
+    }
+    if (returns_void) {
+        ((void (*)(void))(uintptr_t)address)();
+        *result = 0;
+    } else {
+        *result = ((int (*)(void))(uintptr_t)address)();
+    }
+    return true;
+}
+
+/*
+ * JIT-compile the module and run its `main`
+ */
+bool codegen_jit_run(CodegenContext *ctx, int *result) {
+    const CodegenOptions *opts = &ctx->options;
+    JitSession session = {
+        .ctx = ctx,
+        .cache_dir = opts->jit_cache,
+        .target_hash = 0xcbf29ce484222325ULL,
+    };
+    session.target_hash = hash_string(session.target_hash, ctx->target.triple);
+    session.target_hash = hash_string(session.target_hash, ctx->target.cpu);
+    session.target_hash = hash_string(session.target_hash, ctx->target.features);
+    session.target_hash = hash_bytes(session.target_hash, &opts->opt_level,
+        sizeof(opts->opt_level));
+    if (session.cache_dir) {
+        make_cache_dir(session.cache_dir);
+    }
+
+    /* PIC, so calls out of JIT memory reach the runtime through stubs */
+    char *message = NULL;
+    LLVMTargetRef target;
+    if (LLVMGetTargetFromTriple(ctx->target.triple, &target, &message) != 0) {
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "JIT: %s", message);
+        LLVMDisposeMessage(message);
+        return false;
+    }
+    session.machine = LLVMCreateTargetMachine(target, ctx->target.triple, ctx->target.cpu,
+        ctx->target.features, codegen_machine_level(opts->opt_level),
+        LLVMRelocPIC, LLVMCodeModelSmall);
+
+    LLVMOrcLLJITBuilderRef builder = LLVMOrcCreateLLJITBuilder();
+    LLVMErrorRef error = LLVMOrcCreateLLJIT(&session.jit, builder);
+    if (error) {
+        LLVMDisposeTargetMachine(session.machine);
+        return jit_error(ctx, "cannot create JIT", error);
+    }
+
+    LLVMOrcLazyCallThroughManagerRef lctm = NULL;
+    LLVMOrcIndirectStubsManagerRef ism = NULL;
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(ctx->module);
+    session.bitcode = LLVMGetBufferStart(bitcode);
+    session.bitcode_size = LLVMGetBufferSize(bitcode);
+
+    const char *triple = LLVMOrcLLJITGetTripleString(session.jit);
+    bool ok = false;
+    error = LLVMOrcCreateLocalLazyCallThroughManager(triple,
+        LLVMOrcLLJITGetExecutionSession(session.jit),
+        (LLVMOrcJITTargetAddress)(uintptr_t)lazy_compile_failed, &lctm);
+    if (error) {
+        jit_error(ctx, "cannot create lazy call-through manager", error);
+    } else if (!(ism = LLVMOrcCreateLocalIndirectStubsManager(triple))) {
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "JIT: no stubs for target '%s'", triple);
+    } else if ((error = define_runtime(&session)) != NULL) {
+        jit_error(ctx, "cannot define runtime symbols", error);
+    } else if ((error = define_units(&session, ctx, lctm, ism)) != NULL) {
+        jit_error(ctx, "cannot define units", error);
+    } else {
+        ok = call_main(ctx, &session, result);
+    }
+
+    if (opts->time_passes) {
+        fprintf(stderr, "=== JIT ===\n");
+        fprintf(stderr, "  %-16s %9u\n", "units compiled", session.compiled);
+        fprintf(stderr, "  %-16s %9u\n", "units cached", session.cached);
+        fprintf(stderr, "  %-16s %9.3f ms\n", "total", session.milliseconds);
+    }
+
+    error = LLVMOrcDisposeLLJIT(session.jit);
+    if (error) {
+        ok = jit_error(ctx, "cannot tear down JIT", error);
+    }
+    if (ism) LLVMOrcDisposeIndirectStubsManager(ism);
+    if (lctm) LLVMOrcDisposeLazyCallThroughManager(lctm);
+    LLVMDisposeMemoryBuffer(bitcode);
+    LLVMDisposeTargetMachine(session.machine);
+    return ok;
+}
+
+#endif /* HAVE_LLVM */
@@ -12,7 +12,7 @@
  * - () -> void
  * - ! -> void (with noreturn)
  * - record -> named struct
- * - enum -> tagged union
+ * - enum -> tagged union, a bare tag without payloads
  * - tuple -> anonymous struct
  * - array -> [N x T]
  * - slice -> {ptr, len}
@@ -76,97 +76,252 @@ static LLVMTypeRef lower_primitive(CodegenContext *ctx, TypeKind kind) {
 }
 
 /*
- * Lower a record type to LLVM struct
+ * Semantic type of a field or payload type expression, with the type
+ * arguments of a generic instance substituted
  */
-static LLVMTypeRef lower_record(CodegenContext *ctx, Type *type) {
-    Symbol *sym = type->nominal.sym;
-    if (!sym || !sym->decl) {
+static Type *member_type(CodegenContext *ctx, TypeExpr *texpr, Vec(Type *) args) {
+    Type *type = texpr ? texpr->resolved : NULL;
+    if (type && vec_len(args) > 0) {
+        type = type_substitute(&ctx->sema->type_ctx, type, args);
+    }
+    return type;
+}
+
+/*
+ * Type a part is stored as: its lowered type, or an empty struct for
+ * zero-sized types that lower to void
+ */
+static LLVMTypeRef storage_type(CodegenContext *ctx, Type *type) {
+    LLVMTypeRef llvm_type = type ? lower_type(ctx, type) : LLVMInt32TypeInContext(ctx->llvm_ctx);
+    if (LLVMGetTypeKind(llvm_type) == LLVMVoidTypeKind) {
+        return LLVMStructTypeInContext(ctx->llvm_ctx, NULL, 0, 0);
+    }
+    return llvm_type;
+}
+
+static uint64_t align_up(uint64_t value, uint64_t align) {
+    return (value + align - 1) / align * align;
+}
+
+/*
+ * Append parts (in memory order) so each starts at its layout offset,
+ * with byte arrays where LLVM would otherwise place a part too early and
+ * at the end, up to `size`. `slots[k]` receives part k's element index.
+ * Fails unpacked if LLVM would place a part after its offset.
+ */
+static bool place_parts(CodegenContext *ctx, bool packed, size_t count,
+                        const LLVMTypeRef *types, const uint64_t *offsets, uint64_t size,
+                        LLVMTypeRef **elems, unsigned *slots) {
+    LLVMTypeRef byte = LLVMInt8TypeInContext(ctx->llvm_ctx);
+    uint64_t end = 0;
+    uint64_t align = 1;
+    for (size_t k = 0; k < count; k++) {
+        uint64_t part_align = packed ? 1 : LLVMABIAlignmentOfType(ctx->target_data, types[k]);
+        if (offsets[k] % part_align != 0 || align_up(end, part_align) > offsets[k]) {
+            return false;
+        }
+        if (align_up(end, part_align) < offsets[k]) {
+            vec_push(*elems, LLVMArrayType(byte, (unsigned)(offsets[k] - end)));
+        }
+        slots[k] = (unsigned)vec_len(*elems);
+        vec_push(*elems, types[k]);
+        end = offsets[k] + LLVMABISizeOfType(ctx->target_data, types[k]);
+        if (part_align > align) align = part_align;
+    }
+    if (end < size && align_up(end, align) != size) {
+        vec_push(*elems, LLVMArrayType(byte, (unsigned)(size - end)));
+    }
+    return true;
+}
+
+/*
+ * Struct with parts at the given offsets; `named` gets the body, or a
+ * literal struct is created when it is NULL. Unpacked unless the offsets
+ * need it, so loads and stores keep their natural alignment.
+ */
+static LLVMTypeRef struct_at_offsets(CodegenContext *ctx, LLVMTypeRef named, bool packed,
+                                     size_t count, const LLVMTypeRef *types,
+                                     const uint64_t *offsets, uint64_t size, unsigned *slots) {
+    LLVMTypeRef *elems = vec_new(LLVMTypeRef);
+    if (packed || !place_parts(ctx, false, count, types, offsets, size, &elems, slots)) {
+        vec_clear(elems);
+        packed = true;
+        place_parts(ctx, true, count, types, offsets, size, &elems, slots);
+    }
+
+    if (named) {
+        LLVMStructSetBody(named, elems, (unsigned)vec_len(elems), packed);
+    } else {
+        named = LLVMStructTypeInContext(ctx->llvm_ctx, elems, (unsigned)vec_len(elems), packed);
+    }
+    vec_free(elems);
+    return named;
+}
+
+/*
+ * Struct of a record or tuple laid out by `layout`, with `parts` in
+ * declaration order. Records whose layout sema could not compute keep
+ * declaration order and LLVM's own padding.
+ */
+static LLVMTypeRef lower_fields(CodegenContext *ctx, Type *type, LLVMTypeRef named,
+                                const LLVMTypeRef *parts, size_t count) {
+    const Layout *layout = layout_of(&ctx->sema->layout, type);
+    if (!layout || layout->kind != LAYOUT_STRUCT || layout->field_count != count) {
+        if (named) {
+            LLVMStructSetBody(named, (LLVMTypeRef *)parts, (unsigned)count, 0);
+            return named;
+        }
+        return LLVMStructTypeInContext(ctx->llvm_ctx, (LLVMTypeRef *)parts, (unsigned)count, 0);
+    }
+
+    LLVMTypeRef *types = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef, count ? count : 1);
+    uint64_t *offsets = ARENA_ALLOC_ARRAY(ctx->arena, uint64_t, count ? count : 1);
+    unsigned *by_rank = ARENA_ALLOC_ARRAY(ctx->arena, unsigned, count ? count : 1);
+    for (size_t rank = 0; rank < count; rank++) {
+        uint32_t i = layout->order[rank];
+        types[rank] = parts[i];
+        offsets[rank] = layout->fields[i].offset;
+    }
+
+    LLVMTypeRef result = struct_at_offsets(ctx, named, layout->packed, count, types,
+        offsets, layout->size, by_rank);
+
+    unsigned *slots = ARENA_ALLOC_ARRAY(ctx->arena, unsigned, count ? count : 1);
+    for (size_t i = 0; i < count; i++) {
+        slots[i] = by_rank[layout->fields[i].rank];
+    }
+    ptr_map_set(&ctx->field_slots, type, slots);
+    return result;
+}
+
+/* Integer array aligned like the most aligned payload, covering all of them */
+static LLVMTypeRef payload_storage(CodegenContext *ctx, const Layout *layout) {
+    uint32_t unit = layout->payload_align;
+    if (unit > ctx->sema->layout.target.max_scalar_align) {
+        unit = ctx->sema->layout.target.max_scalar_align;
+    }
+    return LLVMArrayType(LLVMIntTypeInContext(ctx->llvm_ctx, unit * 8),
+        (unsigned)((layout->payload_size + unit - 1) / unit));
+}
+
+/*
+ * Struct of an enum or union with payloads: the tag, then the payload
+ * storage, or just the payload when the tag lives in its niche
+ */
+static LLVMTypeRef lower_tagged(CodegenContext *ctx, const Layout *layout, LLVMTypeRef named) {
+    LLVMTypeRef parts[2];
+    uint64_t offsets[2] = { 0, 0 };
+    unsigned slots[2];
+
+    if (!layout) {
+        parts[0] = LLVMInt32TypeInContext(ctx->llvm_ctx);
+        return struct_at_offsets(ctx, named, false, 1, parts, offsets, 4, slots);
+    }
+    if (layout->encoding == TAG_NICHE) {
+        parts[0] = payload_storage(ctx, layout);
+        return struct_at_offsets(ctx, named, false, 1, parts, offsets, layout->size, slots);
+    }
+
+    parts[0] = LLVMIntTypeInContext(ctx->llvm_ctx, layout->tag_size * 8);
+    parts[1] = payload_storage(ctx, layout);
+    offsets[1] = layout->payload_offset;
+    return struct_at_offsets(ctx, named, false, 2, parts, offsets, layout->size, slots);
+}
+
+/* Layout of a tagged type that is just its tag, or NULL */
+static const Layout *tag_only_layout(CodegenContext *ctx, Type *type) {
+    const Layout *layout = layout_of(&ctx->sema->layout, type);
+    if (!layout || layout->kind != LAYOUT_TAGGED) return NULL;
+    return layout->encoding == TAG_DIRECT && layout->payload_size == 0 &&
+           layout->size == layout->tag_size ? layout : NULL;
+}
+
+/*
+ * Lower a record type to LLVM struct. `args` are the type arguments of a
+ * generic instance (NULL otherwise); each instance is a distinct struct.
+ */
+static LLVMTypeRef lower_record(CodegenContext *ctx, Type *type, Symbol *sym,
+                                Vec(Type *) args, const char *name) {
+    if (!sym || !sym->decl || sym->decl->kind != DECL_RECORD) {
         return LLVMVoidTypeInContext(ctx->llvm_ctx);
     }
 
     /* Check cache first */
-    uintptr_t cached;
-    if (map_get(&ctx->type_cache, (uintptr_t)type, &cached)) {
-        return (LLVMTypeRef)cached;
+    LLVMTypeRef cached = ptr_map_get(&ctx->type_cache, type);
+    if (cached) {
+        return cached;
     }
 
     RecordDecl *record = &sym->decl->record;
     size_t field_count = vec_len(record->fields);
 
     /* Create opaque struct first (for recursive types) */
-    LLVMTypeRef struct_type = LLVMStructCreateNamed(ctx->llvm_ctx, sym->name.data);
-    map_put(&ctx->type_cache, (uintptr_t)type, (uintptr_t)struct_type);
+    LLVMTypeRef struct_type = LLVMStructCreateNamed(ctx->llvm_ctx, name);
+    ptr_map_set(&ctx->type_cache, type, struct_type);
 
     /* Lower field types */
-    LLVMTypeRef *field_types = arena_alloc(ctx->arena,
-        field_count * sizeof(LLVMTypeRef), _Alignof(LLVMTypeRef));
-
+    LLVMTypeRef *field_types = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef,
+        field_count ? field_count : 1);
     for (size_t i = 0; i < field_count; i++) {
-        /* Placeholder - would need resolved types from sema */
-        field_types[i] = LLVMInt32TypeInContext(ctx->llvm_ctx);
+        field_types[i] = storage_type(ctx, member_type(ctx, record->fields[i].type, args));
     }
 
-    LLVMStructSetBody(struct_type, field_types, (unsigned)field_count, 0);
-    return struct_type;
+    return lower_fields(ctx, type, struct_type, field_types, field_count);
 }
 
 /*
  * Lower an enum type to LLVM tagged union
  */
-static LLVMTypeRef lower_enum(CodegenContext *ctx, Type *type) {
-    Symbol *sym = type->nominal.sym;
-    if (!sym || !sym->decl) {
+static LLVMTypeRef lower_enum(CodegenContext *ctx, Type *type, Symbol *sym,
+                              Vec(Type *) args, const char *name) {
+    if (!sym || !sym->decl || sym->decl->kind != DECL_ENUM) {
         return LLVMVoidTypeInContext(ctx->llvm_ctx);
     }
 
     /* Check cache first */
-    uintptr_t cached;
-    if (map_get(&ctx->type_cache, (uintptr_t)type, &cached)) {
-        return (LLVMTypeRef)cached;
+    LLVMTypeRef cached = ptr_map_get(&ctx->type_cache, type);
+    if (cached) {
+        return cached;
     }
 
-    EnumDecl *enum_decl = &sym->decl->enum_;
-    size_t variant_count = vec_len(enum_decl->variants);
-
-    /* Determine tag size based on variant count */
-    LLVMTypeRef tag_type;
-    if (variant_count <= 256) {
-        tag_type = LLVMInt8TypeInContext(ctx->llvm_ctx);
-    } else if (variant_count <= 65536) {
-        tag_type = LLVMInt16TypeInContext(ctx->llvm_ctx);
-    } else {
-        tag_type = LLVMInt32TypeInContext(ctx->llvm_ctx);
+    /* Enums without payloads are bare integers */
+    const Layout *layout = tag_only_layout(ctx, type);
+    if (layout) {
+        return LLVMIntTypeInContext(ctx->llvm_ctx, layout->tag_size * 8);
     }
 
-    /* Find maximum payload size */
-    size_t max_payload_size = 0;
-    for (size_t i = 0; i < variant_count; i++) {
-        EnumVariant *variant = &enum_decl->variants[i];
-        if (variant->payload) {
-            /* Placeholder size calculation */
-            size_t payload_size = 8;
-            if (payload_size > max_payload_size) {
-                max_payload_size = payload_size;
-            }
-        }
-    }
+    LLVMTypeRef struct_type = LLVMStructCreateNamed(ctx->llvm_ctx, name);
+    ptr_map_set(&ctx->type_cache, type, struct_type);
 
-    /* Create struct: { tag, payload_bytes } */
-    LLVMTypeRef struct_type = LLVMStructCreateNamed(ctx->llvm_ctx, sym->name.data);
-    map_put(&ctx->type_cache, (uintptr_t)type, (uintptr_t)struct_type);
+    /* Payloads are lowered on their own when a variant is matched */
+    (void)args;
+    layout = layout_of(&ctx->sema->layout, type);
+    return lower_tagged(ctx, layout && layout->kind == LAYOUT_TAGGED ? layout : NULL,
+        struct_type);
+}
 
-    if (max_payload_size > 0) {
-        LLVMTypeRef payload_type = LLVMArrayType(
-            LLVMInt8TypeInContext(ctx->llvm_ctx),
-            (unsigned)max_payload_size);
-        LLVMTypeRef fields[2] = { tag_type, payload_type };
-        LLVMStructSetBody(struct_type, fields, 2, 0);
-    } else {
-        /* No payloads - just the tag */
-        LLVMStructSetBody(struct_type, &tag_type, 1, 0);
+/*
+ * Lower an instance of a generic record or enum. The instance's arguments
+ * are substituted into the declaration's field/payload types; the struct
+ * is named after the instance so distinct instances never share a layout.
+ */
+static LLVMTypeRef lower_generic_inst(CodegenContext *ctx, Type *type) {
+    Type *base = type->generic_inst.base;
+    Vec(Type *) args = type->generic_inst.args;
+    if (!base || !base->nominal.sym) {
+        return LLVMVoidTypeInContext(ctx->llvm_ctx);
     }
 
-    return struct_type;
+    Symbol *sym = base->nominal.sym;
+    const char *name = mono_mangle(ctx, sym->name, args);
+    switch (base->kind) {
+        case TYPE_RECORD:
+            return lower_record(ctx, type, sym, args, name);
+        case TYPE_ENUM:
+            return lower_enum(ctx, type, sym, args, name);
+        default:
+            return lower_type(ctx, base);
+    }
 }
 
 /*
@@ -175,15 +330,13 @@ static LLVMTypeRef lower_enum(CodegenContext *ctx, Type *type) {
 static LLVMTypeRef lower_tuple(CodegenContext *ctx, Type *type) {
     size_t elem_count = vec_len(type->tuple.elements);
 
-    LLVMTypeRef *elem_types = arena_alloc(ctx->arena,
-        elem_count * sizeof(LLVMTypeRef), _Alignof(LLVMTypeRef));
-
+    LLVMTypeRef *elem_types = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef,
+        elem_count ? elem_count : 1);
     for (size_t i = 0; i < elem_count; i++) {
-        elem_types[i] = lower_type(ctx, type->tuple.elements[i]);
+        elem_types[i] = storage_type(ctx, type->tuple.elements[i]);
     }
 
-    return LLVMStructTypeInContext(ctx->llvm_ctx, elem_types,
-        (unsigned)elem_count, 0);
+    return lower_fields(ctx, type, NULL, elem_types, elem_count);
 }
 
 /*
@@ -212,8 +365,7 @@ static LLVMTypeRef lower_slice(CodegenContext *ctx, Type *type) {
 static LLVMTypeRef lower_function(CodegenContext *ctx, Type *type) {
     size_t param_count = vec_len(type->function.params);
 
-    LLVMTypeRef *param_types = arena_alloc(ctx->arena,
-        param_count * sizeof(LLVMTypeRef), _Alignof(LLVMTypeRef));
+    LLVMTypeRef *param_types = ARENA_ALLOC_ARRAY(ctx->arena, LLVMTypeRef, param_count);
 
     for (size_t i = 0; i < param_count; i++) {
         param_types[i] = lower_type(ctx, type->function.params[i]);
@@ -236,33 +388,103 @@ static LLVMTypeRef lower_pointer(CodegenContext *ctx, Type *type) {
  * Lower a union type -> tagged union with all possible types
  */
 static LLVMTypeRef lower_union(CodegenContext *ctx, Type *type) {
-    size_t member_count = vec_len(type->union_.members);
-
-    /* Find the maximum member size */
-    size_t max_size = 0;
-    for (size_t i = 0; i < member_count; i++) {
-        LLVMTypeRef member_type = lower_type(ctx, type->union_.members[i]);
-        size_t size = LLVMABISizeOfType(ctx->target_data, member_type);
-        if (size > max_size) {
-            max_size = size;
-        }
+    const Layout *layout = tag_only_layout(ctx, type);
+    if (layout) {
+        return LLVMIntTypeInContext(ctx->llvm_ctx, layout->tag_size * 8);
+    }
+    layout = layout_of(&ctx->sema->layout, type);
+    return lower_tagged(ctx, layout && layout->kind == LAYOUT_TAGGED ? layout : NULL, NULL);
+}
+
+/*
+ * The concrete, const variant of a type: the key of the lowering caches
+ */
+static Type *concrete_type(CodegenContext *ctx, Type *type) {
+    /* Inside a generic instance, lower the concrete type */
+    type = mono_subst(ctx, type);
+
+    /* Permissions do not affect representation; lower the const variant */
+    if (type->perm != PERM_CONST) {
+        type = type_with_permission(&ctx->sema->type_ctx, type, PERM_CONST);
     }
+    return type;
+}
 
-    /* Determine tag size */
-    LLVMTypeRef tag_type;
-    if (member_count <= 256) {
-        tag_type = LLVMInt8TypeInContext(ctx->llvm_ctx);
-    } else {
-        tag_type = LLVMInt16TypeInContext(ctx->llvm_ctx);
+unsigned lower_field_index(CodegenContext *ctx, Type *type, uint32_t index) {
+    if (!type) return index;
+    type = concrete_type(ctx, type);
+    lower_type(ctx, type);
+    unsigned *slots = ptr_map_get(&ctx->field_slots, type);
+    return slots ? slots[index] : index;
+}
+
+/* Address `offset` bytes into the value at `addr`, as a `type` pointer */
+static LLVMValueRef byte_offset(CodegenContext *ctx, LLVMValueRef addr, uint64_t offset,
+                                LLVMTypeRef type, const char *name) {
+    LLVMTypeRef i8 = LLVMInt8TypeInContext(ctx->llvm_ctx);
+    LLVMValueRef bytes = LLVMBuildPointerCast(ctx->builder, addr, LLVMPointerType(i8, 0), "");
+    if (offset > 0) {
+        LLVMValueRef index = LLVMConstInt(LLVMInt64TypeInContext(ctx->llvm_ctx), offset, 0);
+        bytes = LLVMBuildInBoundsGEP2(ctx->builder, i8, bytes, &index, 1, "");
     }
+    return LLVMBuildPointerCast(ctx->builder, bytes, LLVMPointerType(type, 0), name);
+}
 
-    /* Create union representation: { tag, data } */
-    LLVMTypeRef data_type = LLVMArrayType(
-        LLVMInt8TypeInContext(ctx->llvm_ctx),
-        (unsigned)max_size);
+/* Layout of an enum or union after substitution, or NULL */
+static const Layout *tagged_layout(CodegenContext *ctx, Type *type) {
+    const Layout *layout = type ? layout_of(&ctx->sema->layout, mono_subst(ctx, type)) : NULL;
+    return layout && layout->kind == LAYOUT_TAGGED ? layout : NULL;
+}
 
-    LLVMTypeRef fields[2] = { tag_type, data_type };
-    return LLVMStructTypeInContext(ctx->llvm_ctx, fields, 2, 0);
+LLVMValueRef lower_load_tag(CodegenContext *ctx, Type *type, LLVMValueRef addr) {
+    const Layout *layout = tagged_layout(ctx, type);
+    if (!layout) return NULL;
+
+    LLVMTypeRef tag_type = LLVMIntTypeInContext(ctx->llvm_ctx, layout->tag_size * 8);
+    LLVMValueRef tag = LLVMBuildLoad2(ctx->builder, tag_type,
+        byte_offset(ctx, addr, layout->tag_offset, tag_type, "tag.addr"), "tag");
+
+    /* A niche inside a packed record may be misaligned */
+    uint64_t align = layout->align;
+    while (layout->tag_offset % align != 0) align /= 2;
+    LLVMSetAlignment(tag, (unsigned)align);
+
+    if (layout->encoding == TAG_DIRECT) {
+        return tag;
+    }
+
+    /* Values from niche_first name the other alternatives, in order around
+       the one with data; every other value is that one */
+    LLVMValueRef dataful = LLVMConstInt(tag_type, layout->dataful, 0);
+    LLVMValueRef relative = LLVMBuildSub(ctx->builder, tag,
+        LLVMConstInt(tag_type, layout->niche_first, 0), "");
+    LLVMValueRef in_niche = LLVMBuildICmp(ctx->builder, LLVMIntULT, relative,
+        LLVMConstInt(tag_type, layout->niche_count, 0), "");
+    LLVMValueRef past = LLVMBuildZExt(ctx->builder,
+        LLVMBuildICmp(ctx->builder, LLVMIntUGE, relative, dataful, ""), tag_type, "");
+    return LLVMBuildSelect(ctx->builder, in_niche,
+        LLVMBuildAdd(ctx->builder, relative, past, ""), dataful, "variant");
+}
+
+uint64_t lower_tag_value(CodegenContext *ctx, Type *type, uint32_t index) {
+    const Layout *layout = tagged_layout(ctx, type);
+    if (type && type->kind == TYPE_GENERIC_INST) type = type->generic_inst.base;
+    if (!layout || layout->encoding != TAG_DIRECT || !type || type->kind != TYPE_ENUM ||
+        !type->nominal.sym || !type->nominal.sym->decl ||
+        type->nominal.sym->decl->kind != DECL_ENUM) {
+        return index;
+    }
+    EnumDecl *decl = &type->nominal.sym->decl->enum_;
+    return index < vec_len(decl->variants) ? (uint64_t)decl->variants[index].value : index;
+}
+
+LLVMValueRef lower_payload_addr(CodegenContext *ctx, Type *type, LLVMValueRef addr,
+                                Type *payload) {
+    const Layout *layout = tagged_layout(ctx, type);
+    if (!layout || layout->payload_size == 0) return NULL;
+    LLVMTypeRef payload_type = lower_type(ctx, mono_subst(ctx, payload));
+    if (LLVMGetTypeKind(payload_type) == LLVMVoidTypeKind) return NULL;
+    return byte_offset(ctx, addr, layout->payload_offset, payload_type, "payload");
 }
 
 /*
@@ -273,10 +495,12 @@ LLVMTypeRef lower_type(CodegenContext *ctx, Type *type) {
         return LLVMVoidTypeInContext(ctx->llvm_ctx);
     }
 
-    /* Check cache */
-    uintptr_t cached;
-    if (map_get(&ctx->type_cache, (uintptr_t)type, &cached)) {
-        return (LLVMTypeRef)cached;
+    type = concrete_type(ctx, type);
+
+    /* Types are canonical, so the cache is keyed by pointer */
+    LLVMTypeRef cached = ptr_map_get(&ctx->type_cache, type);
+    if (cached) {
+        return cached;
     }
 
     LLVMTypeRef result;
@@ -323,11 +547,13 @@ LLVMTypeRef lower_type(CodegenContext *ctx, Type *type) {
             break;
 
         case TYPE_RECORD:
-            result = lower_record(ctx, type);
+            result = lower_record(ctx, type, type->nominal.sym, NULL,
+                type->nominal.sym ? type->nominal.sym->name.data : "record");
             break;
 
         case TYPE_ENUM:
-            result = lower_enum(ctx, type);
+            result = lower_enum(ctx, type, type->nominal.sym, NULL,
+                type->nominal.sym ? type->nominal.sym->name.data : "enum");
             break;
 
         case TYPE_MODAL:
@@ -372,7 +598,7 @@ LLVMTypeRef lower_type(CodegenContext *ctx, Type *type) {
             break;
 
         case TYPE_GENERIC_INST:
-            result = lower_type(ctx, type->generic_inst.base);
+            result = lower_generic_inst(ctx, type);
             break;
 
         case TYPE_ERROR:
@@ -386,7 +612,7 @@ LLVMTypeRef lower_type(CodegenContext *ctx, Type *type) {
     }
 
     /* Cache the result */
-    map_put(&ctx->type_cache, (uintptr_t)type, (uintptr_t)result);
+    ptr_map_set(&ctx->type_cache, type, result);
     return result;
 }
 
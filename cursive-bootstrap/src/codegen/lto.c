@@ -0,0 +1,258 @@
+/*
+ * Cursive Bootstrap Compiler - ThinLTO
+ *
+ * With -flto=thin, `-c` stops after the ThinLTO pre-link pipeline and
+ * writes bitcode carrying a module summary (summary.cpp) instead of an
+ * object file. Without `-c`, the driver links: every bitcode input, the
+ * module just compiled if there is one, and the runtime compiled to
+ * bitcode (cursive_rt.bc) go through libLTO's ThinLTO code generator,
+ * which reads the summaries, imports small functions across modules -
+ * cursive_string_eq, the overflow helpers - optimizes each module with
+ * its imports and emits one object per module, in parallel.
+ *
+ * The external definitions of Cursive modules, and `main`, are kept
+ * whether or not anything in the link refers to them; symbols a module
+ * refers to but does not define are cross-referenced, so their definition
+ * survives wherever it lands. Runtime functions nothing refers to may be
+ * dropped.
+ *
+ * The link needs libLTO (HAVE_LIBLTO); without it, -flto=thin can still
+ * write bitcode, and a link reports that it is unavailable.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/BitReader.h>
+#include <llvm-c/Error.h>
+#ifdef HAVE_LIBLTO
+#include <llvm-c/lto.h>
+#endif
+
+/* Defined in summary.cpp */
+LLVMMemoryBufferRef codegen_thin_bitcode(LLVMModuleRef module);
+
+/*
+ * Name every global and write a module as ThinLTO bitcode; NULL (with a
+ * diagnostic) if the passes fail
+ */
+LLVMMemoryBufferRef lto_thin_bitcode(const CodegenOptions *opts, DiagContext *diag,
+                                     LLVMModuleRef module) {
+    char *message = codegen_run_passes(opts, module, NULL, "name-anon-globals");
+    if (message) {
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "Cannot prepare module for ThinLTO: %s", message);
+        LLVMDisposeErrorMessage(message);
+        return NULL;
+    }
+    return codegen_thin_bitcode(module);
+}
+
+#ifdef HAVE_LIBLTO
+
+/* A module queued for the link: its summary bitcode and identifier */
+typedef struct LinkModule {
+    LLVMMemoryBufferRef bitcode;
+    const char *name;
+} LinkModule;
+
+/* Whether a global is one of the module's external definitions */
+static bool is_external_definition(LLVMValueRef global) {
+    if (LLVMIsDeclaration(global)) return false;
+    LLVMLinkage linkage = LLVMGetLinkage(global);
+    return linkage == LLVMExternalLinkage || linkage == LLVMWeakAnyLinkage ||
+           linkage == LLVMWeakODRLinkage;
+}
+
+/* Tell the code generator which of a module's symbols must survive */
+static void mark_symbols(thinlto_code_gen_t cg, LLVMValueRef global, bool preserve) {
+    size_t len;
+    const char *name = LLVMGetValueName2(global, &len);
+    if (len == 0 || LLVMGetIntrinsicID(global) != 0) {
+        return;
+    }
+    if (LLVMIsDeclaration(global)) {
+        thinlto_codegen_add_cross_referenced_symbol(cg, name, (int)len);
+    } else if (is_external_definition(global) &&
+               (preserve || (len == 4 && memcmp(name, "main", 4) == 0))) {
+        thinlto_codegen_add_must_preserve_symbol(cg, name, (int)len);
+    }
+}
+
+/* Queue a parsed module for the link */
+static bool add_module(thinlto_code_gen_t cg, const CodegenOptions *opts, DiagContext *diag,
+                       LLVMModuleRef module, const char *name, bool preserve,
+                       LinkModule *out) {
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        mark_symbols(cg, fn, preserve);
+    }
+    for (LLVMValueRef global = LLVMGetFirstGlobal(module); global;
+         global = LLVMGetNextGlobal(global)) {
+        mark_symbols(cg, global, preserve);
+    }
+
+    out->bitcode = lto_thin_bitcode(opts, diag, module);
+    out->name = name;
+    if (!out->bitcode) {
+        return false;
+    }
+    thinlto_codegen_add_module(cg, name, LLVMGetBufferStart(out->bitcode),
+        (int)LLVMGetBufferSize(out->bitcode));
+    return true;
+}
+
+/* Read a bitcode file into a module of `llvm_ctx` */
+static LLVMModuleRef read_bitcode(LLVMContextRef llvm_ctx, DiagContext *diag,
+                                  const char *path) {
+    LLVMMemoryBufferRef buffer;
+    char *message = NULL;
+    if (LLVMCreateMemoryBufferWithContentsOfFile(path, &buffer, &message)) {
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "Cannot read '%s': %s", path, message);
+        LLVMDisposeMessage(message);
+        return NULL;
+    }
+
+    LLVMModuleRef module = NULL;
+    bool failed = LLVMParseBitcodeInContext2(llvm_ctx, buffer, &module);
+    LLVMDisposeMemoryBuffer(buffer);
+    if (failed) {
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "'%s' is not LLVM bitcode", path);
+        return NULL;
+    }
+
+    /* libLTO aborts on modules that do not name their target */
+    if (!*LLVMGetDataLayoutStr(module) || !*LLVMGetTarget(module)) {
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "'%s' has no target triple or data layout", path);
+        LLVMDisposeModule(module);
+        return NULL;
+    }
+    return module;
+}
+
+/* The -O level passed to libLTO, which knows only 0 to 3 */
+static void set_link_level(OptLevel level) {
+    static bool set = false;
+    if (set) {
+        return;
+    }
+    const char *option = level == OPT_O0 ? "-O0"
+                       : level == OPT_O1 ? "-O1"
+                       : level == OPT_O3 ? "-O3"
+                       : "-O2";
+    thinlto_debug_options(&option, 1);
+    set = true;
+}
+
+/* Write each object the code generator produced; the count, 0 on failure */
+static unsigned write_objects(thinlto_code_gen_t cg, Arena *arena, DiagContext *diag,
+                              const char *filename) {
+    unsigned count = thinlto_module_get_num_objects(cg);
+    if (count == 0) {
+        const char *message = lto_get_error_message();
+        diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "ThinLTO failed: %s", message && *message ? message : "no objects produced");
+        return 0;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        LTOObjectBuffer object = thinlto_module_get_object(cg, i);
+        const char *path = codegen_unit_filename(arena, filename, i);
+        FILE *f = fopen(path, "wb");
+        bool written = f && fwrite(object.Buffer, 1, object.Size, f) == object.Size;
+        if (f && fclose(f) != 0) {
+            written = false;
+        }
+        if (!written) {
+            diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+                "Failed to write object file '%s'", path);
+            return 0;
+        }
+    }
+    return count;
+}
+
+/*
+ * Link with ThinLTO and write one object per module
+ */
+unsigned codegen_thin_link(const CodegenOptions *opts, Arena *arena, DiagContext *diag,
+                           LLVMModuleRef module, const char *const *inputs,
+                           size_t input_count, const char *runtime, const char *filename) {
+    TargetInfo target;
+    target_init_host(&target);
+    target_set_cpu(&target, arena, opts->cpu, opts->features);
+
+    set_link_level(opts->opt_level);
+    thinlto_code_gen_t cg = thinlto_create_codegen();
+    thinlto_codegen_set_cpu(cg, target.cpu);
+    thinlto_codegen_set_pic_model(cg, LTO_CODEGEN_PIC_MODEL_DEFAULT);
+
+    /* libLTO reads the buffers until processing ends */
+    size_t capacity = input_count + 2;
+    LinkModule *modules = ARENA_ALLOC_ARRAY(arena, LinkModule, capacity);
+    size_t count = 0;
+    bool ok = true;
+
+    if (module) {
+        size_t len;
+        const char *name = LLVMGetModuleIdentifier(module, &len);
+        ok = add_module(cg, opts, diag, module, arena_strndup(arena, name, len), true,
+            &modules[count++]);
+    }
+
+    LLVMContextRef llvm_ctx = LLVMContextCreate();
+    for (size_t i = 0; ok && i <= input_count; i++) {
+        const char *path = i < input_count ? inputs[i] : runtime;
+        if (!path) break;
+        LLVMModuleRef input = read_bitcode(llvm_ctx, diag, path);
+        if (!input) {
+            ok = false;
+            break;
+        }
+        ok = add_module(cg, opts, diag, input, path, i < input_count, &modules[count++]);
+        LLVMDisposeModule(input);
+    }
+
+    unsigned objects = 0;
+    if (ok) {
+        thinlto_codegen_process(cg);
+        objects = write_objects(cg, arena, diag, filename);
+    }
+
+    thinlto_codegen_dispose(cg);
+    for (size_t i = 0; i < count; i++) {
+        if (modules[i].bitcode) {
+            LLVMDisposeMemoryBuffer(modules[i].bitcode);
+        }
+    }
+    LLVMContextDispose(llvm_ctx);
+    return objects;
+}
+
+#else /* !HAVE_LIBLTO */
+
+/*
+ * Built without libLTO: there is no ThinLTO link
+ */
+unsigned codegen_thin_link(const CodegenOptions *opts, Arena *arena, DiagContext *diag,
+                           LLVMModuleRef module, const char *const *inputs,
+                           size_t input_count, const char *runtime, const char *filename) {
+    (void)opts;
+    (void)arena;
+    (void)module;
+    (void)inputs;
+    (void)input_count;
+    (void)runtime;
+    (void)filename;
+    diag_report(diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+        "ThinLTO links are unavailable: this compiler was built without libLTO "
+        "(-c -flto=thin still writes bitcode)");
+    return 0;
+}
+
+#endif /* HAVE_LIBLTO */
+
+#endif /* HAVE_LLVM */
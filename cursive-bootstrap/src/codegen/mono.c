@@ -0,0 +1,347 @@
+/*
+ * Cursive Bootstrap Compiler - Monomorphization
+ *
+ * Generic procedures are compiled once per distinct list of concrete type
+ * arguments. Call sites request an instance through mono_instantiate; the
+ * first request declares a specialized function and queues its body, later
+ * requests for the same (declaration, arguments) pair reuse it. Bodies are
+ * generated after the module's own procedures, with the instance's
+ * arguments substituted into every type the body lowers.
+ *
+ * Specializations get linkonce_odr linkage in a comdat of their mangled
+ * name, so identical instances emitted by several modules are merged by
+ * the linker.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/Comdat.h>
+#endif
+
+#define MONO_INITIAL_CAPACITY 64
+
+/*
+ * ============================================
+ * Name Mangling
+ * ============================================
+ */
+
+static void append(Vec(char) *buf, const char *s, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        vec_push(*buf, s[i]);
+    }
+}
+
+static void append_str(Vec(char) *buf, const char *s) {
+    append(buf, s, strlen(s));
+}
+
+static void append_type(Vec(char) *buf, Type *type);
+
+static void append_list(Vec(char) *buf, Vec(Type *) types) {
+    for (size_t i = 0; i < vec_len(types); i++) {
+        if (i > 0) append_str(buf, ",");
+        append_type(buf, types[i]);
+    }
+}
+
+/*
+ * Append a structural spelling of a type. Unlike type_to_string this is
+ * complete (no elided members), so distinct types never share a name.
+ */
+static void append_type(Vec(char) *buf, Type *type) {
+    char num[32];
+
+    if (!type) {
+        append_str(buf, "?");
+        return;
+    }
+
+    if (type->perm == PERM_UNIQUE) append_str(buf, "unique ");
+    else if (type->perm == PERM_SHARED) append_str(buf, "shared ");
+
+    switch (type->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            if (type->nominal.sym) {
+                append(buf, type->nominal.sym->name.data, type->nominal.sym->name.len);
+            }
+            if (vec_len(type->nominal.type_args) > 0) {
+                append_str(buf, "<");
+                append_list(buf, type->nominal.type_args);
+                append_str(buf, ">");
+            }
+            break;
+
+        case TYPE_MODAL_STATE:
+            append_type(buf, type->modal_state.modal_type);
+            append_str(buf, "@");
+            append(buf, type->modal_state.state_name.data, type->modal_state.state_name.len);
+            break;
+
+        case TYPE_TUPLE:
+            append_str(buf, "(");
+            append_list(buf, type->tuple.elements);
+            append_str(buf, ")");
+            break;
+
+        case TYPE_ARRAY:
+            append_str(buf, "[");
+            append_type(buf, type->array.element);
+            snprintf(num, sizeof(num), ";%zu]", type->array.size);
+            append_str(buf, num);
+            break;
+
+        case TYPE_SLICE:
+            append_str(buf, "[");
+            append_type(buf, type->slice.element);
+            append_str(buf, "]");
+            break;
+
+        case TYPE_UNION:
+            for (size_t i = 0; i < vec_len(type->union_.members); i++) {
+                if (i > 0) append_str(buf, "|");
+                append_type(buf, type->union_.members[i]);
+            }
+            break;
+
+        case TYPE_FUNCTION:
+            append_str(buf, "procedure(");
+            append_list(buf, type->function.params);
+            append_str(buf, ")->");
+            append_type(buf, type->function.return_type);
+            break;
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            append_str(buf, "Ptr<");
+            append_type(buf, type->ptr.pointee);
+            append_str(buf, type->kind == TYPE_PTR_VALID ? ">@Valid" :
+                            type->kind == TYPE_PTR_NULL ? ">@Null" : ">");
+            break;
+
+        case TYPE_GENERIC_INST:
+            append_type(buf, type->generic_inst.base);
+            append_str(buf, "<");
+            append_list(buf, type->generic_inst.args);
+            append_str(buf, ">");
+            break;
+
+        default: {
+            /* Primitives and other leaf types print unambiguously */
+            Arena scratch;
+            arena_init(&scratch);
+            append_str(buf, type_to_string(type, &scratch));
+            arena_destroy(&scratch);
+            break;
+        }
+    }
+}
+
+/*
+ * Mangled name of a generic declaration applied to type arguments
+ */
+const char *mono_mangle(CodegenContext *ctx, InternedString base, Vec(Type *) args) {
+    Vec(char) buf = vec_new(char);
+    append(&buf, base.data, base.len);
+    append_str(&buf, "<");
+    append_list(&buf, args);
+    append_str(&buf, ">");
+
+    char *name = ARENA_ALLOC_ARRAY(ctx->arena, char, vec_len(buf) + 1);
+    memcpy(name, buf, vec_len(buf));
+    name[vec_len(buf)] = '\0';
+    vec_free(buf);
+    return name;
+}
+
+/*
+ * ============================================
+ * Instance Table
+ * ============================================
+ */
+
+static size_t instance_hash(const ProcDecl *proc, const Type *key) {
+    uint64_t h = (uint64_t)(uintptr_t)proc * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h ^ key->hash);
+}
+
+static void mono_grow(MonoCache *mono) {
+    size_t new_capacity = mono->capacity ? mono->capacity * 2 : MONO_INITIAL_CAPACITY;
+    MonoInstance **slots = calloc(new_capacity, sizeof(MonoInstance *));
+    if (!slots) {
+        CURSIVE_PANIC("Out of memory growing instance table");
+    }
+
+    for (size_t i = 0; i < mono->capacity; i++) {
+        MonoInstance *inst = mono->slots[i];
+        if (!inst) continue;
+        size_t idx = instance_hash(inst->proc, inst->key) & (new_capacity - 1);
+        while (slots[idx]) {
+            idx = (idx + 1) & (new_capacity - 1);
+        }
+        slots[idx] = inst;
+    }
+
+    free(mono->slots);
+    mono->slots = slots;
+    mono->capacity = new_capacity;
+}
+
+/* Find the slot for (proc, key): the matching instance or an empty slot */
+static MonoInstance **mono_find(MonoCache *mono, ProcDecl *proc, Type *key) {
+    size_t mask = mono->capacity - 1;
+    size_t idx = instance_hash(proc, key) & mask;
+    while (mono->slots[idx]) {
+        MonoInstance *inst = mono->slots[idx];
+        if (inst->proc == proc && inst->key == key) break;
+        idx = (idx + 1) & mask;
+    }
+    return &mono->slots[idx];
+}
+
+/*
+ * Release monomorphization state
+ */
+void mono_destroy(MonoCache *mono) {
+    for (size_t i = 0; i < vec_len(mono->instances); i++) {
+        vec_free(mono->instances[i]->args);
+    }
+    free(mono->slots);
+    vec_free(mono->instances);
+    memset(mono, 0, sizeof(MonoCache));
+}
+
+/*
+ * ============================================
+ * Instantiation
+ * ============================================
+ */
+
+#ifdef HAVE_LLVM
+
+/*
+ * Apply the current instance's type arguments to a type
+ */
+Type *mono_subst(CodegenContext *ctx, Type *type) {
+    if (!type || !type->has_params || !ctx->subst) {
+        return type;
+    }
+    return type_substitute(&ctx->sema->type_ctx, type, ctx->subst);
+}
+
+/*
+ * Get (or create) the specialization of `proc` for `args`
+ */
+LLVMValueRef mono_instantiate(CodegenContext *ctx, ProcDecl *proc, Vec(Type *) args) {
+    MonoCache *mono = &ctx->mono;
+    mono->requests++;
+
+    /* Canonical key: the interned tuple of the arguments */
+    Vec(Type *) key_elems = vec_new(Type *);
+    for (size_t i = 0; i < vec_len(args); i++) {
+        vec_push(key_elems, args[i]);
+    }
+    Type *key = type_tuple(&ctx->sema->type_ctx, key_elems);
+
+    if ((vec_len(mono->instances) + 1) * 10 > mono->capacity * 7) {
+        mono_grow(mono);
+    }
+
+    MonoInstance **slot = mono_find(mono, proc, key);
+    if (*slot) {
+        return (*slot)->fn;
+    }
+
+    MonoInstance *inst = ARENA_ALLOC(ctx->arena, MonoInstance);
+    memset(inst, 0, sizeof(MonoInstance));
+    inst->proc = proc;
+    inst->key = key;
+    inst->args = vec_new(Type *);
+    for (size_t i = 0; i < vec_len(args); i++) {
+        vec_push(inst->args, args[i]);
+    }
+    inst->name = mono_mangle(ctx, codegen_proc_name(ctx, proc), args);
+
+    /* Declare with the instance's arguments substituted into the signature */
+    Vec(Type *) saved = ctx->subst;
+    ctx->subst = inst->args;
+    inst->fn = codegen_declare_proc(ctx, proc, inst->name);
+    ctx->subst = saved;
+
+    /* One definition per instance, merged across modules by the linker */
+    LLVMSetLinkage(inst->fn, LLVMLinkOnceODRLinkage);
+    LLVMSetComdat(inst->fn, LLVMGetOrInsertComdat(ctx->module, inst->name));
+
+    *slot = inst;
+    vec_push(mono->instances, inst);
+    return inst->fn;
+}
+
+/* Count the instructions in a function */
+static size_t count_instructions(LLVMValueRef fn) {
+    size_t count = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb;
+         bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst;
+             inst = LLVMGetNextInstruction(inst)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Generate bodies for queued instances. Generating one body may request
+ * further instances, which are appended and handled by the same loop.
+ */
+void mono_emit_pending(CodegenContext *ctx) {
+    MonoCache *mono = &ctx->mono;
+
+    while (mono->next_pending < vec_len(mono->instances)) {
+        MonoInstance *inst = mono->instances[mono->next_pending++];
+
+        Vec(Type *) saved = ctx->subst;
+        ctx->subst = inst->args;
+        if (vec_len(inst->proc->target_clones) > 0) {
+            multiversion_define(ctx, inst->proc, inst->fn);
+        } else {
+            codegen_proc_body(ctx, inst->proc, inst->fn);
+        }
+        ctx->subst = saved;
+
+        inst->instructions = count_instructions(inst->fn);
+    }
+}
+
+#endif /* HAVE_LLVM */
+
+/*
+ * ============================================
+ * Statistics
+ * ============================================
+ */
+
+void mono_report_stats(const MonoCache *mono, FILE *out) {
+    size_t count = vec_len(mono->instances);
+    size_t instructions = 0;
+    for (size_t i = 0; i < count; i++) {
+        instructions += mono->instances[i]->instructions;
+    }
+
+    fprintf(out, "=== Monomorphization ===\n");
+    fprintf(out, "  %-16s %9zu\n", "requests", mono->requests);
+    fprintf(out, "  %-16s %9zu\n", "instances", count);
+    fprintf(out, "  %-16s %9zu\n", "reused", mono->requests - count);
+    fprintf(out, "  %-16s %9zu\n", "instructions", instructions);
+
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "    %-14s %9zu\n", mono->instances[i]->name,
+                mono->instances[i]->instructions);
+    }
+}
@@ -0,0 +1,246 @@
+/*
+ * Cursive Bootstrap Compiler - Function Multiversioning
+ *
+ * A procedure marked [[bootstrap.target_clones("avx2,fma", "avx512f")]] is
+ * generated several times: once per feature list, with those features
+ * added to the module's, and once for the baseline. The procedure's own
+ * symbol becomes a dispatcher that asks the runtime which lists the CPU
+ * supports (cursive_cpu_supports), takes the first one that matches in
+ * attribute order, and remembers the choice, so after the first call
+ * dispatch is a load and an indirect tail call. Clones are internal to
+ * the module; callers only ever see the dispatcher.
+ *
+ * Every other function is stamped with the CPU and features selected by
+ * -march=/-mcpu=/-mattr=, so inlining and code generation agree with the
+ * target machine about what instructions are available.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+
+/* Add a string attribute to a function */
+static void add_fn_attribute(CodegenContext *ctx, LLVMValueRef fn,
+                             const char *kind, const char *value) {
+    LLVMAttributeRef attr = LLVMCreateStringAttribute(ctx->llvm_ctx,
+        kind, (unsigned)strlen(kind), value, (unsigned)strlen(value));
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, attr);
+}
+
+/* Stamp the module's CPU and features unless the function has its own */
+static void stamp_target(CodegenContext *ctx, LLVMValueRef fn, const char *features) {
+    add_fn_attribute(ctx, fn, "target-cpu", ctx->target.cpu);
+    if (*features) {
+        add_fn_attribute(ctx, fn, "target-features", features);
+    }
+}
+
+/* "avx2,+fma" -> "+avx2,+fma", appended to the module's features */
+static const char *clone_features(CodegenContext *ctx, InternedString list) {
+    const char *base = ctx->target.features;
+    size_t base_len = strlen(base);
+    char *out = ARENA_ALLOC_ARRAY(ctx->arena, char, base_len + 2 * list.len + 2);
+    size_t len = 0;
+    memcpy(out, base, base_len);
+    len += base_len;
+
+    const char *p = list.data;
+    const char *end = list.data + list.len;
+    while (p < end) {
+        if (*p == '+') p++;
+        const char *comma = memchr(p, ',', (size_t)(end - p));
+        size_t n = (size_t)((comma ? comma : end) - p);
+        if (n > 0) {
+            if (len > 0) out[len++] = ',';
+            out[len++] = '+';
+            memcpy(out + len, p, n);
+            len += n;
+        }
+        p += n + (comma ? 1 : 0);
+    }
+    out[len] = '\0';
+    return out;
+}
+
+/* Symbol of a clone: `name.avx2_fma`, punctuation replaced by '_' */
+static const char *clone_name(CodegenContext *ctx, const char *base, const char *list) {
+    size_t base_len = strlen(base);
+    char *out = ARENA_ALLOC_ARRAY(ctx->arena, char, base_len + 1 + strlen(list) + 1);
+    memcpy(out, base, base_len);
+    out[base_len] = '.';
+    size_t len = base_len + 1;
+    for (const char *p = list; *p; p++) {
+        char c = *p;
+        if (c == '+') continue;
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        out[len++] = plain ? c : '_';
+    }
+    out[len] = '\0';
+    return out;
+}
+
+/* Declare one clone and generate its body */
+static LLVMValueRef define_clone(CodegenContext *ctx, ProcDecl *proc, const char *name,
+                                 const char *features) {
+    LLVMValueRef clone = codegen_declare_proc(ctx, proc, name);
+    LLVMSetLinkage(clone, LLVMInternalLinkage);
+    stamp_target(ctx, clone, features);
+    codegen_proc_body(ctx, proc, clone);
+    return clone;
+}
+
+/* `int cursive_cpu_supports(const char *)` from the runtime */
+static LLVMValueRef cpu_supports_function(CodegenContext *ctx, LLVMTypeRef *fn_type) {
+    LLVMTypeRef param = LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm_ctx), 0);
+    *fn_type = LLVMFunctionType(LLVMInt32TypeInContext(ctx->llvm_ctx), &param, 1, 0);
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, "cursive_cpu_supports");
+    if (!fn) {
+        fn = LLVMAddFunction(ctx->module, "cursive_cpu_supports", *fn_type);
+    }
+    return fn;
+}
+
+/*
+ * Build the resolver: test each feature list in order and return the
+ * first clone the CPU can run, the baseline if none
+ */
+static LLVMValueRef build_resolver(CodegenContext *ctx, const char *base, ProcDecl *proc,
+                                   LLVMValueRef *clones, LLVMValueRef fallback) {
+    LLVMTypeRef ptr_type = LLVMTypeOf(fallback);
+    LLVMTypeRef resolver_type = LLVMFunctionType(ptr_type, NULL, 0, 0);
+    size_t len = strlen(base) + sizeof(".resolver");
+    char *name = ARENA_ALLOC_ARRAY(ctx->arena, char, len);
+    snprintf(name, len, "%s.resolver", base);
+    LLVMValueRef resolver = LLVMAddFunction(ctx->module, name, resolver_type);
+    LLVMSetLinkage(resolver, LLVMInternalLinkage);
+    unsigned cold = LLVMGetEnumAttributeKindForName("cold", 4);
+    LLVMAddAttributeAtIndex(resolver, LLVMAttributeFunctionIndex,
+        LLVMCreateEnumAttribute(ctx->llvm_ctx, cold, 0));
+
+    LLVMTypeRef supports_type;
+    LLVMValueRef supports = cpu_supports_function(ctx, &supports_type);
+
+    LLVMPositionBuilderAtEnd(ctx->builder,
+        LLVMAppendBasicBlockInContext(ctx->llvm_ctx, resolver, "entry"));
+    for (size_t i = 0; i < vec_len(proc->target_clones); i++) {
+        LLVMValueRef features = LLVMBuildGlobalStringPtr(ctx->builder,
+            proc->target_clones[i].data, "features");
+        LLVMValueRef ok = LLVMBuildCall2(ctx->builder, supports_type, supports,
+            &features, 1, "");
+        LLVMBasicBlockRef found = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+            resolver, "found");
+        LLVMBasicBlockRef next = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+            resolver, "next");
+        LLVMBuildCondBr(ctx->builder,
+            LLVMBuildICmp(ctx->builder, LLVMIntNE, ok, LLVMConstNull(LLVMTypeOf(ok)), ""),
+            found, next);
+        LLVMPositionBuilderAtEnd(ctx->builder, found);
+        LLVMBuildRet(ctx->builder, clones[i]);
+        LLVMPositionBuilderAtEnd(ctx->builder, next);
+    }
+    LLVMBuildRet(ctx->builder, fallback);
+    return resolver;
+}
+
+/*
+ * Turn `fn` into the dispatcher: resolve on first call, cache the choice,
+ * then forward the arguments
+ */
+static void build_dispatcher(CodegenContext *ctx, LLVMValueRef fn, const char *base,
+                             LLVMValueRef resolver) {
+    LLVMTypeRef fn_type = LLVMGlobalGetValueType(fn);
+    LLVMTypeRef ptr_type = LLVMPointerType(fn_type, 0);
+
+    size_t len = strlen(base) + sizeof(".resolved");
+    char *name = ARENA_ALLOC_ARRAY(ctx->arena, char, len);
+    snprintf(name, len, "%s.resolved", base);
+    LLVMValueRef cache = LLVMAddGlobal(ctx->module, ptr_type, name);
+    LLVMSetLinkage(cache, LLVMInternalLinkage);
+    LLVMSetInitializer(cache, LLVMConstNull(ptr_type));
+    unsigned align = LLVMABIAlignmentOfType(ctx->target_data, ptr_type);
+
+    LLVMBasicBlockRef entry = LLVMAppendBasicBlockInContext(ctx->llvm_ctx, fn, "entry");
+    LLVMBasicBlockRef resolve = LLVMAppendBasicBlockInContext(ctx->llvm_ctx, fn, "resolve");
+    LLVMBasicBlockRef call = LLVMAppendBasicBlockInContext(ctx->llvm_ctx, fn, "call");
+
+    /* Racing first calls store the same pointer, so relaxed atomics do */
+    LLVMPositionBuilderAtEnd(ctx->builder, entry);
+    LLVMValueRef cached = LLVMBuildLoad2(ctx->builder, ptr_type, cache, "cached");
+    LLVMSetOrdering(cached, LLVMAtomicOrderingMonotonic);
+    LLVMSetAlignment(cached, align);
+    LLVMBuildCondBr(ctx->builder, LLVMBuildIsNull(ctx->builder, cached, ""), resolve, call);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, resolve);
+    LLVMValueRef chosen = LLVMBuildCall2(ctx->builder,
+        LLVMGlobalGetValueType(resolver), resolver, NULL, 0, "chosen");
+    LLVMValueRef store = LLVMBuildStore(ctx->builder, chosen, cache);
+    LLVMSetOrdering(store, LLVMAtomicOrderingMonotonic);
+    LLVMSetAlignment(store, align);
+    LLVMBuildBr(ctx->builder, call);
+
+    LLVMPositionBuilderAtEnd(ctx->builder, call);
+    LLVMValueRef target = LLVMBuildPhi(ctx->builder, ptr_type, "target");
+    LLVMValueRef incoming[2] = { cached, chosen };
+    LLVMBasicBlockRef from[2] = { entry, resolve };
+    LLVMAddIncoming(target, incoming, from, 2);
+
+    unsigned count = LLVMCountParams(fn);
+    LLVMValueRef *args = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef, count ? count : 1);
+    LLVMGetParams(fn, args);
+    LLVMValueRef result = LLVMBuildCall2(ctx->builder, fn_type, target, args, count, "");
+    abi_forward_attributes(ctx, fn, result);
+    LLVMSetTailCall(result, 1);
+    if (LLVMGetTypeKind(LLVMGetReturnType(fn_type)) == LLVMVoidTypeKind) {
+        LLVMBuildRetVoid(ctx->builder);
+    } else {
+        LLVMBuildRet(ctx->builder, result);
+    }
+}
+
+/*
+ * Define a multiversioned procedure under the current substitution
+ */
+void multiversion_define(CodegenContext *ctx, ProcDecl *proc, LLVMValueRef fn) {
+    if (!proc->body) {
+        return;
+    }
+
+    size_t base_len;
+    const char *base = LLVMGetValueName2(fn, &base_len);
+    base = arena_strndup(ctx->arena, base, base_len);
+
+    size_t count = vec_len(proc->target_clones);
+    LLVMValueRef *clones = ARENA_ALLOC_ARRAY(ctx->arena, LLVMValueRef, count);
+    for (size_t i = 0; i < count; i++) {
+        InternedString list = proc->target_clones[i];
+        clones[i] = define_clone(ctx, proc, clone_name(ctx, base, list.data),
+            clone_features(ctx, list));
+    }
+    LLVMValueRef fallback = define_clone(ctx, proc, clone_name(ctx, base, "default"),
+        ctx->target.features);
+
+    /* Bodies restore the builder; the dispatcher is built in between them */
+    LLVMBasicBlockRef saved_block = LLVMGetInsertBlock(ctx->builder);
+    LLVMValueRef resolver = build_resolver(ctx, base, proc, clones, fallback);
+    build_dispatcher(ctx, fn, base, resolver);
+    if (saved_block) {
+        LLVMPositionBuilderAtEnd(ctx->builder, saved_block);
+    }
+}
+
+/*
+ * Stamp the selected CPU and features on all defined functions
+ */
+void multiversion_stamp_target(CodegenContext *ctx) {
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn;
+         fn = LLVMGetNextFunction(fn)) {
+        if (LLVMIsDeclaration(fn) ||
+            LLVMGetStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex, "target-cpu", 10)) {
+            continue;
+        }
+        stamp_target(ctx, fn, ctx->target.features);
+    }
+}
+
+#endif /* HAVE_LLVM */
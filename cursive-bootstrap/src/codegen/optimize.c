@@ -0,0 +1,153 @@
+/*
+ * Cursive Bootstrap Compiler - IR Optimization
+ *
+ * Runs LLVM's new pass manager over the finished module. -O1..-O3, -Os
+ * and -Oz select the standard `default<O*>` pipelines; -passes= replaces
+ * them with any pipeline string the pass builder accepts, e.g.
+ * "function(sroa,instcombine),globaldce". At -O0 nothing runs unless
+ * -passes= asks for it.
+ *
+ * With -flto=thin the levels select `thinlto-pre-link<O*>` instead,
+ * which stops short of the inlining and code placement the link step
+ * redoes with cross-module imports (lto.c).
+ *
+ * With -time-passes, LLVM's own per-pass timers are switched on for the
+ * run and report to stderr, followed by a summary of the pipeline.
+ */
+
+#include "codegen.h"
+#include <time.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/Error.h>
+#include <llvm-c/Support.h>
+#include <llvm-c/Transforms/PassBuilder.h>
+
+/* Standard pipeline of an optimization level, NULL at -O0 */
+static const char *default_pipeline(OptLevel level) {
+    switch (level) {
+        case OPT_O0: return NULL;
+        case OPT_O1: return "default<O1>";
+        case OPT_O2: return "default<O2>";
+        case OPT_O3: return "default<O3>";
+        case OPT_OS: return "default<Os>";
+        case OPT_OZ: return "default<Oz>";
+    }
+    return NULL;
+}
+
+/* ThinLTO pre-link pipeline of an optimization level */
+static const char *thin_pipeline(OptLevel level) {
+    switch (level) {
+        case OPT_O0: return "thinlto-pre-link<O0>";
+        case OPT_O1: return "thinlto-pre-link<O1>";
+        case OPT_O2: return "thinlto-pre-link<O2>";
+        case OPT_O3: return "thinlto-pre-link<O3>";
+        case OPT_OS: return "thinlto-pre-link<Os>";
+        case OPT_OZ: return "thinlto-pre-link<Oz>";
+    }
+    return NULL;
+}
+
+/* Machine code optimization level matching an IR level */
+LLVMCodeGenOptLevel codegen_machine_level(OptLevel level) {
+    switch (level) {
+        case OPT_O0: return LLVMCodeGenLevelNone;
+        case OPT_O1: return LLVMCodeGenLevelLess;
+        case OPT_O3: return LLVMCodeGenLevelAggressive;
+        default:     return LLVMCodeGenLevelDefault;
+    }
+}
+
+/* Instructions in all function bodies of a module */
+static size_t count_instructions(LLVMModuleRef module) {
+    size_t count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb;
+             bb = LLVMGetNextBasicBlock(bb)) {
+            for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst;
+                 inst = LLVMGetNextInstruction(inst)) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/* Turn on LLVM's pass timers; they can only be enabled once per process */
+static void enable_pass_timers(void) {
+    static bool enabled = false;
+    if (!enabled) {
+        const char *args[] = { "cursivec", "-time-passes" };
+        LLVMParseCommandLineOptions(2, args, NULL);
+        enabled = true;
+    }
+}
+
+/*
+ * Pipeline the options select, NULL when nothing is to run
+ */
+const char *codegen_pipeline(const CodegenOptions *opts) {
+    if (opts->passes) {
+        return opts->passes;
+    }
+    return opts->thin_lto ? thin_pipeline(opts->opt_level) : default_pipeline(opts->opt_level);
+}
+
+/*
+ * Run a pass pipeline over a module with the pass builder settings of the
+ * options. Touches nothing but the module and the target machine, so
+ * modules of different LLVM contexts can be optimized on different threads.
+ */
+char *codegen_run_passes(const CodegenOptions *opts, LLVMModuleRef module,
+                         LLVMTargetMachineRef machine, const char *pipeline) {
+    LLVMPassBuilderOptionsRef pb = LLVMCreatePassBuilderOptions();
+    /* As clang: vectorize from -O2 except at -Oz, unroll only for speed */
+    bool vectorize = opts->opt_level >= OPT_O2 && opts->opt_level != OPT_OZ;
+    LLVMPassBuilderOptionsSetLoopVectorization(pb, vectorize);
+    LLVMPassBuilderOptionsSetSLPVectorization(pb, vectorize);
+    LLVMPassBuilderOptionsSetLoopUnrolling(pb,
+        opts->opt_level == OPT_O2 || opts->opt_level == OPT_O3);
+
+    LLVMErrorRef error = LLVMRunPasses(module, pipeline, machine, pb);
+    LLVMDisposePassBuilderOptions(pb);
+    return error ? LLVMGetErrorMessage(error) : NULL;
+}
+
+/*
+ * Optimize the generated module
+ */
+bool codegen_optimize(CodegenContext *ctx) {
+    const CodegenOptions *opts = &ctx->options;
+    const char *pipeline = codegen_pipeline(opts);
+    if (!pipeline) {
+        return true;
+    }
+
+    if (opts->time_passes) {
+        enable_pass_timers();
+    }
+    size_t before = opts->time_passes ? count_instructions(ctx->module) : 0;
+    clock_t start = clock();
+
+    char *message = codegen_run_passes(opts, ctx->module, ctx->target_machine, pipeline);
+    if (message) {
+        diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+            "Invalid pass pipeline '%s': %s", pipeline, message);
+        LLVMDisposeErrorMessage(message);
+        return false;
+    }
+
+    if (opts->time_passes) {
+        clock_t elapsed = clock() - start;
+        fprintf(stderr, "=== Optimization ===\n");
+        fprintf(stderr, "  %-16s %s\n", "pipeline", pipeline);
+        fprintf(stderr, "  %-16s %9zu\n", "instructions in", before);
+        fprintf(stderr, "  %-16s %9zu\n", "instructions out", count_instructions(ctx->module));
+        fprintf(stderr, "  %-16s %9.3f ms\n", "total",
+            1000.0 * (double)elapsed / CLOCKS_PER_SEC);
+    }
+    return true;
+}
+
+#endif /* HAVE_LLVM */
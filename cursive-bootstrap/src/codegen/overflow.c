@@ -0,0 +1,216 @@
+/*
+ * Cursive Bootstrap Compiler - Overflow-Checked Arithmetic
+ *
+ * Integer `+`, `-`, `*` and negation lower to the llvm.{s,u}{add,sub,mul}
+ * .with.overflow intrinsics, which exist at every width (i128 included)
+ * and select to the add/jo pairs the target has. On overflow, control
+ * goes to one failure block per function, created on first use; the
+ * check branches there with weights that mark it never taken, and the
+ * block itself ends in a cold, noreturn call, so the optimizer moves it
+ * out of the hot path and the checked code stays straight-line.
+ *
+ * -overflow= picks what the failure block does: `checked` (the default)
+ * panics through the runtime with the operation and source line, which
+ * reach the block through phis; `trap` executes a trap instruction and
+ * needs no operands; `wrapping` emits no checks and wraps around.
+ */
+
+#include "codegen.h"
+#include <string.h>
+
+#ifdef HAVE_LLVM
+
+/* Weights of the (overflowed, ok) edges of a check */
+#define OVERFLOW_WEIGHT_TAKEN 1
+#define OVERFLOW_WEIGHT_NOT_TAKEN 1048575
+
+/* Add an enum attribute to a function */
+static void add_fn_attribute(CodegenContext *ctx, LLVMValueRef fn, const char *kind) {
+    unsigned id = LLVMGetEnumAttributeKindForName(kind, strlen(kind));
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex,
+        LLVMCreateEnumAttribute(ctx->llvm_ctx, id, 0));
+}
+
+/* `void cursive_panic(const char *, const char *, int)` from the runtime */
+static LLVMValueRef panic_function(CodegenContext *ctx, LLVMTypeRef *fn_type) {
+    LLVMTypeRef str = LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm_ctx), 0);
+    LLVMTypeRef params[] = { str, str, LLVMInt32TypeInContext(ctx->llvm_ctx) };
+    *fn_type = LLVMFunctionType(LLVMVoidTypeInContext(ctx->llvm_ctx), params, 3, 0);
+    LLVMValueRef fn = LLVMGetNamedFunction(ctx->module, "cursive_panic");
+    if (!fn) {
+        fn = LLVMAddFunction(ctx->module, "cursive_panic", *fn_type);
+        add_fn_attribute(ctx, fn, "cold");
+        add_fn_attribute(ctx, fn, "noreturn");
+        add_fn_attribute(ctx, fn, "nounwind");
+    }
+    return fn;
+}
+
+/* A private constant string of the module, shared by name */
+static LLVMValueRef module_string(CodegenContext *ctx, const char *name, const char *text) {
+    LLVMValueRef global = LLVMGetNamedGlobal(ctx->module, name);
+    if (!global) {
+        LLVMValueRef init = LLVMConstStringInContext(ctx->llvm_ctx, text,
+            (unsigned)strlen(text), 0);
+        global = LLVMAddGlobal(ctx->module, LLVMTypeOf(init), name);
+        LLVMSetInitializer(global, init);
+        LLVMSetLinkage(global, LLVMPrivateLinkage);
+        LLVMSetGlobalConstant(global, 1);
+        LLVMSetUnnamedAddress(global, LLVMGlobalUnnamedAddr);
+    }
+    return LLVMConstPointerCast(global,
+        LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm_ctx), 0));
+}
+
+/* Mark the call as never returning, cold, and end the block */
+static void finish_failure(CodegenContext *ctx, LLVMValueRef call) {
+    unsigned cold = LLVMGetEnumAttributeKindForName("cold", 4);
+    unsigned noreturn = LLVMGetEnumAttributeKindForName("noreturn", 8);
+    LLVMAddCallSiteAttribute(call, LLVMAttributeFunctionIndex,
+        LLVMCreateEnumAttribute(ctx->llvm_ctx, cold, 0));
+    LLVMAddCallSiteAttribute(call, LLVMAttributeFunctionIndex,
+        LLVMCreateEnumAttribute(ctx->llvm_ctx, noreturn, 0));
+    LLVMBuildUnreachable(ctx->builder);
+}
+
+/*
+ * The current function's failure block, built on first use: a panic with
+ * the phis' message and line, or a trap
+ */
+static LLVMBasicBlockRef failure_block(CodegenContext *ctx, uint32_t file_id) {
+    if (ctx->overflow_block) {
+        return ctx->overflow_block;
+    }
+
+    LLVMBasicBlockRef saved_block = LLVMGetInsertBlock(ctx->builder);
+    ctx->overflow_block = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+        ctx->current_func, "overflow");
+    LLVMPositionBuilderAtEnd(ctx->builder, ctx->overflow_block);
+
+    if (ctx->options.overflow == OVERFLOW_TRAP) {
+        LLVMValueRef trap = LLVMGetIntrinsicDeclaration(ctx->module,
+            LLVMLookupIntrinsicID("llvm.trap", 9), NULL, 0);
+        finish_failure(ctx, LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(trap),
+            trap, NULL, 0, ""));
+    } else {
+        LLVMTypeRef str = LLVMPointerType(LLVMInt8TypeInContext(ctx->llvm_ctx), 0);
+        ctx->overflow_message = LLVMBuildPhi(ctx->builder, str, "message");
+        ctx->overflow_line = LLVMBuildPhi(ctx->builder,
+            LLVMInt32TypeInContext(ctx->llvm_ctx), "line");
+
+        SourceFile *file = diag_get_file(ctx->diag, file_id);
+        char file_name[32];
+        snprintf(file_name, sizeof(file_name), "overflow.file.%u", (unsigned)file_id);
+        LLVMTypeRef fn_type;
+        LLVMValueRef panic = panic_function(ctx, &fn_type);
+        LLVMValueRef args[] = {
+            ctx->overflow_message,
+            module_string(ctx, file_name, file ? file->path : "<unknown>"),
+            ctx->overflow_line
+        };
+        finish_failure(ctx, LLVMBuildCall2(ctx->builder, fn_type, panic, args, 3, ""));
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, saved_block);
+    return ctx->overflow_block;
+}
+
+/* Branch to the failure block when `overflowed`, else fall through */
+static void branch_on_overflow(CodegenContext *ctx, LLVMValueRef overflowed,
+                               const char *what, SourceSpan span) {
+    LLVMBasicBlockRef fail = failure_block(ctx, span.start.file_id);
+    LLVMBasicBlockRef from = LLVMGetInsertBlock(ctx->builder);
+    LLVMBasicBlockRef ok = LLVMAppendBasicBlockInContext(ctx->llvm_ctx,
+        ctx->current_func, "no_overflow");
+
+    LLVMValueRef br = LLVMBuildCondBr(ctx->builder, overflowed, fail, ok);
+    LLVMMetadataRef weights[] = {
+        LLVMMDStringInContext2(ctx->llvm_ctx, "branch_weights", 14),
+        LLVMValueAsMetadata(LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm_ctx),
+            OVERFLOW_WEIGHT_TAKEN, 0)),
+        LLVMValueAsMetadata(LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm_ctx),
+            OVERFLOW_WEIGHT_NOT_TAKEN, 0)),
+    };
+    LLVMSetMetadata(br, LLVMGetMDKindIDInContext(ctx->llvm_ctx, "prof", 4),
+        LLVMMetadataAsValue(ctx->llvm_ctx, LLVMMDNodeInContext2(ctx->llvm_ctx, weights, 3)));
+
+    if (ctx->options.overflow == OVERFLOW_CHECKED) {
+        char name[32];
+        snprintf(name, sizeof(name), "overflow.%s", what);
+        char text[64];
+        snprintf(text, sizeof(text), "attempt to %s with overflow", what);
+        LLVMValueRef message = module_string(ctx, name, text);
+        LLVMValueRef line = LLVMConstInt(LLVMInt32TypeInContext(ctx->llvm_ctx),
+            span.start.line, 0);
+        LLVMAddIncoming(ctx->overflow_message, &message, &from, 1);
+        LLVMAddIncoming(ctx->overflow_line, &line, &from, 1);
+    }
+
+    LLVMPositionBuilderAtEnd(ctx->builder, ok);
+}
+
+/*
+ * `left op right` for integer `+`, `-` or `*` under the -overflow= mode
+ */
+LLVMValueRef overflow_arith(CodegenContext *ctx, BinaryOp op, bool is_unsigned,
+                            LLVMValueRef left, LLVMValueRef right, SourceSpan span) {
+    if (ctx->options.overflow == OVERFLOW_WRAPPING || !ctx->current_func) {
+        switch (op) {
+            case BINOP_ADD: return LLVMBuildAdd(ctx->builder, left, right, "add");
+            case BINOP_SUB: return LLVMBuildSub(ctx->builder, left, right, "sub");
+            default:        return LLVMBuildMul(ctx->builder, left, right, "mul");
+        }
+    }
+
+    const char *intrinsic;
+    const char *what;
+    switch (op) {
+        case BINOP_ADD:
+            intrinsic = is_unsigned ? "llvm.uadd.with.overflow" : "llvm.sadd.with.overflow";
+            what = "add";
+            break;
+        case BINOP_SUB:
+            intrinsic = is_unsigned ? "llvm.usub.with.overflow" : "llvm.ssub.with.overflow";
+            what = "subtract";
+            break;
+        default:
+            intrinsic = is_unsigned ? "llvm.umul.with.overflow" : "llvm.smul.with.overflow";
+            what = "multiply";
+            break;
+    }
+
+    LLVMTypeRef type = LLVMTypeOf(left);
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(ctx->module,
+        LLVMLookupIntrinsicID(intrinsic, strlen(intrinsic)), &type, 1);
+    LLVMValueRef args[] = { left, right };
+    LLVMValueRef pair = LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(fn), fn,
+        args, 2, "");
+    LLVMValueRef value = LLVMBuildExtractValue(ctx->builder, pair, 0, what);
+    branch_on_overflow(ctx, LLVMBuildExtractValue(ctx->builder, pair, 1, "overflowed"),
+        what, span);
+    return value;
+}
+
+/*
+ * `-operand` for integers: 0 - operand, checked like a subtraction
+ */
+LLVMValueRef overflow_neg(CodegenContext *ctx, bool is_unsigned, LLVMValueRef operand,
+                          SourceSpan span) {
+    if (ctx->options.overflow == OVERFLOW_WRAPPING || !ctx->current_func) {
+        return LLVMBuildNeg(ctx->builder, operand, "neg");
+    }
+
+    const char *intrinsic = is_unsigned ? "llvm.usub.with.overflow" : "llvm.ssub.with.overflow";
+    LLVMTypeRef type = LLVMTypeOf(operand);
+    LLVMValueRef fn = LLVMGetIntrinsicDeclaration(ctx->module,
+        LLVMLookupIntrinsicID(intrinsic, strlen(intrinsic)), &type, 1);
+    LLVMValueRef args[] = { LLVMConstNull(type), operand };
+    LLVMValueRef pair = LLVMBuildCall2(ctx->builder, LLVMGlobalGetValueType(fn), fn,
+        args, 2, "");
+    LLVMValueRef value = LLVMBuildExtractValue(ctx->builder, pair, 0, "neg");
+    branch_on_overflow(ctx, LLVMBuildExtractValue(ctx->builder, pair, 1, "overflowed"),
+        "negate", span);
+    return value;
+}
+
+#endif /* HAVE_LLVM */
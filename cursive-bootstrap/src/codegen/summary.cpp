@@ -0,0 +1,35 @@
+/*
+ * Cursive Bootstrap Compiler - ThinLTO Module Summaries
+ *
+ * The one piece of code generation written against LLVM's C++ API: the C
+ * API can write bitcode, but not the module summary index ThinLTO needs
+ * to decide what to import across modules. This builds the summary and
+ * writes it along with the IR; everything else about ThinLTO (lto.c)
+ * goes through the C APIs like the rest of the compiler.
+ */
+
+#include <llvm-c/Core.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSummaryIndex.h>
+#include <llvm/Support/raw_ostream.h>
+
+extern "C" LLVMMemoryBufferRef codegen_thin_bitcode(LLVMModuleRef module);
+
+/*
+ * Serialize a module as ThinLTO bitcode: the IR and its summary index.
+ * All globals must be named (the name-anon-globals pass).
+ */
+extern "C" LLVMMemoryBufferRef codegen_thin_bitcode(LLVMModuleRef module) {
+    llvm::Module &m = *llvm::unwrap(module);
+    llvm::ProfileSummaryInfo profile(m);
+    llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(m, nullptr, &profile);
+
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream out(bitcode);
+    llvm::WriteBitcodeToFile(m, out, false, &index);
+    return LLVMCreateMemoryBufferWithMemoryRangeCopy(bitcode.data(), bitcode.size(),
+        m.getModuleIdentifier().c_str());
+}
@@ -3,10 +3,15 @@
  *
  * Target platform detection and configuration.
  * Supports Windows x86-64 and Linux x86-64.
+ *
+ * Code is generated for the "generic" CPU of the architecture unless
+ * -march=/-mcpu= names another; -march=native asks LLVM for the host CPU
+ * and everything it supports, and -mattr= adds or removes features.
  */
 
 #include "codegen.h"
 #include <string.h>
+#include <stdio.h>
 
 #ifdef _WIN32
 #define HOST_OS TARGET_OS_WINDOWS
@@ -48,6 +53,42 @@ void target_init(TargetInfo *target, TargetOS os, TargetArch arch) {
 
     /* Set target triple */
     target->triple = target_get_triple(target);
+    target->cpu = "generic";
+    target->features = "";
+}
+
+/*
+ * Select the CPU and features to generate code for
+ */
+void target_set_cpu(TargetInfo *target, Arena *arena, const char *cpu, const char *features) {
+    const char *base = "";
+    if (cpu && strcmp(cpu, "native") == 0) {
+#ifdef HAVE_LLVM
+        char *host_cpu = LLVMGetHostCPUName();
+        char *host_features = LLVMGetHostCPUFeatures();
+        cpu = arena_strdup(arena, host_cpu);
+        base = arena_strdup(arena, host_features);
+        LLVMDisposeMessage(host_cpu);
+        LLVMDisposeMessage(host_features);
+#else
+        cpu = "generic";
+#endif
+    }
+    if (cpu) {
+        target->cpu = cpu;
+    }
+
+    if (!features || !*features) {
+        target->features = base;
+    } else if (!*base) {
+        target->features = features;
+    } else {
+        /* Later entries win, so -mattr= overrides what the host reports */
+        size_t len = strlen(base) + 1 + strlen(features);
+        char *joined = ARENA_ALLOC_ARRAY(arena, char, len + 1);
+        snprintf(joined, len + 1, "%s,%s", base, features);
+        target->features = joined;
+    }
 }
 
 /*
@@ -0,0 +1,411 @@
+/*
+ * Cursive Bootstrap Compiler - Parallel Code Generation Units
+ *
+ * With -codegen-units=N the generated module is optimized and compiled to
+ * machine code as N independent units on a pool of threads, each unit
+ * written to its own object file.
+ *
+ * IR generation itself stays on one thread: it reads and extends sema's
+ * type tables. The finished module is serialized to bitcode once; every
+ * worker parses it into an LLVM context of its own (contexts are the unit
+ * of LLVM thread safety), keeps the bodies of the external definitions
+ * assigned to its unit and turns the others into declarations. Local and
+ * linkonce_odr definitions - multiversion clones, generic instances, drop
+ * glue, string constants - are kept wherever they are used and removed by
+ * global DCE elsewhere, so a unit never refers to another's local symbols
+ * and no symbol is renamed. The worker then runs the optimization pipeline
+ * and emits the unit with a target machine of its own.
+ *
+ * External definitions are assigned greedily in module order to the unit
+ * with the fewest instructions so far, so the split - and every object
+ * file - depends only on the module, not on thread timing. As with any
+ * split, inlining does not cross units.
+ */
+
+#include "codegen.h"
+#include <string.h>
+#include <time.h>
+
+#ifdef HAVE_LLVM
+#include <llvm-c/BitReader.h>
+#include <llvm-c/BitWriter.h>
+#include <llvm-c/Error.h>
+
+#ifdef CURSIVE_PLATFORM_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/* One codegen unit and the outcome of compiling it */
+typedef struct CodegenUnit {
+    const char *filename;
+    size_t functions;             /* External definitions assigned to it */
+    size_t instructions;          /* Their instructions before optimization */
+    double milliseconds;          /* Wall time spent optimizing and emitting */
+    char *error;                  /* Failure, malloc'd; NULL on success */
+} CodegenUnit;
+
+/* Work shared by the threads of the pool */
+typedef struct UnitPool {
+    const CodegenContext *ctx;
+    const char *bitcode;          /* The whole module */
+    size_t bitcode_size;
+    const unsigned *owners;       /* Unit of each function in module order, or -1 */
+    CodegenUnit *units;
+    unsigned unit_count;
+    unsigned next;                /* First unit no thread has taken */
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    CRITICAL_SECTION lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} UnitPool;
+
+#define NO_OWNER ((unsigned)-1)
+
+/* Wall clock time in milliseconds; clock() would add up all threads */
+static double wall_ms(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return 1000.0 * (double)ts.tv_sec + (double)ts.tv_nsec / 1e6;
+}
+
+/* Instructions in the body of a function */
+static size_t function_size(LLVMValueRef fn) {
+    size_t count = 0;
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst;
+             inst = LLVMGetNextInstruction(inst)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Does exactly one unit define this function?
+ */
+bool codegen_is_partitioned(LLVMValueRef fn) {
+    return !LLVMIsDeclaration(fn) && LLVMGetLinkage(fn) == LLVMExternalLinkage;
+}
+
+/*
+ * Assign each external definition to a unit; returns the number of units
+ * that received any
+ */
+static unsigned assign_units(CodegenContext *ctx, unsigned requested, unsigned **owners_out,
+                             CodegenUnit *units) {
+    size_t count = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        count++;
+    }
+    unsigned *owners = ARENA_ALLOC_ARRAY(ctx->arena, unsigned, count ? count : 1);
+
+    size_t roots = 0;
+    size_t index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        owners[index] = NO_OWNER;
+        if (codegen_is_partitioned(fn)) {
+            roots++;
+        }
+        index++;
+    }
+    unsigned unit_count = roots < requested ? (unsigned)roots : requested;
+    if (unit_count == 0) unit_count = 1;
+
+    index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(ctx->module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (codegen_is_partitioned(fn)) {
+            unsigned lightest = 0;
+            for (unsigned u = 1; u < unit_count; u++) {
+                if (units[u].instructions < units[lightest].instructions) lightest = u;
+            }
+            owners[index] = lightest;
+            units[lightest].functions++;
+            units[lightest].instructions += function_size(fn) + 1;
+        }
+        index++;
+    }
+
+    *owners_out = owners;
+    return unit_count;
+}
+
+/*
+ * Turn a definition into a declaration. The C API cannot delete a body
+ * directly, so instructions lose their uses first, then go, then the
+ * (now unreferenced) blocks.
+ */
+static void drop_body(LLVMValueRef fn) {
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst;
+             inst = LLVMGetNextInstruction(inst)) {
+            if (LLVMGetTypeKind(LLVMTypeOf(inst)) != LLVMVoidTypeKind) {
+                LLVMReplaceAllUsesWith(inst, LLVMGetUndef(LLVMTypeOf(inst)));
+            }
+        }
+    }
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb)) {
+        LLVMValueRef inst;
+        while ((inst = LLVMGetFirstInstruction(bb)) != NULL) {
+            LLVMInstructionEraseFromParent(inst);
+        }
+    }
+    LLVMBasicBlockRef bb;
+    while ((bb = LLVMGetFirstBasicBlock(fn)) != NULL) {
+        LLVMDeleteBasicBlock(bb);
+    }
+}
+
+/*
+ * Keep what unit `unit` defines; everything else external is declared
+ */
+void codegen_extract_unit(LLVMModuleRef module, const unsigned *owners, unsigned unit) {
+    size_t index = 0;
+    for (LLVMValueRef fn = LLVMGetFirstFunction(module); fn; fn = LLVMGetNextFunction(fn)) {
+        if (owners[index++] != unit && codegen_is_partitioned(fn)) {
+            drop_body(fn);
+        }
+    }
+    /* External variables live in the first unit */
+    if (unit != 0) {
+        for (LLVMValueRef global = LLVMGetFirstGlobal(module); global;
+             global = LLVMGetNextGlobal(global)) {
+            if (!LLVMIsDeclaration(global) && LLVMGetLinkage(global) == LLVMExternalLinkage) {
+                LLVMSetInitializer(global, NULL);
+            }
+        }
+    }
+}
+
+/* Copy an LLVM message into memory the unit owns */
+static char *unit_error(const char *prefix, const char *message) {
+    size_t len = strlen(prefix) + strlen(message) + 1;
+    char *error = malloc(len);
+    if (error) {
+        snprintf(error, len, "%s%s", prefix, message);
+    }
+    return error;
+}
+
+/* Optimize and emit one unit, in a context of its own */
+static void compile_unit(const UnitPool *pool, unsigned unit) {
+    const CodegenContext *ctx = pool->ctx;
+    CodegenUnit *out = &pool->units[unit];
+    double start = wall_ms();
+
+    LLVMContextRef llvm_ctx = LLVMContextCreate();
+    LLVMMemoryBufferRef buffer = LLVMCreateMemoryBufferWithMemoryRange(
+        pool->bitcode, pool->bitcode_size, "unit", 0);
+    LLVMModuleRef module = NULL;
+    if (LLVMParseBitcodeInContext2(llvm_ctx, buffer, &module) != 0) {
+        out->error = unit_error("cannot read module bitcode", "");
+        LLVMDisposeMemoryBuffer(buffer);
+        LLVMContextDispose(llvm_ctx);
+        return;
+    }
+    LLVMDisposeMemoryBuffer(buffer);
+    codegen_extract_unit(module, pool->owners, unit);
+
+    char *message = NULL;
+    LLVMTargetRef target;
+    LLVMTargetMachineRef machine = NULL;
+    if (LLVMGetTargetFromTriple(ctx->target.triple, &target, &message) != 0) {
+        out->error = unit_error("Failed to get target: ", message);
+        LLVMDisposeMessage(message);
+    } else {
+        machine = LLVMCreateTargetMachine(target, ctx->target.triple, ctx->target.cpu,
+            ctx->target.features, codegen_machine_level(ctx->options.opt_level),
+            LLVMRelocDefault, LLVMCodeModelDefault);
+    }
+
+    /* Copies of local definitions this unit does not use go first */
+    const char *pipeline = codegen_pipeline(&ctx->options);
+    if (machine) {
+        message = codegen_run_passes(&ctx->options, module, machine, "globaldce");
+        if (!message && pipeline) {
+            message = codegen_run_passes(&ctx->options, module, machine, pipeline);
+        }
+        if (message) {
+            out->error = unit_error("Optimization failed: ", message);
+            LLVMDisposeErrorMessage(message);
+        }
+    }
+
+    if (machine && !out->error) {
+        if (LLVMTargetMachineEmitToFile(machine, module, (char *)out->filename,
+                LLVMObjectFile, &message) != 0) {
+            out->error = unit_error("Failed to write object file: ", message);
+            LLVMDisposeMessage(message);
+        }
+    }
+
+    if (machine) LLVMDisposeTargetMachine(machine);
+    LLVMDisposeModule(module);
+    LLVMContextDispose(llvm_ctx);
+    out->milliseconds = wall_ms() - start;
+}
+
+static void pool_lock(UnitPool *pool) {
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    EnterCriticalSection(&pool->lock);
+#else
+    pthread_mutex_lock(&pool->lock);
+#endif
+}
+
+static void pool_unlock(UnitPool *pool) {
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    LeaveCriticalSection(&pool->lock);
+#else
+    pthread_mutex_unlock(&pool->lock);
+#endif
+}
+
+/* Take units until none are left */
+static void pool_work(UnitPool *pool) {
+    for (;;) {
+        pool_lock(pool);
+        unsigned unit = pool->next < pool->unit_count ? pool->next++ : NO_OWNER;
+        pool_unlock(pool);
+        if (unit == NO_OWNER) return;
+        compile_unit(pool, unit);
+    }
+}
+
+#ifdef CURSIVE_PLATFORM_WINDOWS
+static DWORD WINAPI pool_thread(LPVOID arg) {
+    pool_work(arg);
+    return 0;
+}
+#else
+static void *pool_thread(void *arg) {
+    pool_work(arg);
+    return NULL;
+}
+#endif
+
+/* Hardware threads available to the process */
+static unsigned hardware_threads(void) {
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (unsigned)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned)count : 1;
+#endif
+}
+
+/*
+ * Run the pool: extra threads up to the hardware's, and the calling thread
+ */
+static void run_pool(UnitPool *pool) {
+    unsigned threads = hardware_threads();
+    if (threads > pool->unit_count) threads = pool->unit_count;
+    unsigned extra = threads > 0 ? threads - 1 : 0;
+
+#ifdef CURSIVE_PLATFORM_WINDOWS
+    InitializeCriticalSection(&pool->lock);
+    HANDLE *handles = calloc(extra ? extra : 1, sizeof(HANDLE));
+    unsigned started = 0;
+    for (unsigned i = 0; i < extra && handles; i++) {
+        handles[i] = CreateThread(NULL, 0, pool_thread, pool, 0, NULL);
+        if (!handles[i]) break;
+        started++;
+    }
+    pool_work(pool);
+    if (started) WaitForMultipleObjects(started, handles, TRUE, INFINITE);
+    for (unsigned i = 0; i < started; i++) CloseHandle(handles[i]);
+    free(handles);
+    DeleteCriticalSection(&pool->lock);
+#else
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_t *handles = calloc(extra ? extra : 1, sizeof(pthread_t));
+    unsigned started = 0;
+    for (unsigned i = 0; i < extra && handles; i++) {
+        if (pthread_create(&handles[i], NULL, pool_thread, pool) != 0) break;
+        started++;
+    }
+    pool_work(pool);
+    for (unsigned i = 0; i < started; i++) pthread_join(handles[i], NULL);
+    free(handles);
+    pthread_mutex_destroy(&pool->lock);
+#endif
+}
+
+/*
+ * Split the module into units, then optimize and emit them in parallel
+ */
+unsigned codegen_write_units(CodegenContext *ctx, const char *filename) {
+    unsigned requested = ctx->options.codegen_units ? ctx->options.codegen_units : 1;
+    CodegenUnit *units = ARENA_ALLOC_ARRAY(ctx->arena, CodegenUnit, requested);
+    memset(units, 0, requested * sizeof(CodegenUnit));
+
+    unsigned *owners;
+    unsigned unit_count = assign_units(ctx, requested, &owners, units);
+    for (unsigned u = 0; u < unit_count; u++) {
+        units[u].filename = codegen_unit_filename(ctx->arena, filename, u);
+    }
+
+    LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(ctx->module);
+    UnitPool pool = {
+        .ctx = ctx,
+        .bitcode = LLVMGetBufferStart(bitcode),
+        .bitcode_size = LLVMGetBufferSize(bitcode),
+        .owners = owners,
+        .units = units,
+        .unit_count = unit_count,
+    };
+    double start = wall_ms();
+    run_pool(&pool);
+    double elapsed = wall_ms() - start;
+    LLVMDisposeMemoryBuffer(bitcode);
+
+    bool ok = true;
+    for (unsigned u = 0; u < unit_count; u++) {
+        if (units[u].error) {
+            diag_report(ctx->diag, DIAG_ERROR, E_GEN_9001, (SourceSpan){0},
+                "Codegen unit %u: %s", u, units[u].error);
+            free(units[u].error);
+            ok = false;
+        }
+    }
+
+    if (ctx->options.time_passes) {
+        fprintf(stderr, "=== Codegen units ===\n");
+        for (unsigned u = 0; u < unit_count; u++) {
+            fprintf(stderr, "  unit %-4u %6zu functions %9zu instructions %9.3f ms\n",
+                u, units[u].functions, units[u].instructions, units[u].milliseconds);
+        }
+        fprintf(stderr, "  %-16s %9.3f ms\n", "total", elapsed);
+    }
+    return ok ? unit_count : 0;
+}
+
+#endif /* HAVE_LLVM */
+
+/*
+ * Object file of a codegen unit: `out.o` -> `out.1.o`, the number before
+ * the extension, after the whole name if there is none
+ */
+const char *codegen_unit_filename(Arena *arena, const char *filename, unsigned unit) {
+    if (unit == 0) {
+        return filename;
+    }
+    const char *dot = strrchr(filename, '.');
+    const char *slash = strrchr(filename, '/');
+    const char *backslash = strrchr(filename, '\\');
+    if (backslash && (!slash || backslash > slash)) slash = backslash;
+    if (!dot || (slash && dot < slash) || dot == filename || (slash && dot == slash + 1)) {
+        dot = filename + strlen(filename);
+    }
+
+    size_t stem = (size_t)(dot - filename);
+    size_t len = strlen(filename) + 12;
+    char *out = ARENA_ALLOC_ARRAY(arena, char, len);
+    snprintf(out, len, "%.*s.%u%s", (int)stem, filename, unit, dot);
+    return out;
+}
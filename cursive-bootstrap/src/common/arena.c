@@ -145,7 +145,7 @@ size_t arena_total_allocated(const Arena *arena) {
 }
 
 /* Panic implementation */
-void cursive_panic(const char *msg, const char *file, int line) {
+void cursive_compiler_panic(const char *msg, const char *file, int line) {
     fprintf(stderr, "PANIC at %s:%d: %s\n", file, line, msg);
     abort();
-}
\ No newline at end of file
+}
@@ -0,0 +1,73 @@
+/*
+ * Cursive Bootstrap Compiler - Dense Bit Sets
+ *
+ * Fixed-size bit sets stored as arrays of 64-bit words. The caller owns
+ * the storage and passes the word count, so many sets of the same size
+ * can share one allocation (as the dataflow solver does).
+ */
+
+#ifndef CURSIVE_BITSET_H
+#define CURSIVE_BITSET_H
+
+#include "common.h"
+
+typedef uint64_t BitWord;
+
+#define BITSET_WORD_BITS 64
+
+/* Number of words needed for n bits */
+static inline size_t bitset_words(size_t bits) {
+    return (bits + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+static inline void bitset_set(BitWord *set, size_t bit) {
+    set[bit / BITSET_WORD_BITS] |= (BitWord)1 << (bit % BITSET_WORD_BITS);
+}
+
+static inline void bitset_clear(BitWord *set, size_t bit) {
+    set[bit / BITSET_WORD_BITS] &= ~((BitWord)1 << (bit % BITSET_WORD_BITS));
+}
+
+static inline bool bitset_test(const BitWord *set, size_t bit) {
+    return (set[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+/* Set every word to zero or to all ones */
+static inline void bitset_fill(BitWord *set, size_t words, bool value) {
+    memset(set, value ? 0xFF : 0, words * sizeof(BitWord));
+}
+
+static inline void bitset_copy(BitWord *dst, const BitWord *src, size_t words) {
+    memcpy(dst, src, words * sizeof(BitWord));
+}
+
+/* dst |= src */
+static inline void bitset_union(BitWord *dst, const BitWord *src, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        dst[i] |= src[i];
+    }
+}
+
+/* dst &= src */
+static inline void bitset_intersect(BitWord *dst, const BitWord *src, size_t words) {
+    for (size_t i = 0; i < words; i++) {
+        dst[i] &= src[i];
+    }
+}
+
+/*
+ * dst = gen | (src & ~kill), the gen/kill transfer function.
+ * Returns true if dst changed.
+ */
+static inline bool bitset_transfer(BitWord *dst, const BitWord *src, const BitWord *gen,
+                                   const BitWord *kill, size_t words) {
+    bool changed = false;
+    for (size_t i = 0; i < words; i++) {
+        BitWord next = gen[i] | (src[i] & ~kill[i]);
+        changed |= next != dst[i];
+        dst[i] = next;
+    }
+    return changed;
+}
+
+#endif /* CURSIVE_BITSET_H */
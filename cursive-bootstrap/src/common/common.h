@@ -49,10 +49,10 @@
 /* Memory alignment */
 #define CURSIVE_DEFAULT_ALIGN (sizeof(void*))
 
-/* Panic/assertion */
-CURSIVE_NORETURN void cursive_panic(const char *msg, const char *file, int line);
+/* Panic/assertion (the compiler's own; cursive_panic is the runtime's) */
+CURSIVE_NORETURN void cursive_compiler_panic(const char *msg, const char *file, int line);
 
-#define CURSIVE_PANIC(msg) cursive_panic(msg, __FILE__, __LINE__)
+#define CURSIVE_PANIC(msg) cursive_compiler_panic((msg), __FILE__, __LINE__)
 #define CURSIVE_ASSERT(cond) do { if (!(cond)) CURSIVE_PANIC("Assertion failed: " #cond); } while(0)
 #define CURSIVE_UNREACHABLE() CURSIVE_PANIC("Unreachable code reached")
 
@@ -105,6 +105,15 @@ const char *diag_get_line_text(const SourceFile *file, uint32_t line, size_t *le
 #define E_RES_0202 "E-RES-0202" /* Cannot access private member */
 #define E_RES_0203 "E-RES-0203" /* Unresolved import */
 
+/* Declaration errors */
+#define E_DEC_2450 "E-DEC-2450" /* Malformed attribute */
+#define E_DEC_2451 "E-DEC-2451" /* Unknown attribute */
+#define E_DEC_2452 "E-DEC-2452" /* Attribute not valid on this declaration */
+#define E_DEC_2453 "E-DEC-2453" /* align(N) not a power of two */
+#define E_DEC_2454 "E-DEC-2454" /* packed on a non-record */
+#define E_DEC_2455 "E-DEC-2455" /* packed combined with align(N) */
+#define W_DEC_2451 "W-DEC-2451" /* align(N) below the natural alignment */
+
 /* Type errors */
 #define E_TYP_1601 "E-TYP-1601" /* Mutation through const path */
 #define E_TYP_1602 "E-TYP-1602" /* Unique permission violation (aliasing) */
@@ -112,7 +121,9 @@ const char *diag_get_line_text(const SourceFile *file, uint32_t line, size_t *le
 #define E_TYP_1604 "E-TYP-1604" /* Missing class implementation */
 #define E_TYP_2052 "E-TYP-2052" /* Invalid state field access */
 #define E_TYP_2053 "E-TYP-2053" /* Invalid state method invocation */
-#define E_TYP_2060 "E-TYP-2060" /* Non-exhaustive modal match */
+#define E_TYP_2006 "E-TYP-2006" /* Infinite type (recursion without indirection) */
+#define E_TYP_2060 "E-TYP-2060" /* Non-exhaustive match */
+#define E_TYP_2061 "E-TYP-2061" /* Unreachable match arm */
 
 /* Memory/move errors */
 #define E_MEM_3001 "E-MEM-3001" /* Access to moved binding */
@@ -120,7 +131,15 @@ const char *diag_get_line_text(const SourceFile *file, uint32_t line, size_t *le
 #define E_MEM_3006 "E-MEM-3006" /* Move from immovable binding */
 #define E_MEM_3007 "E-MEM-3007" /* Use of uninitialized binding */
 
+/* Compile-time evaluation errors */
+#define E_CTE_4001 "E-CTE-4001" /* Expression is not constant */
+#define E_CTE_4002 "E-CTE-4002" /* Evaluation limit exceeded */
+#define E_CTE_4003 "E-CTE-4003" /* Evaluation failed (overflow, bounds, division by zero) */
+
 /* Expression errors */
 #define E_EXP_2537 "E-EXP-2537" /* Method call using . instead of ~> */
 
+/* Code generation errors */
+#define E_GEN_9001 "E-GEN-9001" /* Backend (LLVM) failure */
+
 #endif /* CURSIVE_ERROR_H */
\ No newline at end of file
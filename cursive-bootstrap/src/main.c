@@ -35,6 +35,19 @@ typedef struct Options {
     bool emit_llvm;           /* -emit-llvm: print LLVM IR */
     bool emit_obj;            /* -c: compile to object file only */
     bool check_only;          /* -check: type check only, no codegen */
+    bool run;                 /* -run: JIT-compile and run main */
+    const char *jit_cache;    /* -jit-cache=<dir>: objects -run keeps between runs */
+    bool time_passes;         /* -time-passes: report per-analysis and per-LLVM-pass time */
+    char opt_level;           /* -O0..-O3, -Os, -Oz: '0'..'3', 's' or 'z' */
+    const char *passes;       /* -passes=<pipeline>: custom LLVM pass pipeline */
+    const char *cpu;          /* -march=/-mcpu=<cpu>: target CPU, or "native" */
+    const char *features;     /* -mattr=<features>: e.g. "+avx2,-bmi" */
+    unsigned codegen_units;   /* -codegen-units=<n>: object files compiled in parallel */
+    bool thin_lto;            /* -flto=thin: ThinLTO bitcode with -c, otherwise a ThinLTO link */
+    OverflowMode overflow;    /* -overflow=checked|wrapping|trap */
+    const char **link_inputs; /* Bitcode inputs (.bc, .o) of a ThinLTO link */
+    size_t link_input_count;
+    bool stats;               /* -stats: report code generation statistics */
     bool help;                /* -help: print usage */
     bool version;             /* -version: print version */
 } Options;
@@ -45,9 +58,23 @@ static void print_usage(const char *program) {
     fprintf(stderr, "  -o <file>       Output file (default: a.out / a.exe)\n");
     fprintf(stderr, "  -c              Compile to object file only (no linking)\n");
     fprintf(stderr, "  -check          Type check only, no code generation\n");
+    fprintf(stderr, "  -run            Compile in memory and run main; exits with its result\n");
+    fprintf(stderr, "  -jit-cache=<d>  Keep objects compiled by -run in <d> for later runs\n");
     fprintf(stderr, "  -emit-tokens    Print token stream and exit\n");
     fprintf(stderr, "  -emit-ast       Print AST and exit\n");
     fprintf(stderr, "  -emit-llvm      Print LLVM IR and exit\n");
+    fprintf(stderr, "  -O0 .. -O3      Optimization level (default: -O0)\n");
+    fprintf(stderr, "  -Os, -Oz        Optimize for size\n");
+    fprintf(stderr, "  -passes=<p>     Run LLVM pass pipeline <p> instead of the -O pipeline\n");
+    fprintf(stderr, "  -march=<cpu>    Generate code for <cpu> (-mcpu= is the same; 'native' = host)\n");
+    fprintf(stderr, "  -mattr=<f>      Enable or disable target features, e.g. +avx2,-bmi\n");
+    fprintf(stderr, "  -codegen-units=<n>\n"
+                    "                  Split code into <n> objects (out.o, out.1.o, ...) built in parallel\n");
+    fprintf(stderr, "  -flto=thin      With -c, write ThinLTO bitcode; otherwise link the inputs\n"
+                    "                  and the runtime with ThinLTO (out.o, out.1.o, ...)\n");
+    fprintf(stderr, "  -overflow=<m>   Integer overflow: checked (panic, default), wrapping or trap\n");
+    fprintf(stderr, "  -time-passes    Report time spent in each analysis and LLVM pass\n");
+    fprintf(stderr, "  -stats          Report generic instantiation statistics\n");
     fprintf(stderr, "  -help           Print this help message\n");
     fprintf(stderr, "  -version        Print version information\n");
 }
@@ -71,8 +98,16 @@ static void print_version(void) {
 #endif
 }
 
+/* Whether an input is bitcode to link rather than source */
+static bool is_link_input(const char *path) {
+    const char *dot = strrchr(path, '.');
+    return dot && (strcmp(dot, ".bc") == 0 || strcmp(dot, ".o") == 0 ||
+                   strcmp(dot, ".obj") == 0);
+}
+
 static bool parse_args(int argc, char **argv, Options *opts) {
     memset(opts, 0, sizeof(*opts));
+    opts->opt_level = '0';
 
     for (int i = 1; i < argc; i++) {
         const char *arg = argv[i];
@@ -91,6 +126,47 @@ static bool parse_args(int argc, char **argv, Options *opts) {
             opts->emit_obj = true;
         } else if (strcmp(arg, "-check") == 0) {
             opts->check_only = true;
+        } else if (strcmp(arg, "-run") == 0) {
+            opts->run = true;
+        } else if (strncmp(arg, "-jit-cache=", 11) == 0) {
+            opts->jit_cache = arg + 11;
+        } else if (strcmp(arg, "-time-passes") == 0) {
+            opts->time_passes = true;
+        } else if (strcmp(arg, "-stats") == 0) {
+            opts->stats = true;
+        } else if (arg[0] == '-' && arg[1] == 'O' && arg[2] && !arg[3] &&
+                   strchr("0123sz", arg[2])) {
+            opts->opt_level = arg[2];
+        } else if (strncmp(arg, "-passes=", 8) == 0) {
+            opts->passes = arg + 8;
+        } else if (strncmp(arg, "-march=", 7) == 0) {
+            opts->cpu = arg + 7;
+        } else if (strncmp(arg, "-mcpu=", 6) == 0) {
+            opts->cpu = arg + 6;
+        } else if (strncmp(arg, "-mattr=", 7) == 0) {
+            opts->features = arg + 7;
+        } else if (strncmp(arg, "-codegen-units=", 15) == 0) {
+            char *end;
+            unsigned long units = strtoul(arg + 15, &end, 10);
+            if (end == arg + 15 || *end || units == 0 || units > 256) {
+                fprintf(stderr, "Error: -codegen-units expects a number from 1 to 256\n");
+                return false;
+            }
+            opts->codegen_units = (unsigned)units;
+        } else if (strcmp(arg, "-flto=thin") == 0) {
+            opts->thin_lto = true;
+        } else if (strncmp(arg, "-flto", 5) == 0) {
+            fprintf(stderr, "Error: Only -flto=thin is supported\n");
+            return false;
+        } else if (strcmp(arg, "-overflow=checked") == 0) {
+            opts->overflow = OVERFLOW_CHECKED;
+        } else if (strcmp(arg, "-overflow=wrapping") == 0) {
+            opts->overflow = OVERFLOW_WRAPPING;
+        } else if (strcmp(arg, "-overflow=trap") == 0) {
+            opts->overflow = OVERFLOW_TRAP;
+        } else if (strncmp(arg, "-overflow", 9) == 0) {
+            fprintf(stderr, "Error: -overflow expects checked, wrapping or trap\n");
+            return false;
         } else if (strcmp(arg, "-o") == 0) {
             if (i + 1 >= argc) {
                 fprintf(stderr, "Error: -o requires an argument\n");
@@ -100,6 +176,15 @@ static bool parse_args(int argc, char **argv, Options *opts) {
         } else if (arg[0] == '-') {
             fprintf(stderr, "Error: Unknown option '%s'\n", arg);
             return false;
+        } else if (is_link_input(arg)) {
+            if (!opts->link_inputs) {
+                opts->link_inputs = (const char **)malloc(sizeof(char *) * (size_t)argc);
+                if (!opts->link_inputs) {
+                    fprintf(stderr, "Error: Out of memory\n");
+                    return false;
+                }
+            }
+            opts->link_inputs[opts->link_input_count++] = arg;
         } else {
             if (opts->input_file) {
                 fprintf(stderr, "Error: Multiple input files not supported\n");
@@ -169,6 +254,57 @@ static const char *get_default_output(const Options *opts) {
 #endif
 }
 
+#ifdef HAVE_LLVM
+/* Code generation options selected on the command line */
+static CodegenOptions get_codegen_options(const Options *opts) {
+    CodegenOptions codegen_opts = {
+        .opt_level = opts->opt_level == 's' ? OPT_OS
+                   : opts->opt_level == 'z' ? OPT_OZ
+                   : (OptLevel)(OPT_O0 + (opts->opt_level - '0')),
+        .passes = opts->passes,
+        .cpu = opts->cpu,
+        .features = opts->features,
+        .time_passes = opts->time_passes,
+        .codegen_units = opts->codegen_units,
+        .thin_lto = opts->thin_lto,
+        .jit_cache = opts->jit_cache,
+        .overflow = opts->overflow,
+    };
+    return codegen_opts;
+}
+
+/* Runtime compiled to bitcode for ThinLTO links, if the build made it */
+static const char *get_runtime_bitcode(void) {
+#ifdef CURSIVE_RT_BITCODE
+    FILE *f = fopen(CURSIVE_RT_BITCODE, "rb");
+    if (f) {
+        fclose(f);
+        return CURSIVE_RT_BITCODE;
+    }
+#endif
+    return NULL;
+}
+
+/* ThinLTO link of `module` (may be NULL), the bitcode inputs and the
+ * runtime; returns the exit code */
+static int thin_link(const Options *opts, LLVMModuleRef module, Arena *arena,
+                     DiagContext *diag) {
+    CodegenOptions codegen_opts = get_codegen_options(opts);
+    const char *output = opts->output_file ? opts->output_file : get_default_output(opts);
+    unsigned objects = codegen_thin_link(&codegen_opts, arena, diag, module,
+        opts->link_inputs, opts->link_input_count, get_runtime_bitcode(), output);
+    if (objects == 0) {
+        fprintf(stderr, "ThinLTO link failed.\n");
+        return 1;
+    }
+    for (unsigned i = 0; i < objects; i++) {
+        fprintf(stderr, "Wrote object file to '%s'.\n",
+            codegen_unit_filename(arena, output, i));
+    }
+    return 0;
+}
+#endif
+
 /* Extract module name from filename */
 static const char *get_module_name(const char *path, Arena *arena) {
     /* Find last path separator */
@@ -211,6 +347,39 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    if (opts.run && (opts.emit_obj || opts.emit_llvm || opts.link_input_count > 0)) {
+        fprintf(stderr, "Error: -run cannot be combined with -c, -emit-llvm or bitcode inputs\n");
+        free(opts.link_inputs);
+        return 1;
+    }
+
+    if (opts.link_input_count > 0 && (!opts.thin_lto || opts.emit_obj || opts.emit_llvm)) {
+        fprintf(stderr, "Error: Bitcode inputs are only linked with -flto=thin, "
+                        "without -c or -emit-llvm\n");
+        free(opts.link_inputs);
+        return 1;
+    }
+
+    if (!opts.input_file && opts.link_input_count > 0) {
+        /* Link only: nothing to compile */
+#ifdef HAVE_LLVM
+        DiagContext link_diag;
+        diag_init(&link_diag);
+        Arena link_arena;
+        arena_init(&link_arena);
+        int link_code = thin_link(&opts, NULL, &link_arena, &link_diag);
+        diag_print_all(&link_diag);
+        arena_destroy(&link_arena);
+        diag_destroy(&link_diag);
+        free(opts.link_inputs);
+        return link_code;
+#else
+        fprintf(stderr, "Error: Linking requires LLVM support.\n");
+        free(opts.link_inputs);
+        return 1;
+#endif
+    }
+
     if (!opts.input_file) {
         fprintf(stderr, "Error: No input file specified\n");
         print_usage(argv[0]);
@@ -236,6 +405,10 @@ int main(int argc, char **argv) {
     Arena ast_arena;
     arena_init(&ast_arena);
 
+    SemaContext sema;
+    sema_init(&sema, &ast_arena, &diag, &strings);
+    sema.time_passes = opts.time_passes;
+
     /* Add source file to diagnostics */
     uint32_t file_id = diag_add_file(&diag, opts.input_file, source, source_len);
 
@@ -284,9 +457,6 @@ int main(int argc, char **argv) {
     /* ============================================
      * Stage 3-6: Semantic Analysis
      * ============================================ */
-    SemaContext sema;
-    sema_init(&sema, &ast_arena, &diag, &strings);
-
     /* Run full semantic analysis */
     if (!sema_analyze(&sema, mod)) {
         fprintf(stderr, "Semantic analysis failed.\n");
@@ -310,8 +480,12 @@ int main(int argc, char **argv) {
     {
         const char *module_name = get_module_name(opts.input_file, &ast_arena);
         CodegenContext codegen;
+        CodegenOptions codegen_opts = get_codegen_options(&opts);
+        /* Split objects are optimized unit by unit; IR is printed whole.
+         * Under ThinLTO the link step decides the objects instead. */
+        bool split = opts.codegen_units > 1 && !opts.emit_llvm && !opts.thin_lto && !opts.run;
 
-        if (!codegen_init(&codegen, &ast_arena, &sema, &diag, module_name)) {
+        if (!codegen_init(&codegen, &ast_arena, &sema, &diag, module_name, &codegen_opts)) {
             fprintf(stderr, "Code generation initialization failed.\n");
             exit_code = 1;
             goto cleanup;
@@ -325,10 +499,31 @@ int main(int argc, char **argv) {
             goto cleanup;
         }
 
+        if (opts.stats) {
+            mono_report_stats(&codegen.mono, stderr);
+        }
+
+        if (!split && !codegen_optimize(&codegen)) {
+            fprintf(stderr, "Optimization failed.\n");
+            diag_print_all(&diag);
+            codegen_destroy(&codegen);
+            exit_code = 1;
+            goto cleanup;
+        }
+
         /* Determine output file */
         const char *output = opts.output_file ? opts.output_file : get_default_output(&opts);
 
-        if (opts.emit_llvm) {
+        if (opts.run) {
+            /* Run main in-process; its result is the exit code */
+            int result = 0;
+            if (!codegen_jit_run(&codegen, &result)) {
+                fprintf(stderr, "JIT execution failed.\n");
+                exit_code = 1;
+            } else {
+                exit_code = result;
+            }
+        } else if (opts.emit_llvm) {
             /* Write LLVM IR */
             const char *ir_file = output;
             if (!opts.output_file) {
@@ -340,6 +535,28 @@ int main(int argc, char **argv) {
             } else {
                 fprintf(stderr, "Wrote LLVM IR to '%s'.\n", ir_file);
             }
+        } else if (opts.thin_lto && opts.emit_obj) {
+            /* Write ThinLTO bitcode for a later link */
+            if (!codegen_write_bitcode(&codegen, output)) {
+                fprintf(stderr, "Failed to write bitcode to '%s'.\n", output);
+                exit_code = 1;
+            } else {
+                fprintf(stderr, "Wrote ThinLTO bitcode to '%s'.\n", output);
+            }
+        } else if (opts.thin_lto) {
+            /* Link this module with the bitcode inputs and the runtime */
+            exit_code = thin_link(&opts, codegen.module, &ast_arena, &diag);
+        } else if (split) {
+            /* Write one object file per codegen unit */
+            unsigned units = codegen_write_units(&codegen, output);
+            if (units == 0) {
+                fprintf(stderr, "Failed to write object files for '%s'.\n", output);
+                exit_code = 1;
+            }
+            for (unsigned u = 0; u < units; u++) {
+                fprintf(stderr, "Wrote object file to '%s'.\n",
+                    codegen_unit_filename(&ast_arena, output, u));
+            }
         } else {
             /* Write object file */
             if (!codegen_write_object(&codegen, output)) {
@@ -368,10 +585,12 @@ int main(int argc, char **argv) {
     }
 
 cleanup:
+    sema_destroy(&sema);
     arena_destroy(&ast_arena);
     string_pool_destroy(&strings);
     diag_destroy(&diag);
     free(source);
+    free(opts.link_inputs);
 
     return exit_code;
 }
@@ -791,6 +1010,11 @@ static void print_ast_expr(Expr *expr, int indent) {
             print_ast_expr(expr->widen.operand, indent + 1);
             break;
 
+        case EXPR_COMPTIME:
+            printf("Comptime\n");
+            print_ast_expr(expr->comptime.operand, indent + 1);
+            break;
+
         case EXPR_CAST:
             printf("Cast(as ");
             print_ast_type(expr->cast.target_type);
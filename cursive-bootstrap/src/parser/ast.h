@@ -28,6 +28,24 @@ typedef struct GenericParam GenericParam;
 typedef struct WhereClause WhereClause;
 typedef struct Scope Scope;  /* For storing resolved scope on procedures */
 
+/*
+ * Work done where control leaves scopes: running a deferred block or
+ * dropping a binding (filled by drop elaboration). Cleanups are listed
+ * innermost scope first, each scope in reverse declaration order.
+ */
+typedef enum CleanupKind {
+    CLEANUP_DEFER,          /* Run a deferred block */
+    CLEANUP_DROP,           /* Drop a binding initialized on every path here */
+    CLEANUP_DROP_FLAGGED,   /* Drop a binding if its drop flag is set */
+    CLEANUP_ELIDED          /* Binding is moved or uninitialized on every path here */
+} CleanupKind;
+
+typedef struct Cleanup {
+    CleanupKind kind;
+    Expr *deferred;         /* CLEANUP_DEFER: the deferred block */
+    struct Symbol *sym;     /* Otherwise: the binding */
+} Cleanup;
+
 /*
  * ============================================
  * Visibility
@@ -141,6 +159,7 @@ struct TypeExpr {
     TypeExprKind kind;
     SourceSpan span;
     Permission perm;  /* Permission modifier if any */
+    struct Type *resolved;  /* Semantic type (memoized by type checker) */
 
     union {
         PrimitiveType primitive;
@@ -148,6 +167,7 @@ struct TypeExpr {
         struct {
             InternedString name;
             Vec(InternedString) path;  /* Module path segments */
+            struct Symbol *resolved;   /* Filled by name resolution */
         } named;
 
         struct {
@@ -311,6 +331,9 @@ typedef enum ExprKind {
     EXPR_MOVE,          /* move expr */
     EXPR_WIDEN,         /* widen expr (modal type widening) */
 
+    /* Compile-time evaluation */
+    EXPR_COMPTIME,      /* comptime expr */
+
     /* Type operations */
     EXPR_CAST,          /* expr as Type */
 
@@ -368,6 +391,7 @@ struct Expr {
     ExprKind kind;
     SourceSpan span;
     TypeExpr *resolved_type;  /* Filled by type checker */
+    struct Type *type;        /* Semantic type (filled by type checker) */
 
     union {
         struct {
@@ -394,6 +418,8 @@ struct Expr {
         struct {
             InternedString name;
             struct Symbol *resolved;  /* Filled by name resolution */
+            bool is_last_use;         /* Binding is dead after this read (liveness) */
+            bool is_move;             /* Value is moved out (drop elaboration) */
         } ident;
 
         struct {
@@ -414,6 +440,7 @@ struct Expr {
         struct {
             Expr *callee;
             Vec(Expr *) args;
+            Vec(struct Type *) type_args;  /* Inferred generic arguments (filled by type checker) */
         } call;
 
         struct {
@@ -459,11 +486,14 @@ struct Expr {
             Expr *scrutinee;
             Vec(Pattern *) arms_patterns;
             Vec(Expr *) arms_bodies;
+            struct Decision *decision;  /* Decision tree (filled by type checker) */
+            Vec(Cleanup) *arms_cleanups;  /* Per arm, run after its body (drop elaboration) */
         } match;
 
         struct {
             Vec(Stmt *) stmts;
             Expr *result;  /* Final expression (may be NULL) */
+            Vec(Cleanup) cleanups;  /* Run after the result (drop elaboration) */
         } block;
 
         struct {
@@ -482,6 +512,11 @@ struct Expr {
             Expr *operand;
         } widen;
 
+        struct {
+            Expr *operand;
+            struct ConstValue *value;  /* Result (filled by type checker) */
+        } comptime;
+
         struct {
             Expr *operand;
             TypeExpr *target_type;
@@ -545,6 +580,10 @@ struct Stmt {
     StmtKind kind;
     SourceSpan span;
 
+    /* return/result/break/continue: scopes left by the jump; assign: the
+     * overwritten value (filled by drop elaboration) */
+    Vec(Cleanup) cleanups;
+
     union {
         struct {
             Expr *expr;
@@ -647,6 +686,14 @@ typedef struct ParamDecl {
     SourceSpan span;
 } ParamDecl;
 
+/* Type checking progress of a procedure (callees of constant
+ * evaluation are checked on demand, ahead of declaration order) */
+typedef enum ProcCheckState {
+    PROC_UNCHECKED,
+    PROC_CHECKING,
+    PROC_CHECKED
+} ProcCheckState;
+
 /* Procedure declaration (also used for methods) */
 typedef struct ProcDecl {
     Visibility vis;
@@ -658,7 +705,13 @@ typedef struct ProcDecl {
     Vec(Contract) contracts;
     Vec(WhereClause) where_clauses;
     Expr *body;                   /* NULL for extern declarations */
+    Decl *owner;                  /* Declaring type of a method (NULL for procedures) */
     Scope *scope;                 /* Scope with parameters/locals (filled by resolver) */
+    struct Symbol *self_param;    /* Receiver binding `self` (filled by resolver) */
+    uint32_t local_count;         /* Parameter and local slots (filled by resolver) */
+    struct Type *signature;       /* Function type (filled by type checker) */
+    ProcCheckState check_state;   /* Filled by type checker */
+    Vec(InternedString) target_clones;  /* [[bootstrap.target_clones]] feature lists, or NULL */
     SourceSpan span;
 } ProcDecl;
 
@@ -676,6 +729,7 @@ typedef struct EnumVariant {
     InternedString name;
     TypeExpr *payload;  /* NULL for unit variants */
     Expr *discriminant; /* Optional explicit discriminant */
+    int64_t value;      /* Discriminant (filled by type checker) */
     SourceSpan span;
 } EnumVariant;
 
@@ -695,9 +749,24 @@ typedef struct Transition {
     Vec(ParamDecl) params;
     InternedString target_state;  /* @TargetState */
     Expr *body;
+    uint32_t local_count;         /* Parameter and local slots (filled by resolver) */
     SourceSpan span;
 } Transition;
 
+/*
+ * Representation requested by a [[layout(...)]] attribute. A declaration
+ * without one is laid out freely (see sema/layout.h).
+ */
+typedef struct LayoutAttr {
+    bool present;
+    bool c;               /* layout(C): declaration order, C padding */
+    bool packed;          /* layout(packed): no padding, alignment 1 */
+    uint32_t align;       /* layout(align(N)): minimum alignment, 0 if absent */
+    uint8_t tag_bits;     /* layout(IntType) on an enum: tag width, 0 if absent */
+    bool tag_signed;
+    SourceSpan span;
+} LayoutAttr;
+
 /* Record declaration */
 typedef struct RecordDecl {
     Visibility vis;
@@ -707,6 +776,8 @@ typedef struct RecordDecl {
     Vec(FieldDecl) fields;
     Vec(ProcDecl) methods;        /* Methods defined inline */
     Vec(WhereClause) where_clauses;
+    LayoutAttr layout;
+    struct MemberTable *members;  /* Member index (built after resolution) */
     SourceSpan span;
 } RecordDecl;
 
@@ -719,6 +790,8 @@ typedef struct EnumDecl {
     Vec(EnumVariant) variants;
     Vec(ProcDecl) methods;
     Vec(WhereClause) where_clauses;
+    LayoutAttr layout;
+    struct MemberTable *members;  /* Member index (built after resolution) */
     SourceSpan span;
 } EnumDecl;
 
@@ -731,6 +804,7 @@ typedef struct ModalDecl {
     Vec(ModalState) states;
     Vec(ProcDecl) shared_methods;  /* Methods available in all states */
     Vec(WhereClause) where_clauses;
+    struct MemberTable *members;   /* Member index (built after resolution) */
     SourceSpan span;
 } ModalDecl;
 
@@ -761,6 +835,7 @@ typedef struct ExternFuncDecl {
     InternedString link_name;  /* Optional different C name */
     Vec(ParamDecl) params;
     TypeExpr *return_type;
+    struct Type *signature;    /* Function type (filled by type checker) */
     SourceSpan span;
 } ExternFuncDecl;
 
@@ -382,6 +382,12 @@ static TypeExpr *parse_type_internal(Parser *p) {
         Token name_tok = advance(p);
         InternedString name = name_tok.value.ident;
 
+        /* `_`: left to inference */
+        if (name.len == 1 && name.data[0] == '_') {
+            return ast_new_type(p->ast_arena, TEXPR_INFER,
+                               span_new(start, name_tok.span.end));
+        }
+
         /* Check if it's a primitive */
         PrimitiveType prim = parse_primitive_type(name);
         if ((int)prim != -1) {
@@ -574,6 +580,17 @@ static Pattern *parse_pattern_internal(Parser *p) {
         Expr *lit = parse_primary(p);
         Pattern *pat = ast_new_pattern(p->ast_arena, PAT_LITERAL, lit->span);
         pat->literal.value = lit;
+
+        /* Range pattern: lo..hi or lo..=hi */
+        if (check(p, TOK_DOTDOT) || check(p, TOK_DOTDOTEQ)) {
+            Token op_tok = advance(p);
+            Pattern *range = ast_new_pattern(p->ast_arena, PAT_RANGE, span_point(start));
+            range->range.start = pat;
+            range->range.end = parse_pattern_internal(p);
+            range->range.inclusive = (op_tok.kind == TOK_DOTDOTEQ);
+            range->span.end = range->range.end->span.end;
+            return range;
+        }
         return pat;
     }
 
@@ -709,6 +726,36 @@ Pattern *parse_pattern(Parser *p) {
  * ============================================
  */
 
+/*
+ * Parse a block `{ stmts [result] }`; a final expression without a
+ * semicolon is the block's result
+ */
+static Expr *parse_block(Parser *p) {
+    SourceLoc start = p->current.span.start;
+    expect(p, TOK_LBRACE, "{");
+
+    Expr *block = ast_new_expr(p->ast_arena, EXPR_BLOCK, span_point(start));
+    block->block.stmts = vec_new(Stmt *);
+    block->block.result = NULL;
+
+    while (!check(p, TOK_RBRACE) && !check(p, TOK_EOF)) {
+        Stmt *stmt = parse_stmt(p);
+        vec_push(block->block.stmts, stmt);
+
+        /* Check for final expression (no semicolon) */
+        if (check(p, TOK_RBRACE) && stmt->kind == STMT_EXPR) {
+            block->block.result = stmt->expr.expr;
+            /* Remove from stmts since it's the result */
+            VEC_HEADER(block->block.stmts)->len--;
+            break;
+        }
+    }
+
+    expect(p, TOK_RBRACE, "}");
+    block->span.end = p->current.span.end;
+    return block;
+}
+
 static Expr *parse_primary(Parser *p) {
     SourceLoc start = p->current.span.start;
 
@@ -817,27 +864,8 @@ static Expr *parse_primary(Parser *p) {
     }
 
     /* Block expression */
-    if (accept(p, TOK_LBRACE)) {
-        Expr *block = ast_new_expr(p->ast_arena, EXPR_BLOCK, span_point(start));
-        block->block.stmts = vec_new(Stmt *);
-        block->block.result = NULL;
-
-        while (!check(p, TOK_RBRACE) && !check(p, TOK_EOF)) {
-            Stmt *stmt = parse_stmt(p);
-            vec_push(block->block.stmts, stmt);
-
-            /* Check for final expression (no semicolon) */
-            if (check(p, TOK_RBRACE) && stmt->kind == STMT_EXPR) {
-                block->block.result = stmt->expr.expr;
-                /* Remove from stmts since it's the result */
-                VEC_HEADER(block->block.stmts)->len--;
-                break;
-            }
-        }
-
-        expect(p, TOK_RBRACE, "}");
-        block->span.end = p->current.span.end;
-        return block;
+    if (check(p, TOK_LBRACE)) {
+        return parse_block(p);
     }
 
     /* If expression */
@@ -959,10 +987,18 @@ static Expr *parse_primary(Parser *p) {
         return widen;
     }
 
+    /* Compile-time expression */
+    if (accept(p, TOK_COMPTIME)) {
+        Expr *comptime = ast_new_expr(p->ast_arena, EXPR_COMPTIME, span_point(start));
+        comptime->comptime.operand = parse_expr_prec(p, PREC_UNARY);
+        comptime->span.end = comptime->comptime.operand->span.end;
+        return comptime;
+    }
+
     /* Identifier or path */
     if (check(p, TOK_IDENT) || check(p, TOK_SELF)) {
         Token name_tok = advance(p);
-        InternedString name = check(p, TOK_SELF)
+        InternedString name = name_tok.kind == TOK_SELF
             ? string_pool_intern(p->lexer->strings, "self")
             : name_tok.value.ident;
 
@@ -1325,8 +1361,7 @@ static Stmt *parse_stmt(Parser *p) {
     /* Defer statement */
     if (accept(p, TOK_DEFER)) {
         Stmt *stmt = ast_new_stmt(p->ast_arena, STMT_DEFER, span_point(start));
-        expect(p, TOK_LBRACE, "{");
-        stmt->defer.body = parse_primary(p);  /* Parse block */
+        stmt->defer.body = parse_block(p);
         stmt->span.end = stmt->defer.body->span.end;
         return stmt;
     }
@@ -1334,9 +1369,7 @@ static Stmt *parse_stmt(Parser *p) {
     /* Unsafe block */
     if (accept(p, TOK_UNSAFE)) {
         Stmt *stmt = ast_new_stmt(p->ast_arena, STMT_UNSAFE, span_point(start));
-        expect(p, TOK_LBRACE, "{");
-        /* Back up and re-parse as block */
-        stmt->unsafe.body = parse_primary(p);
+        stmt->unsafe.body = parse_block(p);
         stmt->span.end = stmt->unsafe.body->span.end;
         return stmt;
     }
@@ -1364,12 +1397,192 @@ static Visibility parse_visibility(Parser *p) {
     return VIS_PRIVATE;  /* Default */
 }
 
+/* Specification attributes the bootstrap compiler accepts without acting on */
+static const char *const ignored_attributes[] = {
+    "inline", "cold", "static_dispatch_only", "deprecated", "reflect",
+    "link_name", "no_mangle", "unwind", "dynamic", NULL
+};
+
+/* Skip a parenthesized argument list, nested parentheses included */
+static void skip_attribute_args(Parser *p) {
+    int depth = 0;
+    do {
+        if (check(p, TOK_LPAREN)) depth++;
+        if (check(p, TOK_RPAREN)) depth--;
+        advance(p);
+    } while (depth > 0 && !check(p, TOK_EOF));
+}
+
+/* Width of a layout(IntType) tag: i8..i64 or u8..u64, 0 otherwise */
+static uint8_t layout_tag_bits(InternedString name) {
+    static const char *const names[] = { "8", "16", "32", "64" };
+    if (name.len < 2 || (name.data[0] != 'i' && name.data[0] != 'u')) {
+        return 0;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        if (name.len - 1 == strlen(names[i]) &&
+            memcmp(name.data + 1, names[i], name.len - 1) == 0) {
+            return (uint8_t)(8u << i);
+        }
+    }
+    return 0;
+}
+
+/* layout(kind, ...) with kinds C, packed, align(N) and an integer type */
+static void parse_layout_args(Parser *p, LayoutAttr *layout) {
+    expect(p, TOK_LPAREN, "(");
+    do {
+        if (!check(p, TOK_IDENT)) {
+            diag_report(p->diag, DIAG_ERROR, E_DEC_2450, p->current.span,
+                "expected a layout kind");
+            break;
+        }
+        Token kind = advance(p);
+        InternedString name = kind.value.ident;
+        uint8_t tag_bits = layout_tag_bits(name);
+
+        if (interned_eq_str(name, "C")) {
+            layout->c = true;
+        } else if (interned_eq_str(name, "packed")) {
+            layout->packed = true;
+        } else if (interned_eq_str(name, "align")) {
+            expect(p, TOK_LPAREN, "(");
+            if (check(p, TOK_INT_LIT)) {
+                Token n = advance(p);
+                uint64_t align = n.value.int_val;
+                if (align == 0 || (align & (align - 1)) != 0 || align > (UINT64_C(1) << 29)) {
+                    diag_report(p->diag, DIAG_ERROR, E_DEC_2453, n.span,
+                        "alignment %llu is not a power of two", (unsigned long long)align);
+                } else {
+                    layout->align = (uint32_t)align;
+                }
+            } else {
+                diag_report(p->diag, DIAG_ERROR, E_DEC_2450, p->current.span,
+                    "expected an alignment");
+            }
+            expect(p, TOK_RPAREN, ")");
+        } else if (tag_bits) {
+            layout->tag_bits = tag_bits;
+            layout->tag_signed = name.data[0] == 'i';
+        } else {
+            diag_report(p->diag, DIAG_ERROR, E_DEC_2450, kind.span,
+                "unknown layout kind '%.*s'", (int)name.len, name.data);
+        }
+    } while (accept(p, TOK_COMMA));
+    expect(p, TOK_RPAREN, ")");
+}
+
+/*
+ * [[bootstrap.target_clones("avx2,fma", ...)]]: LLVM feature lists to
+ * clone a procedure for. The baseline is always generated, so an explicit
+ * "default" adds nothing.
+ */
+static void parse_target_clones(Parser *p, Vec(InternedString) *clones) {
+    expect(p, TOK_LPAREN, "(");
+    do {
+        if (!check(p, TOK_STRING_LIT)) {
+            diag_report(p->diag, DIAG_ERROR, E_DEC_2450, p->current.span,
+                "expected a feature list string");
+            advance(p);
+            continue;
+        }
+        InternedString features = advance(p).value.ident;
+        if (features.len > 0 && !interned_eq_str(features, "default")) {
+            vec_push(*clones, features);
+        }
+    } while (accept(p, TOK_COMMA));
+    expect(p, TOK_RPAREN, ")");
+}
+
+/* Attributes with an effect, gathered from the lists before a declaration */
+typedef struct DeclAttrs {
+    LayoutAttr layout;
+    Vec(InternedString) target_clones;  /* NULL without [[bootstrap.target_clones]] */
+    SourceSpan target_clones_span;
+} DeclAttrs;
+
+/*
+ * Attribute lists before a declaration: [[name(args), ...]]. Only
+ * [[layout(...)]] and the [[bootstrap.target_clones(...)]] extension have
+ * an effect; the other specification attributes and namespaced vendor
+ * attributes are skipped.
+ */
+static DeclAttrs parse_attributes(Parser *p) {
+    DeclAttrs attrs = {0};
+    LayoutAttr *layout = &attrs.layout;
+
+    while (check(p, TOK_LBRACKET) && peek(p).kind == TOK_LBRACKET) {
+        advance(p);
+        advance(p);
+
+        do {
+            if (!check(p, TOK_IDENT)) {
+                diag_report(p->diag, DIAG_ERROR, E_DEC_2450, p->current.span,
+                    "expected an attribute name");
+                break;
+            }
+            Token name_tok = advance(p);
+            InternedString name = name_tok.value.ident;
+            InternedString vendor = {0};
+            while (accept(p, TOK_DOT)) {
+                Token segment = expect(p, TOK_IDENT, "attribute name");
+                if (!vendor.data) {
+                    vendor = name;
+                }
+                name = segment.value.ident;
+            }
+
+            if (!vendor.data && interned_eq_str(name, "layout")) {
+                if (!layout->present) {
+                    layout->span = name_tok.span;
+                }
+                layout->present = true;
+                parse_layout_args(p, layout);
+                continue;
+            }
+            if (vendor.data && interned_eq_str(vendor, "bootstrap") &&
+                interned_eq_str(name, "target_clones")) {
+                if (!attrs.target_clones) {
+                    attrs.target_clones = vec_new(InternedString);
+                    attrs.target_clones_span = name_tok.span;
+                }
+                parse_target_clones(p, &attrs.target_clones);
+                continue;
+            }
+
+            bool known = vendor.data != NULL;
+            for (size_t i = 0; !known && ignored_attributes[i]; i++) {
+                known = interned_eq_str(name, ignored_attributes[i]);
+            }
+            if (!known) {
+                diag_report(p->diag, DIAG_ERROR, E_DEC_2451, name_tok.span,
+                    "unknown attribute '%.*s'", (int)name.len, name.data);
+            }
+            if (check(p, TOK_LPAREN)) {
+                skip_attribute_args(p);
+            }
+        } while (accept(p, TOK_COMMA));
+
+        expect(p, TOK_RBRACKET, "]]");
+        expect(p, TOK_RBRACKET, "]]");
+        accept(p, TOK_SEMI);  /* A newline after ]] ends no statement */
+    }
+
+    if (layout->packed && layout->align) {
+        diag_report(p->diag, DIAG_ERROR, E_DEC_2455, layout->span,
+            "layout(packed) cannot be combined with align(N)");
+    }
+    return attrs;
+}
+
 static Vec(GenericParam) parse_generic_params(Parser *p) {
     Vec(GenericParam) params = vec_new(GenericParam);
 
-    if (!accept(p, TOK_LT)) {
+    /* `<:` after a type name starts its class list, not generics */
+    if (!check(p, TOK_LT) || peek(p).kind == TOK_COLON) {
         return params;
     }
+    advance(p);
 
     do {
         GenericParam param = {0};
@@ -1460,8 +1673,13 @@ static ProcDecl parse_proc_decl_internal(Parser *p, Visibility vis) {
 
     expect(p, TOK_PROCEDURE, "procedure");
 
-    Token name_tok = expect(p, TOK_IDENT, "procedure name");
-    proc.name = name_tok.value.ident;
+    /* `drop` is a keyword, and also the method of the Drop class */
+    if (accept(p, TOK_DROP)) {
+        proc.name = string_pool_intern(p->lexer->strings, "drop");
+    } else {
+        Token name_tok = expect(p, TOK_IDENT, "procedure name");
+        proc.name = name_tok.value.ident;
+    }
 
     proc.generics = parse_generic_params(p);
 
@@ -1565,12 +1783,24 @@ static ProcDecl parse_proc_decl_internal(Parser *p, Visibility vis) {
 
 static Decl *parse_decl_internal(Parser *p) {
     SourceLoc start = p->current.span.start;
+    DeclAttrs attrs = parse_attributes(p);
+    LayoutAttr layout = attrs.layout;
     Visibility vis = parse_visibility(p);
 
+    if (layout.present && !check(p, TOK_RECORD) && !check(p, TOK_ENUM)) {
+        diag_report(p->diag, DIAG_ERROR, E_DEC_2452, layout.span,
+            "[[layout]] applies only to records and enums");
+    }
+    if (attrs.target_clones && !check(p, TOK_PROCEDURE)) {
+        diag_report(p->diag, DIAG_ERROR, E_DEC_2452, attrs.target_clones_span,
+            "[[bootstrap.target_clones]] applies only to procedures");
+    }
+
     /* Procedure declaration */
     if (check(p, TOK_PROCEDURE)) {
         Decl *decl = ast_new_decl(p->ast_arena, DECL_PROC, span_point(start));
         decl->proc = parse_proc_decl_internal(p, vis);
+        decl->proc.target_clones = attrs.target_clones;
         decl->span.end = decl->proc.span.end;
         return decl;
     }
@@ -1579,6 +1809,11 @@ static Decl *parse_decl_internal(Parser *p) {
     if (accept(p, TOK_RECORD)) {
         Decl *decl = ast_new_decl(p->ast_arena, DECL_RECORD, span_point(start));
         decl->record.vis = vis;
+        decl->record.layout = layout;
+        if (layout.tag_bits) {
+            diag_report(p->diag, DIAG_ERROR, E_DEC_2452, layout.span,
+                "layout(IntType) applies only to enums");
+        }
 
         Token name_tok = expect(p, TOK_IDENT, "record name");
         decl->record.name = name_tok.value.ident;
@@ -1604,6 +1839,7 @@ static Decl *parse_decl_internal(Parser *p) {
 
             if (check(p, TOK_PROCEDURE)) {
                 ProcDecl method = parse_proc_decl_internal(p, member_vis);
+                method.owner = decl;
                 vec_push(decl->record.methods, method);
             } else {
                 /* Field declaration */
@@ -1638,6 +1874,11 @@ static Decl *parse_decl_internal(Parser *p) {
     if (accept(p, TOK_ENUM)) {
         Decl *decl = ast_new_decl(p->ast_arena, DECL_ENUM, span_point(start));
         decl->enum_.vis = vis;
+        decl->enum_.layout = layout;
+        if (layout.packed) {
+            diag_report(p->diag, DIAG_ERROR, E_DEC_2454, layout.span,
+                "layout(packed) applies only to records");
+        }
 
         Token name_tok = expect(p, TOK_IDENT, "enum name");
         decl->enum_.name = name_tok.value.ident;
@@ -1662,6 +1903,7 @@ static Decl *parse_decl_internal(Parser *p) {
                 Visibility method_vis = parse_visibility(p);
                 if (check(p, TOK_PROCEDURE)) {
                     ProcDecl method = parse_proc_decl_internal(p, method_vis);
+                    method.owner = decl;
                     vec_push(decl->enum_.methods, method);
                     continue;
                 }
@@ -1779,6 +2021,7 @@ static Decl *parse_decl_internal(Parser *p) {
                         vec_push(state.transitions, trans);
                     } else if (check(p, TOK_PROCEDURE)) {
                         ProcDecl method = parse_proc_decl_internal(p, VIS_PRIVATE);
+                        method.owner = decl;
                         vec_push(state.methods, method);
                     } else {
                         /* Field */
@@ -1797,6 +2040,7 @@ static Decl *parse_decl_internal(Parser *p) {
             } else if (check(p, TOK_PROCEDURE)) {
                 /* Shared method */
                 ProcDecl method = parse_proc_decl_internal(p, VIS_PRIVATE);
+                method.owner = decl;
                 vec_push(decl->modal.shared_methods, method);
             } else {
                 synchronize(p);
@@ -1832,6 +2076,7 @@ static Decl *parse_decl_internal(Parser *p) {
         expect(p, TOK_LBRACE, "{");
         while (!check(p, TOK_RBRACE) && !check(p, TOK_EOF)) {
             ProcDecl method = parse_proc_decl_internal(p, VIS_PUBLIC);
+            method.owner = decl;
             if (method.body != NULL) {
                 vec_push(decl->class_.default_methods, method);
             } else {
@@ -364,3 +364,62 @@ int cursive_mul_overflow_i64(int64_t a, int64_t b, int64_t *result) {
 }
 
 #endif /* __GNUC__ */
+
+/* ============================================
+ * CPU Features
+ * ============================================ */
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+
+/* One feature, by its LLVM name; __builtin_cpu_supports needs literals */
+static int cpu_has_feature(const char *name, size_t len) {
+#define CPU_FEATURE(llvm_name, gcc_name) \
+    if (len == sizeof(llvm_name) - 1 && memcmp(name, llvm_name, len) == 0) \
+        return __builtin_cpu_supports(gcc_name);
+    CPU_FEATURE("cmov", "cmov")
+    CPU_FEATURE("mmx", "mmx")
+    CPU_FEATURE("popcnt", "popcnt")
+    CPU_FEATURE("sse", "sse")
+    CPU_FEATURE("sse2", "sse2")
+    CPU_FEATURE("sse3", "sse3")
+    CPU_FEATURE("ssse3", "ssse3")
+    CPU_FEATURE("sse4.1", "sse4.1")
+    CPU_FEATURE("sse4.2", "sse4.2")
+    CPU_FEATURE("avx", "avx")
+    CPU_FEATURE("avx2", "avx2")
+    CPU_FEATURE("fma", "fma")
+    CPU_FEATURE("bmi", "bmi")
+    CPU_FEATURE("bmi2", "bmi2")
+    CPU_FEATURE("avx512f", "avx512f")
+    CPU_FEATURE("avx512vl", "avx512vl")
+    CPU_FEATURE("avx512bw", "avx512bw")
+    CPU_FEATURE("avx512dq", "avx512dq")
+    CPU_FEATURE("avx512cd", "avx512cd")
+#undef CPU_FEATURE
+    return 0;
+}
+
+int cursive_cpu_supports(const char *features) {
+    __builtin_cpu_init();
+    const char *p = features;
+    while (*p) {
+        if (*p == '+') p++;
+        size_t len = strcspn(p, ",");
+        if (len > 0 && !cpu_has_feature(p, len)) {
+            return 0;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 1;
+}
+
+#else
+/* No detection: dispatchers always pick the baseline */
+
+int cursive_cpu_supports(const char *features) {
+    (void)features;
+    return 0;
+}
+
+#endif /* __GNUC__ && x86 */
@@ -17,6 +17,8 @@
 
 #ifdef _WIN32
 typedef int ssize_t;
+#else
+#include <sys/types.h>
 #endif
 
 /* ============================================
@@ -26,8 +28,10 @@ typedef int ssize_t;
 /* Terminate program with error message */
 void cursive_panic(const char *msg, const char *file, int line);
 
-/* Abort macro for convenience */
+/* Abort macro for convenience (the compiler's, when it includes this) */
+#ifndef CURSIVE_PANIC
 #define CURSIVE_PANIC(msg) cursive_panic((msg), __FILE__, __LINE__)
+#endif
 
 /* ============================================
  * Memory Allocation
@@ -152,4 +156,13 @@ int cursive_sub_overflow_i64(int64_t a, int64_t b, int64_t *result);
 int cursive_mul_overflow_i32(int32_t a, int32_t b, int32_t *result);
 int cursive_mul_overflow_i64(int64_t a, int64_t b, int64_t *result);
 
+/* ============================================
+ * CPU Features
+ * ============================================ */
+
+/* Does the running CPU support every feature in a comma-separated list of
+ * LLVM feature names ("avx2,fma", leading '+' allowed)? Used by the
+ * dispatchers of multiversioned procedures; unknown names are unsupported. */
+int cursive_cpu_supports(const char *features);
+
 #endif /* CURSIVE_RT_H */
@@ -0,0 +1,518 @@
+/*
+ * Cursive Bootstrap Compiler - Control-Flow Graph Construction
+ *
+ * The builder follows the walker through a body and keeps a stack of
+ * open control constructs. A construct's children are recognised as the
+ * walker reaches them (the then/else branch of an `if`, each arm pattern
+ * of a `match`, the condition and body of a `loop`), and the current block
+ * is split or joined at those points.
+ */
+
+#include "cfg.h"
+#include <string.h>
+
+#define CFG_NONE UINT32_MAX
+
+/*
+ * An open if/match/loop/block expression
+ */
+typedef struct CfgFrame {
+    Expr *expr;
+    uint32_t split;       /* if: end of condition; match: end of scrutinee; loop: header */
+    uint32_t branch_end;  /* if: end of then branch; loop: end of condition */
+    size_t next_arm;      /* match: index of the next arm pattern */
+    Vec(uint32_t) ends;   /* Blocks jumping to the join: arm ends, breaks, results */
+} CfgFrame;
+
+typedef struct CfgBuilder {
+    Cfg cfg;
+
+    /* Open constructs (storage and `ends` vectors reused across bodies) */
+    CfgFrame *frames;
+    uint32_t frame_count;
+    uint32_t frame_cap;
+
+    /* The binding pattern being walked belongs to a let/var without initializer */
+    bool declare_only;
+
+    /* Scratch for the post-order walk */
+    Vec(uint32_t) dfs_blocks;
+    Vec(size_t) dfs_next;
+    Vec(uint32_t) post_order;
+} CfgBuilder;
+
+/*
+ * ============================================
+ * Graph Construction
+ * ============================================
+ */
+
+static uint32_t new_block(CfgBuilder *b) {
+    Cfg *cfg = &b->cfg;
+    if (cfg->block_count == cfg->block_cap) {
+        uint32_t cap = cfg->block_cap ? cfg->block_cap * 2 : 16;
+        cfg->blocks = realloc(cfg->blocks, cap * sizeof(CfgBlock));
+        if (!cfg->blocks) {
+            CURSIVE_PANIC("Out of memory growing control-flow graph");
+        }
+        memset(cfg->blocks + cfg->block_cap, 0, (cap - cfg->block_cap) * sizeof(CfgBlock));
+        cfg->block_cap = cap;
+    }
+
+    CfgBlock *block = &cfg->blocks[cfg->block_count];
+    vec_clear(block->ops);
+    vec_clear(block->succs);
+    vec_clear(block->preds);
+    block->reachable = false;
+    return cfg->block_count++;
+}
+
+static void add_edge(CfgBuilder *b, uint32_t from, uint32_t to) {
+    vec_push(b->cfg.blocks[from].succs, to);
+    vec_push(b->cfg.blocks[to].preds, from);
+}
+
+/* Continue in a fresh block entered from `pred` */
+static void start_block_after(CfgBuilder *b, uint32_t pred) {
+    uint32_t block = new_block(b);
+    add_edge(b, pred, block);
+    b->cfg.current = block;
+}
+
+/* Control left the current block; following code is unreachable */
+static void terminate(CfgBuilder *b) {
+    b->cfg.current = new_block(b);
+}
+
+/* Join the current block and every block in `ends` */
+static void join_ends(CfgBuilder *b, Vec(uint32_t) ends) {
+    uint32_t join = new_block(b);
+    add_edge(b, b->cfg.current, join);
+    for (size_t i = 0; i < vec_len(ends); i++) {
+        add_edge(b, ends[i], join);
+    }
+    b->cfg.current = join;
+}
+
+static bool is_local(const CfgBuilder *b, const Symbol *sym) {
+    return sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM) &&
+           sym->slot < b->cfg.local_count;
+}
+
+static void emit(CfgBuilder *b, CfgOpKind kind, VisitUse use, Symbol *sym, Expr *expr,
+                 SourceSpan span) {
+    CfgOp op = { kind, use, sym, expr, span };
+    vec_push(b->cfg.blocks[b->cfg.current].ops, op);
+}
+
+/* The value of an assignment has been evaluated; overwrite the target */
+static void emit_assign(CfgBuilder *b, Expr *target) {
+    if (target->kind == EXPR_IDENT && is_local(b, target->ident.resolved)) {
+        emit(b, CFG_OP_ASSIGN, VISIT_USE_ASSIGN, target->ident.resolved, target, target->span);
+    }
+}
+
+/*
+ * ============================================
+ * Construct Stack
+ * ============================================
+ */
+
+static CfgFrame *push_frame(CfgBuilder *b, Expr *expr) {
+    if (b->frame_count == b->frame_cap) {
+        uint32_t cap = b->frame_cap ? b->frame_cap * 2 : 16;
+        b->frames = realloc(b->frames, cap * sizeof(CfgFrame));
+        if (!b->frames) {
+            CURSIVE_PANIC("Out of memory growing control-flow frames");
+        }
+        memset(b->frames + b->frame_cap, 0, (cap - b->frame_cap) * sizeof(CfgFrame));
+        b->frame_cap = cap;
+    }
+
+    CfgFrame *frame = &b->frames[b->frame_count++];
+    frame->expr = expr;
+    frame->split = CFG_NONE;
+    frame->branch_end = CFG_NONE;
+    frame->next_arm = 0;
+    vec_clear(frame->ends);
+    return frame;
+}
+
+static CfgFrame *top_frame(CfgBuilder *b) {
+    return b->frame_count ? &b->frames[b->frame_count - 1] : NULL;
+}
+
+/* Innermost open construct of the given kind */
+static CfgFrame *enclosing_frame(CfgBuilder *b, ExprKind kind) {
+    for (uint32_t i = b->frame_count; i > 0; i--) {
+        if (b->frames[i - 1].expr->kind == kind) {
+            return &b->frames[i - 1];
+        }
+    }
+    return NULL;
+}
+
+/* Open the loop header the first time a repeated part of the loop is reached */
+static void ensure_loop_header(CfgBuilder *b, CfgFrame *frame) {
+    if (frame->split == CFG_NONE) {
+        start_block_after(b, b->cfg.current);
+        frame->split = b->cfg.current;
+    }
+}
+
+/*
+ * ============================================
+ * Walker Callbacks
+ * ============================================
+ */
+
+static bool cfg_enter_body(void *state, VisitBody *body) {
+    CfgBuilder *b = state;
+
+    b->cfg.block_count = 0;
+    b->cfg.local_count = body->local_count;
+    b->frame_count = 0;
+    b->declare_only = false;
+
+    new_block(b);  /* CFG_ENTRY */
+    new_block(b);  /* CFG_EXIT */
+    b->cfg.current = CFG_ENTRY;
+    return true;
+}
+
+/* Compute reachability and reverse post-order from the entry */
+static void cfg_exit_body(void *state, VisitBody *body) {
+    CfgBuilder *b = state;
+    Cfg *cfg = &b->cfg;
+    (void)body;
+
+    add_edge(b, b->cfg.current, CFG_EXIT);
+
+    vec_clear(b->dfs_blocks);
+    vec_clear(b->dfs_next);
+    vec_clear(b->post_order);
+
+    cfg->blocks[CFG_ENTRY].reachable = true;
+    vec_push(b->dfs_blocks, (uint32_t)CFG_ENTRY);
+    vec_push(b->dfs_next, (size_t)0);
+
+    while (vec_len(b->dfs_blocks) > 0) {
+        size_t top = vec_len(b->dfs_blocks) - 1;
+        CfgBlock *block = &cfg->blocks[b->dfs_blocks[top]];
+        if (b->dfs_next[top] < vec_len(block->succs)) {
+            uint32_t succ = block->succs[b->dfs_next[top]++];
+            if (!cfg->blocks[succ].reachable) {
+                cfg->blocks[succ].reachable = true;
+                vec_push(b->dfs_blocks, succ);
+                vec_push(b->dfs_next, (size_t)0);
+            }
+        } else {
+            vec_push(b->post_order, b->dfs_blocks[top]);
+            vec_pop(b->dfs_blocks);
+            vec_pop(b->dfs_next);
+        }
+    }
+
+    vec_clear(cfg->rpo);
+    for (size_t i = vec_len(b->post_order); i > 0; i--) {
+        vec_push(cfg->rpo, b->post_order[i - 1]);
+    }
+}
+
+static bool cfg_enter_stmt(void *state, Stmt *stmt) {
+    CfgBuilder *b = state;
+
+    switch (stmt->kind) {
+        case STMT_LET:
+            /* Without an initializer the pattern is walked right away */
+            b->declare_only = stmt->let.init == NULL;
+            break;
+
+        case STMT_VAR:
+            b->declare_only = stmt->var.init == NULL;
+            break;
+
+        case STMT_DEFER:
+            /* Runs at scope exit, not here */
+            return false;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+static void cfg_exit_stmt(void *state, Stmt *stmt) {
+    CfgBuilder *b = state;
+
+    switch (stmt->kind) {
+        case STMT_LET:
+        case STMT_VAR:
+            b->declare_only = false;
+            break;
+
+        case STMT_ASSIGN:
+            emit_assign(b, stmt->assign.target);
+            break;
+
+        case STMT_RETURN:
+            add_edge(b, b->cfg.current, CFG_EXIT);
+            terminate(b);
+            break;
+
+        case STMT_RESULT: {
+            /* `result` exits the innermost block */
+            CfgFrame *block = enclosing_frame(b, EXPR_BLOCK);
+            if (block) {
+                vec_push(block->ends, b->cfg.current);
+            } else {
+                add_edge(b, b->cfg.current, CFG_EXIT);
+            }
+            terminate(b);
+            break;
+        }
+
+        case STMT_BREAK: {
+            CfgFrame *loop = enclosing_frame(b, EXPR_LOOP);
+            if (loop) {
+                vec_push(loop->ends, b->cfg.current);
+            } else {
+                add_edge(b, b->cfg.current, CFG_EXIT);  /* Reported by move analysis */
+            }
+            terminate(b);
+            break;
+        }
+
+        case STMT_CONTINUE: {
+            CfgFrame *loop = enclosing_frame(b, EXPR_LOOP);
+            if (loop) {
+                ensure_loop_header(b, loop);
+                add_edge(b, b->cfg.current, loop->split);
+            } else {
+                add_edge(b, b->cfg.current, CFG_EXIT);
+            }
+            terminate(b);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Split blocks when the walker reaches a branch of the innermost construct
+ */
+static void enter_construct_child(CfgBuilder *b, Expr *expr, Expr *parent) {
+    CfgFrame *frame = top_frame(b);
+    if (!frame || frame->expr != parent) return;
+
+    switch (parent->kind) {
+        case EXPR_IF:
+            if (expr == parent->if_.then_branch) {
+                frame->split = b->cfg.current;
+                start_block_after(b, frame->split);
+            } else if (expr == parent->if_.else_branch && frame->split != CFG_NONE) {
+                frame->branch_end = b->cfg.current;
+                start_block_after(b, frame->split);
+            }
+            break;
+
+        case EXPR_LOOP:
+            if (expr == parent->loop.condition || expr == parent->loop.body) {
+                ensure_loop_header(b, frame);
+            }
+            if (expr == parent->loop.body && parent->loop.condition) {
+                frame->branch_end = b->cfg.current;
+                start_block_after(b, frame->branch_end);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static bool cfg_enter_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    CfgBuilder *b = state;
+
+    if (edge->parent) {
+        enter_construct_child(b, expr, edge->parent);
+    }
+
+    switch (expr->kind) {
+        case EXPR_IDENT:
+            /* Assignment targets are recorded once the value is evaluated */
+            if (edge->use != VISIT_USE_ASSIGN && is_local(b, expr->ident.resolved)) {
+                emit(b, CFG_OP_USE, edge->use, expr->ident.resolved, expr, expr->span);
+            }
+            break;
+
+        case EXPR_IF:
+        case EXPR_MATCH:
+        case EXPR_LOOP:
+        case EXPR_BLOCK:
+            push_frame(b, expr);
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+static void cfg_exit_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    CfgBuilder *b = state;
+
+    switch (expr->kind) {
+        case EXPR_FIELD: {
+            Expr *object = expr->field.object;
+            if (edge->use == VISIT_USE_CONSUME && object->kind == EXPR_IDENT &&
+                is_local(b, object->ident.resolved)) {
+                emit(b, CFG_OP_USE_FIELD, VISIT_USE_CONSUME, object->ident.resolved,
+                     expr, expr->span);
+            }
+            break;
+        }
+
+        case EXPR_BINARY:
+            if (expr->binary.op >= BINOP_ASSIGN && expr->binary.op <= BINOP_SHR_ASSIGN) {
+                emit_assign(b, expr->binary.left);
+            }
+            break;
+
+        case EXPR_IF: {
+            CfgFrame *frame = &b->frames[--b->frame_count];
+            if (frame->split == CFG_NONE) break;  /* No branches were walked */
+
+            uint32_t join = new_block(b);
+            add_edge(b, b->cfg.current, join);
+            /* Without an else branch the condition falls through to the join */
+            add_edge(b, frame->branch_end != CFG_NONE ? frame->branch_end : frame->split, join);
+            b->cfg.current = join;
+            break;
+        }
+
+        case EXPR_MATCH: {
+            CfgFrame *frame = &b->frames[--b->frame_count];
+            if (frame->next_arm > 0) {
+                join_ends(b, frame->ends);
+            }
+            break;
+        }
+
+        case EXPR_LOOP: {
+            CfgFrame *frame = &b->frames[--b->frame_count];
+            ensure_loop_header(b, frame);
+            if (expr->loop.condition && frame->branch_end == CFG_NONE) {
+                frame->branch_end = b->cfg.current;  /* Condition without a body */
+            }
+            add_edge(b, b->cfg.current, frame->split);
+
+            uint32_t exit = new_block(b);
+            if (expr->loop.iterable) {
+                add_edge(b, frame->split, exit);
+            }
+            if (expr->loop.condition) {
+                add_edge(b, frame->branch_end, exit);
+            }
+            for (size_t i = 0; i < vec_len(frame->ends); i++) {
+                add_edge(b, frame->ends[i], exit);
+            }
+            b->cfg.current = exit;
+            break;
+        }
+
+        case EXPR_BLOCK: {
+            CfgFrame *frame = &b->frames[--b->frame_count];
+            if (vec_len(frame->ends) > 0) {
+                join_ends(b, frame->ends);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static bool cfg_enter_pattern(void *state, Pattern *pat, bool binds) {
+    CfgBuilder *b = state;
+    CfgFrame *frame = top_frame(b);
+
+    /* Each match arm starts from the end of the scrutinee */
+    if (frame && frame->expr->kind == EXPR_MATCH &&
+        frame->next_arm < vec_len(frame->expr->match.arms_patterns) &&
+        pat == frame->expr->match.arms_patterns[frame->next_arm]) {
+        if (frame->next_arm == 0) {
+            frame->split = b->cfg.current;
+        } else {
+            vec_push(frame->ends, b->cfg.current);
+        }
+        start_block_after(b, frame->split);
+        frame->next_arm++;
+    }
+
+    /* A loop binding is rebound at the header on every iteration */
+    if (frame && frame->expr->kind == EXPR_LOOP && pat == frame->expr->loop.binding) {
+        ensure_loop_header(b, frame);
+    }
+
+    if (pat->kind == PAT_BINDING && binds && is_local(b, pat->binding.resolved)) {
+        emit(b, b->declare_only ? CFG_OP_DECLARE : CFG_OP_INIT, VISIT_USE_READ,
+             pat->binding.resolved, NULL, pat->span);
+    }
+    return true;
+}
+
+static void cfg_finish(void *state) {
+    CfgBuilder *b = state;
+
+    for (uint32_t i = 0; i < b->cfg.block_cap; i++) {
+        vec_free(b->cfg.blocks[i].ops);
+        vec_free(b->cfg.blocks[i].succs);
+        vec_free(b->cfg.blocks[i].preds);
+    }
+    free(b->cfg.blocks);
+    vec_free(b->cfg.rpo);
+
+    for (uint32_t i = 0; i < b->frame_cap; i++) {
+        vec_free(b->frames[i].ends);
+    }
+    free(b->frames);
+
+    vec_free(b->dfs_blocks);
+    vec_free(b->dfs_next);
+    vec_free(b->post_order);
+    free(b);
+}
+
+/*
+ * Get the graph built by the walker's CFG pass, registering the pass if needed
+ */
+Cfg *cfg_require_pass(Visitor *v) {
+    VisitPass *existing = visitor_find_pass(v, "cfg");
+    if (existing) {
+        return &((CfgBuilder *)existing->state)->cfg;
+    }
+
+    CfgBuilder *b = calloc(1, sizeof(CfgBuilder));
+    if (!b) {
+        CURSIVE_PANIC("Out of memory allocating control-flow graph builder");
+    }
+
+    VisitPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "cfg";
+    pass.state = b;
+    pass.enter_body = cfg_enter_body;
+    pass.exit_body = cfg_exit_body;
+    pass.enter_stmt = cfg_enter_stmt;
+    pass.exit_stmt = cfg_exit_stmt;
+    pass.enter_expr = cfg_enter_expr;
+    pass.exit_expr = cfg_exit_expr;
+    pass.enter_pattern = cfg_enter_pattern;
+    pass.finish = cfg_finish;
+    visitor_add_pass(v, &pass);
+    return &b->cfg;
+}
@@ -0,0 +1,66 @@
+/*
+ * Cursive Bootstrap Compiler - Control-Flow Graphs
+ *
+ * Lowers a procedure body to basic blocks of binding operations: every
+ * use, initialization, assignment and declaration of a local (addressed by
+ * its resolver slot, see Symbol.slot) in evaluation order, with edges for
+ * if/match branches, loops, break/continue, return and result.
+ *
+ * The graph is built by a pass of the fused body walker (visit.h), so it
+ * classifies uses exactly as the other body analyses see them. Analyses
+ * that need the graph fetch it with cfg_require_pass and read it in their
+ * exit_body callback, which runs after the graph of the body is complete.
+ */
+
+#ifndef CURSIVE_SEMA_CFG_H
+#define CURSIVE_SEMA_CFG_H
+
+#include "scope.h"
+#include "visit.h"
+
+/* Entry and exit blocks of every graph */
+#define CFG_ENTRY 0
+#define CFG_EXIT 1
+
+/*
+ * Operation on a local binding
+ */
+typedef enum CfgOpKind {
+    CFG_OP_USE,        /* Binding is used; `use` says how (never VISIT_USE_ASSIGN) */
+    CFG_OP_USE_FIELD,  /* A field of the binding is consumed */
+    CFG_OP_INIT,       /* Binding pattern receives a value */
+    CFG_OP_DECLARE,    /* Binding is introduced without a value */
+    CFG_OP_ASSIGN      /* Binding is overwritten (after the value is evaluated) */
+} CfgOpKind;
+
+typedef struct CfgOp {
+    CfgOpKind kind;
+    VisitUse use;      /* For CFG_OP_USE */
+    Symbol *sym;       /* The binding (sym->slot indexes per-body arrays) */
+    Expr *expr;        /* Identifier or field expression (NULL for patterns) */
+    SourceSpan span;
+} CfgOp;
+
+typedef struct CfgBlock {
+    Vec(CfgOp) ops;
+    Vec(uint32_t) succs;
+    Vec(uint32_t) preds;
+    bool reachable;          /* Reachable from the entry (set when the body is complete) */
+} CfgBlock;
+
+/*
+ * Graph of the body being walked. Block storage is reused across bodies.
+ */
+typedef struct Cfg {
+    CfgBlock *blocks;
+    uint32_t block_count;
+    uint32_t block_cap;
+    Vec(uint32_t) rpo;       /* Reachable blocks in reverse post-order */
+    uint32_t local_count;    /* Slots of the body (see VisitBody) */
+    uint32_t current;        /* Block receiving operations while the body is walked */
+} Cfg;
+
+/* Get the graph built by the walker's CFG pass, registering the pass if needed */
+Cfg *cfg_require_pass(Visitor *v);
+
+#endif /* CURSIVE_SEMA_CFG_H */
@@ -0,0 +1,1557 @@
+/*
+ * Cursive Bootstrap Compiler - Compile-Time Evaluation Implementation
+ */
+
+#include "consteval.h"
+#include "members.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CONST_DEFAULT_MAX_STEPS   10000000u
+#define CONST_DEFAULT_MAX_BYTES   ((size_t)64 * 1024 * 1024)
+#define CONST_DEFAULT_MAX_DEPTH   256u
+#define CONST_MEMO_INITIAL_CAPACITY 64
+
+/* Locals of one call (or of a root expression), indexed by symbol slot */
+struct ConstFrame {
+    ConstValue *slots;
+    uint32_t count;
+};
+
+/* A memoized call: all arguments are scalars */
+struct ConstMemo {
+    uint32_t hash;
+    uint32_t arg_count;
+    ProcDecl *proc;            /* NULL for an empty entry */
+    ConstValue *args;
+    ConstValue *result;
+};
+
+/* How evaluation of an expression or statement ended */
+typedef enum EvalStatus {
+    EVAL_OK,
+    EVAL_BREAK,                /* Unwinding to the loop named by break_label */
+    EVAL_CONTINUE,
+    EVAL_RETURN,               /* `result`/`return`; the value is the procedure's */
+    EVAL_ERROR                 /* Reported (or follows an earlier type error) */
+} EvalStatus;
+
+static EvalStatus eval_expr(ConstEval *ev, Expr *expr, ConstValue *out);
+static EvalStatus eval_stmt(ConstEval *ev, Stmt *stmt);
+
+void const_eval_init(ConstEval *ev, Arena *arena, DiagContext *diag,
+                     TypeContext *types, ConstHooks hooks) {
+    memset(ev, 0, sizeof(*ev));
+    ev->arena = arena;
+    arena_init(&ev->scratch);
+    ev->diag = diag;
+    ev->types = types;
+    ev->hooks = hooks;
+    ev->limits.max_steps = CONST_DEFAULT_MAX_STEPS;
+    ev->limits.max_bytes = CONST_DEFAULT_MAX_BYTES;
+    ev->limits.max_depth = CONST_DEFAULT_MAX_DEPTH;
+    ptr_map_init(&ev->results);
+}
+
+void const_eval_destroy(ConstEval *ev) {
+    arena_destroy(&ev->scratch);
+    ptr_map_destroy(&ev->results);
+}
+
+/*
+ * ============================================
+ * Errors and limits
+ * ============================================
+ */
+
+static EvalStatus fail(ConstEval *ev, const char *code, SourceSpan span,
+                       const char *message) {
+    diag_report(ev->diag, DIAG_ERROR, code, span, "%s", message);
+    return EVAL_ERROR;
+}
+
+static EvalStatus not_constant(ConstEval *ev, SourceSpan span, const char *what) {
+    char message[160];
+    snprintf(message, sizeof(message), "%s cannot be evaluated at compile time", what);
+    return fail(ev, E_CTE_4001, span, message);
+}
+
+/* Count one evaluation step, enforcing the step and memory limits */
+static EvalStatus step(ConstEval *ev, SourceSpan span) {
+    if (++ev->steps > ev->limits.max_steps) {
+        char message[96];
+        snprintf(message, sizeof(message),
+            "compile-time evaluation exceeded %llu steps",
+            (unsigned long long)ev->limits.max_steps);
+        return fail(ev, E_CTE_4002, span, message);
+    }
+    if (arena_total_allocated(&ev->scratch) > ev->limits.max_bytes) {
+        char message[96];
+        snprintf(message, sizeof(message),
+            "compile-time evaluation exceeded %zu bytes of memory",
+            ev->limits.max_bytes);
+        return fail(ev, E_CTE_4002, span, message);
+    }
+    return EVAL_OK;
+}
+
+/* The solved type of an expression, or NULL after an earlier type error */
+static Type *expr_type(ConstEval *ev, Expr *expr) {
+    Type *type = expr->type ? ev->hooks.expr_type(ev->state, expr) : NULL;
+    return type && type->kind != TYPE_ERROR ? type : NULL;
+}
+
+/*
+ * ============================================
+ * Values
+ * ============================================
+ */
+
+static void set_unit(ConstEval *ev, ConstValue *out) {
+    out->kind = CONST_UNIT;
+    out->type = ev->types->type_unit;
+}
+
+static void set_bool(ConstEval *ev, ConstValue *out, bool value) {
+    out->kind = CONST_BOOL;
+    out->type = ev->types->type_bool;
+    out->b = value;
+}
+
+static ConstValue *alloc_values(Arena *arena, size_t count) {
+    return arena_calloc(arena, count ? count : 1, sizeof(ConstValue));
+}
+
+/* Copy a value and everything it owns into `arena` */
+static void copy_value(Arena *arena, ConstValue *dst, const ConstValue *src) {
+    *dst = *src;
+    if (src->kind == CONST_AGGREGATE) {
+        dst->aggregate.elements = alloc_values(arena, src->aggregate.count);
+        for (size_t i = 0; i < src->aggregate.count; i++) {
+            copy_value(arena, &dst->aggregate.elements[i], &src->aggregate.elements[i]);
+        }
+    }
+}
+
+static bool is_scalar(const ConstValue *value) {
+    return value->kind != CONST_AGGREGATE;
+}
+
+static bool values_equal(const ConstValue *a, const ConstValue *b) {
+    if (a->kind != b->kind) return false;
+    switch (a->kind) {
+        case CONST_UNIT:   return true;
+        case CONST_BOOL:   return a->b == b->b;
+        case CONST_INT:    return a->bits == b->bits;
+        case CONST_FLOAT:  return a->f == b->f;
+        case CONST_CHAR:   return a->ch == b->ch;
+        case CONST_STRING: return interned_eq(a->str, b->str);
+        case CONST_AGGREGATE:
+            if (a->aggregate.count != b->aggregate.count) return false;
+            for (size_t i = 0; i < a->aggregate.count; i++) {
+                if (!values_equal(&a->aggregate.elements[i], &b->aggregate.elements[i])) {
+                    return false;
+                }
+            }
+            return true;
+    }
+    return false;
+}
+
+/*
+ * ============================================
+ * Integers
+ * ============================================
+ *
+ * Integers are held in 64 bits, sign- or zero-extended from their type's
+ * width, so every operation is a 64-bit operation followed by a check
+ * that the result still fits. 128-bit types are evaluated in 64 bits:
+ * a value that needs more is reported as an overflow.
+ */
+
+static bool int_info(const Type *type, unsigned *width, bool *is_signed) {
+    if (!type) return false;
+    switch (type->kind) {
+        case TYPE_PRIM_I8:    *width = 8;  *is_signed = true;  return true;
+        case TYPE_PRIM_I16:   *width = 16; *is_signed = true;  return true;
+        case TYPE_PRIM_I32:   *width = 32; *is_signed = true;  return true;
+        case TYPE_PRIM_I64:
+        case TYPE_PRIM_I128:
+        case TYPE_PRIM_ISIZE: *width = 64; *is_signed = true;  return true;
+        case TYPE_PRIM_U8:    *width = 8;  *is_signed = false; return true;
+        case TYPE_PRIM_U16:   *width = 16; *is_signed = false; return true;
+        case TYPE_PRIM_U32:   *width = 32; *is_signed = false; return true;
+        case TYPE_PRIM_U64:
+        case TYPE_PRIM_U128:
+        case TYPE_PRIM_USIZE: *width = 64; *is_signed = false; return true;
+        default:              return false;
+    }
+}
+
+static bool is_float_type(const Type *type) {
+    return type && type->kind >= TYPE_PRIM_F16 && type->kind <= TYPE_PRIM_F64;
+}
+
+/* Truncate to `width` bits and extend back to 64 */
+static uint64_t int_normalize(uint64_t bits, unsigned width, bool is_signed) {
+    if (width >= 64) return bits;
+    uint64_t mask = (UINT64_C(1) << width) - 1;
+    bits &= mask;
+    if (is_signed && ((bits >> (width - 1)) & 1)) {
+        bits |= ~mask;
+    }
+    return bits;
+}
+
+static void set_int(ConstValue *out, Type *type, uint64_t bits) {
+    out->kind = CONST_INT;
+    out->type = type;
+    out->bits = bits;
+}
+
+/* Round a double to the precision of a float type */
+static double float_round(const Type *type, double value) {
+    return type && type->kind != TYPE_PRIM_F64 ? (double)(float)value : value;
+}
+
+static EvalStatus overflow(ConstEval *ev, SourceSpan span, Type *type) {
+    char message[128];
+    snprintf(message, sizeof(message),
+        "arithmetic overflow in compile-time evaluation of '%s'",
+        type_to_string(type, &ev->scratch));
+    return fail(ev, E_CTE_4003, span, message);
+}
+
+static bool int_less(bool is_signed, uint64_t a, uint64_t b) {
+    return is_signed ? (int64_t)a < (int64_t)b : a < b;
+}
+
+/* a^b by repeated multiplication; any other base overflows within 64 steps */
+static bool int_pow(bool is_signed, uint64_t base, uint64_t exp, uint64_t *out) {
+    if (exp == 0 || base == 1) {
+        *out = 1;
+        return true;
+    }
+    if (base == 0) {
+        *out = 0;
+        return true;
+    }
+    if (is_signed && (int64_t)base == -1) {
+        *out = exp % 2 ? base : 1;
+        return true;
+    }
+
+    uint64_t result = 1;
+    for (uint64_t i = 0; i < exp; i++) {
+        if (is_signed) {
+            int64_t r;
+            if (__builtin_mul_overflow((int64_t)result, (int64_t)base, &r)) return false;
+            result = (uint64_t)r;
+        } else if (__builtin_mul_overflow(result, base, &result)) {
+            return false;
+        }
+    }
+    *out = result;
+    return true;
+}
+
+static EvalStatus int_binary(ConstEval *ev, BinaryOp op, Type *type, uint64_t a,
+                             uint64_t b, SourceSpan span, ConstValue *out) {
+    unsigned width;
+    bool is_signed;
+    if (!int_info(type, &width, &is_signed)) {
+        return not_constant(ev, span, "this operation");
+    }
+
+    uint64_t r = 0;
+    bool overflowed = false;
+    switch (op) {
+        case BINOP_ADD:
+            overflowed = is_signed
+                ? __builtin_add_overflow((int64_t)a, (int64_t)b, (int64_t *)&r)
+                : __builtin_add_overflow(a, b, &r);
+            break;
+        case BINOP_SUB:
+            overflowed = is_signed
+                ? __builtin_sub_overflow((int64_t)a, (int64_t)b, (int64_t *)&r)
+                : __builtin_sub_overflow(a, b, &r);
+            break;
+        case BINOP_MUL:
+            overflowed = is_signed
+                ? __builtin_mul_overflow((int64_t)a, (int64_t)b, (int64_t *)&r)
+                : __builtin_mul_overflow(a, b, &r);
+            break;
+        case BINOP_DIV:
+        case BINOP_MOD:
+            if (b == 0) {
+                return fail(ev, E_CTE_4003, span, "division by zero in compile-time evaluation");
+            }
+            if (is_signed) {
+                if ((int64_t)a == INT64_MIN && (int64_t)b == -1) {
+                    overflowed = true;
+                    break;
+                }
+                r = (uint64_t)(op == BINOP_DIV ? (int64_t)a / (int64_t)b
+                                               : (int64_t)a % (int64_t)b);
+            } else {
+                r = op == BINOP_DIV ? a / b : a % b;
+            }
+            break;
+        case BINOP_POW:
+            if (is_signed && (int64_t)b < 0) {
+                return fail(ev, E_CTE_4003, span, "negative exponent in compile-time evaluation");
+            }
+            overflowed = !int_pow(is_signed, a, b, &r);
+            break;
+        case BINOP_BIT_AND: r = a & b; break;
+        case BINOP_BIT_OR:  r = a | b; break;
+        case BINOP_BIT_XOR: r = a ^ b; break;
+        case BINOP_SHL:
+        case BINOP_SHR:
+            if ((is_signed && (int64_t)b < 0) || b >= width) {
+                return fail(ev, E_CTE_4003, span,
+                    "shift amount out of range in compile-time evaluation");
+            }
+            if (op == BINOP_SHL) {
+                r = int_normalize(a << b, width, is_signed);
+            } else {
+                r = is_signed ? (uint64_t)((int64_t)a >> b) : a >> b;
+            }
+            break;
+        default:
+            return not_constant(ev, span, "this operation");
+    }
+
+    if (overflowed || int_normalize(r, width, is_signed) != r) {
+        return overflow(ev, span, type);
+    }
+    set_int(out, type, r);
+    return EVAL_OK;
+}
+
+static EvalStatus float_binary(ConstEval *ev, BinaryOp op, Type *type, double a,
+                               double b, SourceSpan span, ConstValue *out) {
+    double r;
+    switch (op) {
+        case BINOP_ADD: r = a + b; break;
+        case BINOP_SUB: r = a - b; break;
+        case BINOP_MUL: r = a * b; break;
+        case BINOP_DIV: r = a / b; break;
+        default:
+            return not_constant(ev, span, "this floating-point operation");
+    }
+    out->kind = CONST_FLOAT;
+    out->type = type;
+    out->f = float_round(type, r);
+    return EVAL_OK;
+}
+
+/* Three-way comparison of two scalars of the same type; false if unordered */
+static bool compare(const ConstValue *a, const ConstValue *b, int *order) {
+    switch (a->kind) {
+        case CONST_INT: {
+            unsigned width;
+            bool is_signed = false;
+            int_info(a->type, &width, &is_signed);
+            *order = int_less(is_signed, a->bits, b->bits) ? -1 : a->bits != b->bits;
+            return true;
+        }
+        case CONST_FLOAT:
+            if (a->f != a->f || b->f != b->f) return false;
+            *order = a->f < b->f ? -1 : a->f > b->f;
+            return true;
+        case CONST_CHAR:
+            *order = a->ch < b->ch ? -1 : a->ch > b->ch;
+            return true;
+        case CONST_BOOL:
+            *order = (int)a->b - (int)b->b;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * ============================================
+ * Locals
+ * ============================================
+ */
+
+static ConstFrame *new_frame(ConstEval *ev, uint32_t count) {
+    ConstFrame *frame = arena_calloc(&ev->scratch, 1, sizeof(ConstFrame));
+    frame->count = count;
+    frame->slots = alloc_values(&ev->scratch, count);
+    return frame;
+}
+
+/*
+ * The slot of a local. Bindings made by the evaluation grow the frame on
+ * demand; reading a slot nothing bound means the local belongs to code
+ * that runs only at runtime.
+ */
+static ConstValue *frame_slot(ConstEval *ev, uint32_t slot, bool bind) {
+    ConstFrame *frame = ev->frame;
+    if (slot >= frame->count) {
+        if (!bind) return NULL;
+        uint32_t count = frame->count ? frame->count : 8;
+        while (count <= slot) count *= 2;
+        ConstValue *slots = alloc_values(&ev->scratch, count);
+        memcpy(slots, frame->slots, frame->count * sizeof(ConstValue));
+        frame->slots = slots;
+        frame->count = count;
+    }
+    ConstValue *value = &frame->slots[slot];
+    return bind || value->type ? value : NULL;
+}
+
+static bool is_local(const Symbol *sym) {
+    return sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM);
+}
+
+/*
+ * ============================================
+ * Places
+ * ============================================
+ */
+
+/* Position of a named field in a record or tuple aggregate */
+static bool field_index(Type *type, InternedString name, size_t *index) {
+    if (!type) return false;
+    if (type->kind == TYPE_GENERIC_INST) type = type->generic_inst.base;
+
+    if (type->kind == TYPE_TUPLE) {
+        size_t i = 0;
+        if (name.len == 0) return false;
+        for (size_t c = 0; c < name.len; c++) {
+            if (name.data[c] < '0' || name.data[c] > '9') return false;
+            i = i * 10 + (size_t)(name.data[c] - '0');
+        }
+        *index = i;
+        return i < vec_len(type->tuple.elements);
+    }
+
+    if (type->kind == TYPE_RECORD && type->nominal.sym) {
+        Member *field = member_field(decl_members(type->nominal.sym->decl), name);
+        if (field) {
+            *index = field->index;
+            return true;
+        }
+    }
+    return false;
+}
+
+static EvalStatus bounds_check(ConstEval *ev, SourceSpan span, const ConstValue *index,
+                               size_t count, size_t *out) {
+    unsigned width;
+    bool is_signed;
+    if (index->kind != CONST_INT || !int_info(index->type, &width, &is_signed)) {
+        return not_constant(ev, span, "this index");
+    }
+    if ((is_signed && (int64_t)index->bits < 0) || index->bits >= count) {
+        char message[128];
+        snprintf(message, sizeof(message),
+            "index %lld is out of bounds for length %zu in compile-time evaluation",
+            (long long)index->bits, count);
+        return fail(ev, E_CTE_4003, span, message);
+    }
+    *out = (size_t)index->bits;
+    return EVAL_OK;
+}
+
+/* Find the storage an assignable expression names */
+static EvalStatus eval_place(ConstEval *ev, Expr *expr, ConstValue **out) {
+    switch (expr->kind) {
+        case EXPR_IDENT: {
+            Symbol *sym = expr->ident.resolved;
+            ConstValue *slot = is_local(sym) ? frame_slot(ev, sym->slot, false) : NULL;
+            if (!slot) {
+                char what[96];
+                snprintf(what, sizeof(what), "'%.*s'",
+                    (int)expr->ident.name.len, expr->ident.name.data);
+                return not_constant(ev, expr->span, what);
+            }
+            *out = slot;
+            return EVAL_OK;
+        }
+
+        case EXPR_INDEX: {
+            ConstValue *object;
+            EvalStatus status = eval_place(ev, expr->index.object, &object);
+            if (status != EVAL_OK) return status;
+
+            ConstValue index;
+            status = eval_expr(ev, expr->index.index, &index);
+            if (status != EVAL_OK) return status;
+            if (object->kind != CONST_AGGREGATE) {
+                return not_constant(ev, expr->span, "this index");
+            }
+
+            size_t i;
+            status = bounds_check(ev, expr->index.index->span, &index,
+                                  object->aggregate.count, &i);
+            if (status != EVAL_OK) return status;
+            *out = &object->aggregate.elements[i];
+            return EVAL_OK;
+        }
+
+        case EXPR_FIELD: {
+            ConstValue *object;
+            EvalStatus status = eval_place(ev, expr->field.object, &object);
+            if (status != EVAL_OK) return status;
+
+            size_t i;
+            if (object->kind != CONST_AGGREGATE ||
+                !field_index(object->type, expr->field.field, &i) ||
+                i >= object->aggregate.count) {
+                return not_constant(ev, expr->span, "this field");
+            }
+            *out = &object->aggregate.elements[i];
+            return EVAL_OK;
+        }
+
+        default:
+            return not_constant(ev, expr->span, "this place");
+    }
+}
+
+static bool is_place(const Expr *expr) {
+    switch (expr->kind) {
+        case EXPR_IDENT: return true;
+        case EXPR_INDEX: return is_place(expr->index.object);
+        case EXPR_FIELD: return is_place(expr->field.object);
+        default:         return false;
+    }
+}
+
+/*
+ * ============================================
+ * Patterns
+ * ============================================
+ */
+
+static EvalStatus match_pattern(ConstEval *ev, Pattern *pat, ConstValue *value,
+                                bool *matched) {
+    *matched = false;
+    if (!pat) {
+        *matched = true;
+        return EVAL_OK;
+    }
+
+    switch (pat->kind) {
+        case PAT_WILDCARD:
+            *matched = true;
+            return EVAL_OK;
+
+        case PAT_BINDING: {
+            Symbol *sym = pat->binding.resolved;
+            if (!sym) return EVAL_ERROR;
+            /* The value is the pattern's own, so it moves into the slot */
+            *frame_slot(ev, sym->slot, true) = *value;
+            *matched = true;
+            return EVAL_OK;
+        }
+
+        case PAT_LITERAL: {
+            ConstValue literal;
+            EvalStatus status = eval_expr(ev, pat->literal.value, &literal);
+            if (status != EVAL_OK) return status;
+            *matched = values_equal(value, &literal);
+            return EVAL_OK;
+        }
+
+        case PAT_TUPLE:
+            if (value->kind != CONST_AGGREGATE ||
+                value->aggregate.count != vec_len(pat->tuple.elements)) {
+                return EVAL_ERROR;
+            }
+            for (size_t i = 0; i < vec_len(pat->tuple.elements); i++) {
+                EvalStatus status = match_pattern(ev, pat->tuple.elements[i],
+                                                  &value->aggregate.elements[i], matched);
+                if (status != EVAL_OK || !*matched) return status;
+            }
+            return EVAL_OK;
+
+        case PAT_RANGE: {
+            ConstValue lo, hi;
+            int order;
+            if (pat->range.start) {
+                EvalStatus status = eval_expr(ev, pat->range.start->literal.value, &lo);
+                if (status != EVAL_OK) return status;
+                if (!compare(value, &lo, &order) || order < 0) return EVAL_OK;
+            }
+            if (pat->range.end) {
+                EvalStatus status = eval_expr(ev, pat->range.end->literal.value, &hi);
+                if (status != EVAL_OK) return status;
+                if (!compare(value, &hi, &order) || order > 0 ||
+                    (order == 0 && !pat->range.inclusive)) {
+                    return EVAL_OK;
+                }
+            }
+            *matched = true;
+            return EVAL_OK;
+        }
+
+        case PAT_OR:
+            for (size_t i = 0; i < vec_len(pat->or_.alternatives); i++) {
+                EvalStatus status = match_pattern(ev, pat->or_.alternatives[i], value, matched);
+                if (status != EVAL_OK || *matched) return status;
+            }
+            return EVAL_OK;
+
+        case PAT_GUARD: {
+            EvalStatus status = match_pattern(ev, pat->guard.pattern, value, matched);
+            if (status != EVAL_OK || !*matched) return status;
+
+            ConstValue guard;
+            status = eval_expr(ev, pat->guard.guard, &guard);
+            if (status != EVAL_OK) return status;
+            *matched = guard.kind == CONST_BOOL && guard.b;
+            return EVAL_OK;
+        }
+
+        case PAT_RECORD:
+        case PAT_ENUM:
+        case PAT_MODAL:
+            break;
+    }
+    return not_constant(ev, pat->span, "this pattern");
+}
+
+/*
+ * ============================================
+ * Calls
+ * ============================================
+ */
+
+static uint32_t hash_mix(uint32_t h, uint64_t v) {
+    h ^= (uint32_t)(v ^ (v >> 32)) + 0x9e3779b9u + (h << 6) + (h >> 2);
+    return h;
+}
+
+static uint32_t hash_call(ProcDecl *proc, const ConstValue *args, size_t count) {
+    uint32_t h = hash_mix(0, (uint64_t)(uintptr_t)proc);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t payload = 0;
+        switch (args[i].kind) {
+            case CONST_UNIT:      break;
+            case CONST_BOOL:      payload = args[i].b; break;
+            case CONST_INT:       payload = args[i].bits; break;
+            case CONST_FLOAT:     memcpy(&payload, &args[i].f, sizeof(payload)); break;
+            case CONST_CHAR:      payload = args[i].ch; break;
+            case CONST_STRING:    payload = (uint64_t)(uintptr_t)args[i].str.data; break;
+            case CONST_AGGREGATE: break;
+        }
+        h = hash_mix(hash_mix(h, args[i].kind), payload);
+    }
+    return h;
+}
+
+static ConstMemo *memo_find(ConstEval *ev, uint32_t hash, ProcDecl *proc,
+                            const ConstValue *args, size_t count) {
+    if (!ev->memo_capacity) return NULL;
+    size_t mask = ev->memo_capacity - 1;
+    for (size_t i = hash & mask; ev->memo[i].proc; i = (i + 1) & mask) {
+        ConstMemo *memo = &ev->memo[i];
+        if (memo->hash != hash || memo->proc != proc || memo->arg_count != count) continue;
+        size_t a = 0;
+        while (a < count && args[a].type == memo->args[a].type &&
+               values_equal(&args[a], &memo->args[a])) {
+            a++;
+        }
+        if (a == count) return memo;
+    }
+    return NULL;
+}
+
+static void memo_grow(ConstEval *ev) {
+    size_t capacity = ev->memo_capacity ? ev->memo_capacity * 2 : CONST_MEMO_INITIAL_CAPACITY;
+    ConstMemo *memo = arena_calloc(ev->arena, capacity, sizeof(ConstMemo));
+    for (size_t i = 0; i < ev->memo_capacity; i++) {
+        if (!ev->memo[i].proc) continue;
+        size_t j = ev->memo[i].hash & (capacity - 1);
+        while (memo[j].proc) j = (j + 1) & (capacity - 1);
+        memo[j] = ev->memo[i];
+    }
+    ev->memo = memo;
+    ev->memo_capacity = capacity;
+}
+
+static void memo_insert(ConstEval *ev, uint32_t hash, ProcDecl *proc,
+                        const ConstValue *args, size_t count, const ConstValue *result) {
+    if ((ev->memo_count + 1) * 10 > ev->memo_capacity * 7) {
+        memo_grow(ev);
+    }
+    size_t mask = ev->memo_capacity - 1;
+    size_t i = hash & mask;
+    while (ev->memo[i].proc) i = (i + 1) & mask;
+
+    ConstMemo *memo = &ev->memo[i];
+    memo->hash = hash;
+    memo->arg_count = (uint32_t)count;
+    memo->proc = proc;
+    memo->args = alloc_values(ev->arena, count);
+    memcpy(memo->args, args, count * sizeof(ConstValue));
+    memo->result = arena_calloc(ev->arena, 1, sizeof(ConstValue));
+    copy_value(ev->arena, memo->result, result);
+    ev->memo_count++;
+}
+
+static EvalStatus eval_call(ConstEval *ev, Expr *expr, ConstValue *out) {
+    Expr *callee = expr->call.callee;
+    Symbol *sym = callee->kind == EXPR_IDENT ? callee->ident.resolved : NULL;
+    if (!sym || sym->kind != SYM_PROC || !sym->decl || sym->decl->kind != DECL_PROC) {
+        return not_constant(ev, expr->span, "this call");
+    }
+
+    ProcDecl *proc = &sym->decl->proc;
+    if (vec_len(proc->generics) > 0 || !proc->body) {
+        char what[128];
+        snprintf(what, sizeof(what), "a call to %s procedure '%.*s'",
+            proc->body ? "generic" : "body-less",
+            (int)proc->name.len, proc->name.data);
+        return not_constant(ev, expr->span, what);
+    }
+
+    size_t count = vec_len(expr->call.args);
+    if (count != vec_len(proc->params)) return EVAL_ERROR;
+
+    ConstValue *args = alloc_values(&ev->scratch, count);
+    bool scalar = true;
+    for (size_t i = 0; i < count; i++) {
+        EvalStatus status = eval_expr(ev, expr->call.args[i], &args[i]);
+        if (status != EVAL_OK) return status;
+        scalar = scalar && is_scalar(&args[i]);
+    }
+
+    uint32_t hash = 0;
+    if (scalar) {
+        hash = hash_call(proc, args, count);
+        ConstMemo *memo = memo_find(ev, hash, proc, args, count);
+        if (memo) {
+            copy_value(&ev->scratch, out, memo->result);
+            return EVAL_OK;
+        }
+    }
+
+    if (ev->depth >= ev->limits.max_depth) {
+        char message[96];
+        snprintf(message, sizeof(message),
+            "compile-time evaluation exceeded %u nested calls", ev->limits.max_depth);
+        return fail(ev, E_CTE_4002, expr->span, message);
+    }
+    if (!ev->hooks.prepare_proc(ev->state, proc, expr->span)) {
+        return EVAL_ERROR;
+    }
+
+    ConstFrame *saved = ev->frame;
+    ev->frame = new_frame(ev, proc->local_count);
+    for (size_t i = 0; i < count; i++) {
+        Symbol *param = proc->params[i].resolved;
+        if (param) {
+            ConstValue *slot = frame_slot(ev, param->slot, true);
+            copy_value(&ev->scratch, slot, &args[i]);
+        }
+    }
+
+    ev->depth++;
+    EvalStatus status = eval_expr(ev, proc->body, out);
+    ev->depth--;
+    ev->frame = saved;
+
+    if (status == EVAL_RETURN) {
+        *out = ev->returned;
+        status = EVAL_OK;
+    }
+    if (status != EVAL_OK) return EVAL_ERROR;
+
+    if (scalar) {
+        memo_insert(ev, hash, proc, args, count, out);
+    }
+    return EVAL_OK;
+}
+
+/*
+ * ============================================
+ * Expressions
+ * ============================================
+ */
+
+static EvalStatus eval_int_literal(ConstEval *ev, Expr *expr, bool negate, ConstValue *out) {
+    Type *type = expr_type(ev, expr);
+    unsigned width;
+    bool is_signed;
+    if (!type) return EVAL_ERROR;
+
+    uint64_t value = expr->int_lit.value;
+    if (is_float_type(type)) {
+        out->kind = CONST_FLOAT;
+        out->type = type;
+        out->f = float_round(type, negate ? -(double)value : (double)value);
+        return EVAL_OK;
+    }
+    if (!int_info(type, &width, &is_signed)) {
+        return not_constant(ev, expr->span, "this literal");
+    }
+
+    /* The most negative value is only reachable through negation */
+    uint64_t limit = is_signed ? (UINT64_C(1) << (width - 1)) - (negate ? 0 : 1)
+                               : (negate ? 0 : (width >= 64 ? UINT64_MAX
+                                                             : (UINT64_C(1) << width) - 1));
+    if (value > limit) {
+        return overflow(ev, expr->span, type);
+    }
+    set_int(out, type, negate ? (uint64_t)0 - value : value);
+    return EVAL_OK;
+}
+
+static EvalStatus eval_unary(ConstEval *ev, Expr *expr, ConstValue *out) {
+    Expr *operand = expr->unary.operand;
+    if (expr->unary.op == UNOP_NEG && operand->kind == EXPR_INT_LIT) {
+        return eval_int_literal(ev, operand, true, out);
+    }
+
+    ConstValue value;
+    EvalStatus status = eval_expr(ev, operand, &value);
+    if (status != EVAL_OK) return status;
+
+    switch (expr->unary.op) {
+        case UNOP_NEG:
+            if (value.kind == CONST_FLOAT) {
+                value.f = -value.f;
+                *out = value;
+                return EVAL_OK;
+            }
+            if (value.kind == CONST_INT) {
+                return int_binary(ev, BINOP_SUB, value.type, 0, value.bits, expr->span, out);
+            }
+            break;
+
+        case UNOP_NOT:
+            if (value.kind == CONST_BOOL) {
+                set_bool(ev, out, !value.b);
+                return EVAL_OK;
+            }
+            break;
+
+        case UNOP_BIT_NOT: {
+            unsigned width;
+            bool is_signed;
+            if (value.kind == CONST_INT && int_info(value.type, &width, &is_signed)) {
+                set_int(out, value.type, int_normalize(~value.bits, width, is_signed));
+                return EVAL_OK;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+    return not_constant(ev, expr->span, "this operation");
+}
+
+static bool is_compound_assign(BinaryOp op) {
+    return op >= BINOP_ADD_ASSIGN && op <= BINOP_SHR_ASSIGN;
+}
+
+/* The arithmetic operator of a compound assignment */
+static BinaryOp compound_op(BinaryOp op) {
+    switch (op) {
+        case BINOP_ADD_ASSIGN:     return BINOP_ADD;
+        case BINOP_SUB_ASSIGN:     return BINOP_SUB;
+        case BINOP_MUL_ASSIGN:     return BINOP_MUL;
+        case BINOP_DIV_ASSIGN:     return BINOP_DIV;
+        case BINOP_MOD_ASSIGN:     return BINOP_MOD;
+        case BINOP_BIT_AND_ASSIGN: return BINOP_BIT_AND;
+        case BINOP_BIT_OR_ASSIGN:  return BINOP_BIT_OR;
+        case BINOP_BIT_XOR_ASSIGN: return BINOP_BIT_XOR;
+        case BINOP_SHL_ASSIGN:     return BINOP_SHL;
+        default:                   return BINOP_SHR;
+    }
+}
+
+/* Apply an arithmetic, bitwise or comparison operator to two values */
+static EvalStatus apply_binary(ConstEval *ev, BinaryOp op, ConstValue *left,
+                               ConstValue *right, SourceSpan span, ConstValue *out) {
+    if (op >= BINOP_EQ && op <= BINOP_GE) {
+        if (op == BINOP_EQ || op == BINOP_NE) {
+            set_bool(ev, out, values_equal(left, right) == (op == BINOP_EQ));
+            return EVAL_OK;
+        }
+        int order;
+        if (left->kind != right->kind || !compare(left, right, &order)) {
+            set_bool(ev, out, false);
+            return left->kind == CONST_FLOAT ? EVAL_OK : not_constant(ev, span, "this comparison");
+        }
+        bool result = op == BINOP_LT ? order < 0 :
+                      op == BINOP_LE ? order <= 0 :
+                      op == BINOP_GT ? order > 0 : order >= 0;
+        set_bool(ev, out, result);
+        return EVAL_OK;
+    }
+
+    if (left->kind == CONST_INT && right->kind == CONST_INT) {
+        return int_binary(ev, op, left->type, left->bits, right->bits, span, out);
+    }
+    if (left->kind == CONST_FLOAT && right->kind == CONST_FLOAT) {
+        return float_binary(ev, op, left->type, left->f, right->f, span, out);
+    }
+    if (left->kind == CONST_BOOL && right->kind == CONST_BOOL &&
+        (op == BINOP_BIT_AND || op == BINOP_BIT_OR || op == BINOP_BIT_XOR)) {
+        bool r = op == BINOP_BIT_AND ? (left->b && right->b) :
+                 op == BINOP_BIT_OR ? (left->b || right->b) : (left->b != right->b);
+        set_bool(ev, out, r);
+        return EVAL_OK;
+    }
+    return not_constant(ev, span, "this operation");
+}
+
+static EvalStatus eval_assign(ConstEval *ev, BinaryOp op, Expr *target, Expr *value_expr,
+                              SourceSpan span) {
+    ConstValue value;
+    EvalStatus status = eval_expr(ev, value_expr, &value);
+    if (status != EVAL_OK) return status;
+
+    ConstValue *place;
+    status = eval_place(ev, target, &place);
+    if (status != EVAL_OK) return status;
+
+    if (op == BINOP_ASSIGN) {
+        *place = value;
+        return EVAL_OK;
+    }
+    return apply_binary(ev, compound_op(op), place, &value, span, place);
+}
+
+static EvalStatus eval_binary(ConstEval *ev, Expr *expr, ConstValue *out) {
+    BinaryOp op = expr->binary.op;
+
+    if (op == BINOP_ASSIGN || is_compound_assign(op)) {
+        EvalStatus status = eval_assign(ev, op, expr->binary.left, expr->binary.right,
+                                        expr->span);
+        set_unit(ev, out);
+        return status;
+    }
+
+    ConstValue left;
+    EvalStatus status = eval_expr(ev, expr->binary.left, &left);
+    if (status != EVAL_OK) return status;
+
+    /* Short-circuit */
+    if ((op == BINOP_AND || op == BINOP_OR) && left.kind == CONST_BOOL) {
+        if (left.b == (op == BINOP_OR)) {
+            set_bool(ev, out, left.b);
+            return EVAL_OK;
+        }
+        return eval_expr(ev, expr->binary.right, out);
+    }
+
+    ConstValue right;
+    status = eval_expr(ev, expr->binary.right, &right);
+    if (status != EVAL_OK) return status;
+    return apply_binary(ev, op, &left, &right, expr->span, out);
+}
+
+static EvalStatus eval_cast(ConstEval *ev, Expr *expr, ConstValue *out) {
+    ConstValue value;
+    EvalStatus status = eval_expr(ev, expr->cast.operand, &value);
+    if (status != EVAL_OK) return status;
+
+    Type *target = expr_type(ev, expr);
+    if (!target) return EVAL_ERROR;
+    if (target == value.type) {
+        *out = value;
+        return EVAL_OK;
+    }
+
+    unsigned width;
+    bool is_signed;
+    if (int_info(target, &width, &is_signed)) {
+        switch (value.kind) {
+            case CONST_INT:
+                /* Wraps like the runtime conversion */
+                set_int(out, target, int_normalize(value.bits, width, is_signed));
+                return EVAL_OK;
+            case CONST_BOOL:
+                set_int(out, target, value.b);
+                return EVAL_OK;
+            case CONST_CHAR:
+                set_int(out, target, int_normalize(value.ch, width, is_signed));
+                return EVAL_OK;
+            case CONST_FLOAT: {
+                double f = value.f;
+                bool in_range = is_signed ? (f >= -0x1p63 && f < 0x1p63)
+                                          : (f > -1.0 && f < 0x1p64);
+                if (!in_range) {
+                    return fail(ev, E_CTE_4003, expr->span,
+                        "float to integer conversion out of range in compile-time evaluation");
+                }
+                uint64_t bits = is_signed ? (uint64_t)(int64_t)f : (uint64_t)f;
+                if (int_normalize(bits, width, is_signed) != bits) {
+                    return fail(ev, E_CTE_4003, expr->span,
+                        "float to integer conversion out of range in compile-time evaluation");
+                }
+                set_int(out, target, bits);
+                return EVAL_OK;
+            }
+            default:
+                break;
+        }
+    } else if (is_float_type(target)) {
+        if (value.kind == CONST_INT || value.kind == CONST_FLOAT) {
+            unsigned from_width;
+            bool from_signed = false;
+            int_info(value.type, &from_width, &from_signed);
+            double f = value.kind == CONST_FLOAT ? value.f
+                     : from_signed ? (double)(int64_t)value.bits : (double)value.bits;
+            out->kind = CONST_FLOAT;
+            out->type = target;
+            out->f = float_round(target, f);
+            return EVAL_OK;
+        }
+    } else if (target->kind == TYPE_PRIM_CHAR && value.kind == CONST_INT) {
+        if (value.bits > 0x10FFFF || (value.bits >= 0xD800 && value.bits <= 0xDFFF)) {
+            return fail(ev, E_CTE_4003, expr->span,
+                "integer is not a valid char in compile-time evaluation");
+        }
+        out->kind = CONST_CHAR;
+        out->type = target;
+        out->ch = (uint32_t)value.bits;
+        return EVAL_OK;
+    }
+    return not_constant(ev, expr->span, "this conversion");
+}
+
+/* Does a break or continue with the pending label target this loop? */
+static bool targets_loop(ConstEval *ev, Expr *loop) {
+    if (!ev->break_label.data) return true;
+    return loop->loop.label.data && interned_eq(loop->loop.label, ev->break_label);
+}
+
+/*
+ * Run one iteration's body. Returns EVAL_OK to go on, EVAL_BREAK (with
+ * the label consumed) to leave this loop, anything else to propagate.
+ */
+static EvalStatus eval_loop_body(ConstEval *ev, Expr *expr) {
+    ConstValue ignored;
+    EvalStatus status = eval_expr(ev, expr->loop.body, &ignored);
+    if ((status == EVAL_BREAK || status == EVAL_CONTINUE) && targets_loop(ev, expr)) {
+        ev->break_label = (InternedString){0};
+        return status == EVAL_BREAK ? EVAL_BREAK : EVAL_OK;
+    }
+    return status;
+}
+
+static EvalStatus finish_loop(ConstEval *ev, EvalStatus status, ConstValue *out) {
+    if (status == EVAL_BREAK) status = EVAL_OK;
+    if (status == EVAL_OK) set_unit(ev, out);
+    return status;
+}
+
+static EvalStatus eval_loop(ConstEval *ev, Expr *expr, ConstValue *out) {
+    EvalStatus status = EVAL_OK;
+
+    if (expr->loop.binding && expr->loop.iterable) {
+        Expr *iterable = expr->loop.iterable;
+
+        if (iterable->kind == EXPR_RANGE) {
+            ConstValue lo, hi;
+            if (!iterable->range.start || !iterable->range.end) {
+                return not_constant(ev, iterable->span, "an unbounded range");
+            }
+            status = eval_expr(ev, iterable->range.start, &lo);
+            if (status != EVAL_OK) return status;
+            status = eval_expr(ev, iterable->range.end, &hi);
+            if (status != EVAL_OK) return status;
+
+            unsigned width;
+            bool is_signed;
+            if (lo.kind != CONST_INT || !int_info(lo.type, &width, &is_signed)) {
+                return not_constant(ev, iterable->span, "this range");
+            }
+
+            uint64_t i = lo.bits;
+            while (int_less(is_signed, i, hi.bits) ||
+                   (iterable->range.inclusive && i == hi.bits)) {
+                status = step(ev, expr->span);
+                if (status != EVAL_OK) return status;
+
+                ConstValue value;
+                bool matched;
+                set_int(&value, lo.type, i);
+                status = match_pattern(ev, expr->loop.binding, &value, &matched);
+                if (status != EVAL_OK) return status;
+
+                status = eval_loop_body(ev, expr);
+                if (status != EVAL_OK || i == hi.bits) break;
+                i++;
+            }
+            return finish_loop(ev, status, out);
+        }
+
+        ConstValue items;
+        status = eval_expr(ev, iterable, &items);
+        if (status != EVAL_OK) return status;
+        if (items.kind != CONST_AGGREGATE) {
+            return not_constant(ev, iterable->span, "this iteration");
+        }
+        for (size_t i = 0; i < items.aggregate.count; i++) {
+            status = step(ev, expr->span);
+            if (status != EVAL_OK) return status;
+
+            bool matched;
+            status = match_pattern(ev, expr->loop.binding, &items.aggregate.elements[i],
+                                   &matched);
+            if (status != EVAL_OK) return status;
+
+            status = eval_loop_body(ev, expr);
+            if (status != EVAL_OK) break;
+        }
+        return finish_loop(ev, status, out);
+    }
+
+    for (;;) {
+        status = step(ev, expr->span);
+        if (status != EVAL_OK) return status;
+
+        if (expr->loop.condition) {
+            ConstValue cond;
+            status = eval_expr(ev, expr->loop.condition, &cond);
+            if (status != EVAL_OK) return status;
+            if (cond.kind != CONST_BOOL || !cond.b) break;
+        }
+
+        status = eval_loop_body(ev, expr);
+        if (status != EVAL_OK) break;
+    }
+    return finish_loop(ev, status, out);
+}
+
+static EvalStatus eval_match(ConstEval *ev, Expr *expr, ConstValue *out) {
+    ConstValue scrutinee;
+    EvalStatus status = eval_expr(ev, expr->match.scrutinee, &scrutinee);
+    if (status != EVAL_OK) return status;
+
+    for (size_t i = 0; i < vec_len(expr->match.arms_patterns); i++) {
+        bool matched;
+        status = match_pattern(ev, expr->match.arms_patterns[i], &scrutinee, &matched);
+        if (status != EVAL_OK) return status;
+        if (matched) {
+            return eval_expr(ev, expr->match.arms_bodies[i], out);
+        }
+    }
+    return fail(ev, E_CTE_4003, expr->span,
+        "no match arm matches the value in compile-time evaluation");
+}
+
+static EvalStatus eval_aggregate(ConstEval *ev, Type *type, Vec(Expr *) elements,
+                                 ConstValue *out) {
+    size_t count = vec_len(elements);
+    out->kind = CONST_AGGREGATE;
+    out->type = type;
+    out->aggregate.count = count;
+    out->aggregate.elements = alloc_values(&ev->scratch, count);
+    for (size_t i = 0; i < count; i++) {
+        EvalStatus status = eval_expr(ev, elements[i], &out->aggregate.elements[i]);
+        if (status != EVAL_OK) return status;
+    }
+    return EVAL_OK;
+}
+
+static EvalStatus eval_array(ConstEval *ev, Expr *expr, ConstValue *out) {
+    Type *type = expr_type(ev, expr);
+    if (!type) return EVAL_ERROR;
+    if (!expr->array.repeat_value) {
+        return eval_aggregate(ev, type, expr->array.elements, out);
+    }
+
+    ConstValue value, count;
+    EvalStatus status = eval_expr(ev, expr->array.repeat_value, &value);
+    if (status != EVAL_OK) return status;
+    status = eval_expr(ev, expr->array.repeat_count, &count);
+    if (status != EVAL_OK) return status;
+    if (count.kind != CONST_INT) {
+        return not_constant(ev, expr->array.repeat_count->span, "this count");
+    }
+
+    /* Each element counts as a step, so a huge count hits the limits, not malloc */
+    if (count.bits > ev->limits.max_steps - ev->steps) {
+        ev->steps = ev->limits.max_steps;
+        return step(ev, expr->span);
+    }
+    ev->steps += count.bits;
+    size_t n = (size_t)count.bits;
+    if (n > ev->limits.max_bytes / sizeof(ConstValue)) {
+        return step(ev, expr->span);
+    }
+
+    out->kind = CONST_AGGREGATE;
+    out->type = type;
+    out->aggregate.count = n;
+    out->aggregate.elements = alloc_values(&ev->scratch, n);
+    for (size_t i = 0; i < n; i++) {
+        copy_value(&ev->scratch, &out->aggregate.elements[i], &value);
+    }
+    return step(ev, expr->span);
+}
+
+static EvalStatus eval_record(ConstEval *ev, Expr *expr, ConstValue *out) {
+    Type *type = expr_type(ev, expr);
+    if (!type) return EVAL_ERROR;
+    Type *base = type->kind == TYPE_GENERIC_INST ? type->generic_inst.base : type;
+    if (base->kind != TYPE_RECORD || !base->nominal.sym || !base->nominal.sym->decl) {
+        return not_constant(ev, expr->span, "this record");
+    }
+
+    RecordDecl *record = &base->nominal.sym->decl->record;
+    MemberTable *members = decl_members(base->nominal.sym->decl);
+    size_t count = vec_len(record->fields);
+
+    out->kind = CONST_AGGREGATE;
+    out->type = type;
+    out->aggregate.count = count;
+    out->aggregate.elements = alloc_values(&ev->scratch, count);
+
+    for (size_t i = 0; i < vec_len(expr->record.field_names); i++) {
+        Member *field = member_field(members, expr->record.field_names[i]);
+        if (!field || field->index >= count) return EVAL_ERROR;
+        EvalStatus status = eval_expr(ev, expr->record.field_values[i],
+                                      &out->aggregate.elements[field->index]);
+        if (status != EVAL_OK) return status;
+    }
+
+    /* Fields left out take their defaults */
+    for (size_t i = 0; i < count; i++) {
+        Member *field = member_field(members, record->fields[i].name);
+        if (!field || out->aggregate.elements[field->index].type) continue;
+        if (!record->fields[i].default_value) {
+            return not_constant(ev, expr->span, "a record with missing fields");
+        }
+        EvalStatus status = eval_expr(ev, record->fields[i].default_value,
+                                      &out->aggregate.elements[field->index]);
+        if (status != EVAL_OK) return status;
+    }
+    return EVAL_OK;
+}
+
+static EvalStatus eval_block(ConstEval *ev, Expr *expr, ConstValue *out) {
+    for (size_t i = 0; i < vec_len(expr->block.stmts); i++) {
+        EvalStatus status = eval_stmt(ev, expr->block.stmts[i]);
+        if (status != EVAL_OK) return status;
+    }
+    if (expr->block.result) {
+        return eval_expr(ev, expr->block.result, out);
+    }
+    set_unit(ev, out);
+    return EVAL_OK;
+}
+
+static EvalStatus eval_expr(ConstEval *ev, Expr *expr, ConstValue *out) {
+    EvalStatus status = step(ev, expr->span);
+    if (status != EVAL_OK) return status;
+
+    switch (expr->kind) {
+        case EXPR_INT_LIT:
+            return eval_int_literal(ev, expr, false, out);
+
+        case EXPR_FLOAT_LIT: {
+            Type *type = expr_type(ev, expr);
+            if (!type) return EVAL_ERROR;
+            out->kind = CONST_FLOAT;
+            out->type = type;
+            out->f = float_round(type, expr->float_lit.value);
+            return EVAL_OK;
+        }
+
+        case EXPR_BOOL_LIT:
+            set_bool(ev, out, expr->bool_lit.value);
+            return EVAL_OK;
+
+        case EXPR_CHAR_LIT:
+            out->kind = CONST_CHAR;
+            out->type = ev->types->type_char;
+            out->ch = expr->char_lit.value;
+            return EVAL_OK;
+
+        case EXPR_STRING_LIT:
+            out->kind = CONST_STRING;
+            out->type = ev->types->type_string;
+            out->str = expr->string_lit.value;
+            return EVAL_OK;
+
+        case EXPR_IDENT:
+        case EXPR_INDEX:
+        case EXPR_FIELD: {
+            /* Reads copy, so the value stays independent of later writes */
+            if (is_place(expr)) {
+                ConstValue *place;
+                status = eval_place(ev, expr, &place);
+                if (status != EVAL_OK) return status;
+                copy_value(&ev->scratch, out, place);
+                return EVAL_OK;
+            }
+            if (expr->kind == EXPR_IDENT) {
+                return not_constant(ev, expr->span, "this name");
+            }
+
+            ConstValue object;
+            Expr *object_expr = expr->kind == EXPR_INDEX ? expr->index.object
+                                                         : expr->field.object;
+            status = eval_expr(ev, object_expr, &object);
+            if (status != EVAL_OK) return status;
+            if (object.kind != CONST_AGGREGATE) {
+                return not_constant(ev, expr->span, "this access");
+            }
+
+            size_t i;
+            if (expr->kind == EXPR_INDEX) {
+                ConstValue index;
+                status = eval_expr(ev, expr->index.index, &index);
+                if (status != EVAL_OK) return status;
+                status = bounds_check(ev, expr->index.index->span, &index,
+                                      object.aggregate.count, &i);
+                if (status != EVAL_OK) return status;
+            } else if (!field_index(object.type, expr->field.field, &i) ||
+                       i >= object.aggregate.count) {
+                return not_constant(ev, expr->span, "this field");
+            }
+            *out = object.aggregate.elements[i];
+            return EVAL_OK;
+        }
+
+        case EXPR_BINARY:
+            return eval_binary(ev, expr, out);
+
+        case EXPR_UNARY:
+            return eval_unary(ev, expr, out);
+
+        case EXPR_CALL:
+            return eval_call(ev, expr, out);
+
+        case EXPR_TUPLE: {
+            Type *type = expr_type(ev, expr);
+            if (!type) return EVAL_ERROR;
+            return eval_aggregate(ev, type, expr->tuple.elements, out);
+        }
+
+        case EXPR_ARRAY:
+            return eval_array(ev, expr, out);
+
+        case EXPR_RECORD:
+            return eval_record(ev, expr, out);
+
+        case EXPR_IF: {
+            ConstValue cond;
+            status = eval_expr(ev, expr->if_.condition, &cond);
+            if (status != EVAL_OK) return status;
+            if (cond.kind != CONST_BOOL) return EVAL_ERROR;
+            if (cond.b) return eval_expr(ev, expr->if_.then_branch, out);
+            if (expr->if_.else_branch) return eval_expr(ev, expr->if_.else_branch, out);
+            set_unit(ev, out);
+            return EVAL_OK;
+        }
+
+        case EXPR_MATCH:
+            return eval_match(ev, expr, out);
+
+        case EXPR_BLOCK:
+            return eval_block(ev, expr, out);
+
+        case EXPR_LOOP:
+            return eval_loop(ev, expr, out);
+
+        case EXPR_MOVE:
+            return eval_expr(ev, expr->move.operand, out);
+
+        case EXPR_CAST:
+            return eval_cast(ev, expr, out);
+
+        case EXPR_COMPTIME:
+            /* Already evaluated when the enclosing procedure was checked */
+            if (expr->comptime.value) {
+                copy_value(&ev->scratch, out, expr->comptime.value);
+                return EVAL_OK;
+            }
+            return eval_expr(ev, expr->comptime.operand, out);
+
+        case EXPR_METHOD_CALL:
+        case EXPR_STATIC_CALL:
+            return not_constant(ev, expr->span, "a method call");
+
+        case EXPR_PATH:
+        case EXPR_WIDEN:
+        case EXPR_RANGE:
+        case EXPR_REGION_ALLOC:
+        case EXPR_ADDR_OF:
+        case EXPR_DEREF:
+        case EXPR_CLOSURE:
+            break;
+    }
+    return not_constant(ev, expr->span, "this expression");
+}
+
+/*
+ * ============================================
+ * Statements
+ * ============================================
+ */
+
+static EvalStatus eval_stmt(ConstEval *ev, Stmt *stmt) {
+    switch (stmt->kind) {
+        case STMT_EXPR: {
+            ConstValue ignored;
+            return eval_expr(ev, stmt->expr.expr, &ignored);
+        }
+
+        case STMT_LET:
+        case STMT_VAR: {
+            Pattern *pat = stmt->kind == STMT_LET ? stmt->let.pattern : stmt->var.pattern;
+            Expr *init = stmt->kind == STMT_LET ? stmt->let.init : stmt->var.init;
+            if (!init) {
+                return not_constant(ev, stmt->span, "an uninitialized binding");
+            }
+
+            ConstValue value;
+            EvalStatus status = eval_expr(ev, init, &value);
+            if (status != EVAL_OK) return status;
+
+            bool matched;
+            status = match_pattern(ev, pat, &value, &matched);
+            if (status == EVAL_OK && !matched) {
+                return fail(ev, E_CTE_4003, stmt->span,
+                    "binding pattern does not match in compile-time evaluation");
+            }
+            return status;
+        }
+
+        case STMT_ASSIGN:
+            return eval_assign(ev, BINOP_ASSIGN, stmt->assign.target, stmt->assign.value,
+                               stmt->span);
+
+        case STMT_RETURN:
+        case STMT_RESULT: {
+            Expr *value = stmt->kind == STMT_RETURN ? stmt->return_.value : stmt->result.value;
+            ConstValue returned;
+            set_unit(ev, &returned);
+            if (value) {
+                EvalStatus status = eval_expr(ev, value, &returned);
+                if (status != EVAL_OK) return status;
+            }
+            ev->returned = returned;
+            return EVAL_RETURN;
+        }
+
+        case STMT_BREAK:
+            if (stmt->break_.value) {
+                ConstValue ignored;
+                EvalStatus status = eval_expr(ev, stmt->break_.value, &ignored);
+                if (status != EVAL_OK) return status;
+            }
+            ev->break_label = stmt->break_.label;
+            return EVAL_BREAK;
+
+        case STMT_CONTINUE:
+            ev->break_label = stmt->continue_.label;
+            return EVAL_CONTINUE;
+
+        case STMT_UNSAFE: {
+            ConstValue ignored;
+            return eval_expr(ev, stmt->unsafe.body, &ignored);
+        }
+
+        case STMT_DEFER:
+            break;
+    }
+    return not_constant(ev, stmt->span, "this statement");
+}
+
+/*
+ * ============================================
+ * Entry points
+ * ============================================
+ */
+
+ConstValue *const_eval(ConstEval *ev, Expr *expr, void *state) {
+    if (ptr_map_contains(&ev->results, expr)) {
+        return ptr_map_get(&ev->results, expr);
+    }
+
+    /* A hook may start an evaluation while another is in progress */
+    void *saved_state = ev->state;
+    ConstFrame *saved_frame = ev->frame;
+    uint64_t saved_steps = ev->steps;
+    uint32_t saved_depth = ev->depth;
+    InternedString saved_label = ev->break_label;
+
+    ev->state = state;
+    ev->frame = new_frame(ev, 0);
+    ev->steps = 0;
+    ev->depth = 0;
+    ev->break_label = (InternedString){0};
+    ev->nesting++;
+
+    ConstValue value;
+    memset(&value, 0, sizeof(value));
+    EvalStatus status = eval_expr(ev, expr, &value);
+    if (status == EVAL_BREAK || status == EVAL_CONTINUE || status == EVAL_RETURN) {
+        status = not_constant(ev, expr->span, "control flow leaving the expression");
+    }
+
+    ConstValue *result = NULL;
+    if (status == EVAL_OK) {
+        result = arena_calloc(ev->arena, 1, sizeof(ConstValue));
+        copy_value(ev->arena, result, &value);
+    }
+    ptr_map_set(&ev->results, expr, result);
+
+    ev->nesting--;
+    ev->state = saved_state;
+    ev->frame = saved_frame;
+    ev->steps = saved_steps;
+    ev->depth = saved_depth;
+    ev->break_label = saved_label;
+    if (ev->nesting == 0) {
+        arena_reset(&ev->scratch);
+    }
+    return result;
+}
+
+bool const_eval_size(ConstEval *ev, Expr *expr, void *state, size_t *out) {
+    ConstValue *value = const_eval(ev, expr, state);
+    if (!value) return false;
+
+    unsigned width;
+    bool is_signed;
+    if (value->kind != CONST_INT || !int_info(value->type, &width, &is_signed)) {
+        diag_report(ev->diag, DIAG_ERROR, E_CTE_4001, expr->span,
+            "size must be an integer");
+        return false;
+    }
+    if ((is_signed && (int64_t)value->bits < 0) || value->bits > SIZE_MAX) {
+        diag_report(ev->diag, DIAG_ERROR, E_CTE_4003, expr->span,
+            "size %lld is out of range", (long long)value->bits);
+        return false;
+    }
+    *out = (size_t)value->bits;
+    return true;
+}
+
+bool const_eval_int(ConstEval *ev, Expr *expr, void *state, int64_t *out) {
+    ConstValue *value = const_eval(ev, expr, state);
+    if (!value) return false;
+
+    unsigned width;
+    bool is_signed;
+    if (value->kind != CONST_INT || !int_info(value->type, &width, &is_signed)) {
+        diag_report(ev->diag, DIAG_ERROR, E_CTE_4001, expr->span,
+            "expected an integer constant");
+        return false;
+    }
+    if (!is_signed && value->bits > INT64_MAX) {
+        diag_report(ev->diag, DIAG_ERROR, E_CTE_4003, expr->span,
+            "integer constant %llu is out of range",
+            (unsigned long long)value->bits);
+        return false;
+    }
+    *out = (int64_t)value->bits;
+    return true;
+}
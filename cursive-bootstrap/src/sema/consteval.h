@@ -0,0 +1,123 @@
+/*
+ * Cursive Bootstrap Compiler - Compile-Time Evaluation
+ *
+ * An interpreter over the typed AST for the values the compiler needs
+ * before code generation: array sizes and repeat counts, enum
+ * discriminants, and `comptime` expressions. It runs the same subset of
+ * the language a procedure body uses for scalar work (arithmetic,
+ * bindings, `if`, `match`, loops, tuples, arrays, records and calls to
+ * other procedures), with checked arithmetic: an overflow, a division by
+ * zero or an out-of-bounds index at compile time is an error rather than
+ * a runtime trap.
+ *
+ * Intermediate values live in a scratch arena that is reset after each
+ * outermost evaluation; results are copied to the persistent arena. A
+ * call whose arguments are all scalars is memoized per procedure, so a
+ * table built from repeated calls, or the same size expression spelled
+ * in several types, evaluates each distinct call once. Steps, call depth
+ * and scratch memory are bounded, so a runaway evaluation reports an
+ * error instead of hanging the compiler.
+ */
+
+#ifndef CURSIVE_SEMA_CONSTEVAL_H
+#define CURSIVE_SEMA_CONSTEVAL_H
+
+#include "scope.h"
+#include "types.h"
+#include "common/map.h"
+#include "common/error.h"
+
+typedef enum ConstKind {
+    CONST_UNIT,
+    CONST_BOOL,
+    CONST_INT,
+    CONST_FLOAT,
+    CONST_CHAR,
+    CONST_STRING,
+    CONST_AGGREGATE        /* Tuple, array or record; records in field order */
+} ConstKind;
+
+typedef struct ConstValue ConstValue;
+struct ConstValue {
+    ConstKind kind;
+    Type *type;            /* NULL for an unbound local slot */
+
+    union {
+        bool b;
+        uint64_t bits;     /* CONST_INT: two's complement, extended by the type's signedness */
+        double f;
+        uint32_t ch;
+        InternedString str;
+        struct {
+            ConstValue *elements;
+            size_t count;
+        } aggregate;
+    };
+};
+
+typedef struct ConstLimits {
+    uint64_t max_steps;    /* Expressions evaluated per outermost evaluation */
+    size_t max_bytes;      /* Scratch memory per outermost evaluation */
+    uint32_t max_depth;    /* Nested calls */
+} ConstLimits;
+
+/*
+ * Services of the type checker. `prepare_proc` makes sure a callee has
+ * been type checked (its expression types solved) and returns false if
+ * it cannot be, after reporting why. `expr_type` gives an expression's
+ * solved type.
+ */
+typedef struct ConstHooks {
+    bool (*prepare_proc)(void *state, ProcDecl *proc, SourceSpan use);
+    Type *(*expr_type)(void *state, Expr *expr);
+} ConstHooks;
+
+typedef struct ConstFrame ConstFrame;
+typedef struct ConstMemo ConstMemo;
+
+typedef struct ConstEval {
+    Arena *arena;          /* Results and memoized calls */
+    Arena scratch;         /* Values of the evaluation in progress */
+    DiagContext *diag;
+    TypeContext *types;
+    ConstHooks hooks;
+    void *state;           /* Passed to the hooks */
+    ConstLimits limits;
+
+    /* Evaluation in progress */
+    uint32_t nesting;      /* Evaluations started from hooks of an outer one */
+    uint64_t steps;
+    uint32_t depth;
+    ConstFrame *frame;
+    InternedString break_label;    /* Target of the break or continue being unwound */
+    ConstValue returned;           /* Value of the `result` being unwound */
+
+    /* Call memo (open addressing, power-of-two capacity) */
+    ConstMemo *memo;
+    size_t memo_count;
+    size_t memo_capacity;
+
+    /* Results per expression, so a root is evaluated once */
+    PtrMap results;
+} ConstEval;
+
+void const_eval_init(ConstEval *ev, Arena *arena, DiagContext *diag,
+                     TypeContext *types, ConstHooks hooks);
+void const_eval_destroy(ConstEval *ev);
+
+/*
+ * Evaluate a type-checked expression. Returns NULL, after reporting an
+ * error, if the expression is not constant or its evaluation fails.
+ * Locals of the enclosing procedure are not constant. The result lives
+ * in the persistent arena and is shared by later evaluations of the same
+ * expression.
+ */
+ConstValue *const_eval(ConstEval *ev, Expr *expr, void *state);
+
+/* Evaluate a size or count: a non-negative integer that fits in size_t */
+bool const_eval_size(ConstEval *ev, Expr *expr, void *state, size_t *out);
+
+/* Evaluate a signed integer (enum discriminants) */
+bool const_eval_int(ConstEval *ev, Expr *expr, void *state, int64_t *out);
+
+#endif /* CURSIVE_SEMA_CONSTEVAL_H */
@@ -0,0 +1,127 @@
+/*
+ * Cursive Bootstrap Compiler - Dataflow Solver Implementation
+ */
+
+#include "dataflow.h"
+#include <string.h>
+
+/*
+ * Size a problem for the current graph
+ */
+void dataflow_reset(Dataflow *df, const Cfg *cfg, DataflowDirection direction,
+                    DataflowMeet meet, size_t bits) {
+    df->cfg = cfg;
+    df->direction = direction;
+    df->meet = meet;
+    df->bits = bits;
+    df->words = bitset_words(bits);
+    df->iterations = 0;
+
+    size_t set_words = (size_t)cfg->block_count * 4 * df->words + df->words;
+    size_t total = set_words + bitset_words(cfg->block_count);
+    if (total > df->capacity) {
+        free(df->storage);
+        df->storage = malloc(total * sizeof(BitWord));
+        if (!df->storage) {
+            CURSIVE_PANIC("Out of memory allocating dataflow sets");
+        }
+        df->capacity = total;
+    }
+
+    bitset_fill(df->storage, total, false);
+    df->boundary = df->storage + (size_t)cfg->block_count * 4 * df->words;
+    df->queued = df->storage + set_words;
+}
+
+/* Queue a block unless it is already waiting */
+static void enqueue(Dataflow *df, uint32_t block) {
+    if (!bitset_test(df->queued, block)) {
+        bitset_set(df->queued, block);
+        vec_push(df->worklist, block);
+    }
+}
+
+/* Combine the states flowing into a block from its neighbours */
+static void meet_into(Dataflow *df, BitWord *dst, const Vec(uint32_t) from, bool forward) {
+    bitset_fill(dst, df->words, df->meet == DATAFLOW_INTERSECT);
+    for (size_t i = 0; i < vec_len(from); i++) {
+        BitWord *src = forward ? dataflow_out(df, from[i]) : dataflow_in(df, from[i]);
+        if (df->meet == DATAFLOW_UNION) {
+            bitset_union(dst, src, df->words);
+        } else {
+            bitset_intersect(dst, src, df->words);
+        }
+    }
+}
+
+/*
+ * Solve to a fixpoint
+ */
+void dataflow_solve(Dataflow *df) {
+    const Cfg *cfg = df->cfg;
+    bool forward = df->direction == DATAFLOW_FORWARD;
+    size_t count = vec_len(cfg->rpo);
+
+    /* "Must" problems start from the top of the lattice */
+    if (df->meet == DATAFLOW_INTERSECT) {
+        for (uint32_t b = 0; b < cfg->block_count; b++) {
+            bitset_fill(dataflow_in(df, b), df->words, true);
+            bitset_fill(dataflow_out(df, b), df->words, true);
+        }
+    }
+
+    /* The worklist is a stack: push in reverse so the first pop follows
+     * reverse post-order (forward) or post-order (backward) */
+    vec_clear(df->worklist);
+    for (size_t i = 0; i < count; i++) {
+        enqueue(df, cfg->rpo[forward ? count - 1 - i : i]);
+    }
+
+    while (vec_len(df->worklist) > 0) {
+        uint32_t b = vec_last(df->worklist);
+        vec_pop(df->worklist);
+        bitset_clear(df->queued, b);
+        df->iterations++;
+
+        const CfgBlock *block = &cfg->blocks[b];
+        bool changed;
+        if (forward) {
+            BitWord *in = dataflow_in(df, b);
+            if (b == CFG_ENTRY) {
+                bitset_copy(in, df->boundary, df->words);
+            } else {
+                meet_into(df, in, block->preds, true);
+            }
+            changed = bitset_transfer(dataflow_out(df, b), in,
+                dataflow_gen(df, b), dataflow_kill(df, b), df->words);
+        } else {
+            BitWord *out = dataflow_out(df, b);
+            if (b == CFG_EXIT) {
+                bitset_copy(out, df->boundary, df->words);
+            } else {
+                meet_into(df, out, block->succs, false);
+            }
+            changed = bitset_transfer(dataflow_in(df, b), out,
+                dataflow_gen(df, b), dataflow_kill(df, b), df->words);
+        }
+
+        if (changed) {
+            const Vec(uint32_t) next = forward ? block->succs : block->preds;
+            for (size_t i = 0; i < vec_len(next); i++) {
+                if (cfg->blocks[next[i]].reachable) {
+                    enqueue(df, next[i]);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Release storage
+ */
+void dataflow_destroy(Dataflow *df) {
+    free(df->storage);
+    df->storage = NULL;
+    df->capacity = 0;
+    vec_free(df->worklist);
+}
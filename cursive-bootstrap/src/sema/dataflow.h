@@ -0,0 +1,80 @@
+/*
+ * Cursive Bootstrap Compiler - Dataflow Solver
+ *
+ * Worklist solver for gen/kill problems over a body's control-flow graph
+ * (cfg.h). Facts are dense bit sets; a problem supplies one gen and one
+ * kill set per block, and the solver iterates
+ *
+ *     out[b] = gen[b] | (in[b] & ~kill[b])
+ *
+ * (in and out swapped for backward problems) to a fixpoint, meeting
+ * predecessor states with union ("may") or intersection ("must").
+ * Blocks are visited in reverse post-order, so acyclic regions settle in
+ * one pass and loops only revisit the blocks whose inputs changed.
+ */
+
+#ifndef CURSIVE_SEMA_DATAFLOW_H
+#define CURSIVE_SEMA_DATAFLOW_H
+
+#include "common/bitset.h"
+#include "cfg.h"
+
+typedef enum DataflowDirection {
+    DATAFLOW_FORWARD,
+    DATAFLOW_BACKWARD
+} DataflowDirection;
+
+typedef enum DataflowMeet {
+    DATAFLOW_UNION,      /* Fact holds on some path */
+    DATAFLOW_INTERSECT   /* Fact holds on every path */
+} DataflowMeet;
+
+/*
+ * A gen/kill problem and its solution. Every per-block set is a slice of
+ * `words` words in one allocation, addressed with the accessors below.
+ */
+typedef struct Dataflow {
+    const Cfg *cfg;
+    DataflowDirection direction;
+    DataflowMeet meet;
+    size_t bits;             /* Facts per block */
+    size_t words;            /* Words per set (bitset_words(bits)) */
+
+    BitWord *storage;        /* gen, kill, in, out per block; boundary; queued */
+    size_t capacity;         /* Words the storage has room for */
+    BitWord *boundary;       /* State at the entry (forward) or exit (backward) */
+
+    Vec(uint32_t) worklist;
+    BitWord *queued;         /* One bit per block: on the worklist */
+    size_t iterations;       /* Block visits of the last solve */
+} Dataflow;
+
+/* Size a problem for the current graph; gen, kill and boundary start empty */
+void dataflow_reset(Dataflow *df, const Cfg *cfg, DataflowDirection direction,
+                    DataflowMeet meet, size_t bits);
+
+/* Solve to a fixpoint */
+void dataflow_solve(Dataflow *df);
+
+/* Release storage */
+void dataflow_destroy(Dataflow *df);
+
+static inline BitWord *dataflow_gen(Dataflow *df, uint32_t block) {
+    return df->storage + ((size_t)block * 4 + 0) * df->words;
+}
+
+static inline BitWord *dataflow_kill(Dataflow *df, uint32_t block) {
+    return df->storage + ((size_t)block * 4 + 1) * df->words;
+}
+
+/* State on entry to a block (in program order, for either direction) */
+static inline BitWord *dataflow_in(Dataflow *df, uint32_t block) {
+    return df->storage + ((size_t)block * 4 + 2) * df->words;
+}
+
+/* State on exit from a block (in program order, for either direction) */
+static inline BitWord *dataflow_out(Dataflow *df, uint32_t block) {
+    return df->storage + ((size_t)block * 4 + 3) * df->words;
+}
+
+#endif /* CURSIVE_SEMA_DATAFLOW_H */
@@ -0,0 +1,519 @@
+/*
+ * Cursive Bootstrap Compiler - Drop Elaboration
+ *
+ * Decides what runs where control leaves a scope: deferred blocks, and
+ * the drops of the bindings the scope owns. Each exit gets its list of
+ * cleanups (Cleanup, ast.h) innermost first:
+ *
+ * - A block's fallthrough runs the block's own cleanups after its result
+ *   (Expr.block.cleanups); the procedure body also drops `move` params.
+ * - A match arm's fallthrough drops the bindings of its pattern after its
+ *   body (Expr.match.arms_cleanups).
+ * - `return` and `result` run every open scope's cleanups, `break` and
+ *   `continue` those of the scopes inside the loop (Stmt.cleanups).
+ * - Assigning to a binding drops the value it held (Stmt.cleanups).
+ *
+ * Only bindings whose type needs drop glue (type_needs_drop) are listed,
+ * so Copy and glue-free types cost nothing. Whether a listed binding
+ * still owns a value at an exit is a forward "may" dataflow problem over
+ * the body's control-flow graph (cfg.h, dataflow.h) with a may-be-init
+ * and a may-be-uninit bit per slot: a move or declaration sets the
+ * second, an initialization or assignment the first. A drop reached only
+ * by initialized paths is unconditional; one reached only by moved or
+ * uninitialized paths is elided; only a drop reached by both keeps the
+ * binding's drop flag (Symbol.drop_flag) live at run time.
+ *
+ * Identifiers whose value is moved out are marked (Expr.ident.is_move) so
+ * code generation can clear the drop flag there. Moving a field out counts
+ * as moving the whole binding: its other fields are not dropped. Bindings
+ * of or-patterns, of `loop x in ...` and of destructuring `let`/`var` are
+ * not dropped yet (code generation binds none of the last two).
+ *
+ * The pass is split in two around the CFG builder: the scope pass runs
+ * before the builder in each callback, so an exit sees the builder's
+ * position before the jump closes the block, and the solve pass runs
+ * after the builder has completed the graph.
+ */
+
+#include "sema.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* A drop whose kind is decided once the body's graph is solved */
+typedef struct DropPoint {
+    uint32_t block;          /* CFG block and number of its operations before the exit */
+    uint32_t op;
+    Cleanup *cleanup;
+} DropPoint;
+
+typedef struct DropContext {
+    TypeContext *types;
+    Arena *arena;
+
+    /* Control-flow graph of the current body (built by the CFG pass) */
+    Cfg *cfg;
+
+    /* Owned bindings and defers of the open scopes, outermost first */
+    Vec(Cleanup) items;
+    Vec(size_t) block_marks;   /* Item count at each open block */
+    Vec(size_t) loop_marks;    /* Item count at each open loop */
+    Vec(size_t) arm_marks;     /* Item count at each open match arm */
+    Expr *body;                /* Body block (its fallthrough also drops the params) */
+    uint32_t local_count;      /* Slots of the body */
+
+    Vec(DropPoint) points;
+
+    /* Init/uninit problem, reused across bodies */
+    Dataflow flow;
+    BitWord *state;            /* Scratch for the replay */
+    size_t state_words;
+} DropContext;
+
+/*
+ * ============================================
+ * Scopes and Exits
+ * ============================================
+ */
+
+static bool is_local(const DropContext *ctx, const Symbol *sym) {
+    return sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM) &&
+           sym->slot < ctx->local_count;
+}
+
+static bool owns_glue(const DropContext *ctx, const Symbol *sym) {
+    return is_local(ctx, sym) && type_needs_drop(ctx->types, sym->type);
+}
+
+static void push_drop(DropContext *ctx, Symbol *sym) {
+    Cleanup item = { CLEANUP_DROP, NULL, sym };
+    vec_push(ctx->items, item);
+}
+
+/*
+ * Fill an exit's cleanup list with the items above `floor`, innermost
+ * first, and remember where in the graph the drops happen
+ */
+static void record_exit(DropContext *ctx, Vec(Cleanup) *list, size_t floor) {
+    vec_clear(*list);
+    for (size_t i = vec_len(ctx->items); i > floor; i--) {
+        vec_push(*list, ctx->items[i - 1]);
+    }
+
+    /* The list is complete, so its storage no longer moves */
+    uint32_t block = ctx->cfg->current;
+    uint32_t op = (uint32_t)vec_len(ctx->cfg->blocks[block].ops);
+    for (size_t i = 0; i < vec_len(*list); i++) {
+        if ((*list)[i].kind == CLEANUP_DROP) {
+            DropPoint point = { block, op, &(*list)[i] };
+            vec_push(ctx->points, point);
+        }
+    }
+}
+
+static size_t innermost_loop(const DropContext *ctx) {
+    return vec_len(ctx->loop_marks) ? vec_last(ctx->loop_marks) : vec_len(ctx->items);
+}
+
+/* Index of the match arm whose body this is, or -1 */
+static ptrdiff_t arm_index(Expr *expr, const VisitEdge *edge) {
+    Expr *match = edge->parent;
+    if (!match || match->kind != EXPR_MATCH || expr == match->match.scrutinee) {
+        return -1;
+    }
+    for (size_t i = 0; i < vec_len(match->match.arms_bodies); i++) {
+        if (match->match.arms_bodies[i] == expr) return (ptrdiff_t)i;
+    }
+    return -1;
+}
+
+/* Own the bindings of an arm pattern (not those under an or-pattern) */
+static void push_pattern_drops(DropContext *ctx, Pattern *pat) {
+    if (!pat) return;
+
+    switch (pat->kind) {
+        case PAT_BINDING:
+            if (owns_glue(ctx, pat->binding.resolved)) {
+                pat->binding.resolved->drop_flag = false;
+                push_drop(ctx, pat->binding.resolved);
+            }
+            break;
+        case PAT_TUPLE:
+            for (size_t i = 0; i < vec_len(pat->tuple.elements); i++) {
+                push_pattern_drops(ctx, pat->tuple.elements[i]);
+            }
+            break;
+        case PAT_RECORD:
+            for (size_t i = 0; i < vec_len(pat->record.field_patterns); i++) {
+                push_pattern_drops(ctx, pat->record.field_patterns[i]);
+            }
+            break;
+        case PAT_ENUM:
+            push_pattern_drops(ctx, pat->enum_.payload);
+            break;
+        case PAT_MODAL:
+            for (size_t i = 0; i < vec_len(pat->modal.field_patterns); i++) {
+                push_pattern_drops(ctx, pat->modal.field_patterns[i]);
+            }
+            break;
+        case PAT_GUARD:
+            push_pattern_drops(ctx, pat->guard.pattern);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * ============================================
+ * Scope Pass
+ * ============================================
+ */
+
+static bool drop_enter_body(void *state, VisitBody *body) {
+    DropContext *ctx = state;
+
+    vec_clear(ctx->items);
+    vec_clear(ctx->block_marks);
+    vec_clear(ctx->loop_marks);
+    vec_clear(ctx->arm_marks);
+    vec_clear(ctx->points);
+    ctx->body = body->body;
+    ctx->local_count = body->local_count;
+
+    /* A `move` parameter is owned by the callee */
+    if (body->proc) {
+        for (size_t i = 0; i < vec_len(body->proc->params); i++) {
+            ParamDecl *param = &body->proc->params[i];
+            if (param->is_move && owns_glue(ctx, param->resolved)) {
+                param->resolved->drop_flag = false;
+                push_drop(ctx, param->resolved);
+            }
+        }
+    }
+    return true;
+}
+
+static bool drop_enter_stmt(void *state, Stmt *stmt) {
+    DropContext *ctx = state;
+
+    if (stmt->kind == STMT_DEFER) {
+        /* Runs at scope exit, not here; moves inside it are not tracked */
+        Cleanup item = { CLEANUP_DEFER, stmt->defer.body, NULL };
+        vec_push(ctx->items, item);
+        return false;
+    }
+    return true;
+}
+
+static void drop_exit_stmt(void *state, Stmt *stmt) {
+    DropContext *ctx = state;
+
+    switch (stmt->kind) {
+        case STMT_LET:
+        case STMT_VAR: {
+            Pattern *pat = stmt->kind == STMT_LET ? stmt->let.pattern : stmt->var.pattern;
+            if (pat && pat->kind == PAT_BINDING && owns_glue(ctx, pat->binding.resolved)) {
+                pat->binding.resolved->drop_flag = false;
+                push_drop(ctx, pat->binding.resolved);
+            }
+            break;
+        }
+
+        case STMT_ASSIGN: {
+            /* The old value is dropped once the new one is evaluated */
+            Expr *target = stmt->assign.target;
+            vec_clear(stmt->cleanups);
+            if (target->kind == EXPR_IDENT && owns_glue(ctx, target->ident.resolved)) {
+                size_t floor = vec_len(ctx->items);
+                push_drop(ctx, target->ident.resolved);
+                record_exit(ctx, &stmt->cleanups, floor);
+                vec_pop(ctx->items);
+            }
+            break;
+        }
+
+        case STMT_RETURN:
+        case STMT_RESULT:
+            /* `result` returns from the procedure in generated code */
+            record_exit(ctx, &stmt->cleanups, 0);
+            break;
+
+        case STMT_BREAK:
+        case STMT_CONTINUE:
+            record_exit(ctx, &stmt->cleanups, innermost_loop(ctx));
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Does the parent take ownership of this identifier's value? */
+static bool takes_value(Expr *expr, const VisitEdge *edge) {
+    if (edge->use == VISIT_USE_CONSUME) return true;
+    /* A block's result and an arm's body are the value of the enclosing
+       expression, which owns it */
+    return (edge->parent && edge->parent->kind == EXPR_BLOCK &&
+            edge->parent->block.result == expr) ||
+           arm_index(expr, edge) >= 0;
+}
+
+static bool drop_enter_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    DropContext *ctx = state;
+
+    /* An arm's bindings are the scope around its body */
+    ptrdiff_t arm = expr->kind != EXPR_CLOSURE ? arm_index(expr, edge) : -1;
+    if (arm >= 0) {
+        vec_push(ctx->arm_marks, vec_len(ctx->items));
+        push_pattern_drops(ctx, edge->parent->match.arms_patterns[arm]);
+    }
+
+    switch (expr->kind) {
+        case EXPR_IDENT:
+            expr->ident.is_move = takes_value(expr, edge) &&
+                                  owns_glue(ctx, expr->ident.resolved);
+            break;
+
+        case EXPR_BLOCK:
+            vec_push(ctx->block_marks, vec_len(ctx->items));
+            break;
+
+        case EXPR_LOOP:
+            vec_push(ctx->loop_marks, vec_len(ctx->items));
+            break;
+
+        case EXPR_MATCH: {
+            size_t arms = vec_len(expr->match.arms_bodies);
+            expr->match.arms_cleanups = arena_calloc(ctx->arena, arms ? arms : 1,
+                sizeof(Vec(Cleanup)));
+            break;
+        }
+
+        case EXPR_CLOSURE:
+            /* Closure bodies are not lowered */
+            return false;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+static void drop_exit_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    DropContext *ctx = state;
+
+    switch (expr->kind) {
+        case EXPR_FIELD: {
+            /* Moving a field with glue out ends the whole binding's responsibility */
+            Expr *object = expr->field.object;
+            if (edge->use == VISIT_USE_CONSUME && object->kind == EXPR_IDENT &&
+                owns_glue(ctx, object->ident.resolved) &&
+                type_needs_drop(ctx->types, expr->type)) {
+                object->ident.is_move = true;
+            }
+            break;
+        }
+
+        case EXPR_BLOCK: {
+            size_t mark = vec_last(ctx->block_marks);
+            vec_pop(ctx->block_marks);
+            record_exit(ctx, &expr->block.cleanups, expr == ctx->body ? 0 : mark);
+            while (vec_len(ctx->items) > mark) {
+                vec_pop(ctx->items);
+            }
+            break;
+        }
+
+        case EXPR_LOOP:
+            vec_pop(ctx->loop_marks);
+            break;
+
+        default:
+            break;
+    }
+
+    ptrdiff_t arm = arm_index(expr, edge);
+    if (arm >= 0) {
+        size_t mark = vec_last(ctx->arm_marks);
+        vec_pop(ctx->arm_marks);
+        record_exit(ctx, &edge->parent->match.arms_cleanups[arm], mark);
+        while (vec_len(ctx->items) > mark) {
+            vec_pop(ctx->items);
+        }
+    }
+}
+
+/*
+ * ============================================
+ * Solve Pass
+ * ============================================
+ */
+
+/* Fact bits: slot s may be initialized (s) or moved/uninitialized (n + s) */
+static void apply_op(const Cfg *cfg, const CfgOp *op, BitWord *gen, BitWord *kill) {
+    size_t init = op->sym->slot;
+    size_t uninit = cfg->local_count + op->sym->slot;
+    bool moved;
+
+    switch (op->kind) {
+        case CFG_OP_USE:
+            moved = op->expr && op->expr->kind == EXPR_IDENT && op->expr->ident.is_move;
+            break;
+        case CFG_OP_USE_FIELD:
+            moved = op->expr->field.object->kind == EXPR_IDENT &&
+                    op->expr->field.object->ident.is_move;
+            break;
+        case CFG_OP_DECLARE:
+            moved = true;
+            break;
+        case CFG_OP_INIT:
+        case CFG_OP_ASSIGN:
+        default:
+            moved = false;
+            break;
+    }
+    if ((op->kind == CFG_OP_USE || op->kind == CFG_OP_USE_FIELD) && !moved) return;
+
+    size_t set = moved ? uninit : init;
+    size_t clear = moved ? init : uninit;
+    bitset_set(gen, set);
+    bitset_clear(gen, clear);
+    if (kill) {
+        bitset_clear(kill, set);
+        bitset_set(kill, clear);
+    }
+}
+
+static int compare_points(const void *a, const void *b) {
+    const DropPoint *x = a;
+    const DropPoint *y = b;
+    if (x->block != y->block) return (x->block > y->block) - (x->block < y->block);
+    return (x->op > y->op) - (x->op < y->op);
+}
+
+static void decide(Cleanup *cleanup, const BitWord *state, uint32_t local_count) {
+    Symbol *sym = cleanup->sym;
+    bool init = bitset_test(state, sym->slot);
+    bool uninit = bitset_test(state, local_count + sym->slot);
+
+    if (!init) {
+        cleanup->kind = CLEANUP_ELIDED;
+    } else if (uninit) {
+        cleanup->kind = CLEANUP_DROP_FLAGGED;
+        sym->drop_flag = true;
+    } else {
+        cleanup->kind = CLEANUP_DROP;
+    }
+}
+
+static void drop_solve_body(void *state, VisitBody *body) {
+    DropContext *ctx = state;
+    Cfg *cfg = ctx->cfg;
+    Dataflow *df = &ctx->flow;
+    size_t n = vec_len(ctx->points);
+    if (n == 0) return;
+
+    dataflow_reset(df, cfg, DATAFLOW_FORWARD, DATAFLOW_UNION, 2 * (size_t)cfg->local_count);
+
+    /* Parameters arrive initialized; everything else starts out empty */
+    for (uint32_t slot = 0; slot < cfg->local_count; slot++) {
+        bitset_set(df->boundary, cfg->local_count + slot);
+    }
+    if (body->proc) {
+        for (size_t i = 0; i < vec_len(body->proc->params); i++) {
+            Symbol *sym = body->proc->params[i].resolved;
+            if (is_local(ctx, sym)) {
+                bitset_set(df->boundary, sym->slot);
+                bitset_clear(df->boundary, cfg->local_count + sym->slot);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < vec_len(cfg->rpo); i++) {
+        uint32_t b = cfg->rpo[i];
+        CfgBlock *block = &cfg->blocks[b];
+        for (size_t j = 0; j < vec_len(block->ops); j++) {
+            apply_op(cfg, &block->ops[j], dataflow_gen(df, b), dataflow_kill(df, b));
+        }
+    }
+
+    dataflow_solve(df);
+
+    if (df->words > ctx->state_words) {
+        free(ctx->state);
+        ctx->state = malloc(df->words * sizeof(BitWord));
+        if (!ctx->state) {
+            CURSIVE_PANIC("Out of memory allocating drop state");
+        }
+        ctx->state_words = df->words;
+    }
+
+    /* Replay each block with drops once, stopping at each drop in order */
+    qsort(ctx->points, n, sizeof(DropPoint), compare_points);
+    for (size_t i = 0; i < n;) {
+        uint32_t b = ctx->points[i].block;
+        CfgBlock *block = &cfg->blocks[b];
+        size_t applied = 0;
+        bitset_copy(ctx->state, dataflow_in(df, b), df->words);
+
+        for (; i < n && ctx->points[i].block == b; i++) {
+            DropPoint *point = &ctx->points[i];
+            if (!block->reachable) {
+                point->cleanup->kind = CLEANUP_ELIDED;
+                continue;
+            }
+            for (; applied < point->op; applied++) {
+                apply_op(cfg, &block->ops[applied], ctx->state, NULL);
+            }
+            decide(point->cleanup, ctx->state, cfg->local_count);
+        }
+    }
+}
+
+static void drop_finish(void *state) {
+    DropContext *ctx = state;
+    vec_free(ctx->items);
+    vec_free(ctx->block_marks);
+    vec_free(ctx->loop_marks);
+    vec_free(ctx->arm_marks);
+    vec_free(ctx->points);
+    dataflow_destroy(&ctx->flow);
+    free(ctx->state);
+}
+
+/*
+ * Register drop elaboration with a body walker. It must come before any
+ * pass that builds the control-flow graph.
+ */
+void sema_register_drop_pass(Visitor *v, SemaContext *ctx) {
+    if (visitor_find_pass(v, "cfg")) {
+        CURSIVE_PANIC("Drop elaboration must be registered before the CFG pass");
+    }
+
+    DropContext *dctx = ARENA_ALLOC(ctx->arena, DropContext);
+    memset(dctx, 0, sizeof(*dctx));
+    dctx->types = &ctx->type_ctx;
+    dctx->arena = ctx->arena;
+
+    VisitPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "drops";
+    pass.state = dctx;
+    pass.enter_body = drop_enter_body;
+    pass.enter_stmt = drop_enter_stmt;
+    pass.exit_stmt = drop_exit_stmt;
+    pass.enter_expr = drop_enter_expr;
+    pass.exit_expr = drop_exit_expr;
+    visitor_add_pass(v, &pass);
+
+    dctx->cfg = cfg_require_pass(v);
+
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "drop-flags";
+    pass.state = dctx;
+    pass.exit_body = drop_solve_body;
+    pass.finish = drop_finish;
+    visitor_add_pass(v, &pass);
+}
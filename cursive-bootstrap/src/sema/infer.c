@@ -0,0 +1,252 @@
+/*
+ * Cursive Bootstrap Compiler - Local Type Inference Implementation
+ */
+
+#include "infer.h"
+
+void infer_init(InferTable *table, TypeContext *types) {
+    table->types = types;
+    table->vars = vec_new(InferVar);
+}
+
+void infer_destroy(InferTable *table) {
+    vec_free(table->vars);
+}
+
+void infer_reset(InferTable *table) {
+    vec_clear(table->vars);
+}
+
+Type *infer_fresh(InferTable *table, InferClass cls) {
+    uint32_t index = (uint32_t)vec_len(table->vars);
+    InferVar var = { index, 0, cls, NULL, false };
+    vec_push(table->vars, var);
+    return type_infer_var(table->types, index);
+}
+
+/* Find the root of a variable's class, compressing the path to it */
+static uint32_t find(InferTable *table, uint32_t index) {
+    uint32_t root = index;
+    while (table->vars[root].parent != root) {
+        root = table->vars[root].parent;
+    }
+    while (table->vars[index].parent != root) {
+        uint32_t next = table->vars[index].parent;
+        table->vars[index].parent = root;
+        index = next;
+    }
+    return root;
+}
+
+/* Is this a variable of the current table? */
+static bool is_var(InferTable *table, const Type *type) {
+    return type && type->kind == TYPE_INFER && type->var.index < vec_len(table->vars);
+}
+
+Type *infer_shallow(InferTable *table, Type *type) {
+    if (!is_var(table, type)) return type;
+
+    uint32_t root = find(table, type->var.index);
+    InferVar *var = &table->vars[root];
+    if (var->bound) return var->bound;
+    return root == type->var.index ? type : type_infer_var(table->types, root);
+}
+
+InferClass infer_class(InferTable *table, Type *type) {
+    if (!is_var(table, type)) return INFER_ANY;
+    return table->vars[find(table, type->var.index)].cls;
+}
+
+/* Search a type for an unbound, unclassed variable */
+typedef struct Unconstrained {
+    InferTable *table;
+    bool found;
+} Unconstrained;
+
+static Type *unconstrained_visit(void *state, Type *type) {
+    Unconstrained *unc = state;
+    if (unc->found || !is_var(unc->table, type)) return type;
+
+    InferVar *var = &unc->table->vars[find(unc->table, type->var.index)];
+    if (var->bound) {
+        type_resolve_vars(unc->table->types, var->bound, unconstrained_visit, unc);
+    } else if (var->cls == INFER_ANY) {
+        unc->found = true;
+    }
+    return type;
+}
+
+bool infer_is_unconstrained(InferTable *table, Type *type) {
+    if (!type || !type->has_vars) return false;
+    Unconstrained unc = { table, false };
+    type_resolve_vars(table->types, type, unconstrained_visit, &unc);
+    return unc.found;
+}
+
+/* Does a literal class admit a (non-variable) type? */
+static bool class_admits(InferClass cls, const Type *type) {
+    switch (cls) {
+        case INFER_INT:
+            return type->kind >= TYPE_PRIM_I8 && type->kind <= TYPE_PRIM_USIZE;
+        case INFER_FLOAT:
+            return type->kind >= TYPE_PRIM_F16 && type->kind <= TYPE_PRIM_F64;
+        case INFER_ANY:
+            return true;
+    }
+    return false;
+}
+
+/* Occurs check, walking through the bounds of the variables met */
+typedef struct Occurs {
+    InferTable *table;
+    uint32_t root;
+    bool found;
+} Occurs;
+
+static Type *occurs_visit(void *state, Type *type) {
+    Occurs *occ = state;
+    if (occ->found || !is_var(occ->table, type)) return type;
+
+    uint32_t root = find(occ->table, type->var.index);
+    if (root == occ->root) {
+        occ->found = true;
+    } else if (occ->table->vars[root].bound) {
+        type_resolve_vars(occ->table->types, occ->table->vars[root].bound,
+                          occurs_visit, occ);
+    }
+    return type;
+}
+
+static bool occurs(InferTable *table, uint32_t root, Type *type) {
+    if (!type->has_vars) return false;
+    Occurs occ = { table, root, false };
+    type_resolve_vars(table->types, type, occurs_visit, &occ);
+    return occ.found;
+}
+
+/* Bind the unbound root `root` to `type` (already shallow) */
+static bool bind(InferTable *table, uint32_t root, Type *type) {
+    InferVar *var = &table->vars[root];
+
+    if (is_var(table, type)) {
+        uint32_t other_root = type->var.index;
+        InferVar *other = &table->vars[other_root];
+
+        InferClass cls = var->cls;
+        if (cls == INFER_ANY) {
+            cls = other->cls;
+        } else if (other->cls != INFER_ANY && other->cls != cls) {
+            return false;
+        }
+
+        /* Union by rank */
+        if (var->rank < other->rank) {
+            var->parent = other_root;
+            other->cls = cls;
+        } else {
+            other->parent = root;
+            var->cls = cls;
+            if (var->rank == other->rank) var->rank++;
+        }
+        return true;
+    }
+
+    /* `!` converts to anything, so it says nothing about the variable */
+    if (type->kind == TYPE_NEVER) return true;
+
+    if (type->kind != TYPE_ERROR && !class_admits(var->cls, type)) return false;
+    if (occurs(table, root, type)) return false;
+
+    var->bound = type;
+    var->resolved = !type->has_vars;
+    return true;
+}
+
+static bool unify_all(InferTable *table, Vec(Type *) a, Vec(Type *) b) {
+    if (vec_len(a) != vec_len(b)) return false;
+    for (size_t i = 0; i < vec_len(a); i++) {
+        if (!infer_unify(table, a[i], b[i])) return false;
+    }
+    return true;
+}
+
+bool infer_unify(InferTable *table, Type *a, Type *b) {
+    a = infer_shallow(table, a);
+    b = infer_shallow(table, b);
+    if (a == b) return true;
+
+    if (is_var(table, a)) return bind(table, a->var.index, b);
+    if (is_var(table, b)) return bind(table, b->var.index, a);
+
+    /* Distinct canonical types with nothing left to bind */
+    if (!a->has_vars && !b->has_vars) return false;
+    if (a->kind != b->kind || a->perm != b->perm) return false;
+
+    switch (a->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            return a->nominal.sym == b->nominal.sym &&
+                   unify_all(table, a->nominal.type_args, b->nominal.type_args);
+
+        case TYPE_MODAL_STATE:
+            return interned_eq(a->modal_state.state_name, b->modal_state.state_name) &&
+                   infer_unify(table, a->modal_state.modal_type, b->modal_state.modal_type);
+
+        case TYPE_TUPLE:
+            return unify_all(table, a->tuple.elements, b->tuple.elements);
+
+        case TYPE_ARRAY:
+            return a->array.size == b->array.size &&
+                   infer_unify(table, a->array.element, b->array.element);
+
+        case TYPE_SLICE:
+            return infer_unify(table, a->slice.element, b->slice.element);
+
+        case TYPE_FUNCTION:
+            return unify_all(table, a->function.params, b->function.params) &&
+                   infer_unify(table, a->function.return_type, b->function.return_type);
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            return infer_unify(table, a->ptr.pointee, b->ptr.pointee);
+
+        case TYPE_GENERIC_INST:
+            return infer_unify(table, a->generic_inst.base, b->generic_inst.base) &&
+                   unify_all(table, a->generic_inst.args, b->generic_inst.args);
+
+        default:
+            /* Unions are canonicalized by member id, so members cannot be paired up */
+            return false;
+    }
+}
+
+static Type *resolve_visit(void *state, Type *type) {
+    InferTable *table = state;
+    if (!is_var(table, type)) return type_error_type(table->types);
+
+    uint32_t root = find(table, type->var.index);
+    InferVar *var = &table->vars[root];
+
+    if (!var->bound) {
+        switch (var->cls) {
+            case INFER_INT:   var->bound = table->types->type_i32; break;
+            case INFER_FLOAT: var->bound = table->types->type_f64; break;
+            case INFER_ANY:   var->bound = type_error_type(table->types); break;
+        }
+        var->resolved = true;
+    } else if (!var->resolved) {
+        /* Memoize, so a bound shared by many uses is resolved once */
+        Type *bound = type_resolve_vars(table->types, var->bound, resolve_visit, table);
+        var = &table->vars[root];
+        var->bound = bound;
+        var->resolved = true;
+    }
+    return var->bound;
+}
+
+Type *infer_resolve(InferTable *table, Type *type) {
+    return type_resolve_vars(table->types, type, resolve_visit, table);
+}
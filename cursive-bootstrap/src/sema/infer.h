@@ -0,0 +1,79 @@
+/*
+ * Cursive Bootstrap Compiler - Local Type Inference
+ *
+ * Unknown types inside a procedure body (unannotated bindings, integer
+ * and float literals with no expected type, `_` in a type) are
+ * inference variables. Unification merges variables with a union-find
+ * (union by rank, path compression), so each constraint costs
+ * near-constant time and a procedure is solved in time near-linear in
+ * its size.
+ *
+ * Literal variables carry a class: an integer literal's variable only
+ * unifies with integer types and a float literal's with float types.
+ * They stay open until the end of the procedure, so a later use can
+ * still fix the literal's type, and only then default to i32 and f64.
+ */
+
+#ifndef CURSIVE_SEMA_INFER_H
+#define CURSIVE_SEMA_INFER_H
+
+#include "types.h"
+
+typedef enum InferClass {
+    INFER_ANY,         /* Any type */
+    INFER_INT,         /* An integer type; defaults to i32 */
+    INFER_FLOAT        /* A floating-point type; defaults to f64 */
+} InferClass;
+
+typedef struct InferVar {
+    uint32_t parent;       /* Union-find parent; itself for a root */
+    uint32_t rank;
+    InferClass cls;        /* Roots only */
+    Type *bound;           /* Roots only: the type the variable stands for, or NULL */
+    bool resolved;         /* Roots only: bound mentions no variables */
+} InferVar;
+
+/* The inference variables of one procedure */
+typedef struct InferTable {
+    TypeContext *types;
+    Vec(InferVar) vars;
+} InferTable;
+
+void infer_init(InferTable *table, TypeContext *types);
+void infer_destroy(InferTable *table);
+
+/* Forget all variables (at the start of each procedure) */
+void infer_reset(InferTable *table);
+
+/* Create a new, unbound variable */
+Type *infer_fresh(InferTable *table, InferClass cls);
+
+/*
+ * The type a type stands for at the top level: the bound of a bound
+ * variable (followed through variables), the root of an unbound one,
+ * anything else unchanged. Children are not resolved.
+ */
+Type *infer_shallow(InferTable *table, Type *type);
+
+/* Class of an unbound variable (after infer_shallow), INFER_ANY otherwise */
+InferClass infer_class(InferTable *table, Type *type);
+
+/* Does a type mention a variable that nothing has constrained yet? */
+bool infer_is_unconstrained(InferTable *table, Type *type);
+
+/*
+ * Make two types equal by binding variables. Returns false if they
+ * cannot be: different constructors, a literal class mismatch or a
+ * cyclic binding. Bindings made before a failure are kept.
+ */
+bool infer_unify(InferTable *table, Type *a, Type *b);
+
+/*
+ * Replace every variable in a type by what it is bound to. Integer and
+ * float variables that are still unbound take their default type, and
+ * unconstrained ones the error type. Use only once the procedure has
+ * been checked, since defaulting binds the variables.
+ */
+Type *infer_resolve(InferTable *table, Type *type);
+
+#endif /* CURSIVE_SEMA_INFER_H */
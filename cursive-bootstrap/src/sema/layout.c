@@ -0,0 +1,587 @@
+/*
+ * Cursive Bootstrap Compiler - Type Layout
+ */
+
+#include "layout.h"
+#include "scope.h"
+#include <string.h>
+
+void layout_ctx_init(LayoutContext *ctx, Arena *arena, TypeContext *types) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->arena = arena;
+    ctx->types = types;
+    ctx->target.pointer_size = 8;
+    ctx->target.max_scalar_align = 8;
+    ptr_map_init(&ctx->cache);
+}
+
+void layout_ctx_destroy(LayoutContext *ctx) {
+    ptr_map_destroy(&ctx->cache);
+}
+
+void layout_set_target(LayoutContext *ctx, LayoutTarget target) {
+    if (target.pointer_size == ctx->target.pointer_size &&
+        target.max_scalar_align == ctx->target.max_scalar_align) {
+        return;
+    }
+    ctx->target = target;
+    ptr_map_destroy(&ctx->cache);
+    ptr_map_init(&ctx->cache);
+}
+
+/* Largest object the target can address with a signed offset */
+static uint64_t max_object_size(LayoutContext *ctx) {
+    return (UINT64_C(1) << (ctx->target.pointer_size * 8 - 1)) - 1;
+}
+
+static uint64_t align_up(uint64_t value, uint32_t align) {
+    return (value + align - 1) & ~(uint64_t)(align - 1);
+}
+
+static Layout *new_layout(LayoutContext *ctx, LayoutKind kind) {
+    Layout *layout = ARENA_ALLOC(ctx->arena, Layout);
+    memset(layout, 0, sizeof(*layout));
+    layout->kind = kind;
+    layout->align = 1;
+    return layout;
+}
+
+static Layout *scalar(LayoutContext *ctx, Layout *layout, uint64_t size) {
+    layout->kind = LAYOUT_SCALAR;
+    layout->size = size;
+    layout->align = 1;
+    while (layout->align < size && layout->align < ctx->target.max_scalar_align) {
+        layout->align *= 2;
+    }
+    return layout;
+}
+
+static uint64_t niche_mask(uint32_t size) {
+    return size >= 8 ? UINT64_MAX : (UINT64_C(1) << (size * 8)) - 1;
+}
+
+/* Number of invalid values in a niche */
+static uint64_t niche_available(const LayoutNiche *niche) {
+    if (niche->size == 0) return 0;
+    return (niche->start - niche->end - 1) & niche_mask(niche->size);
+}
+
+static void set_niche(Layout *layout, uint64_t offset, uint32_t size,
+                      uint64_t start, uint64_t end) {
+    layout->niche.offset = offset;
+    layout->niche.size = size;
+    layout->niche.start = start & niche_mask(size);
+    layout->niche.end = end & niche_mask(size);
+}
+
+/* Keep the part's niche, found `offset` bytes in, if it is the larger */
+static void take_niche(Layout *layout, const Layout *part, uint64_t offset) {
+    if (niche_available(&part->niche) > niche_available(&layout->niche)) {
+        layout->niche = part->niche;
+        layout->niche.offset += offset;
+    }
+}
+
+/*
+ * Status of an aggregate given a part's: reaching a part that is still
+ * being computed means the aggregate contains itself
+ */
+static LayoutStatus part_status(const Layout *part) {
+    return part->status == LAYOUT_PENDING ? LAYOUT_INFINITE : part->status;
+}
+
+static Layout *compute(LayoutContext *ctx, Type *type);
+
+/* Type of a field or payload in an instance with `args` */
+static Type *member_type(LayoutContext *ctx, TypeExpr *texpr, Vec(Type *) args) {
+    Type *type = texpr ? texpr->resolved : NULL;
+    if (type && vec_len(args) > 0) {
+        type = type_substitute(ctx->types, type, args);
+    }
+    return type;
+}
+
+/*
+ * Lay out `count` parts as fields. Unless `reorder`, fields are placed in
+ * declaration order; otherwise by decreasing alignment, which is stable
+ * for equal alignments and leaves no padding between fields.
+ */
+static void lay_out_fields(LayoutContext *ctx, Layout *layout, Layout **parts,
+                           uint32_t count, bool reorder, bool packed, uint32_t min_align) {
+    layout->kind = LAYOUT_STRUCT;
+    layout->packed = packed;
+    layout->field_count = count;
+    layout->fields = ARENA_ALLOC_ARRAY(ctx->arena, LayoutField, count ? count : 1);
+    layout->order = ARENA_ALLOC_ARRAY(ctx->arena, uint32_t, count ? count : 1);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t k = i;
+        while (reorder && k > 0 && parts[layout->order[k - 1]]->align < parts[i]->align) {
+            layout->order[k] = layout->order[k - 1];
+            k--;
+        }
+        layout->order[k] = i;
+    }
+
+    uint64_t limit = max_object_size(ctx);
+    uint64_t offset = 0;
+    uint32_t align = 1;
+    for (uint32_t rank = 0; rank < count; rank++) {
+        uint32_t i = layout->order[rank];
+        uint32_t part_align = packed ? 1 : parts[i]->align;
+        offset = align_up(offset, part_align);
+        if (parts[i]->size > limit - offset) {
+            layout->status = LAYOUT_TOO_LARGE;
+            return;
+        }
+        layout->fields[i].offset = offset;
+        layout->fields[i].rank = rank;
+        take_niche(layout, parts[i], offset);
+        offset += parts[i]->size;
+        if (part_align > align) align = part_align;
+    }
+
+    layout->align = align > min_align ? align : min_align;
+    layout->size = align_up(offset, layout->align);
+    if (layout->size > limit) {
+        layout->status = LAYOUT_TOO_LARGE;
+    }
+}
+
+/*
+ * Store the tags of alternatives without data in a niche of the one
+ * alternative with data. False if there is no such alternative or its
+ * niche is too small.
+ */
+static bool lay_out_niche(Layout *layout, Layout **payloads, size_t count,
+                          uint32_t min_align) {
+    size_t dataful = count;
+    for (size_t i = 0; i < count; i++) {
+        if (!payloads[i] || payloads[i]->size == 0) continue;
+        if (dataful != count) return false;
+        dataful = i;
+    }
+    if (dataful == count) return false;
+
+    const Layout *data = payloads[dataful];
+    if (data->niche.size == 0 || niche_available(&data->niche) < count - 1) {
+        return false;
+    }
+
+    uint64_t mask = niche_mask(data->niche.size);
+    layout->kind = LAYOUT_TAGGED;
+    layout->encoding = TAG_NICHE;
+    layout->tag_offset = data->niche.offset;
+    layout->tag_size = data->niche.size;
+    layout->payload_size = data->size;
+    layout->payload_align = data->align;
+    layout->dataful = (uint32_t)dataful;
+    layout->niche_first = (data->niche.end + 1) & mask;
+    layout->niche_count = (uint32_t)(count - 1);
+
+    layout->align = data->align > min_align ? data->align : min_align;
+    layout->size = align_up(data->size, layout->align);
+
+    /* The values now taken are valid for enclosing types */
+    layout->niche = data->niche;
+    layout->niche.end = (data->niche.end + count - 1) & mask;
+    return true;
+}
+
+/*
+ * Tag followed by the largest payload; `payloads[i]` is NULL without one.
+ * Tags hold lo..hi, which leaves the rest as a niche.
+ */
+static void lay_out_tagged(LayoutContext *ctx, Layout *layout, Layout **payloads,
+                           size_t count, uint32_t tag_size, bool tag_signed,
+                           int64_t lo, int64_t hi, uint32_t min_align, bool allow_niche) {
+    if (allow_niche && lay_out_niche(layout, payloads, count, min_align)) {
+        return;
+    }
+
+    layout->kind = LAYOUT_TAGGED;
+    layout->encoding = TAG_DIRECT;
+    layout->tag_size = tag_size;
+    layout->tag_signed = tag_signed;
+    layout->payload_align = 1;
+    for (size_t i = 0; i < count; i++) {
+        if (!payloads[i]) continue;
+        if (payloads[i]->size > layout->payload_size) {
+            layout->payload_size = payloads[i]->size;
+        }
+        if (payloads[i]->align > layout->payload_align) {
+            layout->payload_align = payloads[i]->align;
+        }
+    }
+
+    uint32_t tag_align = tag_size < ctx->target.max_scalar_align
+        ? tag_size : ctx->target.max_scalar_align;
+    layout->payload_offset = align_up(tag_size, layout->payload_align);
+    layout->align = tag_align > layout->payload_align ? tag_align : layout->payload_align;
+    if (min_align > layout->align) layout->align = min_align;
+    set_niche(layout, 0, tag_size, (uint64_t)lo, (uint64_t)hi);
+
+    if (layout->payload_size > max_object_size(ctx) - layout->payload_offset) {
+        layout->status = LAYOUT_TOO_LARGE;
+        return;
+    }
+    layout->size = align_up(layout->payload_offset + layout->payload_size, layout->align);
+}
+
+/* Range of an enum's discriminants */
+static void enum_range(EnumDecl *decl, int64_t *lo, int64_t *hi) {
+    for (size_t i = 0; i < vec_len(decl->variants); i++) {
+        int64_t value = decl->variants[i].value;
+        if (i == 0 || value < *lo) *lo = value;
+        if (i == 0 || value > *hi) *hi = value;
+    }
+}
+
+/* Size of the smallest tag that holds every discriminant */
+static uint32_t enum_tag_size(EnumDecl *decl, int64_t lo, int64_t hi, bool *is_signed) {
+    const LayoutAttr *attr = &decl->layout;
+    if (attr->tag_bits) {
+        *is_signed = attr->tag_signed;
+        return attr->tag_bits / 8;
+    }
+
+    /* C enums are ints unless the values need more */
+    unsigned bits = attr->c ? 32 : 8;
+    while (bits < 64 &&
+           !(lo >= 0 && (uint64_t)hi < (UINT64_C(1) << bits)) &&
+           !(lo >= -(INT64_C(1) << (bits - 1)) && hi < (INT64_C(1) << (bits - 1)))) {
+        bits *= 2;
+    }
+    *is_signed = attr->c || lo < 0;
+    return bits / 8;
+}
+
+static void lay_out_record(LayoutContext *ctx, Layout *layout, RecordDecl *decl,
+                           Vec(Type *) args) {
+    uint32_t count = (uint32_t)vec_len(decl->fields);
+    Layout **parts = ARENA_ALLOC_ARRAY(ctx->arena, Layout *, count ? count : 1);
+    for (uint32_t i = 0; i < count; i++) {
+        Type *field = member_type(ctx, decl->fields[i].type, args);
+        if (!field) {
+            layout->status = LAYOUT_NONE;
+            return;
+        }
+        parts[i] = compute(ctx, field);
+        if (parts[i]->status != LAYOUT_OK) {
+            layout->status = part_status(parts[i]);
+            return;
+        }
+    }
+
+    const LayoutAttr *attr = &decl->layout;
+    lay_out_fields(ctx, layout, parts, count, !attr->c && !attr->packed,
+        attr->packed, attr->align);
+}
+
+static void lay_out_enum(LayoutContext *ctx, Layout *layout, EnumDecl *decl,
+                         Vec(Type *) args) {
+    size_t count = vec_len(decl->variants);
+    Layout **payloads = ARENA_ALLOC_ARRAY(ctx->arena, Layout *, count ? count : 1);
+    for (size_t i = 0; i < count; i++) {
+        payloads[i] = NULL;
+        if (!decl->variants[i].payload) continue;
+
+        Type *payload = member_type(ctx, decl->variants[i].payload, args);
+        if (!payload) {
+            layout->status = LAYOUT_NONE;
+            return;
+        }
+        payloads[i] = compute(ctx, payload);
+        if (payloads[i]->status != LAYOUT_OK) {
+            layout->status = part_status(payloads[i]);
+            return;
+        }
+    }
+
+    /* C and integer layouts fix the tag */
+    const LayoutAttr *attr = &decl->layout;
+    int64_t lo = 0, hi = 0;
+    bool tag_signed;
+    enum_range(decl, &lo, &hi);
+    uint32_t tag_size = enum_tag_size(decl, lo, hi, &tag_signed);
+    lay_out_tagged(ctx, layout, payloads, count, tag_size, tag_signed, lo, hi,
+        attr->align, !attr->c && !attr->tag_bits);
+}
+
+/* Layout of a record or enum, or an instance of a generic one */
+static void lay_out_nominal(LayoutContext *ctx, Layout *layout, Type *type) {
+    Vec(Type *) args = NULL;
+    Type *base = type;
+    if (type->kind == TYPE_GENERIC_INST) {
+        args = type->generic_inst.args;
+        base = type->generic_inst.base;
+    }
+
+    Symbol *sym = base ? base->nominal.sym : NULL;
+    Decl *decl = sym ? sym->decl : NULL;
+    if (!decl) {
+        layout->status = LAYOUT_NONE;
+        return;
+    }
+
+    if (base->kind == TYPE_RECORD && decl->kind == DECL_RECORD &&
+        vec_len(decl->record.generics) == vec_len(args)) {
+        lay_out_record(ctx, layout, &decl->record, args);
+    } else if (base->kind == TYPE_ENUM && decl->kind == DECL_ENUM &&
+               vec_len(decl->enum_.generics) == vec_len(args)) {
+        lay_out_enum(ctx, layout, &decl->enum_, args);
+    } else {
+        layout->status = LAYOUT_NONE;
+    }
+}
+
+static void lay_out_parts(LayoutContext *ctx, Layout *layout, Vec(Type *) types,
+                          bool tagged) {
+    size_t count = vec_len(types);
+    Layout **parts = ARENA_ALLOC_ARRAY(ctx->arena, Layout *, count ? count : 1);
+    for (size_t i = 0; i < count; i++) {
+        parts[i] = compute(ctx, types[i]);
+        if (parts[i]->status != LAYOUT_OK) {
+            layout->status = part_status(parts[i]);
+            return;
+        }
+    }
+
+    if (tagged) {
+        /* Union members are tagged by their index in the canonical order */
+        lay_out_tagged(ctx, layout, parts, count, count <= 256 ? 1 : 2, false,
+            0, count ? (int64_t)count - 1 : 0, 1, true);
+    } else {
+        lay_out_fields(ctx, layout, parts, (uint32_t)count, false, false, 1);
+    }
+}
+
+static void lay_out_array(LayoutContext *ctx, Layout *layout, Type *type) {
+    Layout *element = compute(ctx, type->array.element);
+    if (element->status != LAYOUT_OK) {
+        layout->status = part_status(element);
+        return;
+    }
+
+    layout->kind = LAYOUT_ARRAY;
+    layout->align = element->align;
+    if (element->size > 0 && type->array.size > max_object_size(ctx) / element->size) {
+        layout->status = LAYOUT_TOO_LARGE;
+        return;
+    }
+    layout->size = element->size * type->array.size;
+    if (type->array.size > 0) {
+        take_niche(layout, element, 0);
+    }
+}
+
+/* A pointer and a length: strings and slices */
+static void lay_out_fat_pointer(LayoutContext *ctx, Layout *layout) {
+    Layout *word = scalar(ctx, new_layout(ctx, LAYOUT_SCALAR), ctx->target.pointer_size);
+    Layout *parts[2] = { word, word };
+    lay_out_fields(ctx, layout, parts, 2, false, false, 1);
+}
+
+/*
+ * Compute (or look up) the layout of a type. The entry is cached as
+ * pending before its parts are visited, so a type that contains itself
+ * finds it and fails as infinite instead of recursing forever.
+ */
+static Layout *compute(LayoutContext *ctx, Type *type) {
+    if (type->perm != PERM_CONST) {
+        type = type_with_permission(ctx->types, type, PERM_CONST);
+    }
+
+    Layout *layout = ptr_map_get(&ctx->cache, type);
+    if (layout) {
+        return layout;
+    }
+
+    layout = new_layout(ctx, LAYOUT_SCALAR);
+    layout->status = LAYOUT_PENDING;
+    ptr_map_set(&ctx->cache, type, layout);
+
+    switch (type->kind) {
+        case TYPE_PRIM_I8:
+        case TYPE_PRIM_U8:
+            scalar(ctx, layout, 1);
+            break;
+
+        case TYPE_PRIM_BOOL:
+            scalar(ctx, layout, 1);
+            set_niche(layout, 0, 1, 0, 1);
+            break;
+
+        case TYPE_PRIM_I16:
+        case TYPE_PRIM_U16:
+        case TYPE_PRIM_F16:
+            scalar(ctx, layout, 2);
+            break;
+
+        case TYPE_PRIM_I32:
+        case TYPE_PRIM_U32:
+        case TYPE_PRIM_F32:
+            scalar(ctx, layout, 4);
+            break;
+
+        case TYPE_PRIM_CHAR:
+            /* Unicode scalar values stop at U+10FFFF */
+            scalar(ctx, layout, 4);
+            set_niche(layout, 0, 4, 0, 0x10FFFF);
+            break;
+
+        case TYPE_PRIM_I64:
+        case TYPE_PRIM_U64:
+        case TYPE_PRIM_F64:
+            scalar(ctx, layout, 8);
+            break;
+
+        case TYPE_PRIM_I128:
+        case TYPE_PRIM_U128:
+            scalar(ctx, layout, 16);
+            break;
+
+        case TYPE_PRIM_ISIZE:
+        case TYPE_PRIM_USIZE:
+        case TYPE_PTR:
+            scalar(ctx, layout, ctx->target.pointer_size);
+            break;
+
+        /* Never null, and always null */
+        case TYPE_PTR_VALID:
+        case TYPE_FUNCTION:
+            scalar(ctx, layout, ctx->target.pointer_size);
+            set_niche(layout, 0, ctx->target.pointer_size, 1, UINT64_MAX);
+            break;
+
+        case TYPE_PTR_NULL:
+            scalar(ctx, layout, ctx->target.pointer_size);
+            set_niche(layout, 0, ctx->target.pointer_size, 0, 0);
+            break;
+
+        case TYPE_UNIT:
+        case TYPE_NEVER:
+            scalar(ctx, layout, 0);
+            break;
+
+        case TYPE_STRING:
+        case TYPE_SLICE:
+            lay_out_fat_pointer(ctx, layout);
+            break;
+
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_GENERIC_INST:
+            lay_out_nominal(ctx, layout, type);
+            break;
+
+        case TYPE_TUPLE:
+            lay_out_parts(ctx, layout, type->tuple.elements, false);
+            break;
+
+        case TYPE_UNION:
+            lay_out_parts(ctx, layout, type->union_.members, true);
+            break;
+
+        case TYPE_ARRAY:
+            lay_out_array(ctx, layout, type);
+            break;
+
+        /* Not representable yet, or not concrete */
+        default:
+            layout->status = LAYOUT_NONE;
+            break;
+    }
+
+    /* Still pending unless the type or one of its parts failed */
+    if (layout->status == LAYOUT_PENDING) {
+        layout->status = LAYOUT_OK;
+    }
+    return layout;
+}
+
+const Layout *layout_of(LayoutContext *ctx, Type *type) {
+    if (!type) return NULL;
+    Layout *layout = compute(ctx, type);
+    return layout->status == LAYOUT_OK ? layout : NULL;
+}
+
+bool layout_size_align(LayoutContext *ctx, Type *type, uint64_t *size, uint32_t *align) {
+    const Layout *layout = layout_of(ctx, type);
+    if (!layout) return false;
+    *size = layout->size;
+    *align = layout->align;
+    return true;
+}
+
+bool type_is_sized(LayoutContext *ctx, Type *type) {
+    if (!type || type->kind == TYPE_CLASS) {
+        return false;  /* Class values are dynamically sized */
+    }
+    LayoutStatus status = compute(ctx, type)->status;
+    return status != LAYOUT_INFINITE && status != LAYOUT_TOO_LARGE;
+}
+
+/* Does `value` fit a tag of `bits` bits? */
+static bool tag_holds(int64_t value, unsigned bits, bool is_signed) {
+    if (bits >= 64) return is_signed || value >= 0;
+    if (is_signed) {
+        return value >= -(INT64_C(1) << (bits - 1)) && value < (INT64_C(1) << (bits - 1));
+    }
+    return value >= 0 && (uint64_t)value < (UINT64_C(1) << bits);
+}
+
+void layout_check_decl(LayoutContext *ctx, DiagContext *diag, Decl *decl, Type *type) {
+    const LayoutAttr *attr;
+    InternedString name;
+    SourceSpan span = decl->span;
+    if (decl->kind == DECL_RECORD) {
+        if (vec_len(decl->record.generics) > 0) return;
+        attr = &decl->record.layout;
+        name = decl->record.name;
+    } else if (decl->kind == DECL_ENUM) {
+        if (vec_len(decl->enum_.generics) > 0) return;
+        attr = &decl->enum_.layout;
+        name = decl->enum_.name;
+    } else {
+        return;
+    }
+
+    Layout *layout = compute(ctx, type);
+    switch (layout->status) {
+        case LAYOUT_INFINITE:
+            diag_report(diag, DIAG_ERROR, E_TYP_2006, span,
+                "'%.*s' contains itself without indirection and has infinite size",
+                (int)name.len, name.data);
+            return;
+
+        case LAYOUT_TOO_LARGE:
+            diag_report(diag, DIAG_ERROR, E_CTE_4003, span,
+                "'%.*s' is larger than the target can address", (int)name.len, name.data);
+            return;
+
+        case LAYOUT_OK:
+            break;
+
+        default:
+            return;
+    }
+
+    if (attr->align && attr->align < layout->align) {
+        diag_report(diag, DIAG_WARNING, W_DEC_2451, attr->span,
+            "align(%u) is below the natural alignment %u of '%.*s' and has no effect",
+            attr->align, layout->align, (int)name.len, name.data);
+    }
+
+    if (decl->kind == DECL_ENUM && attr->tag_bits) {
+        for (size_t i = 0; i < vec_len(decl->enum_.variants); i++) {
+            EnumVariant *var = &decl->enum_.variants[i];
+            if (!tag_holds(var->value, attr->tag_bits, attr->tag_signed)) {
+                diag_report(diag, DIAG_ERROR, E_CTE_4003, var->span,
+                    "discriminant %lld of '%.*s' does not fit in %c%u",
+                    (long long)var->value, (int)var->name.len, var->name.data,
+                    attr->tag_signed ? 'i' : 'u', (unsigned)attr->tag_bits);
+            }
+        }
+    }
+}
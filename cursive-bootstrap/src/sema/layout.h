@@ -0,0 +1,140 @@
+/*
+ * Cursive Bootstrap Compiler - Type Layout
+ *
+ * Size, alignment and field offsets of concrete types, computed on demand
+ * and cached per canonical type. Records are laid out compactly: fields
+ * are placed in order of decreasing alignment (declaration order among
+ * equals), which leaves padding only at the end. [[layout(C)]] keeps
+ * declaration order with C padding, [[layout(packed)]] removes padding
+ * altogether, and align(N) raises the alignment. Tuples keep their
+ * element order. Enums and unions are a tag followed by the largest
+ * payload, aligned for the most aligned one; without payloads they are
+ * just the tag.
+ *
+ * Types with invalid bit patterns expose them as a niche: bool, char, the
+ * non-null Ptr<T>@Valid and procedures, the unused values of a tag, and
+ * the best niche among a record's fields. An enum or union whose only
+ * alternative with data has a niche large enough for the others stores
+ * their tags there instead of in a tag of its own, so an optional Ptr<T>
+ * is one pointer that is null when empty, like Ptr<T> itself, whose
+ * @Null state is the null pointer.
+ *
+ * Layouts depend on the target through the pointer size and the largest
+ * scalar alignment; code generation sets both from its data layout, and
+ * the LLVM types it builds reproduce these offsets exactly.
+ */
+
+#ifndef CURSIVE_SEMA_LAYOUT_H
+#define CURSIVE_SEMA_LAYOUT_H
+
+#include "types.h"
+#include "common/map.h"
+#include "common/error.h"
+
+typedef enum LayoutKind {
+    LAYOUT_SCALAR,         /* Primitives, pointers, procedures, () and ! */
+    LAYOUT_STRUCT,         /* Records, tuples, strings and slices */
+    LAYOUT_ARRAY,          /* Elements at multiples of the element size */
+    LAYOUT_TAGGED          /* Enums and unions: tag, then the active payload */
+} LayoutKind;
+
+typedef enum LayoutStatus {
+    LAYOUT_OK,
+    LAYOUT_PENDING,        /* Being computed (a cycle if reached again) */
+    LAYOUT_INFINITE,       /* Contains itself without indirection */
+    LAYOUT_TOO_LARGE,      /* Exceeds the target's largest object */
+    LAYOUT_NONE            /* Unsized, generic or not representable */
+} LayoutStatus;
+
+typedef enum TagEncoding {
+    TAG_DIRECT,            /* A tag holding the discriminant or member index */
+    TAG_NICHE              /* Other alternatives are invalid values of the payload */
+} TagEncoding;
+
+/* Values a scalar part never holds, free for enclosing enums and unions */
+typedef struct LayoutNiche {
+    uint64_t offset;
+    uint32_t size;         /* 0 without a niche */
+    uint64_t start;        /* Valid values run from start to end, wrapping */
+    uint64_t end;
+} LayoutNiche;
+
+typedef struct LayoutField {
+    uint64_t offset;
+    uint32_t rank;         /* Position in memory order */
+} LayoutField;
+
+typedef struct Layout {
+    LayoutKind kind;
+    LayoutStatus status;
+    uint64_t size;         /* A multiple of align */
+    uint32_t align;
+    bool packed;           /* Fields may be misaligned */
+
+    /* LAYOUT_STRUCT: fields by declaration index, and the memory order */
+    uint32_t field_count;
+    LayoutField *fields;
+    uint32_t *order;       /* order[rank] is a declaration index */
+
+    /* LAYOUT_TAGGED */
+    TagEncoding encoding;
+    uint64_t tag_offset;
+    uint32_t tag_size;
+    bool tag_signed;
+    uint64_t payload_offset;
+    uint64_t payload_size;
+    uint32_t payload_align;
+
+    /* TAG_NICHE: alternative `dataful` holds the payload; the others are
+       numbered from niche_first in order, skipping it */
+    uint32_t dataful;
+    uint64_t niche_first;
+    uint32_t niche_count;
+
+    LayoutNiche niche;
+} Layout;
+
+typedef struct LayoutTarget {
+    uint32_t pointer_size;
+    uint32_t max_scalar_align;     /* Scalars align to min(size, this) */
+} LayoutTarget;
+
+typedef struct LayoutContext {
+    Arena *arena;
+    TypeContext *types;
+    LayoutTarget target;
+    PtrMap cache;          /* Canonical const Type * -> Layout * */
+} LayoutContext;
+
+/* Initialize for a 64-bit target whose scalars align to at most 8 bytes */
+void layout_ctx_init(LayoutContext *ctx, Arena *arena, TypeContext *types);
+void layout_ctx_destroy(LayoutContext *ctx);
+
+/* Lay out for another target, dropping layouts computed for the old one */
+void layout_set_target(LayoutContext *ctx, LayoutTarget target);
+
+/*
+ * Layout of a concrete type, or NULL if it has none: slices and other
+ * unsized types, types mentioning generic parameters, infinite types, and
+ * types without a representation yet (modal types, classes). Record
+ * fields and enum payloads must have been type checked.
+ */
+const Layout *layout_of(LayoutContext *ctx, Type *type);
+
+/* Size and alignment of a concrete type; false if it has no layout */
+bool layout_size_align(LayoutContext *ctx, Type *type, uint64_t *size, uint32_t *align);
+
+/*
+ * Is this type sized? Types mentioning generic parameters are sized if
+ * their structure is; their arguments are checked once instantiated.
+ */
+bool type_is_sized(LayoutContext *ctx, Type *type);
+
+/*
+ * Check the layout of a type checked record or enum declaration of type
+ * `type`: report infinite and oversized types, align(N) below the natural
+ * alignment, and discriminants that do not fit a layout(IntType) tag.
+ */
+void layout_check_decl(LayoutContext *ctx, DiagContext *diag, Decl *decl, Type *type);
+
+#endif /* CURSIVE_SEMA_LAYOUT_H */
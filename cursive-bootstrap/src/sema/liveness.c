@@ -0,0 +1,275 @@
+/*
+ * Cursive Bootstrap Compiler - Liveness Analysis
+ *
+ * Computes which local bindings are live (may still be read) at each
+ * point of a body and marks the reads after which a binding is dead on
+ * that path (Expr.ident.is_last_use). Code generation uses the marks to
+ * hand a binding's storage over instead of copying it and to end its
+ * storage lifetime as early as possible.
+ *
+ * Liveness is a backward "may" dataflow problem over the body's
+ * control-flow graph (cfg.h, dataflow.h): a read generates the slot's
+ * bit and an initialization or assignment kills it. Each block is then
+ * replayed backwards from its solved exit state; a read of a slot whose
+ * bit is clear at that point is a last use.
+ *
+ * Only bindings whose storage cannot be observed after their last read
+ * are marked: parameters and let/var bindings that are never assigned,
+ * borrowed, or referenced from a closure or deferred expression. A
+ * binding with drop glue is still read by its drop at scope exit, so only
+ * a read that moves its value out (drops.c) can be its last use.
+ */
+
+#include "sema.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include <string.h>
+
+typedef struct LivenessContext {
+    TypeContext *types;
+
+    /* Control-flow graph of the current body (built by the CFG pass) */
+    Cfg *cfg;
+
+    /* Live slots problem, reused across bodies */
+    Dataflow flow;
+
+    /* Per-slot sets of the current body */
+    BitWord *bound;          /* Parameter or simple let/var binding */
+    BitWord *escaped;        /* Assigned, borrowed or captured */
+    BitWord *live;           /* Scratch state for the backward replay */
+    size_t words;
+    size_t capacity;         /* Words each set has room for */
+    uint32_t local_count;
+
+    /* Depth of closures and defers around the current node */
+    int hidden_depth;
+} LivenessContext;
+
+/*
+ * ============================================
+ * Last Uses
+ * ============================================
+ */
+
+static bool is_slot(const LivenessContext *ctx, const Symbol *sym) {
+    return sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM) &&
+           sym->slot < ctx->local_count;
+}
+
+static bool is_candidate(const LivenessContext *ctx, uint32_t slot) {
+    return bitset_test(ctx->bound, slot) && !bitset_test(ctx->escaped, slot);
+}
+
+/*
+ * Apply one operation to a backward liveness state. With kill == NULL
+ * the operation updates `live` in place; otherwise it is folded into the
+ * block summary (gen, kill) of the operations that follow it.
+ */
+static void apply_op(const CfgOp *op, BitWord *live, BitWord *kill) {
+    uint32_t slot = op->sym->slot;
+
+    switch (op->kind) {
+        case CFG_OP_USE:
+            bitset_set(live, slot);
+            if (kill) bitset_clear(kill, slot);
+            break;
+
+        case CFG_OP_INIT:
+        case CFG_OP_DECLARE:
+        case CFG_OP_ASSIGN:
+            bitset_clear(live, slot);
+            if (kill) bitset_set(kill, slot);
+            break;
+
+        case CFG_OP_USE_FIELD:
+            /* The object read that precedes it is the use */
+            break;
+    }
+}
+
+/*
+ * Solve liveness for the current body and mark last uses
+ */
+static void analyze_liveness(LivenessContext *ctx) {
+    Cfg *cfg = ctx->cfg;
+    Dataflow *df = &ctx->flow;
+
+    dataflow_reset(df, cfg, DATAFLOW_BACKWARD, DATAFLOW_UNION, cfg->local_count);
+
+    /* Summarize each block, last operation first (nothing is live at exit) */
+    for (size_t i = 0; i < vec_len(cfg->rpo); i++) {
+        uint32_t b = cfg->rpo[i];
+        CfgBlock *block = &cfg->blocks[b];
+        for (size_t j = vec_len(block->ops); j-- > 0;) {
+            apply_op(&block->ops[j], dataflow_gen(df, b), dataflow_kill(df, b));
+        }
+    }
+
+    dataflow_solve(df);
+
+    /* Replay each reachable block backwards from its exit state */
+    for (size_t i = 0; i < vec_len(cfg->rpo); i++) {
+        uint32_t b = cfg->rpo[i];
+        CfgBlock *block = &cfg->blocks[b];
+        bitset_copy(ctx->live, dataflow_out(df, b), ctx->words);
+        for (size_t j = vec_len(block->ops); j-- > 0;) {
+            CfgOp *op = &block->ops[j];
+            if (op->kind == CFG_OP_USE && op->expr && op->expr->kind == EXPR_IDENT &&
+                is_candidate(ctx, op->sym->slot) && !bitset_test(ctx->live, op->sym->slot) &&
+                (op->expr->ident.is_move || !type_needs_drop(ctx->types, op->sym->type))) {
+                op->expr->ident.is_last_use = true;
+            }
+            apply_op(op, ctx->live, NULL);
+        }
+    }
+}
+
+/*
+ * ============================================
+ * Walker Callbacks
+ * ============================================
+ */
+
+/* Mark the binding at the root of a place expression as escaped */
+static void escape_place(LivenessContext *ctx, Expr *expr) {
+    while (expr) {
+        switch (expr->kind) {
+            case EXPR_IDENT:
+                if (is_slot(ctx, expr->ident.resolved)) {
+                    bitset_set(ctx->escaped, expr->ident.resolved->slot);
+                }
+                return;
+            case EXPR_FIELD:
+                expr = expr->field.object;
+                break;
+            case EXPR_INDEX:
+                expr = expr->index.object;
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+static void bind_params(LivenessContext *ctx, Vec(ParamDecl) params) {
+    for (size_t i = 0; i < vec_len(params); i++) {
+        if (is_slot(ctx, params[i].resolved)) {
+            bitset_set(ctx->bound, params[i].resolved->slot);
+        }
+    }
+}
+
+static bool live_enter_body(void *state, VisitBody *body) {
+    LivenessContext *ctx = state;
+
+    ctx->local_count = body->local_count;
+    ctx->words = bitset_words(body->local_count);
+    if (ctx->words > ctx->capacity) {
+        size_t cap = ctx->capacity ? ctx->capacity : 1;
+        while (cap < ctx->words) cap *= 2;
+        BitWord *storage = realloc(ctx->bound, 3 * cap * sizeof(BitWord));
+        if (!storage) {
+            CURSIVE_PANIC("Out of memory growing liveness sets");
+        }
+        ctx->bound = storage;
+        ctx->capacity = cap;
+    }
+    ctx->escaped = ctx->bound + ctx->capacity;
+    ctx->live = ctx->escaped + ctx->capacity;
+    bitset_fill(ctx->bound, ctx->words, false);
+    bitset_fill(ctx->escaped, ctx->words, false);
+    ctx->hidden_depth = 0;
+
+    bind_params(ctx, body->proc ? body->proc->params : body->transition->params);
+    return true;
+}
+
+static void live_exit_body(void *state, VisitBody *body) {
+    (void)body;
+    analyze_liveness(state);
+}
+
+static bool live_enter_stmt(void *state, Stmt *stmt) {
+    LivenessContext *ctx = state;
+
+    switch (stmt->kind) {
+        case STMT_LET:
+        case STMT_VAR: {
+            Pattern *pat = stmt->kind == STMT_LET ? stmt->let.pattern : stmt->var.pattern;
+            Expr *init = stmt->kind == STMT_LET ? stmt->let.init : stmt->var.init;
+            if (init && pat && pat->kind == PAT_BINDING && ctx->hidden_depth == 0 &&
+                is_slot(ctx, pat->binding.resolved)) {
+                bitset_set(ctx->bound, pat->binding.resolved->slot);
+            }
+            break;
+        }
+
+        case STMT_DEFER:
+            ctx->hidden_depth++;
+            break;
+
+        default:
+            break;
+    }
+    return true;
+}
+
+static void live_exit_stmt(void *state, Stmt *stmt) {
+    LivenessContext *ctx = state;
+    if (stmt->kind == STMT_DEFER) {
+        ctx->hidden_depth--;
+    }
+}
+
+static bool live_enter_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    LivenessContext *ctx = state;
+
+    if (edge->use == VISIT_USE_ASSIGN || edge->use == VISIT_USE_BORROW) {
+        escape_place(ctx, expr);
+    } else if (expr->kind == EXPR_IDENT && ctx->hidden_depth > 0) {
+        escape_place(ctx, expr);
+    }
+
+    if (expr->kind == EXPR_CLOSURE) {
+        ctx->hidden_depth++;
+    }
+    return true;
+}
+
+static void live_exit_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    LivenessContext *ctx = state;
+    (void)edge;
+    if (expr->kind == EXPR_CLOSURE) {
+        ctx->hidden_depth--;
+    }
+}
+
+static void live_finish(void *state) {
+    LivenessContext *ctx = state;
+    free(ctx->bound);
+    dataflow_destroy(&ctx->flow);
+}
+
+/*
+ * Register liveness analysis with a body walker
+ */
+void sema_register_liveness_pass(Visitor *v, SemaContext *ctx) {
+    LivenessContext *lctx = ARENA_ALLOC(ctx->arena, LivenessContext);
+    memset(lctx, 0, sizeof(*lctx));
+    lctx->types = &ctx->type_ctx;
+    lctx->cfg = cfg_require_pass(v);
+
+    VisitPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "liveness";
+    pass.state = lctx;
+    pass.enter_body = live_enter_body;
+    pass.exit_body = live_exit_body;
+    pass.enter_stmt = live_enter_stmt;
+    pass.exit_stmt = live_exit_stmt;
+    pass.enter_expr = live_enter_expr;
+    pass.exit_expr = live_exit_expr;
+    pass.finish = live_finish;
+    visitor_add_pass(v, &pass);
+}
@@ -0,0 +1,878 @@
+/*
+ * Cursive Bootstrap Compiler - Match Compilation
+ */
+
+#include "match.h"
+#include "members.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Bindings made by a row so far, most recent first (tails are shared) */
+typedef struct BindingList {
+    Symbol *sym;
+    MatchPath *path;
+    struct BindingList *next;
+} BindingList;
+
+/* One row of the pattern matrix */
+typedef struct MatchRow {
+    Pattern **cells;           /* One per column; NULL matches anything */
+    BindingList *bindings;
+    Expr *guard;
+    uint32_t arm;
+} MatchRow;
+
+typedef struct Matrix {
+    MatchRow *rows;
+    uint32_t row_count;
+    MatchPath **paths;         /* Sub-value tested by each column */
+    uint32_t col_count;
+} Matrix;
+
+/* A sub-value fixed on the way to the current node (for witnesses) */
+typedef struct Constraint {
+    MatchPath *path;
+    uint64_t key;              /* Variant, state or range key */
+} Constraint;
+
+typedef struct MatchCompiler {
+    Arena *arena;
+    const MatchTypes *types;
+    MatchPath *root;
+
+    bool *reached;             /* Per arm: some leaf runs it */
+    bool failed;               /* A pattern does not fit its column's type */
+    const char *missing;       /* First value no arm matches */
+
+    Vec(Constraint) constraints;
+} MatchCompiler;
+
+static Decision *compile(MatchCompiler *c, const Matrix *m);
+
+/*
+ * ============================================
+ * Types and Paths
+ * ============================================
+ */
+
+/* Declaration behind a nominal type, instantiation or modal state */
+static Decl *type_decl(Type *type) {
+    if (!type) return NULL;
+    switch (type->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+            return type->nominal.sym ? type->nominal.sym->decl : NULL;
+        case TYPE_MODAL_STATE:
+            return type_decl(type->modal_state.modal_type);
+        case TYPE_GENERIC_INST:
+            return type_decl(type->generic_inst.base);
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * Key space of an integer, char or bool type: the keys of its values,
+ * the bias XORed into signed values, and whether the type has values no
+ * 64-bit literal can name (so it is never covered by literals alone)
+ */
+static bool scalar_domain(Type *type, uint64_t *lo, uint64_t *hi, uint64_t *bias, bool *open) {
+    const uint64_t sign = (uint64_t)1 << 63;
+
+    *bias = 0;
+    *open = false;
+    *lo = 0;
+    switch (type->kind) {
+        case TYPE_PRIM_BOOL:  *hi = 1; return true;
+        case TYPE_PRIM_CHAR:  *hi = 0x10FFFF; return true;
+        case TYPE_PRIM_U8:    *hi = UINT8_MAX; return true;
+        case TYPE_PRIM_U16:   *hi = UINT16_MAX; return true;
+        case TYPE_PRIM_U32:   *hi = UINT32_MAX; return true;
+        case TYPE_PRIM_U128:  *open = true; /* fall through */
+        case TYPE_PRIM_U64:
+        case TYPE_PRIM_USIZE: *hi = UINT64_MAX; return true;
+        case TYPE_PRIM_I8:    *bias = sign; *lo = sign - 128; *hi = sign + INT8_MAX; return true;
+        case TYPE_PRIM_I16:   *bias = sign; *lo = sign - 32768; *hi = sign + INT16_MAX; return true;
+        case TYPE_PRIM_I32:   *bias = sign; *lo = sign - 2147483648u; *hi = sign + INT32_MAX; return true;
+        case TYPE_PRIM_I128:  *open = true; /* fall through */
+        case TYPE_PRIM_I64:
+        case TYPE_PRIM_ISIZE: *bias = sign; *hi = UINT64_MAX; return true;
+        default:              return false;
+    }
+}
+
+static MatchPath *path_child(MatchCompiler *c, MatchPath *parent, MatchPathKind kind,
+                             uint32_t index, Type *type) {
+    for (MatchPath *child = parent->first_child; child; child = child->next_sibling) {
+        if (child->kind == kind && child->index == index) {
+            return child;
+        }
+    }
+
+    MatchPath *child = arena_calloc(c->arena, 1, sizeof(MatchPath));
+    child->kind = kind;
+    child->index = index;
+    child->type = type;
+    child->parent = parent;
+    child->next_sibling = parent->first_child;
+    parent->first_child = child;
+    return child;
+}
+
+static MatchPath *find_child(MatchPath *parent, MatchPathKind kind, uint32_t index) {
+    for (MatchPath *child = parent->first_child; child; child = child->next_sibling) {
+        if (child->kind == kind && child->index == index) {
+            return child;
+        }
+    }
+    return NULL;
+}
+
+static Type *declared_type(MatchCompiler *c, Type *owner, TypeExpr *declared) {
+    return declared ? c->types->member_type(c->types->state, owner, declared) : NULL;
+}
+
+/*
+ * ============================================
+ * Rows
+ * ============================================
+ */
+
+/*
+ * Reduce a pattern placed in a column to the test it makes: bindings and
+ * wildcards match anything (a binding is recorded on the row)
+ */
+static Pattern *normalize(MatchCompiler *c, MatchRow *row, MatchPath *path, Pattern *pat) {
+    if (!pat) return NULL;
+
+    switch (pat->kind) {
+        case PAT_WILDCARD:
+            return NULL;
+
+        case PAT_BINDING:
+            if (pat->binding.resolved) {
+                BindingList *binding = ARENA_ALLOC(c->arena, BindingList);
+                binding->sym = pat->binding.resolved;
+                binding->path = path;
+                binding->next = row->bindings;
+                row->bindings = binding;
+            }
+            return NULL;
+
+        case PAT_LITERAL:
+            /* `()` has no value to compare */
+            return pat->literal.value ? pat : NULL;
+
+        case PAT_GUARD:
+            /* Guards apply to whole arms; see match_compile */
+            return normalize(c, row, path, pat->guard.pattern);
+
+        default:
+            return pat;
+    }
+}
+
+/*
+ * Start a matrix that replaces column `col` of `in` with `k` sub-columns
+ */
+static void matrix_init(MatchCompiler *c, Matrix *out, const Matrix *in, uint32_t col,
+                        MatchPath **sub, uint32_t k, uint32_t row_cap) {
+    out->col_count = in->col_count - 1 + k;
+    out->paths = ARENA_ALLOC_ARRAY(c->arena, MatchPath *, out->col_count ? out->col_count : 1);
+    out->rows = ARENA_ALLOC_ARRAY(c->arena, MatchRow, row_cap ? row_cap : 1);
+    out->row_count = 0;
+
+    for (uint32_t i = 0; i < k; i++) {
+        out->paths[i] = sub[i];
+    }
+    for (uint32_t i = 0, j = k; i < in->col_count; i++) {
+        if (i != col) out->paths[j++] = in->paths[i];
+    }
+}
+
+/*
+ * Add a row to a matrix started with matrix_init: the sub-patterns of
+ * the replaced column (NULL entries, or NULL `cells`, are wildcards), then the
+ * row's other cells
+ */
+static void push_row(MatchCompiler *c, Matrix *out, const Matrix *in, const MatchRow *row,
+                     uint32_t col, Pattern **cells, uint32_t k) {
+    MatchRow *dst = &out->rows[out->row_count++];
+    *dst = *row;
+    dst->cells = ARENA_ALLOC_ARRAY(c->arena, Pattern *, out->col_count ? out->col_count : 1);
+
+    for (uint32_t i = 0; i < k; i++) {
+        dst->cells[i] = normalize(c, dst, out->paths[i], cells ? cells[i] : NULL);
+    }
+    for (uint32_t i = 0, j = k; i < in->col_count; i++) {
+        if (i != col) dst->cells[j++] = row->cells[i];
+    }
+}
+
+/* The rows that match anything in a column, with the column removed */
+static Decision *compile_default(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    Matrix out;
+    matrix_init(c, &out, m, col, NULL, 0, m->row_count);
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        if (!m->rows[r].cells[col]) {
+            push_row(c, &out, m, &m->rows[r], col, NULL, 0);
+        }
+    }
+    return compile(c, &out);
+}
+
+/*
+ * ============================================
+ * Witnesses
+ * ============================================
+ */
+
+static const Constraint *constraint_of(const MatchCompiler *c, const MatchPath *path) {
+    for (size_t i = vec_len(c->constraints); i-- > 0;) {
+        if (c->constraints[i].path == path) {
+            return &c->constraints[i];
+        }
+    }
+    return NULL;
+}
+
+static const char *render(MatchCompiler *c, MatchPath *path);
+
+static const char *render_child(MatchCompiler *c, MatchPath *parent, MatchPathKind kind,
+                                uint32_t index) {
+    MatchPath *child = find_child(parent, kind, index);
+    return child ? render(c, child) : "_";
+}
+
+/* ` { name: pattern, .. }` for the fields that are constrained, or "" */
+static const char *render_fields(MatchCompiler *c, MatchPath *parent, MatchPathKind kind,
+                                 Vec(FieldDecl) fields) {
+    const char *list = NULL;
+    for (size_t i = 0; i < vec_len(fields); i++) {
+        const char *field = render_child(c, parent, kind, (uint32_t)i);
+        if (strcmp(field, "_") == 0) continue;
+        field = arena_sprintf(c->arena, "%s: %s", fields[i].name.data, field);
+        list = list ? arena_sprintf(c->arena, "%s, %s", list, field) : field;
+    }
+    return list ? arena_sprintf(c->arena, " { %s, .. }", list) : "";
+}
+
+/*
+ * Render an example value of a path from the constraints on the current
+ * decision path; anything unconstrained is `_`
+ */
+static const char *render(MatchCompiler *c, MatchPath *path) {
+    Type *type = path->type;
+    const Constraint *fixed = constraint_of(c, path);
+    Decl *decl = type_decl(type);
+    uint64_t lo, hi, bias;
+    bool open;
+
+    if (!type) return "_";
+
+    if (type->kind == TYPE_TUPLE) {
+        const char *list = NULL;
+        for (size_t i = 0; i < vec_len(type->tuple.elements); i++) {
+            const char *elem = render_child(c, path, MATCH_PATH_ELEMENT, (uint32_t)i);
+            list = list ? arena_sprintf(c->arena, "%s, %s", list, elem) : elem;
+        }
+        return arena_sprintf(c->arena, "(%s)", list ? list : "");
+    }
+
+    if (decl && decl->kind == DECL_RECORD) {
+        const char *fields = render_fields(c, path, MATCH_PATH_ELEMENT, decl->record.fields);
+        return fields[0] ? arena_sprintf(c->arena, "%s%s", decl->record.name.data, fields) : "_";
+    }
+
+    if (!fixed) return "_";
+
+    if (decl && decl->kind == DECL_ENUM) {
+        EnumVariant *variant = &decl->enum_.variants[fixed->key];
+        if (!variant->payload) {
+            return arena_sprintf(c->arena, "%s::%s", decl->enum_.name.data, variant->name.data);
+        }
+        return arena_sprintf(c->arena, "%s::%s(%s)", decl->enum_.name.data, variant->name.data,
+            render_child(c, path, MATCH_PATH_PAYLOAD, (uint32_t)fixed->key));
+    }
+
+    if (decl && decl->kind == DECL_MODAL) {
+        ModalState *state = &decl->modal.states[fixed->key];
+        MatchPath *view = find_child(path, MATCH_PATH_PAYLOAD, (uint32_t)fixed->key);
+        return arena_sprintf(c->arena, "@%s%s", state->name.data,
+            view ? render_fields(c, view, MATCH_PATH_FIELD, state->fields) : "");
+    }
+
+    if (scalar_domain(type, &lo, &hi, &bias, &open)) {
+        uint64_t value = fixed->key ^ bias;
+        if (type->kind == TYPE_PRIM_BOOL) {
+            return value ? "true" : "false";
+        }
+        if (type->kind == TYPE_PRIM_CHAR) {
+            return value >= 0x20 && value < 0x7F && value != '\'' && value != '\\'
+                ? arena_sprintf(c->arena, "'%c'", (char)value)
+                : arena_sprintf(c->arena, "'\\u{%llx}'", (unsigned long long)value);
+        }
+        return bias ? arena_sprintf(c->arena, "%lld", (long long)(int64_t)value)
+                    : arena_sprintf(c->arena, "%llu", (unsigned long long)value);
+    }
+
+    return "_";
+}
+
+static Decision *compile_fixed(MatchCompiler *c, const Matrix *m, MatchPath *path, uint64_t key) {
+    Constraint fixed = { path, key };
+    vec_push(c->constraints, fixed);
+    Decision *d = compile(c, m);
+    vec_pop(c->constraints);
+    return d;
+}
+
+/*
+ * ============================================
+ * Leaves
+ * ============================================
+ */
+
+static Decision *fail(MatchCompiler *c) {
+    Decision *d = arena_calloc(c->arena, 1, sizeof(Decision));
+    d->kind = DECISION_FAIL;
+    if (!c->missing) {
+        c->missing = render(c, c->root);
+    }
+    return d;
+}
+
+/* The first row matches: bind, then run its arm unless the guard fails */
+static Decision *leaf(MatchCompiler *c, const Matrix *m) {
+    const MatchRow *row = &m->rows[0];
+    Decision *d = arena_calloc(c->arena, 1, sizeof(Decision));
+    d->kind = DECISION_LEAF;
+    d->leaf.arm = row->arm;
+    d->leaf.guard = row->guard;
+    c->reached[row->arm] = true;
+
+    uint32_t count = 0;
+    for (BindingList *b = row->bindings; b; b = b->next) count++;
+    d->leaf.bindings = ARENA_ALLOC_ARRAY(c->arena, MatchBinding, count ? count : 1);
+    d->leaf.binding_count = count;
+    for (BindingList *b = row->bindings; b; b = b->next) {
+        d->leaf.bindings[--count] = (MatchBinding){ b->sym, b->path };
+    }
+
+    if (row->guard) {
+        Matrix rest = *m;
+        rest.rows++;
+        rest.row_count--;
+        d->leaf.guard_failed = compile(c, &rest);
+    }
+    return d;
+}
+
+static Decision *new_switch(MatchCompiler *c, MatchPath *path, SwitchTest test,
+                            uint32_t case_cap) {
+    Decision *d = arena_calloc(c->arena, 1, sizeof(Decision));
+    d->kind = DECISION_SWITCH;
+    d->switch_.path = path;
+    d->switch_.test = test;
+    d->switch_.cases = arena_calloc(c->arena, case_cap ? case_cap : 1, sizeof(DecisionCase));
+    return d;
+}
+
+/*
+ * ============================================
+ * Splitting Columns
+ * ============================================
+ */
+
+/* Replace or-patterns in a column with one row per alternative */
+static Decision *expand_or(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    uint32_t total = 0;
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        total += pat && pat->kind == PAT_OR ? (uint32_t)vec_len(pat->or_.alternatives) : 1;
+    }
+
+    Matrix out = *m;
+    out.rows = ARENA_ALLOC_ARRAY(c->arena, MatchRow, total ? total : 1);
+    out.row_count = 0;
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        const MatchRow *row = &m->rows[r];
+        Pattern *pat = row->cells[col];
+        if (!pat || pat->kind != PAT_OR) {
+            out.rows[out.row_count++] = *row;
+            continue;
+        }
+        for (size_t i = 0; i < vec_len(pat->or_.alternatives); i++) {
+            MatchRow *dst = &out.rows[out.row_count++];
+            *dst = *row;
+            dst->cells = ARENA_ALLOC_ARRAY(c->arena, Pattern *, m->col_count);
+            memcpy(dst->cells, row->cells, m->col_count * sizeof(Pattern *));
+            dst->cells[col] = normalize(c, dst, m->paths[col], pat->or_.alternatives[i]);
+        }
+    }
+    return compile(c, &out);
+}
+
+/* Tuples and records have one shape: test their elements instead */
+static Decision *split_product(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    MatchPath *path = m->paths[col];
+    Type *type = path->type;
+    Decl *decl = type_decl(type);
+    bool is_tuple = type->kind == TYPE_TUPLE;
+    uint32_t k = is_tuple ? (uint32_t)vec_len(type->tuple.elements)
+                          : (uint32_t)vec_len(decl->record.fields);
+
+    MatchPath **sub = ARENA_ALLOC_ARRAY(c->arena, MatchPath *, k ? k : 1);
+    for (uint32_t i = 0; i < k; i++) {
+        sub[i] = path_child(c, path, MATCH_PATH_ELEMENT, i, is_tuple
+            ? type->tuple.elements[i]
+            : declared_type(c, type, decl->record.fields[i].type));
+    }
+
+    Matrix out;
+    Pattern **cells = ARENA_ALLOC_ARRAY(c->arena, Pattern *, k ? k : 1);
+    matrix_init(c, &out, m, col, sub, k, m->row_count);
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        memset(cells, 0, (k ? k : 1) * sizeof(Pattern *));
+
+        if (pat && is_tuple && pat->kind == PAT_TUPLE &&
+            vec_len(pat->tuple.elements) == k) {
+            memcpy(cells, pat->tuple.elements, k * sizeof(Pattern *));
+        } else if (pat && !is_tuple && pat->kind == PAT_RECORD) {
+            MemberTable *members = decl_members(decl);
+            for (size_t i = 0; i < vec_len(pat->record.field_names); i++) {
+                Member *field = member_field(members, pat->record.field_names[i]);
+                if (!field) {
+                    c->failed = true;
+                    continue;
+                }
+                cells[field->index] = pat->record.field_patterns[i];
+            }
+        } else if (pat) {
+            c->failed = true;
+        }
+        push_row(c, &out, m, &m->rows[r], col, cells, k);
+    }
+    return compile(c, &out);
+}
+
+/* Variant or state index a pattern selects (UINT32_MAX if it does not fit) */
+static uint32_t pattern_tag(MatchCompiler *c, Decl *decl, Pattern *pat) {
+    Member *member = NULL;
+    if (decl->kind == DECL_ENUM && pat->kind == PAT_ENUM) {
+        member = member_variant(decl_members(decl), pat->enum_.variant);
+    } else if (decl->kind == DECL_MODAL && pat->kind == PAT_MODAL) {
+        member = member_state(decl_members(decl), pat->modal.state);
+    }
+    if (!member) {
+        c->failed = true;
+        return UINT32_MAX;
+    }
+    return member->index;
+}
+
+/*
+ * Switch on an enum's variant or a modal value's state. Each case tests
+ * the variant's payload or the state's fields next; values of the
+ * variants no row names go to the default rows.
+ */
+static Decision *split_tags(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    MatchPath *path = m->paths[col];
+    Type *type = path->type;
+    Decl *decl = type_decl(type);
+    bool is_enum = decl->kind == DECL_ENUM;
+    uint32_t count = is_enum ? (uint32_t)vec_len(decl->enum_.variants)
+                             : (uint32_t)vec_len(decl->modal.states);
+
+    /* A value of a known modal state can only be in that state */
+    uint32_t only = UINT32_MAX;
+    if (type->kind == TYPE_MODAL_STATE) {
+        Member *state = member_state(decl_members(decl), type->modal_state.state_name);
+        only = state ? state->index : UINT32_MAX;
+    }
+
+    bool *used = arena_calloc(c->arena, count ? count : 1, sizeof(bool));
+    uint32_t used_count = 0;
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        uint32_t tag = pat ? pattern_tag(c, decl, pat) : UINT32_MAX;
+        if (tag < count && !used[tag]) {
+            used[tag] = true;
+            used_count++;
+        }
+    }
+
+    Decision *d = new_switch(c, path, is_enum ? SWITCH_VARIANT : SWITCH_STATE, used_count);
+    uint32_t missing = UINT32_MAX;
+    for (uint32_t tag = 0; tag < count; tag++) {
+        if (!used[tag]) {
+            if (missing == UINT32_MAX && (only == UINT32_MAX || tag == only)) {
+                missing = tag;
+            }
+            continue;
+        }
+
+        /* Sub-values the case tests next */
+        uint32_t k;
+        MatchPath **sub;
+        MemberTable *state_members = NULL;
+        if (is_enum) {
+            TypeExpr *payload = decl->enum_.variants[tag].payload;
+            k = payload ? 1 : 0;
+            sub = ARENA_ALLOC_ARRAY(c->arena, MatchPath *, 1);
+            if (payload) {
+                sub[0] = path_child(c, path, MATCH_PATH_PAYLOAD, tag,
+                    declared_type(c, type, payload));
+            }
+        } else {
+            ModalState *state = &decl->modal.states[tag];
+            MatchPath *view = path_child(c, path, MATCH_PATH_PAYLOAD, tag, NULL);
+            k = (uint32_t)vec_len(state->fields);
+            sub = ARENA_ALLOC_ARRAY(c->arena, MatchPath *, k ? k : 1);
+            for (uint32_t i = 0; i < k; i++) {
+                sub[i] = path_child(c, view, MATCH_PATH_FIELD, i,
+                    declared_type(c, type, state->fields[i].type));
+            }
+            Member *member = member_state(decl_members(decl), state->name);
+            state_members = member ? member->members : NULL;
+        }
+
+        Matrix out;
+        Pattern **cells = ARENA_ALLOC_ARRAY(c->arena, Pattern *, k ? k : 1);
+        matrix_init(c, &out, m, col, sub, k, m->row_count);
+        for (uint32_t r = 0; r < m->row_count; r++) {
+            Pattern *pat = m->rows[r].cells[col];
+            memset(cells, 0, (k ? k : 1) * sizeof(Pattern *));
+            if (pat) {
+                if (pattern_tag(c, decl, pat) != tag) continue;
+                if (is_enum) {
+                    cells[0] = pat->enum_.payload;
+                } else {
+                    for (size_t i = 0; i < vec_len(pat->modal.field_names); i++) {
+                        Member *field = member_field(state_members, pat->modal.field_names[i]);
+                        if (!field) {
+                            c->failed = true;
+                            continue;
+                        }
+                        cells[field->index] = pat->modal.field_patterns[i];
+                    }
+                }
+            }
+            push_row(c, &out, m, &m->rows[r], col, cells, k);
+        }
+
+        DecisionCase *arm = &d->switch_.cases[d->switch_.case_count++];
+        arm->lo = arm->hi = tag;
+        arm->next = compile_fixed(c, &out, path, tag);
+    }
+
+    if (missing != UINT32_MAX) {
+        Constraint fixed = { path, missing };
+        vec_push(c->constraints, fixed);
+        d->switch_.fallback = compile_default(c, m, col);
+        vec_pop(c->constraints);
+    }
+    return d;
+}
+
+/* Key of a literal in a scalar column (false if it is not a scalar literal) */
+static bool literal_key(Pattern *pat, uint64_t bias, uint64_t *key) {
+    Expr *value = pat && pat->kind == PAT_LITERAL ? pat->literal.value : NULL;
+    if (!value) return false;
+
+    switch (value->kind) {
+        case EXPR_INT_LIT:  *key = value->int_lit.value; break;
+        case EXPR_CHAR_LIT: *key = value->char_lit.value; break;
+        case EXPR_BOOL_LIT: *key = value->bool_lit.value ? 1 : 0; break;
+        case EXPR_UNARY:
+            if (value->unary.op != UNOP_NEG || value->unary.operand->kind != EXPR_INT_LIT) {
+                return false;
+            }
+            *key = (uint64_t)0 - value->unary.operand->int_lit.value;
+            break;
+        default:
+            return false;
+    }
+    *key ^= bias;
+    return true;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Switch on an integer, char or bool value. The row intervals cut the
+ * domain into pieces no row tells apart; adjacent pieces matched by the
+ * same rows form one case, and pieces no literal covers go to the
+ * default rows.
+ */
+static Decision *split_ranges(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    MatchPath *path = m->paths[col];
+    uint64_t dom_lo, dom_hi, bias;
+    bool open;
+    scalar_domain(path->type, &dom_lo, &dom_hi, &bias, &open);
+
+    /* Each row's interval, clamped to the domain (any: wildcard) */
+    uint32_t n = m->row_count;
+    uint64_t *lo = ARENA_ALLOC_ARRAY(c->arena, uint64_t, n);
+    uint64_t *hi = ARENA_ALLOC_ARRAY(c->arena, uint64_t, n);
+    bool *any = ARENA_ALLOC_ARRAY(c->arena, bool, n);
+    uint64_t *cuts = ARENA_ALLOC_ARRAY(c->arena, uint64_t, 2 * n + 1);
+    uint32_t cut_count = 0;
+    cuts[cut_count++] = dom_lo;
+
+    for (uint32_t r = 0; r < n; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        any[r] = !pat;
+        lo[r] = 1;
+        hi[r] = 0;
+        if (!pat) continue;
+
+        bool ok;
+        if (pat->kind == PAT_RANGE) {
+            ok = literal_key(pat->range.start, bias, &lo[r]) &&
+                 literal_key(pat->range.end, bias, &hi[r]);
+            if (ok && !pat->range.inclusive) {
+                if (hi[r] == 0) lo[r] = 1;
+                else hi[r]--;
+            }
+        } else {
+            ok = literal_key(pat, bias, &lo[r]);
+            hi[r] = lo[r];
+        }
+        if (!ok) {
+            c->failed = true;
+            any[r] = true;
+            continue;
+        }
+
+        if (lo[r] < dom_lo) lo[r] = dom_lo;
+        if (hi[r] > dom_hi) hi[r] = dom_hi;
+        if (lo[r] > hi[r]) continue;
+        cuts[cut_count++] = lo[r];
+        if (hi[r] < dom_hi) cuts[cut_count++] = hi[r] + 1;
+    }
+
+    qsort(cuts, cut_count, sizeof(uint64_t), compare_keys);
+
+    /* Matching rows of each piece; merge runs of pieces with equal rows */
+    Decision *d = new_switch(c, path, SWITCH_RANGE, cut_count);
+    d->switch_.key_bias = bias;
+    bool **rows_of = ARENA_ALLOC_ARRAY(c->arena, bool *, cut_count);
+    bool have_gap = false;
+    uint64_t gap = 0;
+
+    for (uint32_t i = 0; i < cut_count; i++) {
+        if (i > 0 && cuts[i] == cuts[i - 1]) continue;
+        uint64_t piece_lo = cuts[i];
+        uint64_t piece_hi = dom_hi;
+        for (uint32_t j = i + 1; j < cut_count; j++) {
+            if (cuts[j] != piece_lo) {
+                piece_hi = cuts[j] - 1;
+                break;
+            }
+        }
+
+        bool *rows = ARENA_ALLOC_ARRAY(c->arena, bool, n ? n : 1);
+        bool covered = false;
+        for (uint32_t r = 0; r < n; r++) {
+            bool inside = !any[r] && lo[r] <= piece_lo && piece_lo <= hi[r];
+            rows[r] = any[r] || inside;
+            covered |= inside;
+        }
+        if (!covered) {
+            if (!have_gap) gap = piece_lo;
+            have_gap = true;
+            continue;
+        }
+
+        uint32_t last = d->switch_.case_count;
+        if (last > 0 && d->switch_.cases[last - 1].hi + 1 == piece_lo &&
+            memcmp(rows_of[last - 1], rows, n * sizeof(bool)) == 0) {
+            d->switch_.cases[last - 1].hi = piece_hi;
+            continue;
+        }
+        rows_of[last] = rows;
+        d->switch_.cases[last].lo = piece_lo;
+        d->switch_.cases[last].hi = piece_hi;
+        d->switch_.case_count++;
+    }
+
+    for (uint32_t i = 0; i < d->switch_.case_count; i++) {
+        Matrix out;
+        matrix_init(c, &out, m, col, NULL, 0, n);
+        for (uint32_t r = 0; r < n; r++) {
+            if (rows_of[i][r]) push_row(c, &out, m, &m->rows[r], col, NULL, 0);
+        }
+        d->switch_.cases[i].next = compile_fixed(c, &out, path, d->switch_.cases[i].lo);
+    }
+
+    if (have_gap) {
+        Constraint fixed = { path, gap };
+        vec_push(c->constraints, fixed);
+        d->switch_.fallback = compile_default(c, m, col);
+        vec_pop(c->constraints);
+    } else if (open) {
+        d->switch_.fallback = compile_default(c, m, col);
+    }
+    return d;
+}
+
+static bool literal_equal(Expr *a, Expr *b) {
+    if (a->kind != b->kind) return false;
+    switch (a->kind) {
+        case EXPR_FLOAT_LIT:
+            return a->float_lit.value == b->float_lit.value;
+        case EXPR_STRING_LIT:
+            return a->string_lit.value.len == b->string_lit.value.len &&
+                   memcmp(a->string_lit.value.data, b->string_lit.value.data,
+                          a->string_lit.value.len) == 0;
+        default:
+            return false;
+    }
+}
+
+/*
+ * Compare against each distinct literal in turn (floats, strings). The
+ * domain has no useful bound, so the default rows always follow.
+ */
+static Decision *split_values(MatchCompiler *c, const Matrix *m, uint32_t col) {
+    MatchPath *path = m->paths[col];
+    uint32_t n = m->row_count;
+    Expr **values = ARENA_ALLOC_ARRAY(c->arena, Expr *, n);
+    uint32_t value_count = 0;
+
+    for (uint32_t r = 0; r < n; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        if (!pat) continue;
+        if (pat->kind != PAT_LITERAL) {
+            c->failed = true;
+            continue;
+        }
+        uint32_t i = 0;
+        while (i < value_count && !literal_equal(values[i], pat->literal.value)) i++;
+        if (i == value_count) values[value_count++] = pat->literal.value;
+    }
+
+    Decision *d = new_switch(c, path, SWITCH_VALUE, value_count);
+    for (uint32_t i = 0; i < value_count; i++) {
+        Matrix out;
+        matrix_init(c, &out, m, col, NULL, 0, n);
+        for (uint32_t r = 0; r < n; r++) {
+            Pattern *pat = m->rows[r].cells[col];
+            if (!pat || (pat->kind == PAT_LITERAL && literal_equal(values[i], pat->literal.value))) {
+                push_row(c, &out, m, &m->rows[r], col, NULL, 0);
+            }
+        }
+        DecisionCase *arm = &d->switch_.cases[d->switch_.case_count++];
+        arm->lo = arm->hi = i;
+        arm->value = values[i];
+        arm->next = compile(c, &out);
+    }
+    d->switch_.fallback = compile_default(c, m, col);
+    return d;
+}
+
+/*
+ * ============================================
+ * Matrix Compilation
+ * ============================================
+ */
+
+static Decision *compile(MatchCompiler *c, const Matrix *m) {
+    if (m->row_count == 0) {
+        return fail(c);
+    }
+
+    /* The first row matches once every column it tests is gone */
+    uint32_t col = 0;
+    while (col < m->col_count && !m->rows[0].cells[col]) col++;
+    if (col == m->col_count) {
+        return leaf(c, m);
+    }
+
+    for (uint32_t r = 0; r < m->row_count; r++) {
+        Pattern *pat = m->rows[r].cells[col];
+        if (pat && pat->kind == PAT_OR) {
+            return expand_or(c, m, col);
+        }
+    }
+
+    Type *type = m->paths[col]->type;
+    Decl *decl = type_decl(type);
+    uint64_t lo, hi, bias;
+    bool open;
+
+    if (!type || type->kind == TYPE_ERROR) {
+        c->failed = true;
+        return compile_default(c, m, col);
+    }
+    if (type->kind == TYPE_TUPLE || (decl && decl->kind == DECL_RECORD)) {
+        return split_product(c, m, col);
+    }
+    if (decl && (decl->kind == DECL_ENUM || decl->kind == DECL_MODAL)) {
+        return split_tags(c, m, col);
+    }
+    if (scalar_domain(type, &lo, &hi, &bias, &open)) {
+        return split_ranges(c, m, col);
+    }
+    return split_values(c, m, col);
+}
+
+Decision *match_compile(Arena *arena, DiagContext *diag, const MatchTypes *types,
+                        Expr *match, Type *scrutinee_type) {
+    size_t arm_count = vec_len(match->match.arms_patterns);
+    if (!scrutinee_type || scrutinee_type->kind == TYPE_ERROR) {
+        return NULL;
+    }
+
+    MatchCompiler c;
+    memset(&c, 0, sizeof(c));
+    c.arena = arena;
+    c.types = types;
+    c.root = arena_calloc(arena, 1, sizeof(MatchPath));
+    c.root->kind = MATCH_PATH_ROOT;
+    c.root->type = scrutinee_type;
+    c.reached = arena_calloc(arena, arm_count ? arm_count : 1, sizeof(bool));
+    c.constraints = vec_new(Constraint);
+
+    /* One row per arm, one column for the scrutinee */
+    Matrix m;
+    m.col_count = 1;
+    m.paths = &c.root;
+    m.rows = arena_calloc(arena, arm_count ? arm_count : 1, sizeof(MatchRow));
+    m.row_count = (uint32_t)arm_count;
+    for (size_t i = 0; i < arm_count; i++) {
+        MatchRow *row = &m.rows[i];
+        Pattern *pat = match->match.arms_patterns[i];
+        row->arm = (uint32_t)i;
+        if (pat && pat->kind == PAT_GUARD) {
+            row->guard = pat->guard.guard;
+            pat = pat->guard.pattern;
+        }
+        row->cells = ARENA_ALLOC_ARRAY(arena, Pattern *, 1);
+        row->cells[0] = normalize(&c, row, c.root, pat);
+    }
+
+    Decision *tree = compile(&c, &m);
+    vec_free(c.constraints);
+    if (c.failed) {
+        return NULL;
+    }
+
+    if (c.missing) {
+        diag_report(diag, DIAG_ERROR, E_TYP_2060, match->span,
+            "non-exhaustive match: '%s' not covered", c.missing);
+    }
+    for (size_t i = 0; i < arm_count; i++) {
+        if (!c.reached[i]) {
+            diag_report(diag, DIAG_WARNING, E_TYP_2061, match->match.arms_patterns[i]->span,
+                "unreachable match arm");
+        }
+    }
+    return tree;
+}
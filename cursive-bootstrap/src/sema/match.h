@@ -0,0 +1,123 @@
+/*
+ * Cursive Bootstrap Compiler - Match Compilation
+ *
+ * Compiles the arms of a `match` into a decision tree with a pattern
+ * matrix: one row per arm (or per alternative of an or-pattern), one
+ * column per sub-value still to be tested. Each step picks a column the
+ * first row refutes and splits the matrix on that column's constructors,
+ * so a test shared by several arms is made once on every path.
+ *
+ * Enum and modal columns switch on the variant or state; integer, char
+ * and bool columns split their domain into the intervals the literal and
+ * range patterns distinguish; other literals (floats, strings) become
+ * equality tests. A path that reaches no arm is a missing case, and an
+ * arm that no leaf reaches is redundant, so exhaustiveness and
+ * redundancy are read off the same tree that code generation lowers.
+ */
+
+#ifndef CURSIVE_SEMA_MATCH_H
+#define CURSIVE_SEMA_MATCH_H
+
+#include "scope.h"
+#include "types.h"
+#include "common/error.h"
+
+/*
+ * A sub-value of the scrutinee. Paths are interned per match: the child
+ * of a path for a given projection is created once, so decisions and
+ * bindings that test the same sub-value share one node.
+ */
+typedef enum MatchPathKind {
+    MATCH_PATH_ROOT,       /* The scrutinee itself */
+    MATCH_PATH_ELEMENT,    /* Tuple element or record field (by member index) */
+    MATCH_PATH_PAYLOAD,    /* Payload of an enum variant, or the fields of a modal
+                              state, by variant or state index */
+    MATCH_PATH_FIELD       /* Field of a modal state payload (by member index) */
+} MatchPathKind;
+
+typedef struct MatchPath MatchPath;
+struct MatchPath {
+    MatchPathKind kind;
+    uint32_t index;            /* Element, field or variant index */
+    Type *type;                /* Type of the sub-value (NULL if unknown) */
+    MatchPath *parent;
+    MatchPath *first_child;
+    MatchPath *next_sibling;
+};
+
+/* A binding made on the way to a leaf */
+typedef struct MatchBinding {
+    Symbol *sym;
+    MatchPath *path;
+} MatchBinding;
+
+typedef enum DecisionKind {
+    DECISION_FAIL,         /* No arm matches (only in non-exhaustive trees) */
+    DECISION_LEAF,         /* Bind, check the guard, run an arm */
+    DECISION_SWITCH        /* Test one sub-value */
+} DecisionKind;
+
+typedef enum SwitchTest {
+    SWITCH_VARIANT,        /* Enum tag; case keys are variant indices */
+    SWITCH_STATE,          /* Modal state; case keys are state indices */
+    SWITCH_RANGE,          /* Integer, char or bool value in [lo, hi] */
+    SWITCH_VALUE           /* Equality with a literal (floats, strings) */
+} SwitchTest;
+
+typedef struct Decision Decision;
+
+/*
+ * One outgoing edge of a switch. Range keys are the values with the
+ * switch's key_bias XORed in, so signed values order correctly as
+ * unsigned keys.
+ */
+typedef struct DecisionCase {
+    uint64_t lo;
+    uint64_t hi;               /* Inclusive; lo == hi except for ranges */
+    Expr *value;               /* SWITCH_VALUE: the literal compared against */
+    Decision *next;
+} DecisionCase;
+
+struct Decision {
+    DecisionKind kind;
+    union {
+        struct {
+            uint32_t arm;
+            MatchBinding *bindings;
+            uint32_t binding_count;
+            Expr *guard;               /* NULL if the arm has none */
+            Decision *guard_failed;    /* Where to continue if the guard is false */
+        } leaf;
+
+        struct {
+            MatchPath *path;
+            SwitchTest test;
+            DecisionCase *cases;       /* Ascending by key */
+            uint32_t case_count;
+            uint64_t key_bias;         /* SWITCH_RANGE: 1 << 63 for signed types */
+            Decision *fallback;        /* Values no case covers (NULL if none) */
+        } switch_;
+    };
+};
+
+/*
+ * Types of the sub-values the compiler expands into: the declared type
+ * of a record field, variant payload or state field as seen through its
+ * owner (which may be a generic instantiation)
+ */
+typedef struct MatchTypes {
+    void *state;
+    Type *(*member_type)(void *state, Type *owner, TypeExpr *declared);
+} MatchTypes;
+
+/*
+ * Compile the arms of a match expression whose scrutinee has type
+ * `scrutinee_type`. Missing cases are reported as E_TYP_2060 with an
+ * example value and unreachable arms as E_TYP_2061 warnings. Returns
+ * NULL if the patterns do not fit the scrutinee type (already reported
+ * by the type checker).
+ */
+Decision *match_compile(Arena *arena, DiagContext *diag, const MatchTypes *types,
+                        Expr *match, Type *scrutinee_type);
+
+#endif /* CURSIVE_SEMA_MATCH_H */
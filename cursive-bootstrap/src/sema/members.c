@@ -0,0 +1,162 @@
+/*
+ * Cursive Bootstrap Compiler - Member Tables
+ *
+ * Builds the per-declaration member indices used by the type checker
+ * and code generator.
+ */
+
+#include "members.h"
+
+/*
+ * ============================================
+ * Table Construction
+ * ============================================
+ */
+
+/* Allocate a table, recorded in `tables` so its maps can be freed */
+static MemberTable *member_table_new(Arena *arena, Vec(MemberTable *) *tables) {
+    MemberTable *table = ARENA_ALLOC(arena, MemberTable);
+    memset(table, 0, sizeof(MemberTable));
+    vec_push(*tables, table);
+    return table;
+}
+
+/*
+ * Add a member to one of a table's maps. Maps are only allocated once
+ * something is added, so declarations without e.g. methods cost nothing.
+ * Returns NULL (and reports) if the name is already taken.
+ */
+static Member *member_add(Arena *arena, DiagContext *diag, Map *map,
+                          InternedString name, const char *what, SourceSpan span) {
+    if (map->capacity == 0) {
+        map_init(map);
+    } else if (map_contains(map, name)) {
+        diag_report(diag, DIAG_ERROR, E_RES_0201, span,
+            "duplicate %s '%.*s'", what, (int)name.len, name.data);
+        return NULL;
+    }
+
+    Member *member = ARENA_ALLOC(arena, Member);
+    memset(member, 0, sizeof(Member));
+    member->index = (uint32_t)map->count;
+    map_set(map, name, member);
+    return member;
+}
+
+static void add_fields(Arena *arena, DiagContext *diag, MemberTable *table,
+                       Vec(FieldDecl) fields) {
+    for (size_t i = 0; i < vec_len(fields); i++) {
+        Member *m = member_add(arena, diag, &table->fields, fields[i].name,
+                               "field", fields[i].span);
+        if (m) m->field = &fields[i];
+    }
+}
+
+static void add_methods(Arena *arena, DiagContext *diag, MemberTable *table,
+                        Vec(ProcDecl) methods) {
+    for (size_t i = 0; i < vec_len(methods); i++) {
+        Member *m = member_add(arena, diag, &table->methods, methods[i].name,
+                               "method", methods[i].span);
+        if (m) m->method = &methods[i];
+    }
+}
+
+/*
+ * Build and attach the member table of a type declaration
+ */
+void members_build_decl(Arena *arena, DiagContext *diag, Vec(MemberTable *) *tables,
+                        Decl *decl) {
+    MemberTable *table;
+
+    switch (decl->kind) {
+        case DECL_RECORD:
+            table = member_table_new(arena, tables);
+            add_fields(arena, diag, table, decl->record.fields);
+            add_methods(arena, diag, table, decl->record.methods);
+            decl->record.members = table;
+            break;
+
+        case DECL_ENUM: {
+            EnumDecl *en = &decl->enum_;
+            table = member_table_new(arena, tables);
+            for (size_t i = 0; i < vec_len(en->variants); i++) {
+                Member *m = member_add(arena, diag, &table->variants,
+                                       en->variants[i].name, "variant",
+                                       en->variants[i].span);
+                if (m) m->variant = &en->variants[i];
+            }
+            add_methods(arena, diag, table, en->methods);
+            en->members = table;
+            break;
+        }
+
+        case DECL_MODAL: {
+            ModalDecl *modal = &decl->modal;
+            table = member_table_new(arena, tables);
+            add_methods(arena, diag, table, modal->shared_methods);
+            for (size_t i = 0; i < vec_len(modal->states); i++) {
+                ModalState *state = &modal->states[i];
+                Member *m = member_add(arena, diag, &table->states, state->name,
+                                       "state", state->span);
+                if (!m) continue;
+
+                m->state = state;
+                m->members = member_table_new(arena, tables);
+                add_fields(arena, diag, m->members, state->fields);
+                add_methods(arena, diag, m->members, state->methods);
+            }
+            modal->members = table;
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+/*
+ * Free the maps of every recorded table
+ */
+void members_destroy(Vec(MemberTable *) *tables) {
+    for (size_t i = 0; i < vec_len(*tables); i++) {
+        MemberTable *table = (*tables)[i];
+        map_destroy(&table->fields);
+        map_destroy(&table->methods);
+        map_destroy(&table->variants);
+        map_destroy(&table->states);
+    }
+    vec_free(*tables);
+}
+
+/*
+ * ============================================
+ * Lookup
+ * ============================================
+ */
+
+MemberTable *decl_members(Decl *decl) {
+    if (!decl) return NULL;
+
+    switch (decl->kind) {
+        case DECL_RECORD: return decl->record.members;
+        case DECL_ENUM:   return decl->enum_.members;
+        case DECL_MODAL:  return decl->modal.members;
+        default:          return NULL;
+    }
+}
+
+Member *member_field(const MemberTable *table, InternedString name) {
+    return table ? map_get(&table->fields, name) : NULL;
+}
+
+Member *member_method(const MemberTable *table, InternedString name) {
+    return table ? map_get(&table->methods, name) : NULL;
+}
+
+Member *member_variant(const MemberTable *table, InternedString name) {
+    return table ? map_get(&table->variants, name) : NULL;
+}
+
+Member *member_state(const MemberTable *table, InternedString name) {
+    return table ? map_get(&table->states, name) : NULL;
+}
@@ -0,0 +1,63 @@
+/*
+ * Cursive Bootstrap Compiler - Member Tables
+ *
+ * Per-declaration indices of fields, methods, enum variants and modal
+ * states, built once after name resolution. Lookups by member name are
+ * a single hash probe instead of a scan over the declaration's vectors,
+ * and every member carries a dense index (field slot, variant tag,
+ * declaration order) that code generation can use directly.
+ */
+
+#ifndef CURSIVE_SEMA_MEMBERS_H
+#define CURSIVE_SEMA_MEMBERS_H
+
+#include "common/arena.h"
+#include "common/error.h"
+#include "common/map.h"
+#include "parser/ast.h"
+
+typedef struct MemberTable MemberTable;
+
+/*
+ * A named member of a type declaration
+ */
+typedef struct Member {
+    uint32_t index;              /* Dense position among members of its kind */
+    union {
+        FieldDecl *field;        /* Record or state field */
+        ProcDecl *method;        /* Method */
+        EnumVariant *variant;    /* Enum variant */
+        ModalState *state;       /* Modal state */
+    };
+    MemberTable *members;        /* Members of a modal state (NULL otherwise) */
+} Member;
+
+/*
+ * Name -> Member indices for one declaration (or one modal state)
+ */
+struct MemberTable {
+    Map fields;      /* Record fields / state fields */
+    Map methods;     /* Record and enum methods, modal shared / state methods */
+    Map variants;    /* Enum variants */
+    Map states;      /* Modal states */
+};
+
+/* Build the member table of a record, enum or modal declaration and store
+ * it on the declaration. Duplicate member names are reported to diag.
+ * Every table built is recorded in `tables`. */
+void members_build_decl(Arena *arena, DiagContext *diag, Vec(MemberTable *) *tables,
+                        Decl *decl);
+
+/* Free the maps of the recorded tables, and the list */
+void members_destroy(Vec(MemberTable *) *tables);
+
+/* Get the member table of a declaration (NULL if it has none) */
+MemberTable *decl_members(Decl *decl);
+
+/* Lookups (NULL table or missing name returns NULL) */
+Member *member_field(const MemberTable *table, InternedString name);
+Member *member_method(const MemberTable *table, InternedString name);
+Member *member_variant(const MemberTable *table, InternedString name);
+Member *member_state(const MemberTable *table, InternedString name);
+
+#endif /* CURSIVE_SEMA_MEMBERS_H */
@@ -12,9 +12,22 @@
  * - `let x = v` / `var x = v`: Movable bindings (= operator)
  * - `let x := v` / `var x := v`: Immovable bindings (:= operator)
  * - `move expr`: Explicit move, transfers responsibility
+ *
+ * Binding states are a forward "may" dataflow problem over the body's
+ * control-flow graph (cfg.h, dataflow.h): each slot has a moved, a
+ * partially-moved and an uninitialized bit, merged with union at joins
+ * and iterated to a fixpoint around loops. Uses are checked by replaying
+ * each block's operations from its solved entry state.
+ *
+ * Checks that do not depend on control flow (moving from an immovable
+ * binding, assigning to an immutable one, break outside a loop) run
+ * directly in the fused body walker (visit.h), which shares one traversal
+ * with permission checking.
  */
 
 #include "sema.h"
+#include "cfg.h"
+#include "dataflow.h"
 #include <string.h>
 
 /*
@@ -23,24 +36,25 @@
  * ============================================
  */
 
-typedef enum BindingState {
-    BIND_STATE_UNINITIALIZED,     /* Never assigned */
-    BIND_STATE_VALID,             /* Has valid value */
-    BIND_STATE_MOVED,             /* Moved out */
-    BIND_STATE_PARTIALLY_MOVED    /* Some fields moved (records) */
-} BindingState;
+/*
+ * Dataflow facts. Fact f of slot s is bit f * local_count + s.
+ */
+typedef enum MoveFact {
+    FACT_MOVED,                /* May have been moved out */
+    FACT_PARTIALLY_MOVED,      /* Some field may have been moved out */
+    FACT_UNINITIALIZED,        /* May not have been assigned a value */
+    FACT_COUNT
+} MoveFact;
 
 /*
- * Binding info tracked during analysis
+ * Binding properties (flow-insensitive), indexed by slot
  */
 typedef struct BindingInfo {
-    Symbol *sym;               /* The binding symbol */
-    BindingState state;        /* Current state */
+    Symbol *sym;               /* The binding symbol (NULL if not yet bound) */
     bool is_movable;           /* = vs := */
     bool is_mutable;           /* var vs let */
     Permission perm;           /* Permission */
-    SourceSpan last_use_span;  /* Location of last use (for diagnostics) */
-    Vec(InternedString) moved_fields; /* For partial moves */
+    SourceSpan move_span;      /* Location of a move (for diagnostics) */
 } BindingInfo;
 
 /*
@@ -51,8 +65,16 @@ typedef struct MoveContext {
     Arena *arena;
     DiagContext *diag;
 
-    /* Current binding state map: Symbol* -> BindingInfo* */
-    PtrMap bindings;
+    /* Binding properties of the current body, indexed by Symbol.slot */
+    BindingInfo *bindings;
+    uint32_t binding_count;
+    uint32_t binding_cap;
+
+    /* Control-flow graph of the current body (built by the CFG pass) */
+    Cfg *cfg;
+
+    /* Binding state problem, reused across bodies */
+    Dataflow flow;
 
     /* Stack of scopes for drop tracking (simplified - just track count) */
     size_t scope_depth;
@@ -60,9 +82,6 @@ typedef struct MoveContext {
     /* Current procedure return type (for result checking) */
     Type *return_type;
 
-    /* Current procedure's scope (for symbol lookup) */
-    Scope *proc_scope;
-
     /* Are we in a loop? (for break/continue analysis) */
     int loop_depth;
 
@@ -70,14 +89,6 @@ typedef struct MoveContext {
     Vec(Expr *) defers;
 } MoveContext;
 
-/* Forward declarations */
-static void analyze_expr(MoveContext *ctx, Expr *expr, bool is_move_context);
-static void analyze_stmt(MoveContext *ctx, Stmt *stmt);
-static void analyze_pattern(MoveContext *ctx, Pattern *pat, bool creates_binding);
-static BindingInfo *get_binding_info(MoveContext *ctx, Symbol *sym);
-static void set_binding_state(MoveContext *ctx, Symbol *sym, BindingState state, SourceSpan span);
-static Symbol *move_scope_lookup(MoveContext *ctx, InternedString name);
-
 /*
  * Check if a TypeExpr represents a Copy type.
  * Primitives (integers, floats, bool, char) are always Copy.
@@ -139,47 +150,57 @@ static void move_ctx_init(MoveContext *ctx, SemaContext *sema) {
     ctx->sema = sema;
     ctx->arena = sema->arena;
     ctx->diag = sema->diag;
-    ptr_map_init(&ctx->bindings);
+    ctx->bindings = NULL;
     ctx->defers = NULL;  /* Vec starts as NULL */
     ctx->loop_depth = 0;
     ctx->scope_depth = 0;
 }
 
 /*
- * Create binding info for a symbol
+ * Reset the slot table for a body with the given number of locals
+ */
+static void reset_bindings(MoveContext *ctx, uint32_t local_count) {
+    if (local_count > ctx->binding_cap) {
+        ctx->bindings = realloc(ctx->bindings, local_count * sizeof(BindingInfo));
+        if (!ctx->bindings) {
+            CURSIVE_PANIC("Out of memory growing binding table");
+        }
+        ctx->binding_cap = local_count;
+    }
+    if (local_count) {
+        memset(ctx->bindings, 0, local_count * sizeof(BindingInfo));
+    }
+    ctx->binding_count = local_count;
+}
+
+/*
+ * Register a binding of the current body
  */
-static BindingInfo *create_binding_info(MoveContext *ctx, Symbol *sym, bool initialized) {
-    BindingInfo *info = arena_alloc_aligned(ctx->arena, sizeof(BindingInfo), _Alignof(BindingInfo));
+static BindingInfo *create_binding_info(MoveContext *ctx, Symbol *sym) {
+    if (sym->slot >= ctx->binding_count) {
+        return NULL;
+    }
+
+    BindingInfo *info = &ctx->bindings[sym->slot];
     memset(info, 0, sizeof(BindingInfo));
     info->sym = sym;
-    info->state = initialized ? BIND_STATE_VALID : BIND_STATE_UNINITIALIZED;
     info->is_movable = (sym->binding_op == BIND_MOVABLE);
     info->is_mutable = sym->is_mutable;
     info->perm = sym->type ? sym->type->perm : PERM_CONST;
-    info->moved_fields = NULL;  /* Vec starts as NULL */
-
-    /* Add to bindings map */
-    ptr_map_set(&ctx->bindings, sym, info);
-
     return info;
 }
 
 /*
- * Get binding info for a symbol
+ * Get binding info for a symbol (NULL if not a local of the current body)
  */
 static BindingInfo *get_binding_info(MoveContext *ctx, Symbol *sym) {
-    return (BindingInfo *)ptr_map_get(&ctx->bindings, sym);
-}
-
-/*
- * Set binding state
- */
-static void set_binding_state(MoveContext *ctx, Symbol *sym, BindingState state, SourceSpan span) {
-    BindingInfo *info = get_binding_info(ctx, sym);
-    if (info) {
-        info->state = state;
-        info->last_use_span = span;
+    if (!sym || (sym->kind != SYM_VAR && sym->kind != SYM_PARAM)) {
+        return NULL;
     }
+    if (sym->slot >= ctx->binding_count || !ctx->bindings[sym->slot].sym) {
+        return NULL;
+    }
+    return &ctx->bindings[sym->slot];
 }
 
 /*
@@ -209,623 +230,361 @@ static void register_binding(MoveContext *ctx, Symbol *sym) {
 }
 
 /*
- * Check if binding is in valid state for use
+ * Does consuming this identifier move a value (rather than copy it)?
  */
-static bool check_binding_valid(MoveContext *ctx, Symbol *sym, SourceSpan span) {
-    BindingInfo *info = get_binding_info(ctx, sym);
-    if (!info) {
-        /* Not a local binding - parameter or global */
-        return true;
-    }
-
-    switch (info->state) {
-        case BIND_STATE_VALID:
-            return true;
-
-        case BIND_STATE_UNINITIALIZED:
-            diag_report(ctx->diag, DIAG_ERROR, E_MEM_3007, span,
-                "use of uninitialized binding '%s'",
-                info->sym->name.data);
-            return false;
-
-        case BIND_STATE_MOVED:
-            diag_report(ctx->diag, DIAG_ERROR, E_MEM_3001, span,
-                "use of moved binding '%s'",
-                info->sym->name.data);
-            diag_report(ctx->diag, DIAG_NOTE, NULL, info->last_use_span,
-                "value was moved here");
-            return false;
-
-        case BIND_STATE_PARTIALLY_MOVED:
-            diag_report(ctx->diag, DIAG_ERROR, E_MEM_3001, span,
-                "use of partially moved binding '%s'",
-                info->sym->name.data);
-            return false;
+static bool ident_is_copy(Expr *expr) {
+    Symbol *sym = expr->ident.resolved;
+    if (expr->resolved_type) {
+        return type_expr_is_copy(expr->resolved_type);
     }
-
-    return true;
+    return sym->type && type_is_copy(sym->type);
 }
 
 /*
- * Analyze an identifier expression
+ * ============================================
+ * Flow-Insensitive Checks
+ * ============================================
  */
-static void analyze_ident(MoveContext *ctx, Expr *expr, bool is_move_context) {
-    /* Use resolved symbol from name resolution instead of looking up */
-    Symbol *sym = expr->ident.resolved;
-    if (!sym) return;  /* Name resolution should have caught this */
-
-    if (sym->kind != SYM_VAR && sym->kind != SYM_PARAM) {
-        return;  /* Not a binding */
-    }
-
-    /* Check if binding is valid for use */
-    if (!check_binding_valid(ctx, sym, expr->span)) {
-        return;
-    }
-
-    /* If this is in a move context and the type is not Copy, mark as moved */
-    if (is_move_context) {
-        BindingInfo *info = get_binding_info(ctx, sym);
-        if (info) {
-            /* Check if type is Copy - use expression's resolved type */
-            bool is_copy = false;
-            if (expr->resolved_type) {
-                is_copy = type_expr_is_copy(expr->resolved_type);
-            } else if (sym->type) {
-                is_copy = type_is_copy(sym->type);
-            }
-
-            if (!is_copy) {
-                /* Check if binding is movable */
-                if (!info->is_movable) {
-                    diag_report(ctx->diag, DIAG_ERROR, E_MEM_3006, expr->span,
-                        "cannot move from immovable binding '%s' (uses := operator)",
-                        sym->name.data);
-                    return;
-                }
 
-                set_binding_state(ctx, sym, BIND_STATE_MOVED, expr->span);
-            }
-        }
+/*
+ * Check that a consumed identifier may be moved from
+ */
+static void check_move_allowed(MoveContext *ctx, Expr *expr) {
+    BindingInfo *info = get_binding_info(ctx, expr->ident.resolved);
+    if (info && !info->is_movable && !ident_is_copy(expr)) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3006, expr->span,
+            "cannot move from immovable binding '%s' (uses := operator)",
+            info->sym->name.data);
     }
 }
 
 /*
- * Analyze a field access expression
+ * Check that a field may be moved out of its binding
  */
-static void analyze_field(MoveContext *ctx, Expr *expr, bool is_move_context) {
-    /* First analyze the base object */
-    analyze_expr(ctx, expr->field.object, false);
-
-    /* If moving a field, need to track partial move */
-    if (is_move_context && expr->field.object->kind == EXPR_IDENT) {
-        /* Use resolved symbol from the identifier expression */
-        Symbol *sym = expr->field.object->ident.resolved;
-        if (sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM)) {
-            BindingInfo *info = get_binding_info(ctx, sym);
-            if (info) {
-                /* Check if the field's type is Copy */
-                /* For now, simplified - treat as full move if any field moved */
-                bool is_copy = false;  /* TODO: Check field type */
-
-                if (!is_copy && !info->is_movable) {
-                    diag_report(ctx->diag, DIAG_ERROR, E_MEM_3006, expr->span,
-                        "cannot move field from immovable binding '%s'",
-                        sym->name.data);
-                    return;
-                }
-
-                if (!is_copy) {
-                    /* Track partial move */
-                    vec_push(info->moved_fields, expr->field.field);
-                    info->state = BIND_STATE_PARTIALLY_MOVED;
-                    info->last_use_span = expr->span;
-                }
-            }
-        }
+static void check_field_move_allowed(MoveContext *ctx, Expr *expr) {
+    if (expr->field.object->kind != EXPR_IDENT) return;
+
+    BindingInfo *info = get_binding_info(ctx, expr->field.object->ident.resolved);
+    /* TODO: Check the field's type; every field is treated as non-Copy */
+    if (info && !info->is_movable) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3006, expr->span,
+            "cannot move field from immovable binding '%s'",
+            info->sym->name.data);
     }
 }
 
 /*
- * Analyze a move expression
+ * Check an assignment target (before the value is analyzed)
  */
-static void analyze_move(MoveContext *ctx, Expr *expr) {
-    /* The operand is used in a move context */
-    analyze_expr(ctx, expr->move.operand, true);
+static void analyze_assign_target(MoveContext *ctx, Expr *target) {
+    BindingInfo *info = get_binding_info(ctx, target->ident.resolved);
+    if (info && !info->is_mutable) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3003, target->span,
+            "cannot assign to immutable binding '%s'",
+            info->sym->name.data);
+    }
 }
 
 /*
- * Analyze an assignment expression
+ * Apply binding properties from a let/var statement once its pattern is bound
  */
-static void analyze_assignment(MoveContext *ctx, Expr *target, Expr *value) {
-    /* Check if target is a mutable binding */
-    if (target->kind == EXPR_IDENT) {
-        /* Use resolved symbol from the identifier expression */
-        Symbol *sym = target->ident.resolved;
-        if (sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM)) {
-            BindingInfo *info = get_binding_info(ctx, sym);
-            if (info) {
-                if (!info->is_mutable) {
-                    diag_report(ctx->diag, DIAG_ERROR, E_MEM_3003, target->span,
-                        "cannot assign to immutable binding '%s'",
-                        sym->name.data);
-                }
+static void finish_binding_stmt(MoveContext *ctx, Pattern *pat, BindingOp op, bool is_var) {
+    if (!pat || pat->kind != PAT_BINDING) return;
 
-                /* Analyze value - might move from it */
-                analyze_expr(ctx, value, true);
+    BindingInfo *info = get_binding_info(ctx, pat->binding.resolved);
+    if (!info) return;
 
-                /* Reassignment revalidates the binding */
-                if (info->state == BIND_STATE_MOVED ||
-                    info->state == BIND_STATE_UNINITIALIZED) {
-                    if (info->is_mutable) {
-                        set_binding_state(ctx, sym, BIND_STATE_VALID, target->span);
-                        vec_clear(info->moved_fields);
-                    }
-                }
-                return;
-            }
-        }
+    /* Set movability from binding operator (= vs :=) */
+    info->is_movable = (op == BIND_MOVABLE);
+    if (is_var) {
+        info->is_mutable = true;  /* var is always mutable */
     }
-
-    /* For field assignments and other targets */
-    analyze_expr(ctx, target, false);
-    analyze_expr(ctx, value, true);
 }
 
 /*
- * Analyze a call expression
+ * ============================================
+ * Flow-Sensitive Binding States
+ * ============================================
  */
-static void analyze_call(MoveContext *ctx, Expr *expr) {
-    /* Analyze callee */
-    analyze_expr(ctx, expr->call.callee, false);
-
-    /* Analyze arguments - each argument might be moved depending on parameter mode */
-    /* For now, conservatively treat all non-Copy arguments as moves */
-    for (size_t i = 0; i < vec_len(expr->call.args); i++) {
-        Expr *arg = expr->call.args[i];
 
-        /* Check if the argument is a move expression */
-        bool is_move = (arg->kind == EXPR_MOVE);
-
-        analyze_expr(ctx, arg, is_move);
-    }
+static size_t fact_bit(MoveContext *ctx, MoveFact fact, uint32_t slot) {
+    return (size_t)fact * ctx->binding_count + slot;
 }
 
 /*
- * Analyze a method call expression
+ * Apply one operation to a block's gen/kill sets, or directly to a state
+ * when `kill` is NULL
  */
-static void analyze_method_call(MoveContext *ctx, Expr *expr) {
-    /* Analyze receiver */
-    analyze_expr(ctx, expr->method_call.receiver, false);
-
-    /* Analyze arguments */
-    for (size_t i = 0; i < vec_len(expr->method_call.args); i++) {
-        Expr *arg = expr->method_call.args[i];
-        bool is_move = (arg->kind == EXPR_MOVE);
-        analyze_expr(ctx, arg, is_move);
+static void apply_fact(BitWord *gen, BitWord *kill, size_t bit, bool holds) {
+    if (holds) {
+        bitset_set(gen, bit);
+        if (kill) bitset_clear(kill, bit);
+    } else {
+        bitset_clear(gen, bit);
+        if (kill) bitset_set(kill, bit);
     }
 }
 
-/*
- * Analyze an if expression
- */
-static void analyze_if(MoveContext *ctx, Expr *expr) {
-    /* Analyze condition */
-    analyze_expr(ctx, expr->if_.condition, false);
+static void apply_op(MoveContext *ctx, const CfgOp *op, BitWord *gen, BitWord *kill) {
+    BindingInfo *info = get_binding_info(ctx, op->sym);
+    if (!info) return;
+    uint32_t slot = op->sym->slot;
 
-    /* Save binding states before branches */
-    /* For now, simplified - we don't merge states from branches */
-    /* A more complete implementation would track states per branch */
+    switch (op->kind) {
+        case CFG_OP_USE:
+            if (op->use == VISIT_USE_CONSUME && info->is_movable && !ident_is_copy(op->expr)) {
+                apply_fact(gen, kill, fact_bit(ctx, FACT_MOVED, slot), true);
+                info->move_span = op->span;
+            }
+            break;
 
-    /* Analyze then branch */
-    enter_scope(ctx);
-    analyze_expr(ctx, expr->if_.then_branch, false);
-    exit_scope(ctx);
+        case CFG_OP_USE_FIELD:
+            if (info->is_movable) {
+                apply_fact(gen, kill, fact_bit(ctx, FACT_PARTIALLY_MOVED, slot), true);
+                info->move_span = op->span;
+            }
+            break;
 
-    /* Analyze else branch if present */
-    if (expr->if_.else_branch) {
-        enter_scope(ctx);
-        analyze_expr(ctx, expr->if_.else_branch, false);
-        exit_scope(ctx);
+        case CFG_OP_ASSIGN:
+            /* Assigning an immutable binding was already reported */
+            if (!info->is_mutable) break;
+            /* fallthrough */
+        case CFG_OP_INIT:
+            apply_fact(gen, kill, fact_bit(ctx, FACT_MOVED, slot), false);
+            apply_fact(gen, kill, fact_bit(ctx, FACT_PARTIALLY_MOVED, slot), false);
+            apply_fact(gen, kill, fact_bit(ctx, FACT_UNINITIALIZED, slot), false);
+            break;
+
+        case CFG_OP_DECLARE:
+            apply_fact(gen, kill, fact_bit(ctx, FACT_MOVED, slot), false);
+            apply_fact(gen, kill, fact_bit(ctx, FACT_PARTIALLY_MOVED, slot), false);
+            apply_fact(gen, kill, fact_bit(ctx, FACT_UNINITIALIZED, slot), true);
+            break;
     }
 }
 
 /*
- * Analyze a match expression
+ * Check a use against the state reaching it
  */
-static void analyze_match(MoveContext *ctx, Expr *expr) {
-    /* Analyze scrutinee - might be moved by the match */
-    analyze_expr(ctx, expr->match.scrutinee, true);
-
-    /* Analyze each arm */
-    for (size_t i = 0; i < vec_len(expr->match.arms_patterns); i++) {
-        Pattern *pat = expr->match.arms_patterns[i];
-        Expr *body = expr->match.arms_bodies[i];
-
-        enter_scope(ctx);
-
-        /* Pattern creates bindings */
-        analyze_pattern(ctx, pat, true);
-
-        /* Analyze body */
-        analyze_expr(ctx, body, false);
-
-        exit_scope(ctx);
+static void check_use(MoveContext *ctx, const CfgOp *op, const BitWord *state) {
+    BindingInfo *info = get_binding_info(ctx, op->sym);
+    if (!info) return;
+    uint32_t slot = op->sym->slot;
+
+    if (bitset_test(state, fact_bit(ctx, FACT_UNINITIALIZED, slot))) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3007, op->span,
+            "use of uninitialized binding '%s'",
+            info->sym->name.data);
+    } else if (bitset_test(state, fact_bit(ctx, FACT_MOVED, slot))) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3001, op->span,
+            "use of moved binding '%s'",
+            info->sym->name.data);
+        diag_report(ctx->diag, DIAG_NOTE, NULL, info->move_span,
+            "value was moved here");
+    } else if (bitset_test(state, fact_bit(ctx, FACT_PARTIALLY_MOVED, slot))) {
+        diag_report(ctx->diag, DIAG_ERROR, E_MEM_3001, op->span,
+            "use of partially moved binding '%s'",
+            info->sym->name.data);
     }
 }
 
 /*
- * Analyze a block expression
+ * Solve binding states over the body's graph and report invalid uses
  */
-static void analyze_block(MoveContext *ctx, Expr *expr) {
-    enter_scope(ctx);
-
-    /* Analyze statements */
-    for (size_t i = 0; i < vec_len(expr->block.stmts); i++) {
-        analyze_stmt(ctx, expr->block.stmts[i]);
+static void analyze_flow(MoveContext *ctx) {
+    Cfg *cfg = ctx->cfg;
+    Dataflow *df = &ctx->flow;
+
+    dataflow_reset(df, cfg, DATAFLOW_FORWARD, DATAFLOW_UNION,
+        (size_t)FACT_COUNT * ctx->binding_count);
+
+    /* Summarize each block as gen/kill sets (parameters start valid,
+     * so the boundary state is empty) */
+    for (size_t i = 0; i < vec_len(cfg->rpo); i++) {
+        uint32_t b = cfg->rpo[i];
+        CfgBlock *block = &cfg->blocks[b];
+        for (size_t j = 0; j < vec_len(block->ops); j++) {
+            apply_op(ctx, &block->ops[j], dataflow_gen(df, b), dataflow_kill(df, b));
+        }
     }
 
-    /* Analyze result expression if present */
-    if (expr->block.result) {
-        analyze_expr(ctx, expr->block.result, false);
+    dataflow_solve(df);
+
+    /* Replay each reachable block from its entry state */
+    for (size_t i = 0; i < vec_len(cfg->rpo); i++) {
+        uint32_t b = cfg->rpo[i];
+        CfgBlock *block = &cfg->blocks[b];
+        BitWord *state = dataflow_in(df, b);
+        for (size_t j = 0; j < vec_len(block->ops); j++) {
+            CfgOp *op = &block->ops[j];
+            if (op->kind == CFG_OP_USE) {
+                check_use(ctx, op, state);
+            }
+            apply_op(ctx, op, state, NULL);
+        }
     }
-
-    exit_scope(ctx);
 }
 
 /*
- * Analyze a loop expression
+ * ============================================
+ * Walker Callbacks
+ * ============================================
  */
-static void analyze_loop(MoveContext *ctx, Expr *expr) {
-    ctx->loop_depth++;
 
-    enter_scope(ctx);
-
-    /* Analyze binding pattern if present (loop x in ...) */
-    if (expr->loop.binding) {
-        analyze_pattern(ctx, expr->loop.binding, true);
-    }
+/*
+ * Enter a procedure, method or transition body
+ */
+static bool move_enter_body(void *state, VisitBody *body) {
+    MoveContext *ctx = state;
 
-    /* Analyze iterable if present */
-    if (expr->loop.iterable) {
-        analyze_expr(ctx, expr->loop.iterable, false);
-    }
+    ctx->return_type = NULL;  /* TODO: Get from type checking */
+    reset_bindings(ctx, body->local_count);
 
-    /* Analyze condition if present */
-    if (expr->loop.condition) {
-        analyze_expr(ctx, expr->loop.condition, false);
-    }
+    enter_scope(ctx);
 
-    /* Analyze body */
-    if (expr->loop.body) {
-        analyze_expr(ctx, expr->loop.body, false);
+    if (body->proc) {
+        /* Register parameters as bindings */
+        ProcDecl *proc = body->proc;
+        for (size_t i = 0; i < vec_len(proc->params); i++) {
+            ParamDecl *param = &proc->params[i];
+            /* Use resolved symbol from name resolution */
+            Symbol *sym = param->resolved;
+            if (sym) {
+                BindingInfo *info = create_binding_info(ctx, sym);
+                if (info) {
+                    info->is_movable = param->is_move;  /* move parameters are movable */
+                    info->perm = param->perm;
+                }
+                register_binding(ctx, sym);
+            }
+        }
+    } else {
+        /* Transitions are like methods */
+        Transition *trans = body->transition;
+        for (size_t i = 0; i < vec_len(trans->params); i++) {
+            Symbol *sym = trans->params[i].resolved;
+            if (sym) {
+                create_binding_info(ctx, sym);
+                register_binding(ctx, sym);
+            }
+        }
     }
 
-    exit_scope(ctx);
-
-    ctx->loop_depth--;
+    return true;
 }
 
 /*
- * Analyze a binary expression
+ * Exit a body: the CFG pass has finished its graph
  */
-static void analyze_binary(MoveContext *ctx, Expr *expr) {
-    /* Check for assignment operators */
-    if (expr->binary.op >= BINOP_ASSIGN && expr->binary.op <= BINOP_SHR_ASSIGN) {
-        analyze_assignment(ctx, expr->binary.left, expr->binary.right);
-        return;
-    }
+static void move_exit_body(void *state, VisitBody *body) {
+    MoveContext *ctx = state;
+    (void)body;
 
-    /* Regular binary - analyze both sides */
-    analyze_expr(ctx, expr->binary.left, false);
-    analyze_expr(ctx, expr->binary.right, false);
+    analyze_flow(ctx);
+
+    /* Defers run at scope exit, which is handled by exit_scope */
+    exit_scope(ctx);
+    ctx->binding_count = 0;
 }
 
 /*
- * Analyze an expression
+ * Enter an expression
  */
-static void analyze_expr(MoveContext *ctx, Expr *expr, bool is_move_context) {
-    if (!expr) return;
+static bool move_enter_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    MoveContext *ctx = state;
 
     switch (expr->kind) {
-        case EXPR_INT_LIT:
-        case EXPR_FLOAT_LIT:
-        case EXPR_STRING_LIT:
-        case EXPR_CHAR_LIT:
-        case EXPR_BOOL_LIT:
-            /* Literals are always valid */
-            break;
-
         case EXPR_IDENT:
-            analyze_ident(ctx, expr, is_move_context);
-            break;
-
-        case EXPR_PATH:
-            /* Path expressions - analyze as identifier of last segment */
-            /* Module paths don't have move semantics */
-            break;
-
-        case EXPR_BINARY:
-            analyze_binary(ctx, expr);
-            break;
-
-        case EXPR_UNARY:
-            analyze_expr(ctx, expr->unary.operand,
-                expr->unary.op == UNOP_DEREF ? is_move_context : false);
-            break;
-
-        case EXPR_CALL:
-            analyze_call(ctx, expr);
-            break;
-
-        case EXPR_METHOD_CALL:
-            analyze_method_call(ctx, expr);
-            break;
-
-        case EXPR_FIELD:
-            analyze_field(ctx, expr, is_move_context);
-            break;
-
-        case EXPR_INDEX:
-            analyze_expr(ctx, expr->index.object, false);
-            analyze_expr(ctx, expr->index.index, false);
-            break;
-
-        case EXPR_TUPLE:
-            for (size_t i = 0; i < vec_len(expr->tuple.elements); i++) {
-                analyze_expr(ctx, expr->tuple.elements[i], is_move_context);
-            }
-            break;
-
-        case EXPR_ARRAY:
-            if (expr->array.repeat_value) {
-                analyze_expr(ctx, expr->array.repeat_value, false);
-                analyze_expr(ctx, expr->array.repeat_count, false);
-            } else {
-                for (size_t i = 0; i < vec_len(expr->array.elements); i++) {
-                    analyze_expr(ctx, expr->array.elements[i], is_move_context);
-                }
-            }
-            break;
-
-        case EXPR_RECORD:
-            for (size_t i = 0; i < vec_len(expr->record.field_values); i++) {
-                analyze_expr(ctx, expr->record.field_values[i], true);
+            if (edge->use == VISIT_USE_ASSIGN) {
+                /* Writing a binding is not a use of its old value */
+                analyze_assign_target(ctx, expr);
+            } else if (edge->use == VISIT_USE_CONSUME) {
+                check_move_allowed(ctx, expr);
             }
             break;
 
         case EXPR_IF:
-            analyze_if(ctx, expr);
-            break;
-
         case EXPR_MATCH:
-            analyze_match(ctx, expr);
-            break;
-
         case EXPR_BLOCK:
-            analyze_block(ctx, expr);
+        case EXPR_CLOSURE:
+            enter_scope(ctx);
             break;
 
         case EXPR_LOOP:
-            analyze_loop(ctx, expr);
-            break;
-
-        case EXPR_MOVE:
-            analyze_move(ctx, expr);
-            break;
-
-        case EXPR_WIDEN:
-            analyze_expr(ctx, expr->widen.operand, is_move_context);
-            break;
-
-        case EXPR_CAST:
-            analyze_expr(ctx, expr->cast.operand, false);
-            break;
-
-        case EXPR_RANGE:
-            if (expr->range.start) analyze_expr(ctx, expr->range.start, false);
-            if (expr->range.end) analyze_expr(ctx, expr->range.end, false);
-            break;
-
-        case EXPR_STATIC_CALL:
-            for (size_t i = 0; i < vec_len(expr->static_call.args); i++) {
-                Expr *arg = expr->static_call.args[i];
-                bool is_move = (arg->kind == EXPR_MOVE);
-                analyze_expr(ctx, arg, is_move);
-            }
-            break;
-
-        case EXPR_REGION_ALLOC:
-            analyze_expr(ctx, expr->region_alloc.value, true);
-            break;
-
-        case EXPR_ADDR_OF:
-            /* Taking address doesn't move */
-            analyze_expr(ctx, expr->addr_of.operand, false);
-            break;
-
-        case EXPR_DEREF:
-            analyze_expr(ctx, expr->deref.operand, false);
+            ctx->loop_depth++;
+            enter_scope(ctx);
             break;
 
-        case EXPR_CLOSURE:
-            /* Analyze closure body in its own scope */
-            enter_scope(ctx);
-            for (size_t i = 0; i < vec_len(expr->closure.params); i++) {
-                analyze_pattern(ctx, expr->closure.params[i], true);
-            }
-            analyze_expr(ctx, expr->closure.body, false);
-            exit_scope(ctx);
+        default:
             break;
     }
+
+    return true;
 }
 
 /*
- * Analyze a pattern (creates bindings when used in let/match/etc.)
+ * Exit an expression (children have been analyzed)
  */
-static void analyze_pattern(MoveContext *ctx, Pattern *pat, bool creates_binding) {
-    if (!pat) return;
+static void move_exit_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    MoveContext *ctx = state;
 
-    switch (pat->kind) {
-        case PAT_WILDCARD:
-            /* No binding created */
-            break;
-
-        case PAT_BINDING:
-            if (creates_binding) {
-                /* Use resolved symbol from name resolution */
-                Symbol *sym = pat->binding.resolved;
-                if (sym) {
-                    /* Create binding info */
-                    BindingInfo *info = create_binding_info(ctx, sym, true);
-                    info->is_mutable = pat->binding.is_mutable;
-                    register_binding(ctx, sym);
-                }
-            }
-            break;
-
-        case PAT_LITERAL:
-            /* No binding, analyze the literal expression */
-            if (pat->literal.value) {
-                analyze_expr(ctx, pat->literal.value, false);
-            }
-            break;
-
-        case PAT_TUPLE:
-            for (size_t i = 0; i < vec_len(pat->tuple.elements); i++) {
-                analyze_pattern(ctx, pat->tuple.elements[i], creates_binding);
-            }
-            break;
-
-        case PAT_RECORD:
-            for (size_t i = 0; i < vec_len(pat->record.field_patterns); i++) {
-                analyze_pattern(ctx, pat->record.field_patterns[i], creates_binding);
-            }
-            break;
-
-        case PAT_ENUM:
-            if (pat->enum_.payload) {
-                analyze_pattern(ctx, pat->enum_.payload, creates_binding);
-            }
-            break;
-
-        case PAT_MODAL:
-            for (size_t i = 0; i < vec_len(pat->modal.field_patterns); i++) {
-                analyze_pattern(ctx, pat->modal.field_patterns[i], creates_binding);
+    switch (expr->kind) {
+        case EXPR_FIELD:
+            if (edge->use == VISIT_USE_CONSUME) {
+                check_field_move_allowed(ctx, expr);
             }
             break;
 
-        case PAT_RANGE:
-            analyze_pattern(ctx, pat->range.start, false);
-            analyze_pattern(ctx, pat->range.end, false);
+        case EXPR_IF:
+        case EXPR_MATCH:
+        case EXPR_BLOCK:
+        case EXPR_CLOSURE:
+            exit_scope(ctx);
             break;
 
-        case PAT_OR:
-            /* Each alternative must create the same bindings */
-            for (size_t i = 0; i < vec_len(pat->or_.alternatives); i++) {
-                analyze_pattern(ctx, pat->or_.alternatives[i], creates_binding);
-            }
+        case EXPR_LOOP:
+            exit_scope(ctx);
+            ctx->loop_depth--;
             break;
 
-        case PAT_GUARD:
-            analyze_pattern(ctx, pat->guard.pattern, creates_binding);
-            analyze_expr(ctx, pat->guard.guard, false);
+        default:
             break;
     }
 }
 
 /*
- * Analyze a statement
+ * Enter a pattern (creates bindings when used in let/match/etc.)
  */
-static void analyze_stmt(MoveContext *ctx, Stmt *stmt) {
-    if (!stmt) return;
-
-    switch (stmt->kind) {
-        case STMT_EXPR:
-            analyze_expr(ctx, stmt->expr.expr, false);
-            break;
-
-        case STMT_LET: {
-            /* Analyze initializer first (might move from existing bindings) */
-            if (stmt->let.init) {
-                analyze_expr(ctx, stmt->let.init, true);
-            }
+static bool move_enter_pattern(void *state, Pattern *pat, bool binds) {
+    MoveContext *ctx = state;
 
-            /* Create binding */
-            if (stmt->let.pattern) {
-                /* Analyze pattern - creates binding info */
-                analyze_pattern(ctx, stmt->let.pattern, true);
-
-                /* Set binding properties from statement */
-                if (stmt->let.pattern->kind == PAT_BINDING) {
-                    Symbol *sym = stmt->let.pattern->binding.resolved;
-                    if (sym) {
-                        BindingInfo *info = get_binding_info(ctx, sym);
-                        if (info) {
-                            /* Set movability from binding operator (= vs :=) */
-                            info->is_movable = (stmt->let.op == BIND_MOVABLE);
-                            if (!stmt->let.init) {
-                                info->state = BIND_STATE_UNINITIALIZED;
-                            }
-                        }
-                    }
-                }
-            }
-            break;
-        }
-
-        case STMT_VAR: {
-            /* Same as let but mutable */
-            if (stmt->var.init) {
-                analyze_expr(ctx, stmt->var.init, true);
-            }
-
-            if (stmt->var.pattern) {
-                analyze_pattern(ctx, stmt->var.pattern, true);
-
-                /* Set binding properties from statement */
-                if (stmt->var.pattern->kind == PAT_BINDING) {
-                    Symbol *sym = stmt->var.pattern->binding.resolved;
-                    if (sym) {
-                        BindingInfo *info = get_binding_info(ctx, sym);
-                        if (info) {
-                            /* Set movability from binding operator (= vs :=) */
-                            info->is_movable = (stmt->var.op == BIND_MOVABLE);
-                            info->is_mutable = true;  /* var is always mutable */
-                            if (!stmt->var.init) {
-                                info->state = BIND_STATE_UNINITIALIZED;
-                            }
-                        }
-                    }
-                }
+    if (pat->kind == PAT_BINDING && binds) {
+        /* Use resolved symbol from name resolution */
+        Symbol *sym = pat->binding.resolved;
+        if (sym) {
+            BindingInfo *info = create_binding_info(ctx, sym);
+            if (info) {
+                info->is_mutable = pat->binding.is_mutable;
             }
-            break;
+            register_binding(ctx, sym);
         }
+    }
 
-        case STMT_ASSIGN:
-            analyze_assignment(ctx, stmt->assign.target, stmt->assign.value);
-            break;
-
-        case STMT_RETURN:
-            if (stmt->return_.value) {
-                analyze_expr(ctx, stmt->return_.value, true);
-            }
-            break;
+    return true;
+}
 
-        case STMT_RESULT:
-            if (stmt->result.value) {
-                analyze_expr(ctx, stmt->result.value, true);
-            }
-            break;
+/*
+ * Enter a statement
+ */
+static bool move_enter_stmt(void *state, Stmt *stmt) {
+    MoveContext *ctx = state;
 
+    switch (stmt->kind) {
         case STMT_BREAK:
             if (ctx->loop_depth == 0) {
                 diag_report(ctx->diag, DIAG_ERROR, E_SYN_0100, stmt->span,
                     "'break' outside of loop");
             }
-            if (stmt->break_.value) {
-                analyze_expr(ctx, stmt->break_.value, true);
-            }
             break;
 
         case STMT_CONTINUE:
@@ -836,145 +595,78 @@ static void analyze_stmt(MoveContext *ctx, Stmt *stmt) {
             break;
 
         case STMT_DEFER:
-            /* Defer body is analyzed but executed later */
+            /* Defer body is executed later, at scope exit */
             vec_push(ctx->defers, stmt->defer.body);
-            break;
+            return false;
 
-        case STMT_UNSAFE:
-            analyze_expr(ctx, stmt->unsafe.body, false);
+        default:
             break;
     }
-}
-
-/*
- * Analyze a procedure body
- */
-static void analyze_proc(MoveContext *ctx, ProcDecl *proc) {
-    ctx->return_type = NULL;  /* TODO: Get from type checking */
-    ctx->proc_scope = proc->scope;  /* Use procedure's resolved scope for lookups */
-
-    enter_scope(ctx);
 
-    /* Register parameters as bindings */
-    for (size_t i = 0; i < vec_len(proc->params); i++) {
-        ParamDecl *param = &proc->params[i];
-        /* Use resolved symbol from name resolution */
-        Symbol *sym = param->resolved;
-        if (sym) {
-            BindingInfo *info = create_binding_info(ctx, sym, true);
-            info->is_movable = param->is_move;  /* move parameters are movable */
-            info->perm = param->perm;
-            register_binding(ctx, sym);
-        }
-    }
-
-    /* Analyze body */
-    if (proc->body) {
-        analyze_expr(ctx, proc->body, false);
-    }
-
-    /* Check defers were all executed */
-    /* Defers run at scope exit, which is handled by exit_scope */
-
-    exit_scope(ctx);
-    ctx->proc_scope = NULL;  /* Clear procedure scope */
+    return true;
 }
 
 /*
- * Analyze a declaration
+ * Exit a statement
  */
-static void analyze_decl(MoveContext *ctx, Decl *decl) {
-    if (!decl) return;
-
-    switch (decl->kind) {
-        case DECL_PROC:
-            analyze_proc(ctx, &decl->proc);
-            break;
-
-        case DECL_RECORD:
-            /* Analyze methods */
-            for (size_t i = 0; i < vec_len(decl->record.methods); i++) {
-                analyze_proc(ctx, &decl->record.methods[i]);
-            }
-            break;
+static void move_exit_stmt(void *state, Stmt *stmt) {
+    MoveContext *ctx = state;
 
-        case DECL_ENUM:
-            for (size_t i = 0; i < vec_len(decl->enum_.methods); i++) {
-                analyze_proc(ctx, &decl->enum_.methods[i]);
-            }
-            break;
-
-        case DECL_MODAL:
-            /* Analyze shared methods */
-            for (size_t i = 0; i < vec_len(decl->modal.shared_methods); i++) {
-                analyze_proc(ctx, &decl->modal.shared_methods[i]);
-            }
-            /* Analyze state-specific methods */
-            for (size_t i = 0; i < vec_len(decl->modal.states); i++) {
-                ModalState *state = &decl->modal.states[i];
-                for (size_t j = 0; j < vec_len(state->methods); j++) {
-                    analyze_proc(ctx, &state->methods[j]);
-                }
-                /* Transitions are like methods */
-                for (size_t j = 0; j < vec_len(state->transitions); j++) {
-                    Transition *trans = &state->transitions[j];
-                    if (trans->body) {
-                        enter_scope(ctx);
-                        /* Register parameters */
-                        for (size_t k = 0; k < vec_len(trans->params); k++) {
-                            ParamDecl *param = &trans->params[k];
-                            Symbol *sym = move_scope_lookup(ctx, param->name);
-                            if (sym) {
-                                create_binding_info(ctx, sym, true);
-                                register_binding(ctx, sym);
-                            }
-                        }
-                        analyze_expr(ctx, trans->body, false);
-                        exit_scope(ctx);
-                    }
-                }
-            }
+    switch (stmt->kind) {
+        case STMT_LET:
+            finish_binding_stmt(ctx, stmt->let.pattern, stmt->let.op, false);
             break;
 
-        case DECL_CLASS:
-            /* Default methods */
-            for (size_t i = 0; i < vec_len(decl->class_.default_methods); i++) {
-                analyze_proc(ctx, &decl->class_.default_methods[i]);
-            }
+        case STMT_VAR:
+            finish_binding_stmt(ctx, stmt->var.pattern, stmt->var.op, true);
             break;
 
-        case DECL_TYPE_ALIAS:
-        case DECL_EXTERN:
-        case DECL_MODULE:
-        case DECL_IMPORT:
-        case DECL_USE:
-            /* No move analysis needed */
+        default:
             break;
     }
 }
 
 /*
- * Look up a symbol in the current procedure's scope
+ * Release analysis state
  */
-static Symbol *move_scope_lookup(MoveContext *ctx, InternedString name) {
-    if (ctx->proc_scope) {
-        return scope_lookup_from(ctx->proc_scope, name);
-    }
-    /* Fallback to sema's scope if no proc scope set */
-    return scope_lookup_from(ctx->sema->current_scope, name);
+static void move_finish(void *state) {
+    MoveContext *ctx = state;
+    free(ctx->bindings);
+    dataflow_destroy(&ctx->flow);
+    vec_free(ctx->defers);
+}
+
+/*
+ * Register move analysis with a body walker
+ */
+void sema_register_move_pass(Visitor *v, SemaContext *ctx) {
+    MoveContext *mctx = ARENA_ALLOC(ctx->arena, MoveContext);
+    move_ctx_init(mctx, ctx);
+    mctx->cfg = cfg_require_pass(v);
+
+    VisitPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "moves";
+    pass.state = mctx;
+    pass.enter_body = move_enter_body;
+    pass.exit_body = move_exit_body;
+    pass.enter_stmt = move_enter_stmt;
+    pass.exit_stmt = move_exit_stmt;
+    pass.enter_expr = move_enter_expr;
+    pass.exit_expr = move_exit_expr;
+    pass.enter_pattern = move_enter_pattern;
+    pass.finish = move_finish;
+    visitor_add_pass(v, &pass);
 }
 
 /*
  * Main entry point: analyze moves in a module
  */
 bool sema_analyze_moves(SemaContext *ctx, Module *mod) {
-    MoveContext mctx;
-    move_ctx_init(&mctx, ctx);
-
-    /* Analyze all declarations */
-    for (size_t i = 0; i < vec_len(mod->decls); i++) {
-        analyze_decl(&mctx, mod->decls[i]);
-    }
+    Visitor visitor;
+    visitor_init(&visitor, false);
+    sema_register_move_pass(&visitor, ctx);
+    visitor_run_module(&visitor, mod);
 
     return !diag_has_errors(ctx->diag);
 }
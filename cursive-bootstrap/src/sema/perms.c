@@ -13,9 +13,15 @@
  * Method receiver compatibility:
  * - ~ (const) methods can be called on any receiver
  * - ~! (unique) methods require unique access
+ *
+ * Runs as a pass of the fused body walker (visit.h), sharing one
+ * traversal with move analysis. Borrowed paths are interned as places
+ * (places.h), so conflict checks are lookups in the place trie and
+ * borrows of disjoint fields do not conflict.
  */
 
 #include "sema.h"
+#include "places.h"
 #include <string.h>
 
 /*
@@ -32,16 +38,18 @@ typedef struct PermContext {
     /* Are we in an unsafe block? */
     bool in_unsafe;
 
-    /* Unique paths currently borrowed (for aliasing detection) */
-    Vec(Expr *) borrowed_unique_paths;
+    /* Places of the current body, indexing the active unique borrows */
+    PlaceTable places;
+
+    /* Uniquely borrowed places, in borrow order */
+    Vec(PlaceId) borrowed_unique_places;
+
+    /* Borrow counts saved on entry to each scoping expression */
+    Vec(size_t) borrow_marks;
 } PermContext;
 
 /* Forward declarations */
-static void check_expr(PermContext *ctx, Expr *expr, Permission required);
-static void check_stmt(PermContext *ctx, Stmt *stmt);
 static Permission get_expr_permission(PermContext *ctx, Expr *expr);
-static bool paths_may_alias(Expr *a, Expr *b);
-static Symbol *perm_scope_lookup(SemaContext *sema, InternedString name);
 
 /*
  * Initialize permission context
@@ -53,14 +61,8 @@ static void perm_ctx_init(PermContext *ctx, SemaContext *sema) {
     ctx->diag = sema->diag;
     ctx->receiver_perm = PERM_CONST;
     ctx->in_unsafe = false;
-    ctx->borrowed_unique_paths = NULL;  /* Vec starts as NULL */
-}
-
-/*
- * Wrapper for scope_lookup using SemaContext
- */
-static Symbol *perm_scope_lookup(SemaContext *sema, InternedString name) {
-    return scope_lookup_from(sema->current_scope, name);
+    ctx->borrowed_unique_places = NULL;  /* Vec starts as NULL */
+    ctx->borrow_marks = NULL;
 }
 
 /*
@@ -71,7 +73,12 @@ static Permission get_expr_permission(PermContext *ctx, Expr *expr) {
 
     switch (expr->kind) {
         case EXPR_IDENT: {
-            Symbol *sym = perm_scope_lookup(ctx->sema, expr->ident.name);
+            Symbol *sym = expr->ident.resolved;
+            /* var bindings and unique parameters grant unique access */
+            if (sym && (sym->kind == SYM_VAR || sym->kind == SYM_PARAM) &&
+                sym->perm == PERM_UNIQUE) {
+                return PERM_UNIQUE;
+            }
             if (sym && sym->type) {
                 return sym->type->perm;
             }
@@ -110,54 +117,30 @@ static Permission get_expr_permission(PermContext *ctx, Expr *expr) {
 }
 
 /*
- * Check if two expressions may alias (conservatively)
+ * Get the operand of a borrow expression (&e or &!e), or NULL
  */
-static bool paths_may_alias(Expr *a, Expr *b) {
-    if (!a || !b) return false;
-
-    /* Same identifier? */
-    if (a->kind == EXPR_IDENT && b->kind == EXPR_IDENT) {
-        return a->ident.name.data == b->ident.name.data;
-    }
-
-    /* Field of same base? */
-    if (a->kind == EXPR_FIELD && b->kind == EXPR_FIELD) {
-        if (paths_may_alias(a->field.object, b->field.object)) {
-            /* Same base - might alias if same field or nested */
-            return true;
-        }
-    }
-
-    /* Index of same base? */
-    if (a->kind == EXPR_INDEX && b->kind == EXPR_INDEX) {
-        if (paths_may_alias(a->index.object, b->index.object)) {
-            /* Conservative: any index into same array might alias */
-            return true;
-        }
+static Expr *borrow_operand(Expr *expr, bool *is_unique) {
+    if (expr->kind == EXPR_ADDR_OF) {
+        *is_unique = expr->addr_of.is_unique;
+        return expr->addr_of.operand;
     }
-
-    /* One is prefix of other? (e.g., a.b vs a.b.c) */
-    if (a->kind == EXPR_FIELD && paths_may_alias(a->field.object, b)) {
-        return true;
+    if (expr->kind == EXPR_UNARY &&
+        (expr->unary.op == UNOP_ADDR || expr->unary.op == UNOP_ADDR_MUT)) {
+        *is_unique = expr->unary.op == UNOP_ADDR_MUT;
+        return expr->unary.operand;
     }
-    if (b->kind == EXPR_FIELD && paths_may_alias(a, b->field.object)) {
-        return true;
-    }
-
-    return false;
+    return NULL;
 }
 
 /*
- * Check if taking a unique borrow would conflict with existing borrows
+ * Check if taking a unique borrow of a place would conflict with an
+ * active one: the same place, a place containing it, or one inside it
  */
-static bool check_unique_borrow(PermContext *ctx, Expr *expr) {
-    for (size_t i = 0; i < vec_len(ctx->borrowed_unique_paths); i++) {
-        Expr *borrowed = ctx->borrowed_unique_paths[i];
-        if (paths_may_alias(expr, borrowed)) {
-            diag_report(ctx->diag, DIAG_ERROR, E_TYP_1602, expr->span,
-                "cannot create unique reference while path is already borrowed");
-            return false;
-        }
+static bool check_unique_borrow(PermContext *ctx, PlaceId place, SourceSpan span) {
+    if (place_borrow_conflicts(&ctx->places, place)) {
+        diag_report(ctx->diag, DIAG_ERROR, E_TYP_1602, span,
+            "cannot create unique reference while path is already borrowed");
+        return false;
     }
     return true;
 }
@@ -178,462 +161,255 @@ static void check_mutation(PermContext *ctx, Expr *target) {
 }
 
 /*
- * Check a binary expression
+ * Check an address-of expression
  */
-static void check_binary(PermContext *ctx, Expr *expr) {
-    /* Check for assignment operators */
-    if (expr->binary.op >= BINOP_ASSIGN && expr->binary.op <= BINOP_SHR_ASSIGN) {
-        /* LHS must be mutable (unique permission) */
-        check_mutation(ctx, expr->binary.left);
-        /* RHS just needs to be readable */
-        check_expr(ctx, expr->binary.right, PERM_CONST);
+static void check_addr_of(PermContext *ctx, Expr *expr, Expr *operand, bool is_unique) {
+    if (!is_unique) {
+        /* Taking const reference - operand is checked as a plain read */
         return;
     }
 
-    /* Regular binary - both sides just need to be readable */
-    check_expr(ctx, expr->binary.left, PERM_CONST);
-    check_expr(ctx, expr->binary.right, PERM_CONST);
-}
-
-/*
- * Check a method call expression
- */
-static void check_method_call(PermContext *ctx, Expr *expr) {
-    /* Check receiver permission against method receiver kind */
-    /* For now we don't have access to the resolved method to check receiver kind */
-    /* This would be done after type resolution fills in method info */
-
-    Permission receiver_perm = get_expr_permission(ctx, expr->method_call.receiver);
-
-    /* Check receiver is valid */
-    check_expr(ctx, expr->method_call.receiver, PERM_CONST);
-
-    /* Check arguments */
-    for (size_t i = 0; i < vec_len(expr->method_call.args); i++) {
-        check_expr(ctx, expr->method_call.args[i], PERM_CONST);
+    /* Taking unique reference - check for aliasing conflicts (values that
+     * are not paths are temporaries and cannot be aliased) */
+    PlaceId place = place_of_expr(&ctx->places, operand);
+    if (place != PLACE_NONE && !check_unique_borrow(ctx, place, operand->span)) {
+        return;
     }
-}
-
-/*
- * Check an address-of expression
- */
-static void check_addr_of(PermContext *ctx, Expr *expr) {
-    if (expr->addr_of.is_unique) {
-        /* Taking unique reference - check for aliasing conflicts */
-        if (!check_unique_borrow(ctx, expr->addr_of.operand)) {
-            return;
-        }
 
-        /* The operand must be a mutable path */
-        Permission operand_perm = get_expr_permission(ctx, expr->addr_of.operand);
-        if (operand_perm == PERM_CONST) {
-            diag_report(ctx->diag, DIAG_ERROR, E_TYP_1602, expr->span,
-                "cannot take unique reference (&!) to const path");
-            return;
-        }
+    /* The operand must be a mutable path */
+    Permission operand_perm = get_expr_permission(ctx, operand);
+    if (operand_perm == PERM_CONST) {
+        diag_report(ctx->diag, DIAG_ERROR, E_TYP_1602, expr->span,
+            "cannot take unique reference (&!) to const path");
+        return;
+    }
 
-        /* Track this unique borrow */
-        vec_push(ctx->borrowed_unique_paths, expr->addr_of.operand);
-    } else {
-        /* Taking const reference - just check operand is valid */
-        check_expr(ctx, expr->addr_of.operand, PERM_CONST);
+    /* Track this unique borrow */
+    if (place != PLACE_NONE) {
+        place_borrow(&ctx->places, place);
+        vec_push(ctx->borrowed_unique_places, place);
     }
 }
 
 /*
- * Check an if expression
+ * Drop borrows taken since the innermost saved mark
  */
-static void check_if(PermContext *ctx, Expr *expr) {
-    /* Check condition */
-    check_expr(ctx, expr->if_.condition, PERM_CONST);
-
-    /* Save borrowed paths */
-    size_t saved_len = vec_len(ctx->borrowed_unique_paths);
-
-    /* Check then branch */
-    check_expr(ctx, expr->if_.then_branch, PERM_CONST);
-
-    /* Restore for else branch */
-    while (vec_len(ctx->borrowed_unique_paths) > saved_len) {
-        (void)vec_pop(ctx->borrowed_unique_paths);
-    }
-
-    /* Check else branch if present */
-    if (expr->if_.else_branch) {
-        check_expr(ctx, expr->if_.else_branch, PERM_CONST);
+static void release_borrows(PermContext *ctx) {
+    size_t saved_len = vec_last(ctx->borrow_marks);
+    while (vec_len(ctx->borrowed_unique_places) > saved_len) {
+        place_release(&ctx->places, vec_last(ctx->borrowed_unique_places));
+        vec_pop(ctx->borrowed_unique_places);
     }
 }
 
 /*
- * Check a match expression
+ * ============================================
+ * Walker Callbacks
+ * ============================================
  */
-static void check_match(PermContext *ctx, Expr *expr) {
-    /* Check scrutinee */
-    check_expr(ctx, expr->match.scrutinee, PERM_CONST);
-
-    size_t saved_len = vec_len(ctx->borrowed_unique_paths);
-
-    /* Check each arm */
-    for (size_t i = 0; i < vec_len(expr->match.arms_bodies); i++) {
-        check_expr(ctx, expr->match.arms_bodies[i], PERM_CONST);
-
-        /* Restore borrowed paths for next arm */
-        while (vec_len(ctx->borrowed_unique_paths) > saved_len) {
-            (void)vec_pop(ctx->borrowed_unique_paths);
-        }
-    }
-}
 
 /*
- * Check a block expression
+ * Enter a procedure, method or transition body
  */
-static void check_block(PermContext *ctx, Expr *expr) {
-    size_t saved_len = vec_len(ctx->borrowed_unique_paths);
-
-    /* Check statements */
-    for (size_t i = 0; i < vec_len(expr->block.stmts); i++) {
-        check_stmt(ctx, expr->block.stmts[i]);
-    }
-
-    /* Check result expression if present */
-    if (expr->block.result) {
-        check_expr(ctx, expr->block.result, PERM_CONST);
+static bool perm_enter_body(void *state, VisitBody *body) {
+    PermContext *ctx = state;
+
+    if (body->proc) {
+        /* Set receiver permission based on receiver kind */
+        switch (body->proc->receiver) {
+            case RECV_NONE:
+            case RECV_CONST:
+                ctx->receiver_perm = PERM_CONST;
+                break;
+            case RECV_UNIQUE:
+                ctx->receiver_perm = PERM_UNIQUE;
+                break;
+            case RECV_SHARED:
+                /* shared is deferred in bootstrap */
+                ctx->receiver_perm = PERM_CONST;
+                break;
+        }
+    } else {
+        /* Transitions typically take ~! receiver */
+        ctx->receiver_perm = PERM_UNIQUE;
     }
 
-    /* Borrows end at scope exit */
-    while (vec_len(ctx->borrowed_unique_paths) > saved_len) {
-        (void)vec_pop(ctx->borrowed_unique_paths);
-    }
+    /* Clear borrowed places for this body */
+    place_table_reset(&ctx->places, body->local_count);
+    vec_clear(ctx->borrowed_unique_places);
+    vec_clear(ctx->borrow_marks);
+    return true;
 }
 
 /*
- * Check a loop expression
+ * Enter an expression
  */
-static void check_loop(PermContext *ctx, Expr *expr) {
-    size_t saved_len = vec_len(ctx->borrowed_unique_paths);
+static bool perm_enter_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    PermContext *ctx = state;
 
-    /* Check iterable */
-    if (expr->loop.iterable) {
-        check_expr(ctx, expr->loop.iterable, PERM_CONST);
+    /* Assignment targets are checked for mutation by the assignment itself */
+    if (edge->use == VISIT_USE_ASSIGN) {
+        return false;
     }
 
-    /* Check condition */
-    if (expr->loop.condition) {
-        check_expr(ctx, expr->loop.condition, PERM_CONST);
+    /* The operand of &! is a place being borrowed, not a value being read */
+    bool is_unique = false;
+    if (edge->parent && borrow_operand(edge->parent, &is_unique) == expr && is_unique) {
+        return false;
     }
 
-    /* Check body */
-    if (expr->loop.body) {
-        check_expr(ctx, expr->loop.body, PERM_CONST);
-    }
-
-    /* Borrows end at scope exit */
-    while (vec_len(ctx->borrowed_unique_paths) > saved_len) {
-        (void)vec_pop(ctx->borrowed_unique_paths);
-    }
-}
-
-/*
- * Check an expression
- */
-static void check_expr(PermContext *ctx, Expr *expr, Permission required) {
-    if (!expr) return;
-
     switch (expr->kind) {
-        case EXPR_INT_LIT:
-        case EXPR_FLOAT_LIT:
-        case EXPR_STRING_LIT:
-        case EXPR_CHAR_LIT:
-        case EXPR_BOOL_LIT:
-            /* Literals are always readable */
-            break;
-
-        case EXPR_IDENT:
-            /* Identifier access is valid if permission is sufficient */
-            /* Required permission is at least what we need */
-            break;
-
-        case EXPR_PATH:
-            /* Path expressions are always readable */
-            break;
-
         case EXPR_BINARY:
-            check_binary(ctx, expr);
-            break;
-
-        case EXPR_UNARY:
-            check_expr(ctx, expr->unary.operand, PERM_CONST);
-            break;
-
-        case EXPR_CALL:
-            check_expr(ctx, expr->call.callee, PERM_CONST);
-            for (size_t i = 0; i < vec_len(expr->call.args); i++) {
-                check_expr(ctx, expr->call.args[i], PERM_CONST);
+            if (expr->binary.op >= BINOP_ASSIGN && expr->binary.op <= BINOP_SHR_ASSIGN) {
+                /* LHS must be mutable (unique permission) */
+                check_mutation(ctx, expr->binary.left);
             }
             break;
 
         case EXPR_METHOD_CALL:
-            check_method_call(ctx, expr);
+            /* Receiver kind is checked once method resolution records the
+             * resolved method; until then the receiver is just read */
             break;
 
-        case EXPR_FIELD:
-            check_expr(ctx, expr->field.object, required);
-            break;
-
-        case EXPR_INDEX:
-            check_expr(ctx, expr->index.object, required);
-            check_expr(ctx, expr->index.index, PERM_CONST);
-            break;
-
-        case EXPR_TUPLE:
-            for (size_t i = 0; i < vec_len(expr->tuple.elements); i++) {
-                check_expr(ctx, expr->tuple.elements[i], required);
-            }
-            break;
-
-        case EXPR_ARRAY:
-            if (expr->array.repeat_value) {
-                check_expr(ctx, expr->array.repeat_value, PERM_CONST);
-                check_expr(ctx, expr->array.repeat_count, PERM_CONST);
-            } else {
-                for (size_t i = 0; i < vec_len(expr->array.elements); i++) {
-                    check_expr(ctx, expr->array.elements[i], PERM_CONST);
-                }
-            }
-            break;
-
-        case EXPR_RECORD:
-            for (size_t i = 0; i < vec_len(expr->record.field_values); i++) {
-                check_expr(ctx, expr->record.field_values[i], PERM_CONST);
+        case EXPR_ADDR_OF:
+        case EXPR_UNARY: {
+            Expr *operand = borrow_operand(expr, &is_unique);
+            if (operand) {
+                check_addr_of(ctx, expr, operand, is_unique);
             }
             break;
+        }
 
         case EXPR_IF:
-            check_if(ctx, expr);
-            break;
-
         case EXPR_MATCH:
-            check_match(ctx, expr);
-            break;
-
         case EXPR_BLOCK:
-            check_block(ctx, expr);
-            break;
-
         case EXPR_LOOP:
-            check_loop(ctx, expr);
-            break;
-
-        case EXPR_MOVE:
-            check_expr(ctx, expr->move.operand, PERM_CONST);
-            break;
-
-        case EXPR_WIDEN:
-            check_expr(ctx, expr->widen.operand, required);
+            /* Save borrowed paths */
+            vec_push(ctx->borrow_marks, vec_len(ctx->borrowed_unique_places));
             break;
 
-        case EXPR_CAST:
-            check_expr(ctx, expr->cast.operand, PERM_CONST);
-            break;
-
-        case EXPR_RANGE:
-            if (expr->range.start) check_expr(ctx, expr->range.start, PERM_CONST);
-            if (expr->range.end) check_expr(ctx, expr->range.end, PERM_CONST);
+        default:
             break;
+    }
 
-        case EXPR_STATIC_CALL:
-            for (size_t i = 0; i < vec_len(expr->static_call.args); i++) {
-                check_expr(ctx, expr->static_call.args[i], PERM_CONST);
-            }
-            break;
+    return true;
+}
 
-        case EXPR_REGION_ALLOC:
-            check_expr(ctx, expr->region_alloc.value, PERM_CONST);
-            break;
+/*
+ * Exit an expression
+ */
+static void perm_exit_expr(void *state, Expr *expr, const VisitEdge *edge) {
+    PermContext *ctx = state;
+    Expr *parent = edge->parent;
+
+    /* Borrows taken in one branch do not constrain its siblings */
+    if (parent && parent->kind == EXPR_IF && expr == parent->if_.then_branch) {
+        release_borrows(ctx);
+    } else if (parent && parent->kind == EXPR_MATCH && expr != parent->match.scrutinee) {
+        release_borrows(ctx);
+    }
 
-        case EXPR_ADDR_OF:
-            check_addr_of(ctx, expr);
+    switch (expr->kind) {
+        case EXPR_BLOCK:
+        case EXPR_LOOP:
+            /* Borrows end at scope exit */
+            release_borrows(ctx);
+            (void)vec_pop(ctx->borrow_marks);
             break;
 
-        case EXPR_DEREF:
-            check_expr(ctx, expr->deref.operand, required);
+        case EXPR_IF:
+        case EXPR_MATCH:
+            (void)vec_pop(ctx->borrow_marks);
             break;
 
-        case EXPR_CLOSURE:
-            /* Check closure body */
-            check_expr(ctx, expr->closure.body, PERM_CONST);
+        default:
             break;
     }
 }
 
 /*
- * Check a statement
+ * Enter a statement
  */
-static void check_stmt(PermContext *ctx, Stmt *stmt) {
-    if (!stmt) return;
+static bool perm_enter_stmt(void *state, Stmt *stmt) {
+    PermContext *ctx = state;
 
     switch (stmt->kind) {
-        case STMT_EXPR:
-            check_expr(ctx, stmt->expr.expr, PERM_CONST);
-            break;
-
-        case STMT_LET:
-            if (stmt->let.init) {
-                check_expr(ctx, stmt->let.init, PERM_CONST);
-            }
-            break;
-
-        case STMT_VAR:
-            if (stmt->var.init) {
-                check_expr(ctx, stmt->var.init, PERM_CONST);
-            }
-            break;
-
         case STMT_ASSIGN:
             check_mutation(ctx, stmt->assign.target);
-            check_expr(ctx, stmt->assign.value, PERM_CONST);
-            break;
-
-        case STMT_RETURN:
-            if (stmt->return_.value) {
-                check_expr(ctx, stmt->return_.value, PERM_CONST);
-            }
-            break;
-
-        case STMT_RESULT:
-            if (stmt->result.value) {
-                check_expr(ctx, stmt->result.value, PERM_CONST);
-            }
-            break;
-
-        case STMT_BREAK:
-            if (stmt->break_.value) {
-                check_expr(ctx, stmt->break_.value, PERM_CONST);
-            }
-            break;
-
-        case STMT_CONTINUE:
-            /* No expression to check */
-            break;
-
-        case STMT_DEFER:
-            check_expr(ctx, stmt->defer.body, PERM_CONST);
             break;
 
         case STMT_UNSAFE:
             /* Inside unsafe block, some permission checks are relaxed */
             ctx->in_unsafe = true;
-            check_expr(ctx, stmt->unsafe.body, PERM_CONST);
-            ctx->in_unsafe = false;
+            break;
+
+        default:
             break;
     }
+
+    return true;
 }
 
 /*
- * Check a procedure
+ * Exit a statement
  */
-static void check_proc(PermContext *ctx, ProcDecl *proc) {
-    /* Set receiver permission based on receiver kind */
-    switch (proc->receiver) {
-        case RECV_NONE:
-        case RECV_CONST:
-            ctx->receiver_perm = PERM_CONST;
-            break;
-        case RECV_UNIQUE:
-            ctx->receiver_perm = PERM_UNIQUE;
-            break;
-        case RECV_SHARED:
-            /* shared is deferred in bootstrap */
-            ctx->receiver_perm = PERM_CONST;
-            break;
-    }
+static void perm_exit_stmt(void *state, Stmt *stmt) {
+    PermContext *ctx = state;
 
-    /* Clear borrowed paths for this procedure */
-    while (vec_len(ctx->borrowed_unique_paths) > 0) {
-        (void)vec_pop(ctx->borrowed_unique_paths);
-    }
-
-    /* Check body */
-    if (proc->body) {
-        check_expr(ctx, proc->body, PERM_CONST);
+    if (stmt->kind == STMT_UNSAFE) {
+        ctx->in_unsafe = false;
     }
 }
 
 /*
- * Check a declaration
+ * Patterns carry no permission requirements
  */
-static void check_decl(PermContext *ctx, Decl *decl) {
-    if (!decl) return;
-
-    switch (decl->kind) {
-        case DECL_PROC:
-            check_proc(ctx, &decl->proc);
-            break;
-
-        case DECL_RECORD:
-            /* Check methods */
-            for (size_t i = 0; i < vec_len(decl->record.methods); i++) {
-                check_proc(ctx, &decl->record.methods[i]);
-            }
-            break;
-
-        case DECL_ENUM:
-            for (size_t i = 0; i < vec_len(decl->enum_.methods); i++) {
-                check_proc(ctx, &decl->enum_.methods[i]);
-            }
-            break;
-
-        case DECL_MODAL:
-            /* Check shared methods */
-            for (size_t i = 0; i < vec_len(decl->modal.shared_methods); i++) {
-                check_proc(ctx, &decl->modal.shared_methods[i]);
-            }
-            /* Check state-specific methods */
-            for (size_t i = 0; i < vec_len(decl->modal.states); i++) {
-                ModalState *state = &decl->modal.states[i];
-                for (size_t j = 0; j < vec_len(state->methods); j++) {
-                    check_proc(ctx, &state->methods[j]);
-                }
-                /* Check transitions */
-                for (size_t j = 0; j < vec_len(state->transitions); j++) {
-                    Transition *trans = &state->transitions[j];
-                    if (trans->body) {
-                        /* Transitions typically take ~! receiver */
-                        ctx->receiver_perm = PERM_UNIQUE;
-                        check_expr(ctx, trans->body, PERM_CONST);
-                    }
-                }
-            }
-            break;
+static bool perm_enter_pattern(void *state, Pattern *pat, bool binds) {
+    (void)state;
+    (void)pat;
+    (void)binds;
+    return false;
+}
 
-        case DECL_CLASS:
-            /* Check default methods */
-            for (size_t i = 0; i < vec_len(decl->class_.default_methods); i++) {
-                check_proc(ctx, &decl->class_.default_methods[i]);
-            }
-            break;
+/*
+ * Release checking state
+ */
+static void perm_finish(void *state) {
+    PermContext *ctx = state;
+    place_table_destroy(&ctx->places);
+    vec_free(ctx->borrowed_unique_places);
+    vec_free(ctx->borrow_marks);
+}
 
-        case DECL_TYPE_ALIAS:
-        case DECL_EXTERN:
-        case DECL_MODULE:
-        case DECL_IMPORT:
-        case DECL_USE:
-            /* No permission checking needed */
-            break;
-    }
+/*
+ * Register permission checking with a body walker
+ */
+void sema_register_perm_pass(Visitor *v, SemaContext *ctx) {
+    PermContext *pctx = ARENA_ALLOC(ctx->arena, PermContext);
+    perm_ctx_init(pctx, ctx);
+
+    VisitPass pass;
+    memset(&pass, 0, sizeof(pass));
+    pass.name = "permissions";
+    pass.state = pctx;
+    pass.enter_body = perm_enter_body;
+    pass.enter_stmt = perm_enter_stmt;
+    pass.exit_stmt = perm_exit_stmt;
+    pass.enter_expr = perm_enter_expr;
+    pass.exit_expr = perm_exit_expr;
+    pass.enter_pattern = perm_enter_pattern;
+    pass.finish = perm_finish;
+    visitor_add_pass(v, &pass);
 }
 
 /*
  * Main entry point: check permissions in a module
  */
 bool sema_check_permissions(SemaContext *ctx, Module *mod) {
-    PermContext pctx;
-    perm_ctx_init(&pctx, ctx);
-
-    /* Check all declarations */
-    for (size_t i = 0; i < vec_len(mod->decls); i++) {
-        check_decl(&pctx, mod->decls[i]);
-    }
+    Visitor visitor;
+    visitor_init(&visitor, false);
+    sema_register_perm_pass(&visitor, ctx);
+    visitor_run_module(&visitor, mod);
 
     return !diag_has_errors(ctx->diag);
 }
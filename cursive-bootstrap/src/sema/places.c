@@ -0,0 +1,171 @@
+/*
+ * Cursive Bootstrap Compiler - Places and Borrow Index
+ */
+
+#include "places.h"
+#include <string.h>
+
+/*
+ * ============================================
+ * Interning
+ * ============================================
+ */
+
+static PlaceId new_node(PlaceTable *table, ProjectionKind kind, PlaceId parent) {
+    if (table->count == table->capacity) {
+        uint32_t cap = table->capacity ? table->capacity * 2 : 32;
+        PlaceNode *nodes = realloc(table->nodes, cap * sizeof(PlaceNode));
+        if (!nodes) {
+            CURSIVE_PANIC("Out of memory growing place table");
+        }
+        table->nodes = nodes;
+        table->capacity = cap;
+    }
+
+    PlaceId id = table->count++;
+    PlaceNode *node = &table->nodes[id];
+    memset(node, 0, sizeof(*node));
+    node->kind = kind;
+    node->parent = parent;
+    node->first_child = PLACE_NONE;
+    node->next_sibling = PLACE_NONE;
+    return id;
+}
+
+void place_table_reset(PlaceTable *table, uint32_t local_count) {
+    table->count = 0;
+    table->other_roots = PLACE_NONE;
+
+    if (local_count > table->local_cap) {
+        PlaceId *roots = realloc(table->local_roots, local_count * sizeof(PlaceId));
+        if (!roots) {
+            CURSIVE_PANIC("Out of memory growing place table");
+        }
+        table->local_roots = roots;
+        table->local_cap = local_count;
+    }
+    table->local_count = local_count;
+    for (uint32_t i = 0; i < local_count; i++) {
+        table->local_roots[i] = PLACE_NONE;
+    }
+}
+
+void place_table_destroy(PlaceTable *table) {
+    free(table->nodes);
+    free(table->local_roots);
+    memset(table, 0, sizeof(*table));
+}
+
+static PlaceId root_of(PlaceTable *table, Symbol *sym) {
+    if ((sym->kind == SYM_VAR || sym->kind == SYM_PARAM) && sym->slot < table->local_count) {
+        if (table->local_roots[sym->slot] == PLACE_NONE) {
+            PlaceId root = new_node(table, PROJ_BASE, PLACE_NONE);
+            table->nodes[root].base = sym;
+            table->local_roots[sym->slot] = root;
+        }
+        return table->local_roots[sym->slot];
+    }
+
+    for (PlaceId id = table->other_roots; id != PLACE_NONE; id = table->nodes[id].next_sibling) {
+        if (table->nodes[id].base == sym) {
+            return id;
+        }
+    }
+    PlaceId root = new_node(table, PROJ_BASE, PLACE_NONE);
+    table->nodes[root].base = sym;
+    table->nodes[root].next_sibling = table->other_roots;
+    table->other_roots = root;
+    return root;
+}
+
+static PlaceId child_of(PlaceTable *table, PlaceId parent, ProjectionKind kind,
+                        InternedString field) {
+    for (PlaceId id = table->nodes[parent].first_child; id != PLACE_NONE;
+         id = table->nodes[id].next_sibling) {
+        PlaceNode *node = &table->nodes[id];
+        if (node->kind == kind && (kind != PROJ_FIELD || node->field.data == field.data)) {
+            return id;
+        }
+    }
+
+    PlaceId child = new_node(table, kind, parent);
+    PlaceNode *node = &table->nodes[child];
+    node->field = field;
+    node->next_sibling = table->nodes[parent].first_child;
+    table->nodes[parent].first_child = child;
+    return child;
+}
+
+PlaceId place_of_expr(PlaceTable *table, Expr *expr) {
+    InternedString none = {0};
+    PlaceId base;
+
+    if (!expr) return PLACE_NONE;
+
+    switch (expr->kind) {
+        case EXPR_IDENT:
+            return expr->ident.resolved ? root_of(table, expr->ident.resolved) : PLACE_NONE;
+
+        case EXPR_FIELD:
+            base = place_of_expr(table, expr->field.object);
+            return base == PLACE_NONE ? PLACE_NONE
+                : child_of(table, base, PROJ_FIELD, expr->field.field);
+
+        case EXPR_INDEX:
+            base = place_of_expr(table, expr->index.object);
+            return base == PLACE_NONE ? PLACE_NONE
+                : child_of(table, base, PROJ_INDEX, none);
+
+        case EXPR_DEREF:
+            base = place_of_expr(table, expr->deref.operand);
+            return base == PLACE_NONE ? PLACE_NONE
+                : child_of(table, base, PROJ_DEREF, none);
+
+        case EXPR_UNARY:
+            if (expr->unary.op != UNOP_DEREF) return PLACE_NONE;
+            base = place_of_expr(table, expr->unary.operand);
+            return base == PLACE_NONE ? PLACE_NONE
+                : child_of(table, base, PROJ_DEREF, none);
+
+        default:
+            return PLACE_NONE;
+    }
+}
+
+/*
+ * ============================================
+ * Borrow Index
+ * ============================================
+ */
+
+bool place_borrow_conflicts(const PlaceTable *table, PlaceId place) {
+    /* A borrow of this place or of anything inside it */
+    if (table->nodes[place].borrows || table->nodes[place].borrows_below) {
+        return true;
+    }
+
+    /* A borrow of a place containing it */
+    for (PlaceId id = table->nodes[place].parent; id != PLACE_NONE;
+         id = table->nodes[id].parent) {
+        if (table->nodes[id].borrows) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void place_borrow(PlaceTable *table, PlaceId place) {
+    table->nodes[place].borrows++;
+    for (PlaceId id = table->nodes[place].parent; id != PLACE_NONE;
+         id = table->nodes[id].parent) {
+        table->nodes[id].borrows_below++;
+    }
+}
+
+void place_release(PlaceTable *table, PlaceId place) {
+    table->nodes[place].borrows--;
+    for (PlaceId id = table->nodes[place].parent; id != PLACE_NONE;
+         id = table->nodes[id].parent) {
+        table->nodes[id].borrows_below--;
+    }
+}
@@ -0,0 +1,78 @@
+/*
+ * Cursive Bootstrap Compiler - Places and Borrow Index
+ *
+ * A place is a memory location named by a path expression: a base
+ * binding followed by field, index and dereference projections
+ * (`a.b[i].c`). Places are interned in a trie per body, so two paths
+ * denote the same place exactly when they map to the same node, and one
+ * place contains another exactly when its node is an ancestor.
+ *
+ * Every node also counts the unique borrows taken of it and of the places
+ * below it, which makes the trie an index of active borrows: whether a
+ * new borrow conflicts is answered by walking the new place's ancestors
+ * instead of comparing it against every borrowed path. Sibling fields are
+ * disjoint; all elements of an array share one index node, since index
+ * values are not known statically.
+ */
+
+#ifndef CURSIVE_SEMA_PLACES_H
+#define CURSIVE_SEMA_PLACES_H
+
+#include "scope.h"
+#include "parser/ast.h"
+
+typedef uint32_t PlaceId;
+
+#define PLACE_NONE UINT32_MAX
+
+typedef enum ProjectionKind {
+    PROJ_BASE,    /* Root: the binding itself */
+    PROJ_FIELD,   /* .name */
+    PROJ_INDEX,   /* [i], any index */
+    PROJ_DEREF    /* *p */
+} ProjectionKind;
+
+typedef struct PlaceNode {
+    ProjectionKind kind;
+    InternedString field;     /* For PROJ_FIELD */
+    Symbol *base;             /* For PROJ_BASE */
+    PlaceId parent;           /* PLACE_NONE for roots */
+    PlaceId first_child;
+    PlaceId next_sibling;     /* Next child of the parent (or next non-local root) */
+
+    uint32_t borrows;         /* Active unique borrows of exactly this place */
+    uint32_t borrows_below;   /* Active unique borrows of places it contains */
+} PlaceNode;
+
+/*
+ * Places of one body. Locals are rooted by slot (see Symbol.slot); other
+ * symbols (module-level bindings) share a short list of roots.
+ */
+typedef struct PlaceTable {
+    PlaceNode *nodes;
+    uint32_t count;
+    uint32_t capacity;
+
+    PlaceId *local_roots;     /* Indexed by slot; PLACE_NONE until used */
+    uint32_t local_count;
+    uint32_t local_cap;
+    PlaceId other_roots;      /* Roots of non-local symbols */
+} PlaceTable;
+
+/* Start a new body with `local_count` slots (storage is reused) */
+void place_table_reset(PlaceTable *table, uint32_t local_count);
+
+/* Release storage */
+void place_table_destroy(PlaceTable *table);
+
+/* Intern the place named by a path expression (PLACE_NONE if not a path) */
+PlaceId place_of_expr(PlaceTable *table, Expr *expr);
+
+/* Would a unique borrow of the place overlap an active one? */
+bool place_borrow_conflicts(const PlaceTable *table, PlaceId place);
+
+/* Record or end a unique borrow of the place */
+void place_borrow(PlaceTable *table, PlaceId place);
+void place_release(PlaceTable *table, PlaceId place);
+
+#endif /* CURSIVE_SEMA_PLACES_H */
@@ -21,6 +21,7 @@ typedef struct ResolveContext {
     /* Current context */
     Decl *current_type_decl;      /* Current record/enum/modal being resolved */
     ProcDecl *current_proc;       /* Current procedure being resolved */
+    uint32_t next_slot;           /* Next local slot in the current body */
 } ResolveContext;
 
 /* Forward declarations */
@@ -214,7 +215,7 @@ static void resolve_type_expr(ResolveContext *ctx, TypeExpr *type) {
             } else if (!scope_is_visible(ctx->scope_ctx.current, sym)) {
                 error_not_visible(ctx, type->named.name, type->span);
             }
-            /* TODO: store resolved symbol in AST node */
+            type->named.resolved = sym;
             break;
         }
 
@@ -286,6 +287,36 @@ static void resolve_type_expr(ResolveContext *ctx, TypeExpr *type) {
     }
 }
 
+/*
+ * Define a parameter or local binding, giving it the next slot of the
+ * body being resolved. Later phases index per-body arrays by this slot
+ * instead of looking the binding up by name or pointer.
+ */
+static Symbol *define_local(ResolveContext *ctx, InternedString name, SymbolKind kind,
+                            SourceSpan span) {
+    Symbol *sym = scope_define(&ctx->scope_ctx, name, kind, VIS_PRIVATE, NULL, span);
+    if (sym) {
+        sym->slot = ctx->next_slot++;
+    }
+    return sym;
+}
+
+/*
+ * Bindings introduced by `var` are mutable and grant unique access
+ */
+static void mark_var_bindings(Pattern *pat) {
+    if (!pat) return;
+
+    if (pat->kind == PAT_BINDING && pat->binding.resolved) {
+        pat->binding.resolved->is_mutable = true;
+        pat->binding.resolved->perm = PERM_UNIQUE;
+    } else if (pat->kind == PAT_TUPLE) {
+        for (size_t i = 0; i < vec_len(pat->tuple.elements); i++) {
+            mark_var_bindings(pat->tuple.elements[i]);
+        }
+    }
+}
+
 /*
  * Resolve a pattern
  */
@@ -300,8 +331,7 @@ static void resolve_pattern(ResolveContext *ctx, Pattern *pat, bool is_definitio
         case PAT_BINDING:
             if (is_definition) {
                 /* Define the binding in current scope */
-                Symbol *sym = scope_define(&ctx->scope_ctx, pat->binding.name,
-                                          SYM_VAR, VIS_PRIVATE, NULL, pat->span);
+                Symbol *sym = define_local(ctx, pat->binding.name, SYM_VAR, pat->span);
                 if (!sym) {
                     Symbol *existing = scope_lookup_local(ctx->scope_ctx.current,
                                                          pat->binding.name);
@@ -309,16 +339,17 @@ static void resolve_pattern(ResolveContext *ctx, Pattern *pat, bool is_definitio
                                    existing ? existing->span : (SourceSpan){0});
                 } else {
                     sym->is_mutable = pat->binding.is_mutable;
+                    sym->perm = sym->is_mutable ? PERM_UNIQUE : PERM_CONST;
                 }
                 /* Store resolved symbol on pattern for later phases */
                 pat->binding.resolved = sym;
             } else {
                 /* In match patterns, check if identifier is a constant */
                 /* For now, treat as new binding */
-                Symbol *sym = scope_define(&ctx->scope_ctx, pat->binding.name,
-                                          SYM_VAR, VIS_PRIVATE, NULL, pat->span);
+                Symbol *sym = define_local(ctx, pat->binding.name, SYM_VAR, pat->span);
                 if (sym) {
                     sym->is_mutable = pat->binding.is_mutable;
+                    sym->perm = sym->is_mutable ? PERM_UNIQUE : PERM_CONST;
                 }
                 /* Store resolved symbol on pattern for later phases */
                 pat->binding.resolved = sym;
@@ -528,6 +559,10 @@ static void resolve_expr(ResolveContext *ctx, Expr *expr) {
             resolve_expr(ctx, expr->widen.operand);
             break;
 
+        case EXPR_COMPTIME:
+            resolve_expr(ctx, expr->comptime.operand);
+            break;
+
         case EXPR_CAST:
             resolve_expr(ctx, expr->cast.operand);
             resolve_type_expr(ctx, expr->cast.target_type);
@@ -615,6 +650,7 @@ static void resolve_stmt(ResolveContext *ctx, Stmt *stmt) {
                 resolve_type_expr(ctx, stmt->var.type);
             }
             resolve_pattern(ctx, stmt->var.pattern, true);
+            mark_var_bindings(stmt->var.pattern);
             break;
         }
 
@@ -684,6 +720,7 @@ static void resolve_stmt(ResolveContext *ctx, Stmt *stmt) {
  */
 static void resolve_proc_decl(ResolveContext *ctx, ProcDecl *proc) {
     ctx->current_proc = proc;
+    ctx->next_slot = 0;
 
     /* Create scope for generic parameters and procedure body */
     Scope *proc_scope = scope_enter(&ctx->scope_ctx, SCOPE_BLOCK);
@@ -694,15 +731,29 @@ static void resolve_proc_decl(ResolveContext *ctx, ProcDecl *proc) {
     /* Resolve where clauses */
     resolve_where_clauses(ctx, proc->where_clauses);
 
+    /* The receiver is the implicit parameter `self` */
+    proc->self_param = NULL;
+    if (proc->receiver != RECV_NONE) {
+        InternedString self_name = string_pool_intern(ctx->strings, "self");
+        Symbol *sym = define_local(ctx, self_name, SYM_PARAM, proc->span);
+        if (sym) {
+            sym->is_mutable = false;
+            sym->perm = proc->receiver == RECV_UNIQUE ? PERM_UNIQUE
+                      : proc->receiver == RECV_SHARED ? PERM_SHARED
+                      : PERM_CONST;
+        }
+        proc->self_param = sym;
+    }
+
     /* Resolve parameter types and define parameters */
     for (size_t i = 0; i < vec_len(proc->params); i++) {
         ParamDecl *param = &proc->params[i];
         resolve_type_expr(ctx, param->type);
 
-        Symbol *sym = scope_define(&ctx->scope_ctx, param->name, SYM_PARAM,
-                                  VIS_PRIVATE, NULL, param->span);
+        Symbol *sym = define_local(ctx, param->name, SYM_PARAM, param->span);
         if (sym) {
             sym->is_mutable = false;  /* Parameters are immutable by default */
+            sym->perm = param->perm;
         }
         /* Store resolved symbol on parameter for later phases */
         param->resolved = sym;
@@ -723,6 +774,7 @@ static void resolve_proc_decl(ResolveContext *ctx, ProcDecl *proc) {
 
     /* Store scope on procedure for later phases (move analysis, etc.) */
     proc->scope = proc_scope;
+    proc->local_count = ctx->next_slot;
 
     scope_exit(&ctx->scope_ctx);
     ctx->current_proc = NULL;
@@ -741,7 +793,7 @@ static void resolve_record_decl(ResolveContext *ctx, RecordDecl *rec) {
     self_sym->name = string_pool_intern(ctx->strings, "Self");
     self_sym->vis = VIS_PRIVATE;
     type_scope->self_type = self_sym;
-    scope_add_symbol(type_scope, self_sym);
+    scope_add_symbol(&ctx->scope_ctx, self_sym);
 
     /* Resolve generics */
     resolve_generic_params(ctx, rec->generics);
@@ -784,7 +836,7 @@ static void resolve_enum_decl(ResolveContext *ctx, EnumDecl *en) {
     self_sym->name = string_pool_intern(ctx->strings, "Self");
     self_sym->vis = VIS_PRIVATE;
     type_scope->self_type = self_sym;
-    scope_add_symbol(type_scope, self_sym);
+    scope_add_symbol(&ctx->scope_ctx, self_sym);
 
     /* Resolve generics */
     resolve_generic_params(ctx, en->generics);
@@ -829,7 +881,7 @@ static void resolve_modal_decl(ResolveContext *ctx, ModalDecl *modal) {
     self_sym->name = string_pool_intern(ctx->strings, "Self");
     self_sym->vis = VIS_PRIVATE;
     type_scope->self_type = self_sym;
-    scope_add_symbol(type_scope, self_sym);
+    scope_add_symbol(&ctx->scope_ctx, self_sym);
 
     /* Resolve generics */
     resolve_generic_params(ctx, modal->generics);
@@ -871,13 +923,16 @@ static void resolve_modal_decl(ResolveContext *ctx, ModalDecl *modal) {
 
             /* Create scope for transition */
             scope_enter(&ctx->scope_ctx, SCOPE_BLOCK);
+            ctx->next_slot = 0;
 
             /* Resolve parameters */
             for (size_t k = 0; k < vec_len(trans->params); k++) {
                 ParamDecl *param = &trans->params[k];
                 resolve_type_expr(ctx, param->type);
-                scope_define(&ctx->scope_ctx, param->name, SYM_PARAM,
-                           VIS_PRIVATE, NULL, param->span);
+                param->resolved = define_local(ctx, param->name, SYM_PARAM, param->span);
+                if (param->resolved) {
+                    param->resolved->perm = param->perm;
+                }
             }
 
             /* Check target state exists */
@@ -892,6 +947,7 @@ static void resolve_modal_decl(ResolveContext *ctx, ModalDecl *modal) {
             if (trans->body) {
                 resolve_expr(ctx, trans->body);
             }
+            trans->local_count = ctx->next_slot;
 
             scope_exit(&ctx->scope_ctx);
         }
@@ -921,7 +977,7 @@ static void resolve_class_decl(ResolveContext *ctx, ClassDecl *cls) {
     self_sym->name = string_pool_intern(ctx->strings, "Self");
     self_sym->vis = VIS_PRIVATE;
     type_scope->self_type = self_sym;
-    scope_add_symbol(type_scope, self_sym);
+    scope_add_symbol(&ctx->scope_ctx, self_sym);
 
     /* Resolve generics */
     resolve_generic_params(ctx, cls->generics);
@@ -1018,13 +1074,9 @@ bool sema_resolve_names(SemaContext *ctx, Module *mod) {
     memset(&rctx, 0, sizeof(rctx));
     rctx.arena = ctx->arena;
     rctx.diag = ctx->diag;
-    rctx.strings = NULL;  /* TODO: pass string pool */
+    rctx.strings = ctx->strings;
 
     /* Initialize scope context */
-    /* Use existing string pool from somewhere */
-    StringPool pool;
-    string_pool_init(&pool);
-    rctx.strings = &pool;
     scope_ctx_init(&rctx.scope_ctx, ctx->arena, rctx.strings);
 
     /* Initialize type context */
@@ -1042,11 +1094,19 @@ bool sema_resolve_names(SemaContext *ctx, Module *mod) {
         resolve_decl(&rctx, mod->decls[i]);
     }
 
+    /* Phase 3: Index type members for constant-time lookup */
+    for (size_t i = 0; i < vec_len(mod->decls); i++) {
+        members_build_decl(ctx->arena, ctx->diag, &ctx->member_tables, mod->decls[i]);
+    }
+
     /* Store scope context for later phases - BEFORE exiting module scope */
     ctx->current_scope = mod_scope;  /* Module scope with all declarations */
     ctx->universe_scope = rctx.scope_ctx.universe;
 
-    /* Note: Don't call scope_exit here - we want to preserve mod_scope for type checking */
+    /* Note: Don't call scope_exit here - we want to preserve mod_scope for type checking.
+     * Later phases look symbols up through the scopes themselves, so the
+     * shared symbol table is no longer needed. */
+    scope_ctx_destroy(&rctx.scope_ctx);
 
     /* Return success if no errors */
     return !diag_has_errors(rctx.diag);
@@ -5,11 +5,114 @@
 #include "scope.h"
 #include "types.h"
 
+#define SYMBOL_TABLE_INITIAL_CAP 256
+
+/*
+ * ============================================
+ * Symbol Table
+ * ============================================
+ */
+
+/* Find the entry for a name, or the empty slot where it would go */
+static SymbolTableEntry *table_find(const SymbolTable *table, InternedString name) {
+    size_t mask = table->capacity - 1;
+    size_t idx = name.hash & mask;
+
+    for (;;) {
+        SymbolTableEntry *entry = &table->entries[idx];
+        if (interned_is_null(entry->name) || interned_eq(entry->name, name)) {
+            return entry;
+        }
+        idx = (idx + 1) & mask;
+    }
+}
+
+/* Grow and rehash (entries are never removed, only emptied of symbols) */
+static void table_grow(SymbolTable *table) {
+    size_t old_capacity = table->capacity;
+    SymbolTableEntry *old_entries = table->entries;
+
+    table->capacity *= 2;
+    table->entries = calloc(table->capacity, sizeof(SymbolTableEntry));
+    if (!table->entries) {
+        CURSIVE_PANIC("Out of memory growing symbol table");
+    }
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (!interned_is_null(old_entries[i].name)) {
+            *table_find(table, old_entries[i].name) = old_entries[i];
+        }
+    }
+
+    free(old_entries);
+}
+
+/* Innermost visible symbol for a name */
+static Symbol *table_get(const SymbolTable *table, InternedString name) {
+    if (interned_is_null(name)) return NULL;
+    return table_find(table, name)->top;
+}
+
+/* Make sym the innermost binding of its name and log it for undo */
+static void table_push(SymbolTable *table, Symbol *sym) {
+    if ((table->count + 1) * 4 > table->capacity * 3) {
+        table_grow(table);
+    }
+
+    SymbolTableEntry *entry = table_find(table, sym->name);
+    if (interned_is_null(entry->name)) {
+        entry->name = sym->name;
+        table->count++;
+    }
+    sym->shadowed = entry->top;
+    entry->top = sym;
+    vec_push(table->undo, sym);
+}
+
+/* Undo definitions back to a log mark, restoring the bindings they shadowed */
+static void table_unwind(SymbolTable *table, size_t mark) {
+    while (vec_len(table->undo) > mark) {
+        Symbol *sym = vec_last(table->undo);
+        vec_pop(table->undo);
+        table_find(table, sym->name)->top = sym->shadowed;
+    }
+}
+
+/* Record a symbol as defined in the current scope */
+static void define_in_current(ScopeContext *ctx, Symbol *sym) {
+    sym->defining_scope = ctx->current;
+    sym->next_in_scope = ctx->current->symbols;
+    ctx->current->symbols = sym;
+    table_push(&ctx->table, sym);
+
+    Scope *scope = ctx->current;
+    if (scope->kind == SCOPE_MODULE || scope->kind == SCOPE_UNIVERSE) {
+        if (scope->index.capacity == 0) {
+            map_init(&scope->index);
+        }
+        map_set(&scope->index, sym->name, sym);
+    }
+}
+
+/*
+ * ============================================
+ * Scopes
+ * ============================================
+ */
+
 /* Initialize scope context with universe scope */
 void scope_ctx_init(ScopeContext *ctx, Arena *arena, StringPool *strings) {
     ctx->arena = arena;
     ctx->strings = strings;
 
+    ctx->table.capacity = SYMBOL_TABLE_INITIAL_CAP;
+    ctx->table.count = 0;
+    ctx->table.entries = calloc(ctx->table.capacity, sizeof(SymbolTableEntry));
+    if (!ctx->table.entries) {
+        CURSIVE_PANIC("Out of memory allocating symbol table");
+    }
+    ctx->table.undo = NULL;  /* Vec starts as NULL */
+
     /* Create universe scope */
     ctx->universe = scope_new(ctx, SCOPE_UNIVERSE);
     ctx->current = ctx->universe;
@@ -18,26 +121,37 @@ void scope_ctx_init(ScopeContext *ctx, Arena *arena, StringPool *strings) {
     scope_populate_universe(ctx);
 }
 
+/* Release the symbol table */
+void scope_ctx_destroy(ScopeContext *ctx) {
+    free(ctx->table.entries);
+    ctx->table.entries = NULL;
+    ctx->table.count = 0;
+    ctx->table.capacity = 0;
+    vec_free(ctx->table.undo);
+}
+
 /* Create a new scope */
 Scope *scope_new(ScopeContext *ctx, ScopeKind kind) {
     Scope *scope = ARENA_ALLOC(ctx->arena, Scope);
     memset(scope, 0, sizeof(Scope));
     scope->kind = kind;
     scope->parent = NULL;
-    map_init(&scope->symbols);
-    scope->imported_modules = vec_new(Scope *);
+    scope->symbols = NULL;
+    scope->imported_modules = NULL;  /* Vec starts as NULL */
     return scope;
 }
 
 /* Push a scope onto the scope stack */
 void scope_push(ScopeContext *ctx, Scope *scope) {
     scope->parent = ctx->current;
+    scope->undo_mark = vec_len(ctx->table.undo);
     ctx->current = scope;
 }
 
-/* Pop current scope */
+/* Pop current scope, unbinding everything it defined */
 void scope_pop(ScopeContext *ctx) {
     if (ctx->current && ctx->current->parent) {
+        table_unwind(&ctx->table, ctx->current->undo_mark);
         ctx->current = ctx->current->parent;
     }
 }
@@ -61,13 +175,12 @@ Symbol *symbol_new(Arena *arena) {
     return sym;
 }
 
-/* Add a symbol to a scope */
-bool scope_add_symbol(Scope *scope, Symbol *sym) {
-    if (scope_is_defined_locally(scope, sym->name)) {
+/* Add a symbol to the current scope */
+bool scope_add_symbol(ScopeContext *ctx, Symbol *sym) {
+    if (scope_is_defined_locally(ctx, sym->name)) {
         return false;  /* Already defined */
     }
-    sym->defining_scope = scope;
-    map_set(&scope->symbols, sym->name, sym);
+    define_in_current(ctx, sym);
     return true;
 }
 
@@ -75,7 +188,7 @@ bool scope_add_symbol(Scope *scope, Symbol *sym) {
 Symbol *scope_define(ScopeContext *ctx, InternedString name, SymbolKind kind,
                      Visibility vis, Decl *decl, SourceSpan span) {
     /* Check for redefinition in current scope */
-    if (scope_is_defined_locally(ctx->current, name)) {
+    if (scope_is_defined_locally(ctx, name)) {
         return NULL;  /* Error: redefinition */
     }
 
@@ -85,16 +198,30 @@ Symbol *scope_define(ScopeContext *ctx, InternedString name, SymbolKind kind,
     sym->vis = vis;
     sym->decl = decl;
     sym->span = span;
-    sym->defining_scope = ctx->current;
 
-    map_set(&ctx->current->symbols, name, sym);
+    define_in_current(ctx, sym);
     return sym;
 }
 
+/* Release a scope's name index */
+void scope_destroy(Scope *scope) {
+    if (scope && scope->index.capacity) {
+        map_destroy(&scope->index);
+    }
+}
+
 /* Look up a symbol only in a specific scope */
 Symbol *scope_lookup_local(Scope *scope, InternedString name) {
     if (!scope) return NULL;
-    return (Symbol *)map_get(&scope->symbols, name);
+    if (scope->index.capacity) {
+        return map_get(&scope->index, name);
+    }
+    for (Symbol *sym = scope->symbols; sym; sym = sym->next_in_scope) {
+        if (interned_eq(sym->name, name)) {
+            return sym;
+        }
+    }
+    return NULL;
 }
 
 /* Look up a symbol in a scope chain */
@@ -121,12 +248,27 @@ Symbol *scope_lookup_from(Scope *scope, InternedString name) {
 
 /* Look up a symbol in current scope chain */
 Symbol *scope_lookup(ScopeContext *ctx, InternedString name) {
-    return scope_lookup_from(ctx->current, name);
+    Symbol *sym = table_get(&ctx->table, name);
+    if (sym) return sym;
+
+    /* Fall back to modules imported by enclosing module scopes */
+    for (Scope *scope = ctx->current; scope; scope = scope->parent) {
+        if (scope->kind != SCOPE_MODULE) continue;
+        Scope *imported;
+        vec_foreach(scope->imported_modules, imported) {
+            sym = scope_lookup_local(imported, name);
+            if (sym && scope_is_visible(scope, sym)) {
+                return sym;
+            }
+        }
+    }
+    return NULL;
 }
 
 /* Check if a name is defined in current scope (not parents) */
-bool scope_is_defined_locally(Scope *scope, InternedString name) {
-    return scope_lookup_local(scope, name) != NULL;
+bool scope_is_defined_locally(ScopeContext *ctx, InternedString name) {
+    Symbol *sym = table_get(&ctx->table, name);
+    return sym && sym->defining_scope == ctx->current;
 }
 
 /* Visibility check: is sym visible from the current scope? */
@@ -212,9 +354,8 @@ static Symbol *add_builtin_type(ScopeContext *ctx, const char *name) {
     sym->name = iname;
     sym->vis = VIS_PUBLIC;
     sym->decl = NULL;  /* Built-in, no declaration */
-    sym->defining_scope = ctx->universe;
     sym->span = (SourceSpan){0};
-    map_set(&ctx->universe->symbols, iname, sym);
+    define_in_current(ctx, sym);  /* Universe is current during population */
     return sym;
 }
 
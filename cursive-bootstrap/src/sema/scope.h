@@ -3,6 +3,16 @@
  *
  * Implements lexical scoping for name resolution.
  * Scope hierarchy: Universe -> Module -> Block/Type
+ *
+ * All open scopes share one symbol table keyed by name. Each entry holds
+ * the innermost visible symbol for that name; the bindings it shadows are
+ * chained through Symbol.shadowed. Every definition is recorded in an undo
+ * log, and leaving a scope pops the log back to the scope's mark, so
+ * entering and leaving scopes allocates nothing per scope.
+ *
+ * Module and universe scopes are still searched by name after resolution
+ * (type checking, imports), so they also keep a name index of their own;
+ * block scopes are small and are scanned.
  */
 
 #ifndef CURSIVE_SCOPE_H
@@ -57,10 +67,15 @@ struct Symbol {
     Decl *decl;              /* Declaration AST node (may be NULL for built-ins) */
     Type *type;              /* Resolved type (filled by type checker) */
     Scope *defining_scope;   /* Scope where this symbol is defined */
+    Symbol *shadowed;        /* Binding of the same name this one hides */
+    Symbol *next_in_scope;   /* Next symbol defined in defining_scope */
 
     /* For variables/parameters: binding information */
     bool is_mutable;         /* var vs let */
+    Permission perm;         /* Access through the binding (unique for var and unique params) */
     BindingOp binding_op;    /* = vs := */
+    uint32_t slot;           /* Dense index among the locals of its body */
+    bool drop_flag;          /* Dropped only on paths that still own it (see drops.c) */
 
     /* For generic parameters */
     size_t generic_index;    /* Index in generic parameter list */
@@ -74,7 +89,9 @@ struct Symbol {
 struct Scope {
     ScopeKind kind;
     Scope *parent;           /* Enclosing scope (NULL for universe) */
-    Map symbols;             /* InternedString -> Symbol* */
+    Symbol *symbols;         /* Symbols defined here (via next_in_scope) */
+    Map index;               /* Name -> symbol, module and universe scopes only */
+    size_t undo_mark;        /* Undo log length when the scope was entered */
 
     /* For module scopes */
     InternedString module_name;
@@ -89,6 +106,24 @@ struct Scope {
     Vec(Scope *) imported_modules;
 };
 
+/*
+ * Symbol table entry: innermost visible symbol for a name
+ */
+typedef struct SymbolTableEntry {
+    InternedString name;     /* Key (NULL data means empty slot) */
+    Symbol *top;             /* Innermost binding (NULL once all scopes exit) */
+} SymbolTableEntry;
+
+/*
+ * Scoped symbol table shared by all open scopes
+ */
+typedef struct SymbolTable {
+    SymbolTableEntry *entries;
+    size_t count;
+    size_t capacity;
+    Vec(Symbol *) undo;      /* Definitions in order, popped on scope exit */
+} SymbolTable;
+
 /*
  * Scope context for resolution
  */
@@ -97,11 +132,15 @@ typedef struct ScopeContext {
     Scope *universe;         /* Root scope with built-ins */
     Scope *current;          /* Current active scope */
     StringPool *strings;     /* For interning names */
+    SymbolTable table;       /* Visible symbols of all open scopes */
 } ScopeContext;
 
 /* Initialize scope context with universe scope */
 void scope_ctx_init(ScopeContext *ctx, Arena *arena, StringPool *strings);
 
+/* Release the symbol table (scopes and symbols stay valid in the arena) */
+void scope_ctx_destroy(ScopeContext *ctx);
+
 /* Create a new scope */
 Scope *scope_new(ScopeContext *ctx, ScopeKind kind);
 
@@ -119,23 +158,27 @@ void scope_exit(ScopeContext *ctx);
 Symbol *scope_define(ScopeContext *ctx, InternedString name, SymbolKind kind,
                      Visibility vis, Decl *decl, SourceSpan span);
 
-/* Look up a symbol in current scope chain */
+/* Look up a symbol in current scope chain (one table probe) */
 Symbol *scope_lookup(ScopeContext *ctx, InternedString name);
 
-/* Look up a symbol only in current scope (no parent search) */
+/* Release a scope's name index (the scope stays valid in the arena) */
+void scope_destroy(Scope *scope);
+
+/* Look up a symbol only in a given scope (open or closed) */
 Symbol *scope_lookup_local(Scope *scope, InternedString name);
 
-/* Look up a symbol in a specific scope chain starting from given scope */
+/* Look up a symbol in a specific scope chain starting from given scope.
+ * Searches each scope, so it also works after the scopes have been exited. */
 Symbol *scope_lookup_from(Scope *scope, InternedString name);
 
-/* Check if a name is defined in current scope (not parents) */
-bool scope_is_defined_locally(Scope *scope, InternedString name);
+/* Check if a name is defined in the current scope (not parents) */
+bool scope_is_defined_locally(ScopeContext *ctx, InternedString name);
 
 /* Create a symbol without adding to scope (for building) */
 Symbol *symbol_new(Arena *arena);
 
-/* Add a symbol to a scope */
-bool scope_add_symbol(Scope *scope, Symbol *sym);
+/* Add a symbol to the current scope */
+bool scope_add_symbol(ScopeContext *ctx, Symbol *sym);
 
 /* Visibility check: is sym visible from the current scope? */
 bool scope_is_visible(Scope *from_scope, Symbol *sym);
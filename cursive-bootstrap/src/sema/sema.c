@@ -15,15 +15,21 @@ void sema_init(SemaContext *ctx, Arena *arena, DiagContext *diag, StringPool *st
 
     /* Initialize type context */
     type_ctx_init(&ctx->type_ctx, arena, strings);
-
-    /* Initialize type cache */
-    map_init(&ctx->type_cache);
+    layout_ctx_init(&ctx->layout, arena, &ctx->type_ctx);
 
     /* Scope context will be created during name resolution */
     ctx->current_scope = NULL;
     ctx->universe_scope = NULL;
 }
 
+/* Release what the context owns outside its arena */
+void sema_destroy(SemaContext *ctx) {
+    members_destroy(&ctx->member_tables);
+    scope_destroy(ctx->current_scope);
+    scope_destroy(ctx->universe_scope);
+    layout_ctx_destroy(&ctx->layout);
+}
+
 /* Run full semantic analysis on a module */
 bool sema_analyze(SemaContext *ctx, Module *mod) {
     /* Phase 1: Name resolution */
@@ -36,17 +42,22 @@ bool sema_analyze(SemaContext *ctx, Module *mod) {
         return false;
     }
 
-    /* Phase 3: Move analysis */
-    if (!sema_analyze_moves(ctx, mod)) {
-        return false;
-    }
+    /* Phases 3-4: Move analysis and permission checking, fused into a
+     * single walk over each body together with the drop elaboration and
+     * liveness marks that code generation consumes */
+    Visitor visitor;
+    visitor_init(&visitor, ctx->time_passes);
+    sema_register_drop_pass(&visitor, ctx);
+    sema_register_move_pass(&visitor, ctx);
+    sema_register_perm_pass(&visitor, ctx);
+    sema_register_liveness_pass(&visitor, ctx);
+    visitor_run_module(&visitor, mod);
 
-    /* Phase 4: Permission checking */
-    if (!sema_check_permissions(ctx, mod)) {
-        return false;
+    if (ctx->time_passes) {
+        visitor_report_timing(&visitor, stderr);
     }
 
-    return true;
+    return !diag_has_errors(ctx->diag);
 }
 
 /* Note: sema_check_types is implemented in typecheck.c */
@@ -14,9 +14,12 @@
 #include "common/map.h"
 #include "common/string_pool.h"
 
-/* Include scope and types headers */
+/* Include scope, type and member table headers */
 #include "scope.h"
 #include "types.h"
+#include "layout.h"
+#include "members.h"
+#include "visit.h"
 
 /*
  * Semantic Analysis Context
@@ -31,13 +34,20 @@ typedef struct SemaContext {
     Scope *universe_scope;  /* Built-in types */
 
     /* Type system */
-    TypeContext type_ctx;   /* Type context */
-    Map type_cache;         /* Canonical types */
+    TypeContext type_ctx;   /* Type context (owns the canonical type table) */
+    LayoutContext layout;   /* Sizes, alignments and field offsets */
+    Vec(MemberTable *) member_tables;  /* Built by name resolution */
+
+    /* Diagnostics */
+    bool time_passes;       /* Report per-analysis time of the body walk */
 } SemaContext;
 
 /* Initialize semantic analysis context */
 void sema_init(SemaContext *ctx, Arena *arena, DiagContext *diag, StringPool *strings);
 
+/* Release what the context owns outside its arena */
+void sema_destroy(SemaContext *ctx);
+
 /* Run full semantic analysis on a module */
 bool sema_analyze(SemaContext *ctx, Module *mod);
 
@@ -47,4 +57,10 @@ bool sema_check_types(SemaContext *ctx, Module *mod);
 bool sema_analyze_moves(SemaContext *ctx, Module *mod);
 bool sema_check_permissions(SemaContext *ctx, Module *mod);
 
+/* Register body analyses with a shared walker (see visit.h) */
+void sema_register_drop_pass(Visitor *v, SemaContext *ctx);  /* Before any CFG user */
+void sema_register_move_pass(Visitor *v, SemaContext *ctx);
+void sema_register_perm_pass(Visitor *v, SemaContext *ctx);
+void sema_register_liveness_pass(Visitor *v, SemaContext *ctx);
+
 #endif /* CURSIVE_SEMA_H */
@@ -12,8 +12,12 @@
 #include "sema.h"
 #include "scope.h"
 #include "types.h"
+#include "match.h"
+#include "infer.h"
+#include "consteval.h"
 #include "common/error.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 /* Type checking context */
 typedef struct TypeCheckContext {
@@ -27,9 +31,21 @@ typedef struct TypeCheckContext {
     Decl *current_type_decl;
     ProcDecl *current_proc;
     Type *current_return_type;
+    Type *self_type;                   /* `Self` of the type being checked, or NULL */
 
     /* Scope for looking up symbols */
     Scope *scope;
+
+    /* Local inference, solved at the end of each procedure */
+    InferTable infer;
+    bool allow_infer;                  /* `_` may stand for a type here */
+    Vec(Type **) infer_slots;          /* Types to resolve once solved */
+    Vec(Pattern *) infer_bindings;     /* Bindings typed by inference */
+    Vec(Expr *) pending_matches;       /* Matches waiting for their scrutinee type */
+    Vec(Expr *) pending_comptime;      /* `comptime` expressions waiting for their types */
+
+    /* Compile-time evaluation, shared by all contexts */
+    ConstEval *consteval;
 } TypeCheckContext;
 
 /* Forward declarations */
@@ -37,14 +53,28 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected);
 static void check_stmt(TypeCheckContext *ctx, Stmt *stmt);
 static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr);
 static Type *check_pattern(TypeCheckContext *ctx, Pattern *pat, Type *expected);
+static bool eval_size(TypeCheckContext *ctx, Expr *size, size_t *out);
+
+/* Spell a type for a diagnostic, naming literal variables by their class */
+static const char *describe_type(TypeCheckContext *ctx, Type *type) {
+    type = infer_shallow(&ctx->infer, type);
+    if (type->kind == TYPE_INFER) {
+        switch (infer_class(&ctx->infer, type)) {
+            case INFER_INT:   return "{integer}";
+            case INFER_FLOAT: return "{float}";
+            case INFER_ANY:   break;
+        }
+    }
+    return type_to_string(type, ctx->arena);
+}
 
 /* Error reporting helpers */
 static void error_type_mismatch(TypeCheckContext *ctx, SourceSpan span,
                                 Type *expected, Type *actual) {
     diag_report(ctx->diag, DIAG_ERROR, E_TYP_1603, span,
         "type mismatch: expected '%s', found '%s'",
-        type_to_string(expected, ctx->arena),
-        type_to_string(actual, ctx->arena));
+        describe_type(ctx, expected),
+        describe_type(ctx, actual));
 }
 
 static void error_not_callable(TypeCheckContext *ctx, SourceSpan span, Type *type) {
@@ -104,11 +134,9 @@ static TypeKind prim_to_type_kind(PrimitiveType prim) {
 }
 
 /*
- * Convert AST TypeExpr to semantic Type
+ * Convert AST TypeExpr to semantic Type (uncached; see resolve_type_expr)
  */
-static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
-    if (!texpr) return ctx->types->type_unit;
-
+static Type *resolve_type_expr_uncached(TypeCheckContext *ctx, TypeExpr *texpr) {
     Type *result = NULL;
 
     switch (texpr->kind) {
@@ -117,14 +145,20 @@ static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
             break;
 
         case TEXPR_NAMED: {
-            /* Look up the type symbol */
-            Symbol *sym = scope_lookup_from(ctx->scope, texpr->named.name);
+            /* Use the symbol name resolution found in the declaring scope */
+            Symbol *sym = texpr->named.resolved;
+            if (!sym) {
+                sym = scope_lookup_from(ctx->scope, texpr->named.name);
+            }
             if (!sym) {
                 diag_report(ctx->diag, DIAG_ERROR, E_RES_0200, texpr->span, "unknown type");
                 return type_error_type(ctx->types);
             }
-            Vec(Type *) args = vec_new(Type *);
-            result = type_nominal(ctx->types, sym, args);
+            if (sym->kind == SYM_GENERIC) {
+                result = type_generic_param(ctx->types, sym->name, sym->generic_index, NULL);
+            } else {
+                result = type_nominal(ctx->types, sym, NULL);
+            }
             break;
         }
 
@@ -157,10 +191,9 @@ static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
 
         case TEXPR_ARRAY: {
             Type *elem = resolve_type_expr(ctx, texpr->array.element);
-            /* For bootstrap, assume array size is a constant integer literal */
-            size_t size = 0;
-            if (texpr->array.size && texpr->array.size->kind == EXPR_INT_LIT) {
-                size = (size_t)texpr->array.size->int_lit.value;
+            size_t size;
+            if (!texpr->array.size || !eval_size(ctx, texpr->array.size, &size)) {
+                return type_error_type(ctx->types);
             }
             result = type_array(ctx->types, elem, size);
             break;
@@ -218,14 +251,18 @@ static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
             break;
 
         case TEXPR_SELF:
-            /* Look for Self in enclosing type scope */
-            /* For bootstrap, return error type if not found */
-            result = type_error_type(ctx->types);
+            result = ctx->self_type ? ctx->self_type : type_error_type(ctx->types);
             break;
 
         case TEXPR_INFER:
-            /* Will be inferred later */
-            result = type_error_type(ctx->types);
+            /* Solved with the rest of the procedure body */
+            if (ctx->allow_infer) {
+                result = infer_fresh(&ctx->infer, INFER_ANY);
+            } else {
+                diag_report(ctx->diag, DIAG_ERROR, E_TYP_1603, texpr->span,
+                    "'_' is only allowed in the types of local bindings");
+                result = type_error_type(ctx->types);
+            }
             break;
     }
 
@@ -237,11 +274,234 @@ static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
     return result;
 }
 
+/*
+ * Convert AST TypeExpr to semantic Type.
+ * The result is memoized on the TypeExpr: a type expression always resolves
+ * in the same scope, and types are canonical, so it never changes. Types
+ * with `_` in them are not memoized, since their variables are local to
+ * one solve.
+ */
+static Type *resolve_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
+    if (!texpr) return ctx->types->type_unit;
+
+    if (texpr->resolved) return texpr->resolved;
+
+    Type *result = resolve_type_expr_uncached(ctx, texpr);
+    if (!result->has_vars) {
+        texpr->resolved = result;
+    }
+    return result;
+}
+
+/* Resolve the annotation of a local binding, where `_` leaves a part to inference */
+static Type *resolve_local_type_expr(TypeCheckContext *ctx, TypeExpr *texpr) {
+    ctx->allow_infer = true;
+    Type *result = resolve_type_expr(ctx, texpr);
+    ctx->allow_infer = false;
+    return result;
+}
+
+/* Record a type slot to rewrite once the procedure's variables are solved */
+static void note_inferred(TypeCheckContext *ctx, Type **slot) {
+    if (*slot && (*slot)->has_vars) {
+        vec_push(ctx->infer_slots, slot);
+    }
+}
+
+/* Is this an integer type, or an integer literal's variable? */
+static bool is_integer_type(TypeCheckContext *ctx, Type *type) {
+    type = infer_shallow(&ctx->infer, type);
+    return (type->kind >= TYPE_PRIM_I8 && type->kind <= TYPE_PRIM_USIZE) ||
+           infer_class(&ctx->infer, type) == INFER_INT;
+}
+
+/* Is this a numeric type, or a numeric literal's variable? */
+static bool is_numeric_type(TypeCheckContext *ctx, Type *type) {
+    type = infer_shallow(&ctx->infer, type);
+    return (type->kind >= TYPE_PRIM_I8 && type->kind <= TYPE_PRIM_F64) ||
+           infer_class(&ctx->infer, type) != INFER_ANY;
+}
+
+/*
+ * The type `Self` names inside a record or enum: the nominal type,
+ * instantiated with its own parameters when it is generic. Modal types
+ * and classes have no single `Self` type here.
+ */
+static Type *decl_self_type(TypeCheckContext *ctx, Decl *decl) {
+    if (!decl) return NULL;
+
+    InternedString name;
+    Vec(GenericParam) generics;
+    switch (decl->kind) {
+        case DECL_RECORD:
+            name = decl->record.name;
+            generics = decl->record.generics;
+            break;
+        case DECL_ENUM:
+            name = decl->enum_.name;
+            generics = decl->enum_.generics;
+            break;
+        default:
+            return NULL;
+    }
+
+    Symbol *sym = scope_lookup_from(ctx->scope, name);
+    if (!sym || sym->decl != decl) return NULL;
+
+    Type *self = type_nominal(ctx->types, sym, NULL);
+    if (vec_len(generics) == 0) return self;
+
+    Vec(Type *) args = vec_new(Type *);
+    vec_reserve(args, vec_len(generics));
+    for (size_t i = 0; i < vec_len(generics); i++) {
+        vec_push(args, type_generic_param(ctx->types, generics[i].name, i, NULL));
+    }
+    return type_generic_inst(ctx->types, self, args);
+}
+
+/*
+ * Get the function type of a procedure or method, built once per declaration
+ */
+static Type *proc_signature(TypeCheckContext *ctx, ProcDecl *proc) {
+    if (proc->signature) return proc->signature;
+
+    Type *saved_self = ctx->self_type;
+    ctx->self_type = decl_self_type(ctx, proc->owner);
+
+    Vec(Type *) params = vec_new(Type *);
+    vec_reserve(params, vec_len(proc->params));
+    for (size_t i = 0; i < vec_len(proc->params); i++) {
+        vec_push(params, resolve_type_expr(ctx, proc->params[i].type));
+    }
+    Type *ret = resolve_type_expr(ctx, proc->return_type);
+
+    ctx->self_type = saved_self;
+    proc->signature = type_function(ctx->types, params, ret);
+    return proc->signature;
+}
+
+/*
+ * Signature of the function named `name` in an extern block, computed on
+ * first use like those of procedures
+ */
+static Type *extern_signature(TypeCheckContext *ctx, ExternBlock *block, InternedString name) {
+    for (size_t i = 0; i < vec_len(block->funcs); i++) {
+        ExternFuncDecl *func = &block->funcs[i];
+        if (!interned_eq(func->name, name)) continue;
+        if (func->signature) return func->signature;
+
+        Vec(Type *) params = vec_new(Type *);
+        vec_reserve(params, vec_len(func->params));
+        for (size_t j = 0; j < vec_len(func->params); j++) {
+            vec_push(params, resolve_type_expr(ctx, func->params[j].type));
+        }
+        func->signature = type_function(ctx->types, params,
+            resolve_type_expr(ctx, func->return_type));
+        return func->signature;
+    }
+    return type_error_type(ctx->types);
+}
+
+/*
+ * Get the generic procedure an expression names directly, if any
+ */
+static ProcDecl *generic_callee(Expr *callee) {
+    if (callee->kind != EXPR_IDENT) return NULL;
+
+    Symbol *sym = callee->ident.resolved;
+    if (!sym || sym->kind != SYM_PROC || !sym->decl || sym->decl->kind != DECL_PROC) {
+        return NULL;
+    }
+    return vec_len(sym->decl->proc.generics) > 0 ? &sym->decl->proc : NULL;
+}
+
+/*
+ * Infer generic arguments by matching a parameter type against an argument type.
+ * Only slots that are still NULL in `inferred` are filled.
+ */
+static void infer_type_args(TypeCheckContext *ctx, Type *param, Type *arg,
+                            Vec(Type *) inferred) {
+    if (!param->has_params || !arg || arg->kind == TYPE_ERROR) return;
+
+    if (param->kind == TYPE_GENERIC_PARAM) {
+        size_t index = param->generic_param.index;
+        if (index < vec_len(inferred) && !inferred[index]) {
+            /* A permission written on the parameter is not part of the argument */
+            inferred[index] = param->perm != PERM_CONST
+                ? type_with_permission(ctx->types, arg, PERM_CONST) : arg;
+        }
+        return;
+    }
+
+    if (param->kind != arg->kind) return;
+
+    switch (param->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            for (size_t i = 0; i < vec_len(param->nominal.type_args) &&
+                               i < vec_len(arg->nominal.type_args); i++) {
+                infer_type_args(ctx, param->nominal.type_args[i],
+                                arg->nominal.type_args[i], inferred);
+            }
+            break;
+
+        case TYPE_TUPLE:
+            for (size_t i = 0; i < vec_len(param->tuple.elements) &&
+                               i < vec_len(arg->tuple.elements); i++) {
+                infer_type_args(ctx, param->tuple.elements[i],
+                                arg->tuple.elements[i], inferred);
+            }
+            break;
+
+        case TYPE_ARRAY:
+            infer_type_args(ctx, param->array.element, arg->array.element, inferred);
+            break;
+
+        case TYPE_SLICE:
+            infer_type_args(ctx, param->slice.element, arg->slice.element, inferred);
+            break;
+
+        case TYPE_FUNCTION:
+            for (size_t i = 0; i < vec_len(param->function.params) &&
+                               i < vec_len(arg->function.params); i++) {
+                infer_type_args(ctx, param->function.params[i],
+                                arg->function.params[i], inferred);
+            }
+            infer_type_args(ctx, param->function.return_type,
+                            arg->function.return_type, inferred);
+            break;
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            infer_type_args(ctx, param->ptr.pointee, arg->ptr.pointee, inferred);
+            break;
+
+        case TYPE_GENERIC_INST:
+            if (param->generic_inst.base != arg->generic_inst.base) break;
+            for (size_t i = 0; i < vec_len(param->generic_inst.args) &&
+                               i < vec_len(arg->generic_inst.args); i++) {
+                infer_type_args(ctx, param->generic_inst.args[i],
+                                arg->generic_inst.args[i], inferred);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
 /*
  * Check if two types are compatible (with implicit conversions)
  */
 static bool types_compatible(TypeCheckContext *ctx, Type *expected, Type *actual) {
     if (type_equals(expected, actual)) return true;
+    if ((expected->has_vars || actual->has_vars) &&
+        infer_unify(&ctx->infer, expected, actual)) {
+        return true;
+    }
     if (type_is_subtype(actual, expected)) return true;
 
     /* Error type is compatible with anything (error recovery) */
@@ -255,11 +515,13 @@ static bool types_compatible(TypeCheckContext *ctx, Type *expected, Type *actual
  */
 static Type *binary_result_type(TypeCheckContext *ctx, BinaryOp op,
                                 Type *left, Type *right) {
+    left = infer_shallow(&ctx->infer, left);
+    right = infer_shallow(&ctx->infer, right);
+
     /* Arithmetic operations */
     if (op >= BINOP_ADD && op <= BINOP_POW) {
         /* Both operands must be numeric and same type */
-        if (type_equals(left, right) &&
-            left->kind >= TYPE_PRIM_I8 && left->kind <= TYPE_PRIM_F64) {
+        if (type_equals(left, right) && is_numeric_type(ctx, left)) {
             return left;
         }
         return type_error_type(ctx->types);
@@ -272,7 +534,8 @@ static Type *binary_result_type(TypeCheckContext *ctx, BinaryOp op,
 
     /* Logical operations */
     if (op == BINOP_AND || op == BINOP_OR) {
-        if (left->kind == TYPE_PRIM_BOOL && right->kind == TYPE_PRIM_BOOL) {
+        if (types_compatible(ctx, ctx->types->type_bool, left) &&
+            types_compatible(ctx, ctx->types->type_bool, right)) {
             return ctx->types->type_bool;
         }
         return type_error_type(ctx->types);
@@ -280,8 +543,7 @@ static Type *binary_result_type(TypeCheckContext *ctx, BinaryOp op,
 
     /* Bitwise operations */
     if (op >= BINOP_BIT_AND && op <= BINOP_SHR) {
-        if (type_equals(left, right) &&
-            left->kind >= TYPE_PRIM_I8 && left->kind <= TYPE_PRIM_USIZE) {
+        if (type_equals(left, right) && is_integer_type(ctx, left)) {
             return left;
         }
         return type_error_type(ctx->types);
@@ -304,24 +566,26 @@ static Type *binary_result_type(TypeCheckContext *ctx, BinaryOp op,
  * Get the result type of a unary operation
  */
 static Type *unary_result_type(TypeCheckContext *ctx, UnaryOp op, Type *operand) {
+    operand = infer_shallow(&ctx->infer, operand);
+
     switch (op) {
         case UNOP_NEG:
             /* Numeric types */
-            if (operand->kind >= TYPE_PRIM_I8 && operand->kind <= TYPE_PRIM_F64) {
+            if (is_numeric_type(ctx, operand)) {
                 return operand;
             }
             return type_error_type(ctx->types);
 
         case UNOP_NOT:
             /* Boolean */
-            if (operand->kind == TYPE_PRIM_BOOL) {
+            if (types_compatible(ctx, ctx->types->type_bool, operand)) {
                 return ctx->types->type_bool;
             }
             return type_error_type(ctx->types);
 
         case UNOP_BIT_NOT:
             /* Integer types */
-            if (operand->kind >= TYPE_PRIM_I8 && operand->kind <= TYPE_PRIM_USIZE) {
+            if (is_integer_type(ctx, operand)) {
                 return operand;
             }
             return type_error_type(ctx->types);
@@ -355,6 +619,37 @@ static Type *unary_result_type(TypeCheckContext *ctx, UnaryOp op, Type *operand)
     return type_error_type(ctx->types);
 }
 
+/*
+ * Get the member table of a nominal type (modal states use their modal's)
+ */
+static MemberTable *type_members(Type *type) {
+    switch (type->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+            return type->nominal.sym ? decl_members(type->nominal.sym->decl) : NULL;
+        case TYPE_MODAL_STATE:
+            return type->modal_state.modal_type
+                ? type_members(type->modal_state.modal_type) : NULL;
+        case TYPE_GENERIC_INST:
+            return type_members(type->generic_inst.base);
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * Resolve the declared type of a member as seen through `owner`, substituting
+ * the owner's generic arguments if it is an instantiation
+ */
+static Type *member_type(TypeCheckContext *ctx, Type *owner, TypeExpr *declared) {
+    Type *type = resolve_type_expr(ctx, declared);
+    if (owner->kind == TYPE_GENERIC_INST) {
+        type = type_substitute(ctx->types, type, owner->generic_inst.args);
+    }
+    return type;
+}
+
 /*
  * Look up a field in a type
  */
@@ -362,15 +657,10 @@ static Type *lookup_field(TypeCheckContext *ctx, Type *type, InternedString name
                           SourceSpan span) {
     if (type->kind == TYPE_ERROR) return type;
 
-    if (type->kind == TYPE_RECORD && type->nominal.sym && type->nominal.sym->decl) {
-        Decl *decl = type->nominal.sym->decl;
-        if (decl->kind == DECL_RECORD) {
-            RecordDecl *rec = &decl->record;
-            for (size_t i = 0; i < vec_len(rec->fields); i++) {
-                if (rec->fields[i].name.data == name.data) {
-                    return resolve_type_expr(ctx, rec->fields[i].type);
-                }
-            }
+    if (type->kind == TYPE_RECORD || type->kind == TYPE_GENERIC_INST) {
+        Member *field = member_field(type_members(type), name);
+        if (field) {
+            return member_type(ctx, type, field->field->type);
         }
     }
 
@@ -399,84 +689,22 @@ static Type *lookup_method(TypeCheckContext *ctx, Type *type, InternedString nam
 
     if (type->kind == TYPE_ERROR) return type;
 
-    if (type->nominal.sym && type->nominal.sym->decl) {
-        Decl *decl = type->nominal.sym->decl;
-
-        /* Check record methods */
-        if (decl->kind == DECL_RECORD) {
-            RecordDecl *rec = &decl->record;
-            for (size_t i = 0; i < vec_len(rec->methods); i++) {
-                if (rec->methods[i].name.data == name.data) {
-                    *out_method = &rec->methods[i];
-                    /* Build function type from method signature */
-                    Vec(Type *) params = vec_new(Type *);
-                    for (size_t j = 0; j < vec_len(rec->methods[i].params); j++) {
-                        Type *pt = resolve_type_expr(ctx, rec->methods[i].params[j].type);
-                        vec_push(params, pt);
-                    }
-                    Type *ret = resolve_type_expr(ctx, rec->methods[i].return_type);
-                    return type_function(ctx->types, params, ret);
-                }
-            }
-        }
+    MemberTable *members = type_members(type);
+    if (members) {
+        /* Record and enum methods, or methods shared by all modal states */
+        Member *method = member_method(members, name);
 
-        /* Check enum methods */
-        if (decl->kind == DECL_ENUM) {
-            EnumDecl *en = &decl->enum_;
-            for (size_t i = 0; i < vec_len(en->methods); i++) {
-                if (en->methods[i].name.data == name.data) {
-                    *out_method = &en->methods[i];
-                    Vec(Type *) params = vec_new(Type *);
-                    for (size_t j = 0; j < vec_len(en->methods[i].params); j++) {
-                        Type *pt = resolve_type_expr(ctx, en->methods[i].params[j].type);
-                        vec_push(params, pt);
-                    }
-                    Type *ret = resolve_type_expr(ctx, en->methods[i].return_type);
-                    return type_function(ctx->types, params, ret);
-                }
+        /* State-specific methods if we have a modal state type */
+        if (!method && type->kind == TYPE_MODAL_STATE) {
+            Member *state = member_state(members, type->modal_state.state_name);
+            if (state) {
+                method = member_method(state->members, name);
             }
         }
 
-        /* Check modal type methods */
-        if (decl->kind == DECL_MODAL) {
-            ModalDecl *modal = &decl->modal;
-
-            /* Check shared methods first */
-            for (size_t i = 0; i < vec_len(modal->shared_methods); i++) {
-                if (modal->shared_methods[i].name.data == name.data) {
-                    *out_method = &modal->shared_methods[i];
-                    Vec(Type *) params = vec_new(Type *);
-                    for (size_t j = 0; j < vec_len(modal->shared_methods[i].params); j++) {
-                        Type *pt = resolve_type_expr(ctx, modal->shared_methods[i].params[j].type);
-                        vec_push(params, pt);
-                    }
-                    Type *ret = resolve_type_expr(ctx, modal->shared_methods[i].return_type);
-                    return type_function(ctx->types, params, ret);
-                }
-            }
-
-            /* Check state-specific methods if we have a modal state type */
-            if (type->kind == TYPE_MODAL_STATE) {
-                for (size_t s = 0; s < vec_len(modal->states); s++) {
-                    ModalState *state = &modal->states[s];
-                    if (state->name.data == type->modal_state.state_name.data) {
-                        /* Found the state, check its methods */
-                        for (size_t i = 0; i < vec_len(state->methods); i++) {
-                            if (state->methods[i].name.data == name.data) {
-                                *out_method = &state->methods[i];
-                                Vec(Type *) params = vec_new(Type *);
-                                for (size_t j = 0; j < vec_len(state->methods[i].params); j++) {
-                                    Type *pt = resolve_type_expr(ctx, state->methods[i].params[j].type);
-                                    vec_push(params, pt);
-                                }
-                                Type *ret = resolve_type_expr(ctx, state->methods[i].return_type);
-                                return type_function(ctx->types, params, ret);
-                            }
-                        }
-                        break;
-                    }
-                }
-            }
+        if (method) {
+            *out_method = method->method;
+            return proc_signature(ctx, method->method);
         }
     }
 
@@ -497,7 +725,7 @@ static Type *check_pattern(TypeCheckContext *ctx, Pattern *pat, Type *expected)
         case PAT_BINDING: {
             Type *binding_type = expected;
             if (pat->binding.type) {
-                binding_type = resolve_type_expr(ctx, pat->binding.type);
+                binding_type = resolve_local_type_expr(ctx, pat->binding.type);
                 if (expected && !types_compatible(ctx, expected, binding_type)) {
                     error_type_mismatch(ctx, pat->span, expected, binding_type);
                 }
@@ -505,6 +733,10 @@ static Type *check_pattern(TypeCheckContext *ctx, Pattern *pat, Type *expected)
             /* Set the type on the resolved symbol for later phases (move analysis) */
             if (pat->binding.resolved && binding_type) {
                 pat->binding.resolved->type = binding_type;
+                if (binding_type->has_vars) {
+                    note_inferred(ctx, &pat->binding.resolved->type);
+                    vec_push(ctx->infer_bindings, pat);
+                }
             }
             return binding_type;
         }
@@ -532,8 +764,29 @@ static Type *check_pattern(TypeCheckContext *ctx, Pattern *pat, Type *expected)
             /* Type check handled by the type annotation in pattern */
             return expected;
 
-        case PAT_ENUM:
+        case PAT_ENUM: {
+            Type *enum_type = resolve_type_expr(ctx, pat->enum_.type);
+            if (enum_type->kind != TYPE_ENUM) {
+                check_pattern(ctx, pat->enum_.payload, NULL);
+                return expected;
+            }
+
+            Member *variant = member_variant(type_members(enum_type), pat->enum_.variant);
+            if (!variant) {
+                diag_report(ctx->diag, DIAG_ERROR, E_RES_0200, pat->span,
+                    "enum '%s' has no variant '%.*s'",
+                    type_to_string(enum_type, ctx->arena),
+                    (int)pat->enum_.variant.len, pat->enum_.variant.data);
+                check_pattern(ctx, pat->enum_.payload, NULL);
+                return expected;
+            }
+
+            /* Payload bindings take the variant's payload type */
+            TypeExpr *payload = variant->variant->payload;
+            check_pattern(ctx, pat->enum_.payload,
+                          payload ? resolve_type_expr(ctx, payload) : NULL);
             return expected;
+        }
 
         case PAT_MODAL:
             return expected;
@@ -558,29 +811,132 @@ static Type *check_pattern(TypeCheckContext *ctx, Pattern *pat, Type *expected)
     return expected;
 }
 
+/* member_type for the match compiler */
+static Type *match_member_type(void *state, Type *owner, TypeExpr *declared) {
+    return member_type(state, owner, declared);
+}
+
+/*
+ * Check a record literal. A generic record named without arguments takes
+ * them from the expected type if that is an instance of it, and otherwise
+ * infers them from the field values, like the arguments of a generic call.
+ */
+static Type *check_record_literal(TypeCheckContext *ctx, Expr *expr, Type *expected) {
+    Type *record_type = resolve_type_expr(ctx, expr->record.type);
+    if (record_type->kind != TYPE_RECORD && record_type->kind != TYPE_GENERIC_INST) {
+        return record_type;
+    }
+
+    Decl *decl = record_type->kind == TYPE_RECORD && record_type->nominal.sym
+        ? record_type->nominal.sym->decl : NULL;
+    Vec(GenericParam) generics = decl && decl->kind == DECL_RECORD
+        ? decl->record.generics : NULL;
+    Vec(Type *) inferred = NULL;
+    if (vec_len(generics) > 0) {
+        if (expected && expected->kind == TYPE_GENERIC_INST &&
+            expected->generic_inst.base == record_type) {
+            record_type = expected;
+        } else {
+            inferred = vec_new(Type *);
+            for (size_t i = 0; i < vec_len(generics); i++) {
+                vec_push(inferred, NULL);
+            }
+        }
+    }
+
+    /* Values of fields whose type mentions a parameter only feed inference
+       until the arguments are known; check_expr reports the others */
+    MemberTable *members = type_members(record_type);
+    for (size_t i = 0; members && i < vec_len(expr->record.field_values); i++) {
+        InternedString field_name = expr->record.field_names[i];
+        Expr *field_value = expr->record.field_values[i];
+        Member *field = member_field(members, field_name);
+        if (!field) {
+            error_no_field(ctx, field_value->span, record_type, field_name);
+            continue;
+        }
+
+        Type *field_type = member_type(ctx, record_type, field->field->type);
+        if (inferred && field_type->has_params) {
+            infer_type_args(ctx, field_type, check_expr(ctx, field_value, NULL), inferred);
+        } else {
+            check_expr(ctx, field_value, field_type);
+        }
+    }
+    if (!inferred) {
+        return record_type;
+    }
+
+    for (size_t i = 0; i < vec_len(inferred); i++) {
+        if (!inferred[i]) {
+            diag_report(ctx->diag, DIAG_ERROR, E_TYP_1603, expr->span,
+                "cannot infer generic argument '%.*s'",
+                (int)generics[i].name.len, generics[i].name.data);
+            inferred[i] = type_error_type(ctx->types);
+        }
+    }
+    record_type = type_generic_inst(ctx->types, record_type, inferred);
+
+    /* Values must match the instantiated field types */
+    for (size_t i = 0; members && i < vec_len(expr->record.field_values); i++) {
+        Member *field = member_field(members, expr->record.field_names[i]);
+        if (!field) continue;
+        Type *declared = resolve_type_expr(ctx, field->field->type);
+        if (!declared->has_params) continue;
+
+        Expr *field_value = expr->record.field_values[i];
+        Type *field_type = member_type(ctx, record_type, field->field->type);
+        if (!types_compatible(ctx, field_type, field_value->type)) {
+            error_type_mismatch(ctx, field_value->span, field_type, field_value->type);
+        }
+    }
+    return record_type;
+}
+
+/*
+ * Compile a match into its decision tree, reporting missing cases and
+ * unreachable arms
+ */
+static void check_match_arms(TypeCheckContext *ctx, Expr *expr, Type *scrutinee_type) {
+    MatchTypes types = { ctx, match_member_type };
+    expr->match.decision = match_compile(ctx->arena, ctx->diag, &types, expr,
+                                         scrutinee_type);
+}
+
 /*
  * Check an expression and return its type
  */
 static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
     if (!expr) return ctx->types->type_unit;
 
+    if (expected) {
+        expected = infer_shallow(&ctx->infer, expected);
+    }
+
     Type *result = NULL;
 
     switch (expr->kind) {
         case EXPR_INT_LIT:
-            /* Default to i32, or use expected type if numeric */
-            if (expected && expected->kind >= TYPE_PRIM_I8 &&
-                expected->kind <= TYPE_PRIM_USIZE) {
+            /*
+             * Use the expected type if it is an integer type. With none (or
+             * an unknown one) the literal gets a variable that a later use
+             * may fix, defaulting to i32.
+             */
+            if (expected && is_integer_type(ctx, expected)) {
                 result = expected;
+            } else if (!expected || expected->kind == TYPE_INFER) {
+                result = infer_fresh(&ctx->infer, INFER_INT);
             } else {
                 result = ctx->types->type_i32;
             }
             break;
 
         case EXPR_FLOAT_LIT:
-            if (expected && expected->kind >= TYPE_PRIM_F16 &&
-                expected->kind <= TYPE_PRIM_F64) {
+            if (expected && is_numeric_type(ctx, expected) &&
+                !is_integer_type(ctx, expected)) {
                 result = expected;
+            } else if (!expected || expected->kind == TYPE_INFER) {
+                result = infer_fresh(&ctx->infer, INFER_FLOAT);
             } else {
                 result = ctx->types->type_f64;
             }
@@ -599,7 +955,10 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
             break;
 
         case EXPR_IDENT: {
-            Symbol *sym = scope_lookup_from(ctx->scope, expr->ident.name);
+            Symbol *sym = expr->ident.resolved;
+            if (!sym) {
+                sym = scope_lookup_from(ctx->scope, expr->ident.name);
+            }
             if (!sym) {
                 result = type_error_type(ctx->types);
             } else if (sym->type) {
@@ -615,14 +974,9 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
                     case SYM_PROC:
                         /* Return function type */
                         if (sym->decl->kind == DECL_PROC) {
-                            ProcDecl *proc = &sym->decl->proc;
-                            Vec(Type *) params = vec_new(Type *);
-                            for (size_t i = 0; i < vec_len(proc->params); i++) {
-                                Type *pt = resolve_type_expr(ctx, proc->params[i].type);
-                                vec_push(params, pt);
-                            }
-                            Type *ret = resolve_type_expr(ctx, proc->return_type);
-                            result = type_function(ctx->types, params, ret);
+                            result = proc_signature(ctx, &sym->decl->proc);
+                        } else if (sym->decl->kind == DECL_EXTERN) {
+                            result = extern_signature(ctx, &sym->decl->extern_, sym->name);
                         } else {
                             result = type_error_type(ctx->types);
                         }
@@ -681,17 +1035,64 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
                                          vec_len(callee->function.params),
                                          vec_len(expr->call.args));
                 }
+
+                /* Generic callees get their arguments inferred from the call */
+                ProcDecl *generic = generic_callee(expr->call.callee);
+                Vec(Type *) inferred = NULL;
+                if (generic) {
+                    inferred = vec_new(Type *);
+                    for (size_t i = 0; i < vec_len(generic->generics); i++) {
+                        vec_push(inferred, NULL);
+                    }
+                }
+
                 /* Check argument types */
                 for (size_t i = 0; i < vec_len(expr->call.args); i++) {
                     Type *param_type = i < vec_len(callee->function.params)
                         ? callee->function.params[i] : NULL;
+                    if (param_type && param_type->has_params && inferred) {
+                        Type *arg_type = check_expr(ctx, expr->call.args[i], NULL);
+                        infer_type_args(ctx, param_type, arg_type, inferred);
+                        continue;
+                    }
                     Type *arg_type = check_expr(ctx, expr->call.args[i], param_type);
                     if (param_type && !types_compatible(ctx, param_type, arg_type)) {
                         error_type_mismatch(ctx, expr->call.args[i]->span,
                                           param_type, arg_type);
                     }
                 }
+
                 result = callee->function.return_type;
+                if (inferred) {
+                    for (size_t i = 0; i < vec_len(inferred); i++) {
+                        if (!inferred[i]) {
+                            diag_report(ctx->diag, DIAG_ERROR, E_TYP_1603, expr->span,
+                                "cannot infer generic argument '%.*s'",
+                                (int)generic->generics[i].name.len,
+                                generic->generics[i].name.data);
+                            inferred[i] = type_error_type(ctx->types);
+                        }
+                    }
+
+                    /* Arguments must match the instantiated parameter types */
+                    for (size_t i = 0; i < vec_len(expr->call.args) &&
+                                       i < vec_len(callee->function.params); i++) {
+                        Type *param_type = callee->function.params[i];
+                        if (!param_type->has_params) continue;
+                        Type *expected_arg = type_substitute(ctx->types, param_type, inferred);
+                        Type *arg_type = expr->call.args[i]->type;
+                        if (!types_compatible(ctx, expected_arg, arg_type)) {
+                            error_type_mismatch(ctx, expr->call.args[i]->span,
+                                              expected_arg, arg_type);
+                        }
+                    }
+
+                    result = type_substitute(ctx->types, result, inferred);
+                    expr->call.type_args = inferred;
+                    for (size_t i = 0; i < vec_len(inferred); i++) {
+                        note_inferred(ctx, &inferred[i]);
+                    }
+                }
             }
             break;
         }
@@ -779,13 +1180,11 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
             if (expr->array.repeat_value) {
                 /* [value; count] syntax */
                 Type *value_type = check_expr(ctx, expr->array.repeat_value, elem_type);
-                check_expr(ctx, expr->array.repeat_count, ctx->types->type_usize);
 
-                size_t count = 0;
-                if (expr->array.repeat_count->kind == EXPR_INT_LIT) {
-                    count = (size_t)expr->array.repeat_count->int_lit.value;
-                }
-                result = type_array(ctx->types, value_type, count);
+                size_t count;
+                result = eval_size(ctx, expr->array.repeat_count, &count)
+                    ? type_array(ctx->types, value_type, count)
+                    : type_error_type(ctx->types);
             } else {
                 /* [elem1, elem2, ...] syntax */
                 for (size_t i = 0; i < vec_len(expr->array.elements); i++) {
@@ -797,47 +1196,16 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
                                           elem_type, elem);
                     }
                 }
-                result = type_array(ctx->types, elem_type ? elem_type : type_error_type(ctx->types),
+                result = type_array(ctx->types,
+                                   elem_type ? elem_type : infer_fresh(&ctx->infer, INFER_ANY),
                                    vec_len(expr->array.elements));
             }
             break;
         }
 
-        case EXPR_RECORD: {
-            Type *record_type = resolve_type_expr(ctx, expr->record.type);
-            /* Check field types against declaration */
-            if (record_type->nominal.sym && record_type->nominal.sym->decl) {
-                Decl *decl = record_type->nominal.sym->decl;
-                if (decl->kind == DECL_RECORD) {
-                    /* Match fields */
-                    for (size_t i = 0; i < vec_len(expr->record.field_values); i++) {
-                        InternedString field_name = expr->record.field_names[i];
-                        Expr *field_value = expr->record.field_values[i];
-
-                        /* Find field in declaration */
-                        Type *field_type = NULL;
-                        for (size_t j = 0; j < vec_len(decl->record.fields); j++) {
-                            if (decl->record.fields[j].name.data == field_name.data) {
-                                field_type = resolve_type_expr(ctx, decl->record.fields[j].type);
-                                break;
-                            }
-                        }
-
-                        if (!field_type) {
-                            error_no_field(ctx, field_value->span, record_type, field_name);
-                        } else {
-                            Type *value_type = check_expr(ctx, field_value, field_type);
-                            if (!types_compatible(ctx, field_type, value_type)) {
-                                error_type_mismatch(ctx, field_value->span,
-                                                  field_type, value_type);
-                            }
-                        }
-                    }
-                }
-            }
-            result = record_type;
+        case EXPR_RECORD:
+            result = check_record_literal(ctx, expr, expected);
             break;
-        }
 
         case EXPR_IF: {
             Type *cond_type = check_expr(ctx, expr->if_.condition, ctx->types->type_bool);
@@ -882,6 +1250,9 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
                 }
             }
             result = result_type ? result_type : ctx->types->type_unit;
+
+            /* Compiled once the scrutinee's type is solved (see solve_types) */
+            vec_push(ctx->pending_matches, expr);
             break;
         }
 
@@ -954,6 +1325,12 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
             break;
         }
 
+        case EXPR_COMPTIME:
+            /* Evaluated once its types are solved (see solve_types) */
+            result = check_expr(ctx, expr->comptime.operand, expected);
+            vec_push(ctx->pending_comptime, expr);
+            break;
+
         case EXPR_CAST: {
             check_expr(ctx, expr->cast.operand, NULL);
             result = resolve_type_expr(ctx, expr->cast.target_type);
@@ -1023,14 +1400,15 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
             /* Check closure parameters */
             Vec(Type *) params = vec_new(Type *);
             for (size_t i = 0; i < vec_len(expr->closure.params); i++) {
-                Type *param_type = check_pattern(ctx, expr->closure.params[i], NULL);
+                Type *param_type = check_pattern(ctx, expr->closure.params[i],
+                                                 infer_fresh(&ctx->infer, INFER_ANY));
                 vec_push(params, param_type ? param_type : type_error_type(ctx->types));
             }
 
             /* Check return type */
             Type *ret_type = NULL;
             if (expr->closure.return_type) {
-                ret_type = resolve_type_expr(ctx, expr->closure.return_type);
+                ret_type = resolve_local_type_expr(ctx, expr->closure.return_type);
             }
 
             /* Check body */
@@ -1042,8 +1420,10 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
         }
     }
 
-    /* Store resolved type in AST */
-    /* expr->resolved_type = result; - would need to convert Type* back to TypeExpr* */
+    /* Store the semantic type for later phases (code generation) */
+    result = result ? infer_shallow(&ctx->infer, result) : type_error_type(ctx->types);
+    expr->type = result;
+    note_inferred(ctx, &expr->type);
 
     /* Check against expected type */
     if (expected && result && !types_compatible(ctx, expected, result)) {
@@ -1056,6 +1436,16 @@ static Type *check_expr(TypeCheckContext *ctx, Expr *expr, Type *expected) {
     return result ? result : type_error_type(ctx->types);
 }
 
+/*
+ * The type written on a binding pattern (`let p: Pair<i32> = ...`): the
+ * binding's type, which the initializer is checked against; NULL if there
+ * is none
+ */
+static Type *binding_annotation(TypeCheckContext *ctx, Pattern *pat) {
+    if (!pat || pat->kind != PAT_BINDING || !pat->binding.type) return NULL;
+    return resolve_local_type_expr(ctx, pat->binding.type);
+}
+
 /*
  * Check a statement
  */
@@ -1068,33 +1458,39 @@ static void check_stmt(TypeCheckContext *ctx, Stmt *stmt) {
             break;
 
         case STMT_LET: {
-            Type *type_annot = NULL;
-            if (stmt->let.type) {
-                type_annot = resolve_type_expr(ctx, stmt->let.type);
-            }
+            Type *type_annot = stmt->let.type
+                ? resolve_local_type_expr(ctx, stmt->let.type)
+                : binding_annotation(ctx, stmt->let.pattern);
 
             Type *init_type = NULL;
             if (stmt->let.init) {
                 init_type = check_expr(ctx, stmt->let.init, type_annot);
             }
 
+            /* With neither, the binding's uses decide its type */
             Type *binding_type = type_annot ? type_annot : init_type;
+            if (!binding_type) {
+                binding_type = infer_fresh(&ctx->infer, INFER_ANY);
+            }
             check_pattern(ctx, stmt->let.pattern, binding_type);
             break;
         }
 
         case STMT_VAR: {
-            Type *type_annot = NULL;
-            if (stmt->var.type) {
-                type_annot = resolve_type_expr(ctx, stmt->var.type);
-            }
+            Type *type_annot = stmt->var.type
+                ? resolve_local_type_expr(ctx, stmt->var.type)
+                : binding_annotation(ctx, stmt->var.pattern);
 
             Type *init_type = NULL;
             if (stmt->var.init) {
                 init_type = check_expr(ctx, stmt->var.init, type_annot);
             }
 
+            /* With neither, the binding's uses decide its type */
             Type *binding_type = type_annot ? type_annot : init_type;
+            if (!binding_type) {
+                binding_type = infer_fresh(&ctx->infer, INFER_ANY);
+            }
             check_pattern(ctx, stmt->var.pattern, binding_type);
             break;
         }
@@ -1138,12 +1534,85 @@ static void check_stmt(TypeCheckContext *ctx, Stmt *stmt) {
     }
 }
 
+/*
+ * Finish inference for the code checked since the last solve: report
+ * bindings nothing constrained, give every recorded type its solution
+ * (defaulting literals), then compile the matches that were waiting for
+ * their scrutinee types and evaluate the `comptime` expressions
+ */
+static void solve_types(TypeCheckContext *ctx) {
+    for (size_t i = 0; i < vec_len(ctx->infer_bindings); i++) {
+        Pattern *pat = ctx->infer_bindings[i];
+        Type *type = pat->binding.resolved->type;
+        if (infer_is_unconstrained(&ctx->infer, type)) {
+            diag_report(ctx->diag, DIAG_ERROR, E_TYP_1603, pat->span,
+                "cannot infer the type of '%.*s'",
+                (int)pat->binding.name.len, pat->binding.name.data);
+        }
+    }
+
+    for (size_t i = 0; i < vec_len(ctx->infer_slots); i++) {
+        Type **slot = ctx->infer_slots[i];
+        *slot = infer_resolve(&ctx->infer, *slot);
+    }
+
+    for (size_t i = 0; i < vec_len(ctx->pending_matches); i++) {
+        Expr *match = ctx->pending_matches[i];
+        check_match_arms(ctx, match, match->match.scrutinee->type);
+    }
+
+    for (size_t i = 0; i < vec_len(ctx->pending_comptime); i++) {
+        Expr *comptime = ctx->pending_comptime[i];
+        comptime->comptime.value = const_eval(ctx->consteval, comptime->comptime.operand, ctx);
+    }
+
+    vec_clear(ctx->infer_bindings);
+    vec_clear(ctx->infer_slots);
+    vec_clear(ctx->pending_matches);
+    vec_clear(ctx->pending_comptime);
+    infer_reset(&ctx->infer);
+}
+
+/*
+ * Evaluate an array size or repeat count: check it as a usize, then run
+ * it once the variables it introduced are solved (by the expected type,
+ * or the hook's defaulting)
+ */
+static bool eval_size(TypeCheckContext *ctx, Expr *size, size_t *out) {
+    if (!size->type) {
+        check_expr(ctx, size, ctx->types->type_usize);
+    }
+    if (infer_resolve(&ctx->infer, size->type)->kind == TYPE_ERROR) {
+        return false;
+    }
+    return const_eval_size(ctx->consteval, size, ctx, out);
+}
+
 /*
  * Check a procedure declaration
  */
 static void check_proc_decl(TypeCheckContext *ctx, ProcDecl *proc) {
+    /* Constant evaluation may have checked it already */
+    if (proc->check_state != PROC_UNCHECKED) return;
+    proc->check_state = PROC_CHECKING;
+
+    Type *signature = proc_signature(ctx, proc);
+    Type *saved_self = ctx->self_type;
     ctx->current_proc = proc;
-    ctx->current_return_type = resolve_type_expr(ctx, proc->return_type);
+    ctx->current_return_type = signature->function.return_type;
+    ctx->self_type = decl_self_type(ctx, proc->owner);
+
+    /* Parameters are typed by the signature; the receiver by its owner */
+    for (size_t i = 0; i < vec_len(proc->params); i++) {
+        if (proc->params[i].resolved) {
+            proc->params[i].resolved->type = signature->function.params[i];
+        }
+    }
+    if (proc->self_param) {
+        proc->self_param->type = ctx->self_type
+            ? type_with_permission(ctx->types, ctx->self_type, proc->self_param->perm)
+            : type_error_type(ctx->types);
+    }
 
     /* Check contracts */
     for (size_t i = 0; i < vec_len(proc->contracts); i++) {
@@ -1164,8 +1633,58 @@ static void check_proc_decl(TypeCheckContext *ctx, ProcDecl *proc) {
         }
     }
 
+    solve_types(ctx);
+    proc->check_state = PROC_CHECKED;
+
     ctx->current_proc = NULL;
     ctx->current_return_type = NULL;
+    ctx->self_type = saved_self;
+}
+
+/* Order variants by discriminant */
+static int compare_discriminants(const void *a, const void *b) {
+    const EnumVariant *x = *(EnumVariant *const *)a;
+    const EnumVariant *y = *(EnumVariant *const *)b;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+/*
+ * Give each variant its discriminant: the explicit one, evaluated at
+ * compile time, or one more than the previous variant's. Variants that
+ * share a value are adjacent once sorted.
+ */
+static void check_discriminants(TypeCheckContext *ctx, EnumDecl *decl) {
+    size_t count = vec_len(decl->variants);
+    int64_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        EnumVariant *var = &decl->variants[i];
+        if (var->discriminant) {
+            int64_t value;
+            check_expr(ctx, var->discriminant, ctx->types->type_i32);
+            if (const_eval_int(ctx->consteval, var->discriminant, ctx, &value)) {
+                next = value;
+            }
+        }
+        var->value = next++;
+    }
+    if (count < 2) return;
+
+    EnumVariant **sorted = malloc(count * sizeof(EnumVariant *));
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = &decl->variants[i];
+    }
+    qsort(sorted, count, sizeof(EnumVariant *), compare_discriminants);
+    for (size_t i = 1; i < count; i++) {
+        if (sorted[i]->value != sorted[i - 1]->value) continue;
+        /* Report the later declaration */
+        EnumVariant *first = sorted[i - 1] < sorted[i] ? sorted[i - 1] : sorted[i];
+        EnumVariant *dup = first == sorted[i] ? sorted[i - 1] : sorted[i];
+        diag_report(ctx->diag, DIAG_ERROR, E_RES_0201, dup->span,
+            "discriminant %lld of '%.*s' is already used by '%.*s'",
+            (long long)dup->value, (int)dup->name.len, dup->name.data,
+            (int)first->name.len, first->name.data);
+    }
+    free(sorted);
 }
 
 /*
@@ -1173,6 +1692,7 @@ static void check_proc_decl(TypeCheckContext *ctx, ProcDecl *proc) {
  */
 static void check_decl(TypeCheckContext *ctx, Decl *decl) {
     ctx->current_type_decl = decl;
+    ctx->self_type = decl_self_type(ctx, decl);
 
     switch (decl->kind) {
         case DECL_PROC:
@@ -1180,11 +1700,11 @@ static void check_decl(TypeCheckContext *ctx, Decl *decl) {
             break;
 
         case DECL_RECORD:
-            /* Check field default values */
+            /* Resolve field types (memoized for layout) and check defaults */
             for (size_t i = 0; i < vec_len(decl->record.fields); i++) {
                 FieldDecl *field = &decl->record.fields[i];
+                Type *field_type = resolve_type_expr(ctx, field->type);
                 if (field->default_value) {
-                    Type *field_type = resolve_type_expr(ctx, field->type);
                     check_expr(ctx, field->default_value, field_type);
                 }
             }
@@ -1195,13 +1715,14 @@ static void check_decl(TypeCheckContext *ctx, Decl *decl) {
             break;
 
         case DECL_ENUM:
-            /* Check variant discriminants */
+            /* Resolve payload types and number the variants */
             for (size_t i = 0; i < vec_len(decl->enum_.variants); i++) {
                 EnumVariant *var = &decl->enum_.variants[i];
-                if (var->discriminant) {
-                    check_expr(ctx, var->discriminant, ctx->types->type_i32);
+                if (var->payload) {
+                    resolve_type_expr(ctx, var->payload);
                 }
             }
+            check_discriminants(ctx, &decl->enum_);
             /* Check methods */
             for (size_t i = 0; i < vec_len(decl->enum_.methods); i++) {
                 check_proc_decl(ctx, &decl->enum_.methods[i]);
@@ -1253,7 +1774,10 @@ static void check_decl(TypeCheckContext *ctx, Decl *decl) {
             break;
 
         case DECL_EXTERN:
-            /* Extern signatures were validated during resolution */
+            /* Signatures, for code generation even if nothing calls them */
+            for (size_t i = 0; i < vec_len(decl->extern_.funcs); i++) {
+                extern_signature(ctx, &decl->extern_, decl->extern_.funcs[i].name);
+            }
             break;
 
         case DECL_IMPORT:
@@ -1263,26 +1787,90 @@ static void check_decl(TypeCheckContext *ctx, Decl *decl) {
             break;
     }
 
+    /* Field defaults and other expressions outside procedure bodies */
+    solve_types(ctx);
+
     ctx->current_type_decl = NULL;
+    ctx->self_type = NULL;
+}
+
+static void context_init(TypeCheckContext *tctx, SemaContext *ctx, ConstEval *consteval) {
+    memset(tctx, 0, sizeof(*tctx));
+    tctx->sema = ctx;
+    tctx->arena = ctx->arena;
+    tctx->diag = ctx->diag;
+    tctx->types = &ctx->type_ctx;
+    tctx->strings = ctx->strings;
+    tctx->scope = ctx->current_scope;
+    infer_init(&tctx->infer, tctx->types);
+    tctx->infer_slots = vec_new(Type **);
+    tctx->infer_bindings = vec_new(Pattern *);
+    tctx->pending_matches = vec_new(Expr *);
+    tctx->pending_comptime = vec_new(Expr *);
+    tctx->consteval = consteval;
+}
+
+static void context_destroy(TypeCheckContext *tctx) {
+    infer_destroy(&tctx->infer);
+    vec_free(tctx->infer_slots);
+    vec_free(tctx->infer_bindings);
+    vec_free(tctx->pending_matches);
+    vec_free(tctx->pending_comptime);
+}
+
+/*
+ * Constant evaluation hooks. A callee is checked ahead of its turn in a
+ * context of its own, since the caller may be in the middle of solving
+ * its own variables.
+ */
+static bool const_prepare_proc(void *state, ProcDecl *proc, SourceSpan use) {
+    TypeCheckContext *ctx = state;
+    if (proc->check_state == PROC_CHECKED) return true;
+    if (proc->check_state == PROC_CHECKING) {
+        diag_report(ctx->diag, DIAG_ERROR, E_CTE_4001, use,
+            "'%.*s' is called at compile time while its own types are being checked",
+            (int)proc->name.len, proc->name.data);
+        return false;
+    }
+
+    TypeCheckContext callee;
+    context_init(&callee, ctx->sema, ctx->consteval);
+    check_proc_decl(&callee, proc);
+    context_destroy(&callee);
+    return true;
+}
+
+static Type *const_expr_type(void *state, Expr *expr) {
+    TypeCheckContext *ctx = state;
+    return infer_resolve(&ctx->infer, expr->type);
 }
 
 /*
  * Main entry point for type checking
  */
 bool sema_check_types(SemaContext *ctx, Module *mod) {
+    ConstEval consteval;
+    ConstHooks hooks = { const_prepare_proc, const_expr_type };
+    const_eval_init(&consteval, ctx->arena, ctx->diag, &ctx->type_ctx, hooks);
+
     TypeCheckContext tctx;
-    memset(&tctx, 0, sizeof(tctx));
-    tctx.sema = ctx;
-    tctx.arena = ctx->arena;
-    tctx.diag = ctx->diag;
-    tctx.types = &ctx->type_ctx;
-    tctx.strings = ctx->strings;
-    tctx.scope = ctx->current_scope;
+    context_init(&tctx, ctx, &consteval);
 
     /* Check all declarations */
     for (size_t i = 0; i < vec_len(mod->decls); i++) {
         check_decl(&tctx, mod->decls[i]);
     }
 
+    /* Lay out the types once every field type and discriminant is known */
+    for (size_t i = 0; i < vec_len(mod->decls); i++) {
+        Type *type = decl_self_type(&tctx, mod->decls[i]);
+        if (type) {
+            layout_check_decl(&ctx->layout, ctx->diag, mod->decls[i], type);
+        }
+    }
+
+    context_destroy(&tctx);
+    const_eval_destroy(&consteval);
+
     return !diag_has_errors(ctx->diag);
 }
@@ -1,52 +1,356 @@
 /*
  * Cursive Bootstrap Compiler - Semantic Type System Implementation
+ *
+ * All types are hash-consed through the TypeContext intern table, so
+ * type identity is pointer identity.
  */
 
 #include "types.h"
 #include "scope.h"
 #include <stdio.h>
 
-/* Helper to allocate a type */
-static Type *type_alloc(TypeContext *ctx, TypeKind kind) {
+/*
+ * ============================================
+ * Hash-consing
+ * ============================================
+ */
+
+#define TYPE_INTERN_INITIAL_CAPACITY 256
+
+static uint32_t hash_mix(uint32_t h, uint64_t v) {
+    h ^= (uint32_t)(v ^ (v >> 32)) + 0x9e3779b9u + (h << 6) + (h >> 2);
+    return h;
+}
+
+static uint32_t hash_ptr(uint32_t h, const void *p) {
+    return hash_mix(h, (uint64_t)(uintptr_t)p);
+}
+
+/* Children are canonical, so their ids identify them */
+static uint32_t hash_type(uint32_t h, const Type *t) {
+    return hash_mix(h, t ? t->id + 1 : 0);
+}
+
+static uint32_t hash_types(uint32_t h, Vec(Type *) types) {
+    h = hash_mix(h, vec_len(types));
+    for (size_t i = 0; i < vec_len(types); i++) {
+        h = hash_type(h, types[i]);
+    }
+    return h;
+}
+
+static bool same_types(Vec(Type *) a, Vec(Type *) b) {
+    size_t len = vec_len(a);
+    if (len != vec_len(b)) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+/* Structural hash of a type whose children are already canonical */
+static uint32_t type_hash(const Type *t) {
+    uint32_t h = hash_mix((uint32_t)t->kind, (uint64_t)t->perm);
+
+    switch (t->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            h = hash_ptr(h, t->nominal.sym);
+            return hash_types(h, t->nominal.type_args);
+
+        case TYPE_MODAL_STATE:
+            h = hash_type(h, t->modal_state.modal_type);
+            return hash_mix(h, t->modal_state.state_name.hash);
+
+        case TYPE_TUPLE:
+            return hash_types(h, t->tuple.elements);
+
+        case TYPE_ARRAY:
+            h = hash_type(h, t->array.element);
+            return hash_mix(h, t->array.size);
+
+        case TYPE_SLICE:
+            return hash_type(h, t->slice.element);
+
+        case TYPE_UNION:
+            return hash_types(h, t->union_.members);
+
+        case TYPE_FUNCTION:
+            h = hash_types(h, t->function.params);
+            return hash_type(h, t->function.return_type);
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            return hash_type(h, t->ptr.pointee);
+
+        case TYPE_GENERIC_PARAM:
+            h = hash_mix(h, t->generic_param.name.hash);
+            h = hash_mix(h, t->generic_param.index);
+            return hash_types(h, t->generic_param.bounds);
+
+        case TYPE_GENERIC_INST:
+            h = hash_type(h, t->generic_inst.base);
+            return hash_types(h, t->generic_inst.args);
+
+        case TYPE_INFER:
+            return hash_mix(h, t->var.index);
+
+        default:
+            /* Primitives, unit, never, string, error: kind says it all */
+            return h;
+    }
+}
+
+/*
+ * Compare the top-level structure of two types (children by pointer).
+ * Permission is compared only if `with_perm` is set.
+ */
+static bool type_same_shape(const Type *a, const Type *b, bool with_perm) {
+    if (a->kind != b->kind) return false;
+    if (with_perm && a->perm != b->perm) return false;
+
+    switch (a->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            return a->nominal.sym == b->nominal.sym &&
+                   same_types(a->nominal.type_args, b->nominal.type_args);
+
+        case TYPE_MODAL_STATE:
+            return a->modal_state.modal_type == b->modal_state.modal_type &&
+                   interned_eq(a->modal_state.state_name, b->modal_state.state_name);
+
+        case TYPE_TUPLE:
+            return same_types(a->tuple.elements, b->tuple.elements);
+
+        case TYPE_ARRAY:
+            return a->array.element == b->array.element &&
+                   a->array.size == b->array.size;
+
+        case TYPE_SLICE:
+            return a->slice.element == b->slice.element;
+
+        case TYPE_UNION:
+            /* Members are canonically ordered */
+            return same_types(a->union_.members, b->union_.members);
+
+        case TYPE_FUNCTION:
+            return a->function.return_type == b->function.return_type &&
+                   same_types(a->function.params, b->function.params);
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            return a->ptr.pointee == b->ptr.pointee;
+
+        case TYPE_GENERIC_PARAM:
+            return interned_eq(a->generic_param.name, b->generic_param.name) &&
+                   a->generic_param.index == b->generic_param.index &&
+                   same_types(a->generic_param.bounds, b->generic_param.bounds);
+
+        case TYPE_GENERIC_INST:
+            return a->generic_inst.base == b->generic_inst.base &&
+                   same_types(a->generic_inst.args, b->generic_inst.args);
+
+        case TYPE_INFER:
+            return a->var.index == b->var.index;
+
+        default:
+            return true;
+    }
+}
+
+/* A type mentions whatever one of its children mentions */
+static void inherit_flags(Type *t, const Type *child) {
+    if (child) {
+        t->has_params |= child->has_params;
+        t->has_vars |= child->has_vars;
+    }
+}
+
+static void inherit_all(Type *t, Vec(Type *) types) {
+    for (size_t i = 0; i < vec_len(types); i++) {
+        inherit_flags(t, types[i]);
+    }
+}
+
+/* Compute has_params and has_vars for a type with canonical children */
+static void type_set_flags(Type *t) {
+    t->has_params = t->kind == TYPE_GENERIC_PARAM;
+    t->has_vars = t->kind == TYPE_INFER;
+
+    switch (t->kind) {
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_MODAL:
+        case TYPE_CLASS:
+            inherit_all(t, t->nominal.type_args);
+            break;
+
+        case TYPE_MODAL_STATE:
+            inherit_flags(t, t->modal_state.modal_type);
+            break;
+
+        case TYPE_TUPLE:
+            inherit_all(t, t->tuple.elements);
+            break;
+
+        case TYPE_ARRAY:
+            inherit_flags(t, t->array.element);
+            break;
+
+        case TYPE_SLICE:
+            inherit_flags(t, t->slice.element);
+            break;
+
+        case TYPE_UNION:
+            inherit_all(t, t->union_.members);
+            break;
+
+        case TYPE_FUNCTION:
+            inherit_all(t, t->function.params);
+            inherit_flags(t, t->function.return_type);
+            break;
+
+        case TYPE_PTR:
+        case TYPE_PTR_VALID:
+        case TYPE_PTR_NULL:
+            inherit_flags(t, t->ptr.pointee);
+            break;
+
+        case TYPE_GENERIC_INST:
+            inherit_flags(t, t->generic_inst.base);
+            inherit_all(t, t->generic_inst.args);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Rehash the intern table into a larger slot array */
+static void intern_grow(TypeContext *ctx) {
+    size_t new_capacity = ctx->interned_capacity ?
+        ctx->interned_capacity * 2 : TYPE_INTERN_INITIAL_CAPACITY;
+    Type **slots = ARENA_ALLOC_ARRAY(ctx->arena, Type *, new_capacity);
+    memset(slots, 0, new_capacity * sizeof(Type *));
+
+    for (size_t i = 0; i < ctx->interned_capacity; i++) {
+        Type *t = ctx->interned[i];
+        if (!t) continue;
+        size_t idx = t->hash & (new_capacity - 1);
+        while (slots[idx]) {
+            idx = (idx + 1) & (new_capacity - 1);
+        }
+        slots[idx] = t;
+    }
+
+    ctx->interned = slots;
+    ctx->interned_capacity = new_capacity;
+}
+
+/*
+ * Return the canonical type equal to `key`, creating it if needed.
+ * `key` is a stack template; the returned type is arena-owned.
+ */
+static Type *type_intern(TypeContext *ctx, const Type *key) {
+    uint32_t hash = type_hash(key);
+
+    if (ctx->interned_capacity) {
+        size_t mask = ctx->interned_capacity - 1;
+        for (size_t idx = hash & mask; ctx->interned[idx]; idx = (idx + 1) & mask) {
+            Type *t = ctx->interned[idx];
+            if (t->hash == hash && type_same_shape(t, key, true)) {
+                return t;
+            }
+        }
+    }
+
+    /* Keep load factor under 70% */
+    if ((ctx->interned_count + 1) * 10 > ctx->interned_capacity * 7) {
+        intern_grow(ctx);
+    }
+
     Type *t = ARENA_ALLOC(ctx->arena, Type);
-    memset(t, 0, sizeof(Type));
-    t->kind = kind;
-    t->perm = PERM_CONST;  /* Default permission */
+    *t = *key;
+    t->id = (uint32_t)ctx->interned_count;
+    t->hash = hash;
+    type_set_flags(t);
+
+    size_t mask = ctx->interned_capacity - 1;
+    size_t idx = hash & mask;
+    while (ctx->interned[idx]) {
+        idx = (idx + 1) & mask;
+    }
+    ctx->interned[idx] = t;
+    ctx->interned_count++;
     return t;
 }
 
+/* Intern a key that owns `owned`; the Vec is released if the type already exists */
+static Type *type_intern_owned(TypeContext *ctx, const Type *key, Vec(Type *) owned) {
+    size_t before = ctx->interned_count;
+    Type *t = type_intern(ctx, key);
+    if (ctx->interned_count == before) {
+        vec_free(owned);
+    }
+    return t;
+}
+
+/* Build a template for a type of the given kind */
+static Type type_key(TypeKind kind) {
+    Type key;
+    memset(&key, 0, sizeof(Type));
+    key.kind = kind;
+    key.perm = PERM_CONST;  /* Default permission */
+    return key;
+}
+
+/* Intern a type with no structure beyond its kind */
+static Type *type_simple(TypeContext *ctx, TypeKind kind) {
+    Type key = type_key(kind);
+    return type_intern(ctx, &key);
+}
+
 /* Initialize type context */
 void type_ctx_init(TypeContext *ctx, Arena *arena, StringPool *strings) {
     ctx->arena = arena;
     ctx->strings = strings;
+    ctx->interned = NULL;
+    ctx->interned_count = 0;
+    ctx->interned_capacity = 0;
 
     /* Create cached primitive types */
-    ctx->type_i8 = type_alloc(ctx, TYPE_PRIM_I8);
-    ctx->type_i16 = type_alloc(ctx, TYPE_PRIM_I16);
-    ctx->type_i32 = type_alloc(ctx, TYPE_PRIM_I32);
-    ctx->type_i64 = type_alloc(ctx, TYPE_PRIM_I64);
-    ctx->type_i128 = type_alloc(ctx, TYPE_PRIM_I128);
-    ctx->type_isize = type_alloc(ctx, TYPE_PRIM_ISIZE);
-
-    ctx->type_u8 = type_alloc(ctx, TYPE_PRIM_U8);
-    ctx->type_u16 = type_alloc(ctx, TYPE_PRIM_U16);
-    ctx->type_u32 = type_alloc(ctx, TYPE_PRIM_U32);
-    ctx->type_u64 = type_alloc(ctx, TYPE_PRIM_U64);
-    ctx->type_u128 = type_alloc(ctx, TYPE_PRIM_U128);
-    ctx->type_usize = type_alloc(ctx, TYPE_PRIM_USIZE);
-
-    ctx->type_f16 = type_alloc(ctx, TYPE_PRIM_F16);
-    ctx->type_f32 = type_alloc(ctx, TYPE_PRIM_F32);
-    ctx->type_f64 = type_alloc(ctx, TYPE_PRIM_F64);
-
-    ctx->type_bool = type_alloc(ctx, TYPE_PRIM_BOOL);
-    ctx->type_char = type_alloc(ctx, TYPE_PRIM_CHAR);
-
-    ctx->type_unit = type_alloc(ctx, TYPE_UNIT);
-    ctx->type_never = type_alloc(ctx, TYPE_NEVER);
-    ctx->type_string = type_alloc(ctx, TYPE_STRING);
-
-    ctx->type_error = type_alloc(ctx, TYPE_ERROR);
+    ctx->type_i8 = type_simple(ctx, TYPE_PRIM_I8);
+    ctx->type_i16 = type_simple(ctx, TYPE_PRIM_I16);
+    ctx->type_i32 = type_simple(ctx, TYPE_PRIM_I32);
+    ctx->type_i64 = type_simple(ctx, TYPE_PRIM_I64);
+    ctx->type_i128 = type_simple(ctx, TYPE_PRIM_I128);
+    ctx->type_isize = type_simple(ctx, TYPE_PRIM_ISIZE);
+
+    ctx->type_u8 = type_simple(ctx, TYPE_PRIM_U8);
+    ctx->type_u16 = type_simple(ctx, TYPE_PRIM_U16);
+    ctx->type_u32 = type_simple(ctx, TYPE_PRIM_U32);
+    ctx->type_u64 = type_simple(ctx, TYPE_PRIM_U64);
+    ctx->type_u128 = type_simple(ctx, TYPE_PRIM_U128);
+    ctx->type_usize = type_simple(ctx, TYPE_PRIM_USIZE);
+
+    ctx->type_f16 = type_simple(ctx, TYPE_PRIM_F16);
+    ctx->type_f32 = type_simple(ctx, TYPE_PRIM_F32);
+    ctx->type_f64 = type_simple(ctx, TYPE_PRIM_F64);
+
+    ctx->type_bool = type_simple(ctx, TYPE_PRIM_BOOL);
+    ctx->type_char = type_simple(ctx, TYPE_PRIM_CHAR);
+
+    ctx->type_unit = type_simple(ctx, TYPE_UNIT);
+    ctx->type_never = type_simple(ctx, TYPE_NEVER);
+    ctx->type_string = type_simple(ctx, TYPE_STRING);
+
+    ctx->type_error = type_simple(ctx, TYPE_ERROR);
 }
 
 /* Get primitive type */
@@ -78,7 +382,7 @@ Type *type_primitive(TypeContext *ctx, TypeKind kind) {
 
 /* Create nominal type */
 Type *type_nominal(TypeContext *ctx, Symbol *sym, Vec(Type *) type_args) {
-    Type *t = type_alloc(ctx, TYPE_RECORD);  /* Will be updated based on symbol */
+    Type key = type_key(TYPE_RECORD);  /* Will be updated based on symbol */
 
     if (sym) {
         switch (sym->kind) {
@@ -86,154 +390,191 @@ Type *type_nominal(TypeContext *ctx, Symbol *sym, Vec(Type *) type_args) {
                 /* Determine actual kind from declaration */
                 if (sym->decl) {
                     switch (sym->decl->kind) {
-                        case DECL_RECORD: t->kind = TYPE_RECORD; break;
-                        case DECL_ENUM:   t->kind = TYPE_ENUM; break;
-                        case DECL_MODAL:  t->kind = TYPE_MODAL; break;
-                        default:          t->kind = TYPE_RECORD; break;
+                        case DECL_RECORD: key.kind = TYPE_RECORD; break;
+                        case DECL_ENUM:   key.kind = TYPE_ENUM; break;
+                        case DECL_MODAL:  key.kind = TYPE_MODAL; break;
+                        default:          key.kind = TYPE_RECORD; break;
                     }
                 }
                 break;
             case SYM_CLASS:
-                t->kind = TYPE_CLASS;
+                key.kind = TYPE_CLASS;
                 break;
             default:
                 break;
         }
     }
 
-    t->nominal.sym = sym;
-    t->nominal.type_args = type_args;
-    return t;
+    key.nominal.sym = sym;
+    key.nominal.type_args = type_args;
+    return type_intern_owned(ctx, &key, type_args);
 }
 
 /* Create modal state type */
 Type *type_modal_state(TypeContext *ctx, Type *modal, InternedString state) {
-    Type *t = type_alloc(ctx, TYPE_MODAL_STATE);
-    t->modal_state.modal_type = modal;
-    t->modal_state.state_name = state;
-    return t;
+    Type key = type_key(TYPE_MODAL_STATE);
+    key.modal_state.modal_type = modal;
+    key.modal_state.state_name = state;
+    return type_intern(ctx, &key);
 }
 
 /* Create tuple type */
 Type *type_tuple(TypeContext *ctx, Vec(Type *) elements) {
     /* Unit type for empty tuple */
     if (vec_len(elements) == 0) {
+        vec_free(elements);
         return ctx->type_unit;
     }
 
-    Type *t = type_alloc(ctx, TYPE_TUPLE);
-    t->tuple.elements = elements;
-    return t;
+    Type key = type_key(TYPE_TUPLE);
+    key.tuple.elements = elements;
+    return type_intern_owned(ctx, &key, elements);
 }
 
 /* Create array type */
 Type *type_array(TypeContext *ctx, Type *element, size_t size) {
-    Type *t = type_alloc(ctx, TYPE_ARRAY);
-    t->array.element = element;
-    t->array.size = size;
-    return t;
+    Type key = type_key(TYPE_ARRAY);
+    key.array.element = element;
+    key.array.size = size;
+    return type_intern(ctx, &key);
 }
 
 /* Create slice type */
 Type *type_slice(TypeContext *ctx, Type *element) {
-    Type *t = type_alloc(ctx, TYPE_SLICE);
-    t->slice.element = element;
-    return t;
+    Type key = type_key(TYPE_SLICE);
+    key.slice.element = element;
+    return type_intern(ctx, &key);
 }
 
-/* Compare two types for ordering (for union canonicalization) */
-static int type_compare(const void *a, const void *b) {
-    Type *ta = *(Type **)a;
-    Type *tb = *(Type **)b;
-
-    /* Compare by kind first */
-    if (ta->kind != tb->kind) {
-        return (int)ta->kind - (int)tb->kind;
-    }
-
-    /* For nominal types, compare by symbol pointer */
-    if (ta->kind >= TYPE_RECORD && ta->kind <= TYPE_CLASS) {
-        return (int)((char *)ta->nominal.sym - (char *)tb->nominal.sym);
+/* Add a union member, flattening nested unions */
+static void union_add_member(Vec(Type *) *flat, Type *member) {
+    if (member->kind == TYPE_UNION && member->perm == PERM_CONST) {
+        for (size_t i = 0; i < vec_len(member->union_.members); i++) {
+            vec_push(*flat, member->union_.members[i]);
+        }
+    } else {
+        vec_push(*flat, member);
     }
-
-    /* For other types, just use pointer for now */
-    return (int)((char *)ta - (char *)tb);
 }
 
 /* Create union type (canonicalizes member order) */
 Type *type_union(TypeContext *ctx, Vec(Type *) members) {
-    size_t len = vec_len(members);
-
-    /* Single member - just return that type */
-    if (len == 1) {
-        return members[0];
+    /* Flatten nested unions (rare, so only copy when one is present) */
+    for (size_t i = 0; i < vec_len(members); i++) {
+        if (members[i]->kind == TYPE_UNION && members[i]->perm == PERM_CONST) {
+            Vec(Type *) flat = vec_new(Type *);
+            for (size_t j = 0; j < vec_len(members); j++) {
+                union_add_member(&flat, members[j]);
+            }
+            vec_free(members);
+            members = flat;
+            break;
+        }
     }
 
-    /* Sort members for canonical ordering */
-    /* Simple bubble sort for small arrays */
-    for (size_t i = 0; i < len - 1; i++) {
-        for (size_t j = 0; j < len - i - 1; j++) {
-            if (type_compare(&members[j], &members[j + 1]) > 0) {
-                Type *tmp = members[j];
-                members[j] = members[j + 1];
-                members[j + 1] = tmp;
-            }
+    /* Sort by type id (insertion sort: unions are small) */
+    size_t len = vec_len(members);
+    for (size_t i = 1; i < len; i++) {
+        Type *t = members[i];
+        size_t j = i;
+        while (j > 0 && members[j - 1]->id > t->id) {
+            members[j] = members[j - 1];
+            j--;
         }
+        members[j] = t;
     }
 
-    /* Remove duplicates */
-    Vec(Type *) unique = vec_new(Type *);
-    Type *prev = NULL;
+    /* Remove duplicates in place (members are canonical, so equal means same pointer) */
+    size_t unique = 0;
     for (size_t i = 0; i < len; i++) {
-        if (!prev || !type_equals(prev, members[i])) {
-            vec_push(unique, members[i]);
-            prev = members[i];
+        if (unique == 0 || members[i] != members[unique - 1]) {
+            members[unique++] = members[i];
         }
     }
+    while (vec_len(members) > unique) {
+        vec_pop(members);
+    }
 
     /* Single unique member */
-    if (vec_len(unique) == 1) {
-        Type *result = unique[0];
-        vec_free(unique);
+    if (unique == 1) {
+        Type *result = members[0];
+        vec_free(members);
         return result;
     }
 
-    Type *t = type_alloc(ctx, TYPE_UNION);
-    t->union_.members = unique;
-    return t;
+    Type key = type_key(TYPE_UNION);
+    key.union_.members = members;
+    Type *result = type_intern_owned(ctx, &key, members);
+
+    /* Index the members of a new union by id */
+    if (!result->union_.member_bits && unique > 0) {
+        uint32_t max_id = result->union_.members[unique - 1]->id;
+        result->union_.member_words = (uint32_t)bitset_words((size_t)max_id + 1);
+        result->union_.member_bits = ARENA_ALLOC_ARRAY(ctx->arena, BitWord,
+            result->union_.member_words);
+        bitset_fill(result->union_.member_bits, result->union_.member_words, false);
+        for (size_t i = 0; i < unique; i++) {
+            bitset_set(result->union_.member_bits, result->union_.members[i]->id);
+        }
+    }
+    return result;
+}
+
+/* Is `member` one of the union's members? */
+bool type_union_contains(const Type *u, const Type *member) {
+    return member->id / BITSET_WORD_BITS < u->union_.member_words &&
+           bitset_test(u->union_.member_bits, member->id);
+}
+
+/* Is every member of union `sub` a member of union `super`? */
+bool type_union_subset(const Type *sub, const Type *super) {
+    for (uint32_t i = 0; i < sub->union_.member_words; i++) {
+        BitWord theirs = i < super->union_.member_words ? super->union_.member_bits[i] : 0;
+        if (sub->union_.member_bits[i] & ~theirs) {
+            return false;
+        }
+    }
+    return true;
 }
 
 /* Create function type */
 Type *type_function(TypeContext *ctx, Vec(Type *) params, Type *return_type) {
-    Type *t = type_alloc(ctx, TYPE_FUNCTION);
-    t->function.params = params;
-    t->function.return_type = return_type ? return_type : ctx->type_unit;
-    return t;
+    Type key = type_key(TYPE_FUNCTION);
+    key.function.params = params;
+    key.function.return_type = return_type ? return_type : ctx->type_unit;
+    return type_intern_owned(ctx, &key, params);
 }
 
 /* Create pointer type */
 Type *type_ptr(TypeContext *ctx, Type *pointee, TypeKind ptr_kind) {
-    Type *t = type_alloc(ctx, ptr_kind);
-    t->ptr.pointee = pointee;
-    return t;
+    Type key = type_key(ptr_kind);
+    key.ptr.pointee = pointee;
+    return type_intern(ctx, &key);
 }
 
-/* Create generic parameter type */
+/* Create generic parameter type (bounds do not take part in identity) */
 Type *type_generic_param(TypeContext *ctx, InternedString name, size_t index,
                          Vec(Type *) bounds) {
-    Type *t = type_alloc(ctx, TYPE_GENERIC_PARAM);
-    t->generic_param.name = name;
-    t->generic_param.index = index;
-    t->generic_param.bounds = bounds;
-    return t;
+    Type key = type_key(TYPE_GENERIC_PARAM);
+    key.generic_param.name = name;
+    key.generic_param.index = index;
+    key.generic_param.bounds = bounds;
+    return type_intern_owned(ctx, &key, bounds);
 }
 
 /* Create generic instantiation */
 Type *type_generic_inst(TypeContext *ctx, Type *base, Vec(Type *) args) {
-    Type *t = type_alloc(ctx, TYPE_GENERIC_INST);
-    t->generic_inst.base = base;
-    t->generic_inst.args = args;
-    return t;
+    Type key = type_key(TYPE_GENERIC_INST);
+    key.generic_inst.base = base;
+    key.generic_inst.args = args;
+    return type_intern_owned(ctx, &key, args);
+}
+
+/* Get an inference variable */
+Type *type_infer_var(TypeContext *ctx, uint32_t index) {
+    Type key = type_key(TYPE_INFER);
+    key.var.index = index;
+    return type_intern(ctx, &key);
 }
 
 /* Apply permission to type */
@@ -242,135 +583,150 @@ Type *type_with_permission(TypeContext *ctx, Type *type, Permission perm) {
         return type;
     }
 
-    /* Create a copy with new permission */
-    Type *t = ARENA_ALLOC(ctx->arena, Type);
-    *t = *type;
-    t->perm = perm;
-    return t;
+    /* Same structure with new permission (shares the original's Vecs) */
+    Type key = *type;
+    key.perm = perm;
+    return type_intern(ctx, &key);
 }
 
-/* Type equality */
-bool type_equals(Type *a, Type *b) {
-    if (a == b) return true;
-    if (!a || !b) return false;
-    if (a->kind != b->kind) return false;
+/*
+ * ============================================
+ * Substitution
+ * ============================================
+ */
 
-    switch (a->kind) {
-        /* Primitives are equal by kind */
-        case TYPE_PRIM_I8:
-        case TYPE_PRIM_I16:
-        case TYPE_PRIM_I32:
-        case TYPE_PRIM_I64:
-        case TYPE_PRIM_I128:
-        case TYPE_PRIM_ISIZE:
-        case TYPE_PRIM_U8:
-        case TYPE_PRIM_U16:
-        case TYPE_PRIM_U32:
-        case TYPE_PRIM_U64:
-        case TYPE_PRIM_U128:
-        case TYPE_PRIM_USIZE:
-        case TYPE_PRIM_F16:
-        case TYPE_PRIM_F32:
-        case TYPE_PRIM_F64:
-        case TYPE_PRIM_BOOL:
-        case TYPE_PRIM_CHAR:
-        case TYPE_UNIT:
-        case TYPE_NEVER:
-        case TYPE_STRING:
-            return true;
+/*
+ * Rebuilds a type with some of its leaves replaced: generic parameters
+ * for type_substitute, inference variables for type_resolve_vars
+ */
+typedef struct TypeMapper {
+    TypeContext *ctx;
+    bool vars;                 /* Map variables rather than parameters */
+    Type *(*leaf)(const struct TypeMapper *mapper, Type *type);
+    Vec(Type *) args;          /* type_substitute */
+    Type *(*resolve)(void *state, Type *var);  /* type_resolve_vars */
+    void *state;
+} TypeMapper;
+
+static Type *map_type(const TypeMapper *m, Type *type);
+
+static Vec(Type *) map_all(const TypeMapper *m, Vec(Type *) types) {
+    Vec(Type *) result = vec_new(Type *);
+    vec_reserve(result, vec_len(types));
+    for (size_t i = 0; i < vec_len(types); i++) {
+        vec_push(result, map_type(m, types[i]));
+    }
+    return result;
+}
+
+static Type *map_type(const TypeMapper *m, Type *type) {
+    if (!type || !(m->vars ? type->has_vars : type->has_params)) {
+        return type;
+    }
+
+    TypeContext *ctx = m->ctx;
+    Type *result;
+
+    switch (type->kind) {
+        case TYPE_GENERIC_PARAM:
+        case TYPE_INFER:
+            result = m->leaf(m, type);
+            if (result == type) return type;
+            break;
 
-        /* Nominal types: compare by symbol */
         case TYPE_RECORD:
         case TYPE_ENUM:
         case TYPE_MODAL:
         case TYPE_CLASS:
-            if (a->nominal.sym != b->nominal.sym) return false;
-            /* Compare type arguments */
-            if (vec_len(a->nominal.type_args) != vec_len(b->nominal.type_args)) {
-                return false;
-            }
-            for (size_t i = 0; i < vec_len(a->nominal.type_args); i++) {
-                if (!type_equals(a->nominal.type_args[i], b->nominal.type_args[i])) {
-                    return false;
-                }
-            }
-            return true;
+            result = type_nominal(ctx, type->nominal.sym, map_all(m, type->nominal.type_args));
+            break;
 
         case TYPE_MODAL_STATE:
-            return type_equals(a->modal_state.modal_type, b->modal_state.modal_type) &&
-                   a->modal_state.state_name.data == b->modal_state.state_name.data;
+            result = type_modal_state(ctx, map_type(m, type->modal_state.modal_type),
+                                      type->modal_state.state_name);
+            break;
 
         case TYPE_TUPLE:
-            if (vec_len(a->tuple.elements) != vec_len(b->tuple.elements)) {
-                return false;
-            }
-            for (size_t i = 0; i < vec_len(a->tuple.elements); i++) {
-                if (!type_equals(a->tuple.elements[i], b->tuple.elements[i])) {
-                    return false;
-                }
-            }
-            return true;
+            result = type_tuple(ctx, map_all(m, type->tuple.elements));
+            break;
 
         case TYPE_ARRAY:
-            return a->array.size == b->array.size &&
-                   type_equals(a->array.element, b->array.element);
+            result = type_array(ctx, map_type(m, type->array.element), type->array.size);
+            break;
 
         case TYPE_SLICE:
-            return type_equals(a->slice.element, b->slice.element);
+            result = type_slice(ctx, map_type(m, type->slice.element));
+            break;
 
         case TYPE_UNION:
-            if (vec_len(a->union_.members) != vec_len(b->union_.members)) {
-                return false;
-            }
-            /* Members are canonically ordered */
-            for (size_t i = 0; i < vec_len(a->union_.members); i++) {
-                if (!type_equals(a->union_.members[i], b->union_.members[i])) {
-                    return false;
-                }
-            }
-            return true;
+            result = type_union(ctx, map_all(m, type->union_.members));
+            break;
 
         case TYPE_FUNCTION:
-            if (vec_len(a->function.params) != vec_len(b->function.params)) {
-                return false;
-            }
-            for (size_t i = 0; i < vec_len(a->function.params); i++) {
-                if (!type_equals(a->function.params[i], b->function.params[i])) {
-                    return false;
-                }
-            }
-            return type_equals(a->function.return_type, b->function.return_type);
+            result = type_function(ctx, map_all(m, type->function.params),
+                                   map_type(m, type->function.return_type));
+            break;
 
         case TYPE_PTR:
         case TYPE_PTR_VALID:
         case TYPE_PTR_NULL:
-            return type_equals(a->ptr.pointee, b->ptr.pointee);
-
-        case TYPE_GENERIC_PARAM:
-            return a->generic_param.name.data == b->generic_param.name.data &&
-                   a->generic_param.index == b->generic_param.index;
+            result = type_ptr(ctx, map_type(m, type->ptr.pointee), type->kind);
+            break;
 
         case TYPE_GENERIC_INST:
-            if (!type_equals(a->generic_inst.base, b->generic_inst.base)) {
-                return false;
-            }
-            if (vec_len(a->generic_inst.args) != vec_len(b->generic_inst.args)) {
-                return false;
-            }
-            for (size_t i = 0; i < vec_len(a->generic_inst.args); i++) {
-                if (!type_equals(a->generic_inst.args[i], b->generic_inst.args[i])) {
-                    return false;
-                }
-            }
-            return true;
-
-        case TYPE_ERROR:
-        case TYPE_INFER:
-            return true;
+            result = type_generic_inst(ctx, map_type(m, type->generic_inst.base),
+                                       map_all(m, type->generic_inst.args));
+            break;
 
         default:
-            return false;
+            return type;
+    }
+
+    /* A parameter written with a permission keeps it after substitution */
+    if (type->perm != PERM_CONST) {
+        result = type_with_permission(ctx, result, type->perm);
     }
+    return result;
+}
+
+static Type *substitute_param(const TypeMapper *m, Type *param) {
+    if (param->kind != TYPE_GENERIC_PARAM) return param;
+    size_t index = param->generic_param.index;
+    return index < vec_len(m->args) && m->args[index] ? m->args[index] : param;
+}
+
+/* Substitute generic arguments into a type */
+Type *type_substitute(TypeContext *ctx, Type *type, Vec(Type *) args) {
+    if (!type || !type->has_params || vec_len(args) == 0) {
+        return type;
+    }
+
+    TypeMapper mapper = { ctx, false, substitute_param, args, NULL, NULL };
+    return map_type(&mapper, type);
+}
+
+static Type *resolve_var(const TypeMapper *m, Type *var) {
+    return var->kind == TYPE_INFER ? m->resolve(m->state, var) : var;
+}
+
+/* Replace inference variables in a type */
+Type *type_resolve_vars(TypeContext *ctx, Type *type,
+                        Type *(*resolve)(void *state, Type *var), void *state) {
+    if (!type || !type->has_vars) {
+        return type;
+    }
+
+    TypeMapper mapper = { ctx, true, resolve_var, NULL, resolve, state };
+    return map_type(&mapper, type);
+}
+
+/* Type equality */
+bool type_equals(Type *a, Type *b) {
+    if (a == b) return true;
+    if (!a || !b) return false;
+
+    /* Error placeholders are compatible with each other for recovery */
+    return a->kind == TYPE_ERROR && b->kind == TYPE_ERROR;
 }
 
 /* Subtyping check */
@@ -384,13 +740,27 @@ bool type_is_subtype(Type *sub, Type *super) {
     /* Permission subtyping: unique <: const */
     if (sub->perm == PERM_UNIQUE && super->perm == PERM_CONST) {
         /* Check structural equality ignoring permission */
-        Type sub_copy = *sub;
-        sub_copy.perm = PERM_CONST;
-        return type_equals(&sub_copy, super);
+        return type_same_shape(sub, super, false);
     }
 
-    /* Union subtyping: T <: T | U */
+    /* Union subtyping: T <: T | U, and T | U <: T | U | V */
     if (super->kind == TYPE_UNION) {
+        if (type_union_contains(super, sub)) {
+            return true;
+        }
+        if (sub->kind == TYPE_UNION) {
+            if (type_union_subset(sub, super)) {
+                return true;
+            }
+            for (size_t i = 0; i < vec_len(sub->union_.members); i++) {
+                if (!type_is_subtype(sub->union_.members[i], super)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /* Members related by permission or state widening */
         for (size_t i = 0; i < vec_len(super->union_.members); i++) {
             if (type_is_subtype(sub, super->union_.members[i])) {
                 return true;
@@ -470,22 +840,131 @@ bool type_is_copy(Type *type) {
     }
 }
 
-/* Is this type sized? */
-bool type_is_sized(Type *type) {
+/* The nominal symbol and type arguments of a record or enum type */
+static Symbol *nominal_parts(Type *type, Vec(Type *) *args) {
+    if (type->kind == TYPE_GENERIC_INST) {
+        *args = type->generic_inst.args;
+        type = type->generic_inst.base;
+    } else {
+        *args = NULL;
+    }
+    if (type->kind != TYPE_RECORD && type->kind != TYPE_ENUM) return NULL;
+    if (!*args) *args = type->nominal.type_args;
+    return type->nominal.sym;
+}
+
+/* Does a declaration list the built-in Drop class among its classes? */
+static bool implements_drop(Vec(TypeExpr *) implements) {
+    for (size_t i = 0; i < vec_len(implements); i++) {
+        TypeExpr *texpr = implements[i];
+        if (texpr->kind != TEXPR_NAMED) continue;
+        Symbol *sym = texpr->named.resolved;
+        if (sym && sym->kind == SYM_CLASS && !sym->decl && interned_eq_str(sym->name, "Drop")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ProcDecl *type_drop_method(Type *type) {
+    if (!type) return NULL;
+
+    Vec(Type *) args;
+    Symbol *sym = nominal_parts(type, &args);
+    if (!sym || !sym->decl) return NULL;
+
+    Vec(TypeExpr *) implements;
+    Vec(ProcDecl) methods;
+    if (sym->decl->kind == DECL_RECORD) {
+        implements = sym->decl->record.implements;
+        methods = sym->decl->record.methods;
+    } else if (sym->decl->kind == DECL_ENUM) {
+        implements = sym->decl->enum_.implements;
+        methods = sym->decl->enum_.methods;
+    } else {
+        return NULL;
+    }
+    if (!implements_drop(implements)) return NULL;
+
+    for (size_t i = 0; i < vec_len(methods); i++) {
+        if (interned_eq_str(methods[i].name, "drop") && methods[i].receiver != RECV_NONE) {
+            return &methods[i];
+        }
+    }
+    return NULL;
+}
+
+/* Type of a record field or enum payload in an instance with `args` */
+static Type *member_type(TypeContext *ctx, TypeExpr *texpr, Vec(Type *) args) {
+    Type *type = texpr ? texpr->resolved : NULL;
+    if (type && vec_len(args) > 0) {
+        type = type_substitute(ctx, type, args);
+    }
+    return type;
+}
+
+/* Nesting bound, for types that (illegally) contain themselves by value */
+#define DROP_GLUE_MAX_DEPTH 64
+
+static bool needs_drop(TypeContext *ctx, Type *type, uint32_t depth) {
     if (!type) return false;
+    if (depth > DROP_GLUE_MAX_DEPTH) return true;
 
     switch (type->kind) {
-        case TYPE_SLICE:
-            return false;  /* Slices are unsized */
+        case TYPE_TUPLE:
+            for (size_t i = 0; i < vec_len(type->tuple.elements); i++) {
+                if (needs_drop(ctx, type->tuple.elements[i], depth + 1)) return true;
+            }
+            return false;
 
-        case TYPE_NEVER:
-            return false;  /* Never is zero-sized */
+        case TYPE_ARRAY:
+            return type->array.size > 0 && needs_drop(ctx, type->array.element, depth + 1);
 
-        default:
+        case TYPE_UNION:
+            for (size_t i = 0; i < vec_len(type->union_.members); i++) {
+                if (needs_drop(ctx, type->union_.members[i], depth + 1)) return true;
+            }
+            return false;
+
+        /* Unknown until instantiated, so assume it does */
+        case TYPE_GENERIC_PARAM:
             return true;
+
+        case TYPE_RECORD:
+        case TYPE_ENUM:
+        case TYPE_GENERIC_INST: {
+            if (type_drop_method(type)) return true;
+
+            Vec(Type *) args;
+            Symbol *sym = nominal_parts(type, &args);
+            if (!sym || !sym->decl) return false;
+
+            if (sym->decl->kind == DECL_RECORD) {
+                RecordDecl *record = &sym->decl->record;
+                for (size_t i = 0; i < vec_len(record->fields); i++) {
+                    Type *field = member_type(ctx, record->fields[i].type, args);
+                    if (needs_drop(ctx, field, depth + 1)) return true;
+                }
+            } else if (sym->decl->kind == DECL_ENUM) {
+                EnumDecl *en = &sym->decl->enum_;
+                for (size_t i = 0; i < vec_len(en->variants); i++) {
+                    Type *payload = member_type(ctx, en->variants[i].payload, args);
+                    if (needs_drop(ctx, payload, depth + 1)) return true;
+                }
+            }
+            return false;
+        }
+
+        /* Primitives, pointers, strings and functions own nothing to release */
+        default:
+            return false;
     }
 }
 
+bool type_needs_drop(TypeContext *ctx, Type *type) {
+    return needs_drop(ctx, type, 0);
+}
+
 /* Pretty-print type for diagnostics */
 const char *type_to_string(Type *type, Arena *arena) {
     if (!type) return "<null>";
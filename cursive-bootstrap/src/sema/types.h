@@ -12,6 +12,7 @@
 #include "common/arena.h"
 #include "common/vec.h"
 #include "common/string_pool.h"
+#include "common/bitset.h"
 #include "parser/ast.h"
 
 /* Forward declarations */
@@ -68,6 +69,10 @@ typedef enum TypeKind {
 struct Type {
     TypeKind kind;
     Permission perm;           /* Permission modifier */
+    uint32_t id;               /* Creation order, unique per canonical type */
+    uint32_t hash;             /* Structural hash (hash-consing key) */
+    bool has_params;           /* Mentions a generic parameter */
+    bool has_vars;             /* Mentions an inference variable */
 
     union {
         /* TYPE_RECORD, TYPE_ENUM, TYPE_MODAL, TYPE_CLASS */
@@ -100,7 +105,9 @@ struct Type {
 
         /* TYPE_UNION */
         struct {
-            Vec(Type *) members;       /* Canonical order */
+            Vec(Type *) members;       /* Sorted by id; no duplicates or nested unions */
+            BitWord *member_bits;      /* Bit `id` set for each member */
+            uint32_t member_words;     /* Words in member_bits */
         } union_;
 
         /* TYPE_FUNCTION */
@@ -126,16 +133,30 @@ struct Type {
             Type *base;                /* The generic type definition */
             Vec(Type *) args;          /* Type arguments */
         } generic_inst;
+
+        /* TYPE_INFER */
+        struct {
+            uint32_t index;            /* Variable in the procedure's inference table */
+        } var;
     };
 };
 
 /*
- * Type context for managing canonical types
+ * Type context for managing canonical types.
+ *
+ * Every type is hash-consed: constructors look the structure up in an
+ * intern table keyed by kind, permission and (already canonical) children,
+ * so structurally equal types are the same pointer.
  */
 typedef struct TypeContext {
     Arena *arena;
     StringPool *strings;
 
+    /* Intern table (open addressing, power-of-two capacity) */
+    Type **interned;
+    size_t interned_count;
+    size_t interned_capacity;
+
     /* Cached primitive types */
     Type *type_i8, *type_i16, *type_i32, *type_i64, *type_i128;
     Type *type_u8, *type_u16, *type_u32, *type_u64, *type_u128;
@@ -150,6 +171,12 @@ typedef struct TypeContext {
 /* Initialize type context */
 void type_ctx_init(TypeContext *ctx, Arena *arena, StringPool *strings);
 
+/*
+ * Type constructors return the canonical instance for their arguments.
+ * Constructors that take a Vec take ownership of it; if an equal type
+ * already exists the Vec is freed.
+ */
+
 /* Get primitive type */
 Type *type_primitive(TypeContext *ctx, TypeKind kind);
 
@@ -168,26 +195,56 @@ Type *type_array(TypeContext *ctx, Type *element, size_t size);
 /* Create slice type */
 Type *type_slice(TypeContext *ctx, Type *element);
 
-/* Create union type (canonicalizes member order) */
+/*
+ * Create union type. Nested unions are flattened, duplicates removed and
+ * members sorted by type id, so equal member sets give the same union.
+ */
 Type *type_union(TypeContext *ctx, Vec(Type *) members);
 
+/* Is `member` one of the union's members? (O(1)) */
+bool type_union_contains(const Type *u, const Type *member);
+
+/* Is every member of union `sub` a member of union `super`? */
+bool type_union_subset(const Type *sub, const Type *super);
+
 /* Create function type */
 Type *type_function(TypeContext *ctx, Vec(Type *) params, Type *return_type);
 
 /* Create pointer type */
 Type *type_ptr(TypeContext *ctx, Type *pointee, TypeKind ptr_kind);
 
-/* Create generic parameter type */
+/* Create generic parameter type (its bounds, in order, are part of its identity) */
 Type *type_generic_param(TypeContext *ctx, InternedString name, size_t index,
                          Vec(Type *) bounds);
 
 /* Create generic instantiation */
 Type *type_generic_inst(TypeContext *ctx, Type *base, Vec(Type *) args);
 
+/*
+ * Get the inference variable with the given index. Variables are
+ * numbered per procedure (see infer.h), so the same index names a
+ * different unknown in each procedure.
+ */
+Type *type_infer_var(TypeContext *ctx, uint32_t index);
+
 /* Apply permission to type */
 Type *type_with_permission(TypeContext *ctx, Type *type, Permission perm);
 
-/* Type equality (structural for structural types, nominal for nominal) */
+/*
+ * Replace each generic parameter with the argument at its index.
+ * Parameters with no corresponding argument are left in place; types
+ * that mention no parameters are returned unchanged.
+ */
+Type *type_substitute(TypeContext *ctx, Type *type, Vec(Type *) args);
+
+/*
+ * Replace each inference variable with `resolve(state, var)`; types that
+ * mention no variables are returned unchanged.
+ */
+Type *type_resolve_vars(TypeContext *ctx, Type *type,
+                        Type *(*resolve)(void *state, Type *var), void *state);
+
+/* Type equality: pointer identity on canonical types (O(1)) */
 bool type_equals(Type *a, Type *b);
 
 /* Subtyping check: is `sub` a subtype of `super`? */
@@ -196,8 +253,18 @@ bool type_is_subtype(Type *sub, Type *super);
 /* Is this type Copy? */
 bool type_is_copy(Type *type);
 
-/* Is this type sized? */
-bool type_is_sized(Type *type);
+/*
+ * The `drop` method of a record or enum (or an instance of one) that
+ * implements the Drop class, or NULL.
+ */
+ProcDecl *type_drop_method(Type *type);
+
+/*
+ * Does destroying a value of this type run any code? True for types with
+ * a `drop` method and for aggregates that contain one; generic parameters
+ * are assumed to. Copy types never need drop glue.
+ */
+bool type_needs_drop(TypeContext *ctx, Type *type);
 
 /* Pretty-print type for diagnostics */
 const char *type_to_string(Type *type, Arena *arena);
@@ -0,0 +1,585 @@
+/*
+ * Cursive Bootstrap Compiler - Fused Body Walker
+ *
+ * Walks each body once and fans every node out to the registered passes.
+ * Each pass has a bit in an "active" mask; a pass that declines a node
+ * (enter returns false) is masked out for that subtree, and the subtree is
+ * skipped entirely once no pass remains active.
+ */
+
+#include "visit.h"
+#include <string.h>
+
+/* Run a body-level callback, charging its time to the pass in timing mode.
+ * Per-node callbacks are not sampled: a clock() per node would cost more
+ * than most of the callbacks it measures. */
+#define VISIT_TIMED(v, p, call) do { \
+    if ((v)->timing) { \
+        clock_t start_ = clock(); \
+        call; \
+        (p)->elapsed += clock() - start_; \
+    } else { \
+        call; \
+    } \
+} while (0)
+
+#define VISIT_BIT(i) ((uint32_t)1 << (i))
+
+/* Forward declarations */
+static void walk_expr(Visitor *v, uint32_t active, Expr *expr, Expr *parent, VisitUse use);
+static void walk_stmt(Visitor *v, uint32_t active, Stmt *stmt);
+static void walk_pattern(Visitor *v, uint32_t active, Pattern *pat, bool binds);
+
+/*
+ * Initialize a walker
+ */
+void visitor_init(Visitor *v, bool timing) {
+    memset(v, 0, sizeof(Visitor));
+    v->timing = timing;
+}
+
+/*
+ * Register a pass
+ */
+void visitor_add_pass(Visitor *v, const VisitPass *pass) {
+    CURSIVE_ASSERT(v->pass_count < VISIT_MAX_PASSES);
+    v->passes[v->pass_count] = *pass;
+    v->passes[v->pass_count].elapsed = 0;
+    v->pass_count++;
+}
+
+/*
+ * Find a registered pass by name
+ */
+VisitPass *visitor_find_pass(Visitor *v, const char *name) {
+    for (size_t i = 0; i < v->pass_count; i++) {
+        if (strcmp(v->passes[i].name, name) == 0) {
+            return &v->passes[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Mask with every registered pass active
+ */
+static uint32_t all_passes(const Visitor *v) {
+    return v->pass_count == 0 ? 0 : (uint32_t)(VISIT_BIT(v->pass_count) - 1);
+}
+
+/*
+ * Use of a child that inherits its parent's use (tuple elements, widen, ...).
+ * Only consumption propagates; assignment and borrow apply to the parent alone.
+ */
+static VisitUse inherit_use(VisitUse use) {
+    return use == VISIT_USE_CONSUME ? VISIT_USE_CONSUME : VISIT_USE_READ;
+}
+
+/*
+ * ============================================
+ * Dispatch
+ * ============================================
+ */
+
+static uint32_t enter_expr(Visitor *v, uint32_t active, Expr *expr, const VisitEdge *edge) {
+    uint32_t entered = 0;
+    for (size_t i = 0; i < v->pass_count; i++) {
+        if (!(active & VISIT_BIT(i))) continue;
+        VisitPass *p = &v->passes[i];
+        bool descend = true;
+        if (p->enter_expr) {
+            descend = p->enter_expr(p->state, expr, edge);
+        }
+        if (descend) entered |= VISIT_BIT(i);
+    }
+    return entered;
+}
+
+static void exit_expr(Visitor *v, uint32_t active, Expr *expr, const VisitEdge *edge) {
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        if ((active & VISIT_BIT(i)) && p->exit_expr) {
+            p->exit_expr(p->state, expr, edge);
+        }
+    }
+}
+
+static uint32_t enter_stmt(Visitor *v, uint32_t active, Stmt *stmt) {
+    uint32_t entered = 0;
+    for (size_t i = 0; i < v->pass_count; i++) {
+        if (!(active & VISIT_BIT(i))) continue;
+        VisitPass *p = &v->passes[i];
+        bool descend = true;
+        if (p->enter_stmt) {
+            descend = p->enter_stmt(p->state, stmt);
+        }
+        if (descend) entered |= VISIT_BIT(i);
+    }
+    return entered;
+}
+
+static void exit_stmt(Visitor *v, uint32_t active, Stmt *stmt) {
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        if ((active & VISIT_BIT(i)) && p->exit_stmt) {
+            p->exit_stmt(p->state, stmt);
+        }
+    }
+}
+
+static uint32_t enter_pattern(Visitor *v, uint32_t active, Pattern *pat, bool binds) {
+    uint32_t entered = 0;
+    for (size_t i = 0; i < v->pass_count; i++) {
+        if (!(active & VISIT_BIT(i))) continue;
+        VisitPass *p = &v->passes[i];
+        bool descend = true;
+        if (p->enter_pattern) {
+            descend = p->enter_pattern(p->state, pat, binds);
+        }
+        if (descend) entered |= VISIT_BIT(i);
+    }
+    return entered;
+}
+
+static void exit_pattern(Visitor *v, uint32_t active, Pattern *pat, bool binds) {
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        if ((active & VISIT_BIT(i)) && p->exit_pattern) {
+            p->exit_pattern(p->state, pat, binds);
+        }
+    }
+}
+
+/*
+ * ============================================
+ * Traversal
+ * ============================================
+ */
+
+/*
+ * Walk the children of an expression.
+ * The use assigned to each child mirrors the language's evaluation rules:
+ * initializers, `move` operands, record fields, match scrutinees and region
+ * allocations consume their value; everything else reads it.
+ */
+static void walk_expr_children(Visitor *v, uint32_t active, Expr *expr, VisitUse use) {
+    switch (expr->kind) {
+        case EXPR_INT_LIT:
+        case EXPR_FLOAT_LIT:
+        case EXPR_STRING_LIT:
+        case EXPR_CHAR_LIT:
+        case EXPR_BOOL_LIT:
+        case EXPR_IDENT:
+        case EXPR_PATH:
+            break;
+
+        case EXPR_BINARY:
+            if (expr->binary.op >= BINOP_ASSIGN && expr->binary.op <= BINOP_SHR_ASSIGN) {
+                walk_expr(v, active, expr->binary.left, expr, VISIT_USE_ASSIGN);
+                walk_expr(v, active, expr->binary.right, expr, VISIT_USE_CONSUME);
+            } else {
+                walk_expr(v, active, expr->binary.left, expr, VISIT_USE_READ);
+                walk_expr(v, active, expr->binary.right, expr, VISIT_USE_READ);
+            }
+            break;
+
+        case EXPR_UNARY: {
+            VisitUse operand_use = VISIT_USE_READ;
+            if (expr->unary.op == UNOP_DEREF) {
+                operand_use = inherit_use(use);
+            } else if (expr->unary.op == UNOP_ADDR || expr->unary.op == UNOP_ADDR_MUT) {
+                operand_use = VISIT_USE_BORROW;
+            }
+            walk_expr(v, active, expr->unary.operand, expr, operand_use);
+            break;
+        }
+
+        case EXPR_CALL:
+            walk_expr(v, active, expr->call.callee, expr, VISIT_USE_READ);
+            for (size_t i = 0; i < vec_len(expr->call.args); i++) {
+                walk_expr(v, active, expr->call.args[i], expr, VISIT_USE_READ);
+            }
+            break;
+
+        case EXPR_METHOD_CALL:
+            walk_expr(v, active, expr->method_call.receiver, expr, VISIT_USE_READ);
+            for (size_t i = 0; i < vec_len(expr->method_call.args); i++) {
+                walk_expr(v, active, expr->method_call.args[i], expr, VISIT_USE_READ);
+            }
+            break;
+
+        case EXPR_FIELD:
+            walk_expr(v, active, expr->field.object, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_INDEX:
+            walk_expr(v, active, expr->index.object, expr, VISIT_USE_READ);
+            walk_expr(v, active, expr->index.index, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_TUPLE:
+            for (size_t i = 0; i < vec_len(expr->tuple.elements); i++) {
+                walk_expr(v, active, expr->tuple.elements[i], expr, inherit_use(use));
+            }
+            break;
+
+        case EXPR_ARRAY:
+            if (expr->array.repeat_value) {
+                walk_expr(v, active, expr->array.repeat_value, expr, VISIT_USE_READ);
+                walk_expr(v, active, expr->array.repeat_count, expr, VISIT_USE_READ);
+            } else {
+                for (size_t i = 0; i < vec_len(expr->array.elements); i++) {
+                    walk_expr(v, active, expr->array.elements[i], expr, inherit_use(use));
+                }
+            }
+            break;
+
+        case EXPR_RECORD:
+            for (size_t i = 0; i < vec_len(expr->record.field_values); i++) {
+                walk_expr(v, active, expr->record.field_values[i], expr, VISIT_USE_CONSUME);
+            }
+            break;
+
+        case EXPR_IF:
+            walk_expr(v, active, expr->if_.condition, expr, VISIT_USE_READ);
+            walk_expr(v, active, expr->if_.then_branch, expr, VISIT_USE_READ);
+            walk_expr(v, active, expr->if_.else_branch, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_MATCH:
+            walk_expr(v, active, expr->match.scrutinee, expr, VISIT_USE_CONSUME);
+            for (size_t i = 0; i < vec_len(expr->match.arms_patterns); i++) {
+                walk_pattern(v, active, expr->match.arms_patterns[i], true);
+                walk_expr(v, active, expr->match.arms_bodies[i], expr, VISIT_USE_READ);
+            }
+            break;
+
+        case EXPR_BLOCK:
+            for (size_t i = 0; i < vec_len(expr->block.stmts); i++) {
+                walk_stmt(v, active, expr->block.stmts[i]);
+            }
+            walk_expr(v, active, expr->block.result, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_LOOP:
+            walk_expr(v, active, expr->loop.iterable, expr, VISIT_USE_READ);
+            walk_pattern(v, active, expr->loop.binding, true);
+            walk_expr(v, active, expr->loop.condition, expr, VISIT_USE_READ);
+            walk_expr(v, active, expr->loop.body, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_MOVE:
+            walk_expr(v, active, expr->move.operand, expr, VISIT_USE_CONSUME);
+            break;
+
+        case EXPR_WIDEN:
+            walk_expr(v, active, expr->widen.operand, expr, inherit_use(use));
+            break;
+
+        case EXPR_COMPTIME:
+            /* The operand runs in the compiler, not in the procedure */
+            break;
+
+        case EXPR_CAST:
+            walk_expr(v, active, expr->cast.operand, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_RANGE:
+            walk_expr(v, active, expr->range.start, expr, VISIT_USE_READ);
+            walk_expr(v, active, expr->range.end, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_STATIC_CALL:
+            for (size_t i = 0; i < vec_len(expr->static_call.args); i++) {
+                walk_expr(v, active, expr->static_call.args[i], expr, VISIT_USE_READ);
+            }
+            break;
+
+        case EXPR_REGION_ALLOC:
+            walk_expr(v, active, expr->region_alloc.value, expr, VISIT_USE_CONSUME);
+            break;
+
+        case EXPR_ADDR_OF:
+            walk_expr(v, active, expr->addr_of.operand, expr, VISIT_USE_BORROW);
+            break;
+
+        case EXPR_DEREF:
+            walk_expr(v, active, expr->deref.operand, expr, VISIT_USE_READ);
+            break;
+
+        case EXPR_CLOSURE:
+            for (size_t i = 0; i < vec_len(expr->closure.params); i++) {
+                walk_pattern(v, active, expr->closure.params[i], true);
+            }
+            walk_expr(v, active, expr->closure.body, expr, VISIT_USE_READ);
+            break;
+    }
+}
+
+/*
+ * Walk an expression
+ */
+static void walk_expr(Visitor *v, uint32_t active, Expr *expr, Expr *parent, VisitUse use) {
+    if (!expr || !active) return;
+
+    VisitEdge edge = { parent, use };
+    uint32_t inner = enter_expr(v, active, expr, &edge);
+    if (inner) {
+        walk_expr_children(v, inner, expr, use);
+        exit_expr(v, inner, expr, &edge);
+    }
+}
+
+/*
+ * Walk a pattern. `binds` is false for sub-patterns that only compare
+ * (range bounds) and therefore introduce no bindings.
+ */
+static void walk_pattern(Visitor *v, uint32_t active, Pattern *pat, bool binds) {
+    if (!pat || !active) return;
+
+    uint32_t inner = enter_pattern(v, active, pat, binds);
+    if (!inner) return;
+
+    switch (pat->kind) {
+        case PAT_WILDCARD:
+        case PAT_BINDING:
+            break;
+
+        case PAT_LITERAL:
+            walk_expr(v, inner, pat->literal.value, NULL, VISIT_USE_READ);
+            break;
+
+        case PAT_TUPLE:
+            for (size_t i = 0; i < vec_len(pat->tuple.elements); i++) {
+                walk_pattern(v, inner, pat->tuple.elements[i], binds);
+            }
+            break;
+
+        case PAT_RECORD:
+            for (size_t i = 0; i < vec_len(pat->record.field_patterns); i++) {
+                walk_pattern(v, inner, pat->record.field_patterns[i], binds);
+            }
+            break;
+
+        case PAT_ENUM:
+            walk_pattern(v, inner, pat->enum_.payload, binds);
+            break;
+
+        case PAT_MODAL:
+            for (size_t i = 0; i < vec_len(pat->modal.field_patterns); i++) {
+                walk_pattern(v, inner, pat->modal.field_patterns[i], binds);
+            }
+            break;
+
+        case PAT_RANGE:
+            walk_pattern(v, inner, pat->range.start, false);
+            walk_pattern(v, inner, pat->range.end, false);
+            break;
+
+        case PAT_OR:
+            for (size_t i = 0; i < vec_len(pat->or_.alternatives); i++) {
+                walk_pattern(v, inner, pat->or_.alternatives[i], binds);
+            }
+            break;
+
+        case PAT_GUARD:
+            walk_pattern(v, inner, pat->guard.pattern, binds);
+            walk_expr(v, inner, pat->guard.guard, NULL, VISIT_USE_READ);
+            break;
+    }
+
+    exit_pattern(v, inner, pat, binds);
+}
+
+/*
+ * Walk a statement
+ */
+static void walk_stmt(Visitor *v, uint32_t active, Stmt *stmt) {
+    if (!stmt || !active) return;
+
+    uint32_t inner = enter_stmt(v, active, stmt);
+    if (!inner) return;
+
+    switch (stmt->kind) {
+        case STMT_EXPR:
+            walk_expr(v, inner, stmt->expr.expr, NULL, VISIT_USE_READ);
+            break;
+
+        case STMT_LET:
+            /* Initializer first: it may move out of bindings the pattern shadows */
+            walk_expr(v, inner, stmt->let.init, NULL, VISIT_USE_CONSUME);
+            walk_pattern(v, inner, stmt->let.pattern, true);
+            break;
+
+        case STMT_VAR:
+            walk_expr(v, inner, stmt->var.init, NULL, VISIT_USE_CONSUME);
+            walk_pattern(v, inner, stmt->var.pattern, true);
+            break;
+
+        case STMT_ASSIGN:
+            walk_expr(v, inner, stmt->assign.target, NULL, VISIT_USE_ASSIGN);
+            walk_expr(v, inner, stmt->assign.value, NULL, VISIT_USE_CONSUME);
+            break;
+
+        case STMT_RETURN:
+            walk_expr(v, inner, stmt->return_.value, NULL, VISIT_USE_CONSUME);
+            break;
+
+        case STMT_RESULT:
+            walk_expr(v, inner, stmt->result.value, NULL, VISIT_USE_CONSUME);
+            break;
+
+        case STMT_BREAK:
+            walk_expr(v, inner, stmt->break_.value, NULL, VISIT_USE_CONSUME);
+            break;
+
+        case STMT_CONTINUE:
+            break;
+
+        case STMT_DEFER:
+            walk_expr(v, inner, stmt->defer.body, NULL, VISIT_USE_READ);
+            break;
+
+        case STMT_UNSAFE:
+            walk_expr(v, inner, stmt->unsafe.body, NULL, VISIT_USE_READ);
+            break;
+    }
+
+    exit_stmt(v, inner, stmt);
+}
+
+/*
+ * Walk a single body
+ */
+void visitor_walk_body(Visitor *v, VisitBody *body) {
+    uint32_t inner = 0;
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        bool descend = true;
+        if (p->enter_body) {
+            VISIT_TIMED(v, p, descend = p->enter_body(p->state, body));
+        }
+        if (descend) inner |= VISIT_BIT(i);
+    }
+
+    walk_expr(v, inner, body->body, NULL, VISIT_USE_READ);
+
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        if ((inner & VISIT_BIT(i)) && p->exit_body) {
+            VISIT_TIMED(v, p, p->exit_body(p->state, body));
+        }
+    }
+}
+
+/*
+ * Walk a procedure or method
+ */
+static void walk_proc(Visitor *v, ProcDecl *proc) {
+    VisitBody body = { proc, NULL, proc->body, proc->local_count };
+    visitor_walk_body(v, &body);
+}
+
+/*
+ * Walk all bodies owned by a declaration
+ */
+static void walk_decl(Visitor *v, Decl *decl) {
+    if (!decl) return;
+
+    switch (decl->kind) {
+        case DECL_PROC:
+            walk_proc(v, &decl->proc);
+            break;
+
+        case DECL_RECORD:
+            for (size_t i = 0; i < vec_len(decl->record.methods); i++) {
+                walk_proc(v, &decl->record.methods[i]);
+            }
+            break;
+
+        case DECL_ENUM:
+            for (size_t i = 0; i < vec_len(decl->enum_.methods); i++) {
+                walk_proc(v, &decl->enum_.methods[i]);
+            }
+            break;
+
+        case DECL_MODAL:
+            for (size_t i = 0; i < vec_len(decl->modal.shared_methods); i++) {
+                walk_proc(v, &decl->modal.shared_methods[i]);
+            }
+            for (size_t i = 0; i < vec_len(decl->modal.states); i++) {
+                ModalState *state = &decl->modal.states[i];
+                for (size_t j = 0; j < vec_len(state->methods); j++) {
+                    walk_proc(v, &state->methods[j]);
+                }
+                for (size_t j = 0; j < vec_len(state->transitions); j++) {
+                    Transition *trans = &state->transitions[j];
+                    if (trans->body) {
+                        VisitBody body = { NULL, trans, trans->body, trans->local_count };
+                        visitor_walk_body(v, &body);
+                    }
+                }
+            }
+            break;
+
+        case DECL_CLASS:
+            for (size_t i = 0; i < vec_len(decl->class_.default_methods); i++) {
+                walk_proc(v, &decl->class_.default_methods[i]);
+            }
+            break;
+
+        case DECL_TYPE_ALIAS:
+        case DECL_EXTERN:
+        case DECL_MODULE:
+        case DECL_IMPORT:
+        case DECL_USE:
+            /* No bodies */
+            break;
+    }
+}
+
+/*
+ * Walk a whole module, then let passes release their state
+ */
+void visitor_run_module(Visitor *v, Module *mod) {
+    clock_t start = v->timing ? clock() : 0;
+
+    if (all_passes(v)) {
+        for (size_t i = 0; i < vec_len(mod->decls); i++) {
+            walk_decl(v, mod->decls[i]);
+        }
+    }
+
+    for (size_t i = 0; i < v->pass_count; i++) {
+        VisitPass *p = &v->passes[i];
+        if (p->finish) {
+            p->finish(p->state);
+        }
+    }
+
+    if (v->timing) {
+        v->total += clock() - start;
+    }
+}
+
+/*
+ * Print timing: one line per pass for its body-level work, plus the fused
+ * node walk (traversal and every per-node callback)
+ */
+void visitor_report_timing(const Visitor *v, FILE *out) {
+    clock_t in_passes = 0;
+
+    fprintf(out, "=== Body walk timing ===\n");
+    for (size_t i = 0; i < v->pass_count; i++) {
+        const VisitPass *p = &v->passes[i];
+        in_passes += p->elapsed;
+        fprintf(out, "  %-16s %9.3f ms\n", p->name,
+            1000.0 * (double)p->elapsed / CLOCKS_PER_SEC);
+    }
+
+    clock_t walk = v->total > in_passes ? v->total - in_passes : 0;
+    fprintf(out, "  %-16s %9.3f ms\n", "(node walk)",
+        1000.0 * (double)walk / CLOCKS_PER_SEC);
+    fprintf(out, "  %-16s %9.3f ms\n", "total",
+        1000.0 * (double)v->total / CLOCKS_PER_SEC);
+}
@@ -0,0 +1,106 @@
+/*
+ * Cursive Bootstrap Compiler - Fused Body Walker
+ *
+ * A single traversal over procedure bodies that dispatches to every
+ * registered analysis pass. Passes supply enter/exit callbacks per node
+ * kind instead of each owning a full recursive walk, so move analysis and
+ * permission checking share one pointer-chasing traversal of the AST.
+ *
+ * The walker computes how each expression is used by its parent (read,
+ * consumed, assigned to, borrowed) so passes do not have to reconstruct
+ * that context themselves.
+ */
+
+#ifndef CURSIVE_SEMA_VISIT_H
+#define CURSIVE_SEMA_VISIT_H
+
+#include "parser/ast.h"
+#include <stdio.h>
+#include <time.h>
+
+/* Maximum number of passes that can share one walk */
+#define VISIT_MAX_PASSES 8
+
+/*
+ * How an expression's value is used by its parent
+ */
+typedef enum VisitUse {
+    VISIT_USE_READ,      /* Value is read (copied or inspected) */
+    VISIT_USE_CONSUME,   /* Value is consumed: moved if not Copy */
+    VISIT_USE_ASSIGN,    /* Expression is the target of an assignment */
+    VISIT_USE_BORROW     /* Operand of an address-of */
+} VisitUse;
+
+/*
+ * Edge from a parent to the expression being visited
+ */
+typedef struct VisitEdge {
+    Expr *parent;        /* Enclosing expression (NULL under a statement/pattern) */
+    VisitUse use;        /* How the parent uses this expression */
+} VisitEdge;
+
+/*
+ * A procedure-like body being walked
+ */
+typedef struct VisitBody {
+    ProcDecl *proc;          /* Procedure or method (NULL for transitions) */
+    Transition *transition;  /* Modal transition (NULL for procedures) */
+    Expr *body;              /* Body expression */
+    uint32_t local_count;    /* Local slots of the body (see Symbol.slot) */
+} VisitBody;
+
+/*
+ * An analysis pass registered with the walker.
+ *
+ * Every callback is optional. An enter callback returning false stops the
+ * walk from descending into that node's children for this pass only, and
+ * the matching exit callback is then not called.
+ */
+typedef struct VisitPass {
+    const char *name;    /* Name shown in timing reports */
+    void *state;         /* Pass-private context */
+
+    bool (*enter_body)(void *state, VisitBody *body);
+    void (*exit_body)(void *state, VisitBody *body);
+    bool (*enter_stmt)(void *state, Stmt *stmt);
+    void (*exit_stmt)(void *state, Stmt *stmt);
+    bool (*enter_expr)(void *state, Expr *expr, const VisitEdge *edge);
+    void (*exit_expr)(void *state, Expr *expr, const VisitEdge *edge);
+    bool (*enter_pattern)(void *state, Pattern *pat, bool binds);
+    void (*exit_pattern)(void *state, Pattern *pat, bool binds);
+
+    /* Called once after the module walk to release pass resources */
+    void (*finish)(void *state);
+
+    clock_t elapsed;     /* Time spent in enter_body/exit_body (timing mode) */
+} VisitPass;
+
+/*
+ * Walker state
+ */
+typedef struct Visitor {
+    VisitPass passes[VISIT_MAX_PASSES];
+    size_t pass_count;
+    bool timing;         /* Accumulate per-pass body-level callback time */
+    clock_t total;       /* Total time of the last module walk */
+} Visitor;
+
+/* Initialize a walker with no passes */
+void visitor_init(Visitor *v, bool timing);
+
+/* Register a pass (copied into the walker) */
+void visitor_add_pass(Visitor *v, const VisitPass *pass);
+
+/* Find a registered pass by name (NULL if absent) */
+VisitPass *visitor_find_pass(Visitor *v, const char *name);
+
+/* Walk a single body with all registered passes */
+void visitor_walk_body(Visitor *v, VisitBody *body);
+
+/* Walk every procedure, method and transition body in a module, then finish passes */
+void visitor_run_module(Visitor *v, Module *mod);
+
+/* Print per-pass body-level times and node walk time from the last run */
+void visitor_report_timing(const Visitor *v, FILE *out);
+
+#endif /* CURSIVE_SEMA_VISIT_H */
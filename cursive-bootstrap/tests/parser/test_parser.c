@@ -1,12 +1,126 @@
 /*
  * Cursive Bootstrap Compiler - Parser Tests
- *
- * Placeholder for Stage 3.
  */
 
 #include <stdio.h>
+#include <string.h>
+
+#include "common/arena.h"
+#include "common/string_pool.h"
+#include "common/error.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) do { \
+    printf("  Testing: %s... ", #name); \
+    tests_run++; \
+    if (test_##name()) { \
+        printf("PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("FAILED\n"); \
+    } \
+} while (0)
+
+/* Helper to parse a source string; NULL if it had errors */
+static Module *parse_source(const char *source, Arena *arena, StringPool *pool,
+                            DiagContext *diag) {
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, pool, diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, arena, diag);
+
+    Module *mod = parse_module(&parser);
+    return mod && !diag_has_errors(diag) ? mod : NULL;
+}
+
+/* Test: [[bootstrap.target_clones]] records its feature lists, procedures only */
+static bool test_target_clones(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    const char *source =
+        "[[bootstrap.target_clones(\"avx2,fma\", \"default\", \"sse4.2\")]]\n"
+        "procedure scale(n: i32) -> i32 {\n"
+        "    result n * 3\n"
+        "}\n";
+
+    Module *mod = parse_source(source, &arena, &pool, &diag);
+    bool ok = mod != NULL;
+
+    if (ok) {
+        ProcDecl *proc = &mod->decls[0]->proc;
+        ok = vec_len(proc->target_clones) == 2 &&
+             interned_eq_str(proc->target_clones[0], "avx2,fma") &&
+             interned_eq_str(proc->target_clones[1], "sse4.2");
+    }
+    diag_destroy(&diag);
+
+    /* Not valid on records */
+    diag_init(&diag);
+    const char *record_source =
+        "[[bootstrap.target_clones(\"avx2\")]]\n"
+        "record Point { x: i32 }\n";
+    ok = ok && !parse_source(record_source, &arena, &pool, &diag);
+
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    diag_destroy(&diag);
+    return ok;
+}
+
+/* Test: a range pattern spans its bounds and nothing after them */
+static bool test_range_pattern_span(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    const char *source =
+        "procedure test(n: u8) -> i32 {\n"
+        "    result match n {\n"
+        "        10..=99 => 1,\n"
+        "        _ => 0\n"
+        "    }\n"
+        "}\n";
+
+    Module *mod = parse_source(source, &arena, &pool, &diag);
+    bool ok = mod != NULL;
+
+    if (ok) {
+        Stmt *stmt = mod->decls[0]->proc.body->block.stmts[0];
+        Pattern *range = stmt->result.value->match.arms_patterns[0];
+        ok = range->kind == PAT_RANGE &&
+             range->span.start.line == 3 && range->span.start.col == 9 &&
+             range->span.end.line == 3 && range->span.end.col == 16;
+    }
+
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    diag_destroy(&diag);
+    return ok;
+}
 
 int main(void) {
-    printf("Parser tests not yet implemented (Stage 3).\n");
-    return 0;
+    printf("Running parser tests:\n");
+
+    TEST(target_clones);
+    TEST(range_pattern_span);
+
+    printf("\nResults: %d/%d tests passed\n", tests_passed, tests_run);
+    return tests_passed == tests_run ? 0 : 1;
 }
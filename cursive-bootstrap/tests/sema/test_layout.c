@@ -0,0 +1,256 @@
+/*
+ * Cursive Bootstrap Compiler - Type Layout Tests
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common/arena.h"
+#include "common/string_pool.h"
+#include "common/error.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "sema/types.h"
+#include "sema/layout.h"
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) do { \
+    printf("  Testing: %s... ", #name); \
+    tests_run++; \
+    if (test_##name()) { \
+        printf("PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("FAILED\n"); \
+    } \
+} while (0)
+
+/* Build a Vec of two types */
+static Vec(Type *) pair(Type *a, Type *b) {
+    Vec(Type *) v = vec_new(Type *);
+    vec_push(v, a);
+    vec_push(v, b);
+    return v;
+}
+
+/* Helper to parse and run full semantic analysis */
+static bool full_analysis(const char *source, DiagContext *diag) {
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, &pool, diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, &arena, diag);
+
+    Module *mod = parse_module(&parser);
+    if (!mod || diag_has_errors(diag)) {
+        arena_destroy(&arena);
+        string_pool_destroy(&pool);
+        return false;
+    }
+
+    SemaContext sema;
+    sema_init(&sema, &arena, diag, &pool);
+
+    bool result = sema_analyze(&sema, mod);
+
+    sema_destroy(&sema);
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    return result;
+}
+
+/* Test: Records are reordered by alignment unless layout(C) or packed */
+static bool test_record_layout(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    const char *source =
+        "record Mixed { a: u8, b: u64, c: u8 }\n"
+        "\n"
+        "[[layout(C)]]\n"
+        "record CMixed { a: u8, b: u64, c: u8 }\n"
+        "\n"
+        "[[layout(packed)]]\n"
+        "record Packed { a: u8, b: u64, c: u8 }\n"
+        "\n"
+        "procedure test() -> i32 {\n"
+        "    let m = Mixed { a: 1, b: 2, c: 3 }\n"
+        "    let c = CMixed { a: 1, b: 2, c: 3 }\n"
+        "    let p = Packed { a: 1, b: 2, c: 3 }\n"
+        "    result 0\n"
+        "}\n";
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, &pool, &diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, &arena, &diag);
+
+    Module *mod = parse_module(&parser);
+    bool ok = mod && !diag_has_errors(&diag);
+
+    SemaContext sema;
+    if (ok) {
+        sema_init(&sema, &arena, &diag, &pool);
+        ok = sema_analyze(&sema, mod);
+    }
+
+    if (ok) {
+        Vec(Stmt *) stmts = mod->decls[3]->proc.body->block.stmts;
+        const Layout *m = layout_of(&sema.layout, stmts[0]->let.pattern->binding.resolved->type);
+        const Layout *c = layout_of(&sema.layout, stmts[1]->let.pattern->binding.resolved->type);
+        const Layout *p = layout_of(&sema.layout, stmts[2]->let.pattern->binding.resolved->type);
+
+        /* b first, then a and c in declaration order */
+        ok = m && c && p &&
+             m->size == 16 && m->align == 8 && m->fields[1].offset == 0 &&
+             m->fields[0].offset == 8 && m->fields[2].offset == 9 &&
+             c->size == 24 && c->fields[1].offset == 8 && c->fields[2].offset == 16 &&
+             p->size == 10 && p->align == 1 && p->fields[1].offset == 1;
+    }
+
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    diag_destroy(&diag);
+    return ok;
+}
+
+/* Test: A record containing itself without indirection is rejected */
+static bool test_infinite_record(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "record Node {\n"
+        "    value: i32,\n"
+        "    next: Node\n"  /* Error: infinite size */
+        "}\n";
+
+    bool result = full_analysis(source, &diag);
+    diag_destroy(&diag);
+
+    /* Should fail - infinite type */
+    return !result;
+}
+
+/* Test: Enums use niches of their payload; fieldless enums are their tag */
+static bool test_enum_niches(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    const char *source =
+        "enum Color { Red, Green, Blue }\n"
+        "enum Opt { Some(&i32), None }\n"
+        "enum Wrap { Has(Color), Nothing, Other }\n"
+        "enum Wide { Big(i64), Small(i8) }\n"
+        "\n"
+        "procedure test(c: Color, o: Opt, w: Wrap, d: Wide) -> i32 {\n"
+        "    result 0\n"
+        "}\n";
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, &pool, &diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, &arena, &diag);
+
+    Module *mod = parse_module(&parser);
+    bool ok = mod && !diag_has_errors(&diag);
+
+    SemaContext sema;
+    if (ok) {
+        sema_init(&sema, &arena, &diag, &pool);
+        ok = sema_analyze(&sema, mod);
+    }
+
+    if (ok) {
+        Vec(ParamDecl) params = mod->decls[4]->proc.params;
+        const Layout *color = layout_of(&sema.layout, params[0].resolved->type);
+        const Layout *opt = layout_of(&sema.layout, params[1].resolved->type);
+        const Layout *wrap = layout_of(&sema.layout, params[2].resolved->type);
+        const Layout *wide = layout_of(&sema.layout, params[3].resolved->type);
+
+        /* Red..Blue take 0..2, so Nothing and Other are 3 and 4 */
+        ok = color && opt && wrap && wide &&
+             color->size == 1 && color->payload_size == 0 &&
+             opt->encoding == TAG_NICHE && opt->size == 8 && opt->niche_first == 0 &&
+             wrap->encoding == TAG_NICHE && wrap->size == 1 && wrap->niche_first == 3 &&
+             wrap->niche.end == 4 &&
+             wide->encoding == TAG_DIRECT && wide->size == 16;
+    }
+
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    diag_destroy(&diag);
+    return ok;
+}
+
+/* Test: Unions of one sized member and () keep the tag in a niche */
+static bool test_union_niches(void) {
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    TypeContext types;
+    type_ctx_init(&types, &arena, &pool);
+
+    LayoutContext layouts;
+    layout_ctx_init(&layouts, &arena, &types);
+
+    Type *ptr = type_ptr(&types, types.type_i32, TYPE_PTR_VALID);
+    Type *pair_ib = type_tuple(&types, pair(types.type_i64, types.type_bool));
+    const Layout *opt_ptr = layout_of(&layouts, type_union(&types, pair(ptr, types.type_unit)));
+    const Layout *opt_bool = layout_of(&layouts,
+        type_union(&types, pair(types.type_bool, types.type_unit)));
+    const Layout *opt_pair = layout_of(&layouts, type_union(&types, pair(pair_ib, types.type_unit)));
+    const Layout *opt_int = layout_of(&layouts,
+        type_union(&types, pair(types.type_i32, types.type_unit)));
+
+    bool ok = opt_ptr && opt_bool && opt_pair && opt_int &&
+              opt_ptr->encoding == TAG_NICHE && opt_ptr->size == 8 &&
+              opt_bool->encoding == TAG_NICHE && opt_bool->size == 1 &&
+              opt_pair->size == 16 && opt_pair->tag_offset == 8 && opt_pair->tag_size == 1 &&
+              opt_int->encoding == TAG_DIRECT && opt_int->size == 8 &&
+              opt_int->payload_offset == 4;
+
+    layout_ctx_destroy(&layouts);
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    return ok;
+}
+
+int main(void) {
+    printf("Running type layout tests:\n");
+
+    TEST(record_layout);
+    TEST(infinite_record);
+    TEST(enum_niches);
+    TEST(union_niches);
+
+    printf("\nResults: %d/%d tests passed\n", tests_passed, tests_run);
+    return tests_passed == tests_run ? 0 : 1;
+}
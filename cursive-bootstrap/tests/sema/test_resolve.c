@@ -53,6 +53,7 @@ static bool parse_and_resolve(const char *source, DiagContext *diag) {
 
     bool result = sema_resolve_names(&sema, mod);
 
+    sema_destroy(&sema);
     arena_destroy(&arena);
     string_pool_destroy(&pool);
     return result;
@@ -113,6 +114,27 @@ static bool test_variable_shadowing(void) {
     return result;
 }
 
+/* Test: Bindings of an exited block are no longer visible */
+static bool test_block_binding_out_of_scope(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "procedure test() -> i32 {\n"
+        "    {\n"
+        "        let y: i32 = 2\n"
+        "        y\n"
+        "    }\n"
+        "    result y\n"
+        "}\n";
+
+    bool result = parse_and_resolve(source, &diag);
+    diag_destroy(&diag);
+
+    /* Should fail - y went out of scope with its block */
+    return !result && diag_has_errors(&diag);
+}
+
 /* Test: Record definition and use */
 static bool test_record_definition(void) {
     DiagContext diag;
@@ -285,12 +307,66 @@ static bool test_record_implements_class(void) {
     return result;
 }
 
+/* Test: Parameters and locals get dense per-procedure slots */
+static bool test_local_slots(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    Arena arena;
+    arena_init(&arena);
+
+    StringPool pool;
+    string_pool_init(&pool);
+
+    const char *source =
+        "procedure test(a: i32, b: i32) -> i32 {\n"
+        "    let x: i32 = a\n"
+        "    {\n"
+        "        let x: i32 = b\n"
+        "        x\n"
+        "    }\n"
+        "    result x\n"
+        "}\n";
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, &pool, &diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, &arena, &diag);
+
+    Module *mod = parse_module(&parser);
+    if (!mod || diag_has_errors(&diag)) {
+        arena_destroy(&arena);
+        string_pool_destroy(&pool);
+        diag_destroy(&diag);
+        return false;
+    }
+
+    SemaContext sema;
+    sema_init(&sema, &arena, &diag, &pool);
+    bool ok = sema_resolve_names(&sema, mod);
+
+    if (ok) {
+        ProcDecl *proc = &mod->decls[0]->proc;
+        ok = proc->local_count == 4 &&
+             proc->params[0].resolved->slot == 0 &&
+             proc->params[1].resolved->slot == 1;
+    }
+
+    sema_destroy(&sema);
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    diag_destroy(&diag);
+    return ok;
+}
+
 int main(void) {
     printf("Running name resolution tests:\n");
 
     TEST(builtin_types);
     TEST(undefined_variable);
     TEST(variable_shadowing);
+    TEST(block_binding_out_of_scope);
     TEST(record_definition);
     TEST(undefined_type);
     TEST(enum_definition);
@@ -300,6 +376,7 @@ int main(void) {
     TEST(match_bindings);
     TEST(class_definition);
     TEST(record_implements_class);
+    TEST(local_slots);
 
     printf("\nResults: %d/%d tests passed\n", tests_passed, tests_run);
     return tests_passed == tests_run ? 0 : 1;
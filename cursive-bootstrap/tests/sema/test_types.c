@@ -0,0 +1,349 @@
+/*
+ * Cursive Bootstrap Compiler - Type System Tests
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "common/arena.h"
+#include "common/string_pool.h"
+#include "common/error.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "sema/sema.h"
+#include "sema/types.h"
+#include "sema/infer.h"
+
+static int tests_run = 0;
+static int tests_passed = 0;
+
+#define TEST(name) do { \
+    printf("  Testing: %s... ", #name); \
+    tests_run++; \
+    if (test_##name()) { \
+        printf("PASSED\n"); \
+        tests_passed++; \
+    } else { \
+        printf("FAILED\n"); \
+    } \
+} while (0)
+
+static Arena arena;
+static StringPool pool;
+static TypeContext types;
+
+/* Parse and run full semantic analysis on a source string */
+static bool analyze_source(const char *source, DiagContext *diag) {
+    Arena source_arena;
+    arena_init(&source_arena);
+
+    Lexer lexer;
+    lexer_init(&lexer, source, strlen(source), 0, &pool, diag);
+
+    Parser parser;
+    parser_init(&parser, &lexer, &source_arena, diag);
+
+    Module *mod = parse_module(&parser);
+    bool result = mod && !diag_has_errors(diag);
+    if (result) {
+        SemaContext sema;
+        sema_init(&sema, &source_arena, diag, &pool);
+        result = sema_analyze(&sema, mod);
+        sema_destroy(&sema);
+    }
+
+    arena_destroy(&source_arena);
+    return result;
+}
+
+/* Whether a diagnostic with this code was reported */
+static bool reported(const DiagContext *diag, const char *code) {
+    for (size_t i = 0; i < vec_len(diag->diagnostics); i++) {
+        if (strcmp(diag->diagnostics[i].code, code) == 0) return true;
+    }
+    return false;
+}
+
+/* Build a Vec of two types */
+static Vec(Type *) pair(Type *a, Type *b) {
+    Vec(Type *) v = vec_new(Type *);
+    vec_push(v, a);
+    vec_push(v, b);
+    return v;
+}
+
+/* Test: Equal structural types are the same pointer */
+static bool test_structural_interning(void) {
+    Type *a = type_tuple(&types, pair(types.type_i32, types.type_bool));
+    Type *b = type_tuple(&types, pair(types.type_i32, types.type_bool));
+    Type *c = type_tuple(&types, pair(types.type_bool, types.type_i32));
+
+    Type *arr_a = type_array(&types, a, 4);
+    Type *arr_b = type_array(&types, b, 4);
+    Type *arr_c = type_array(&types, a, 8);
+
+    return a == b && a != c && arr_a == arr_b && arr_a != arr_c &&
+           type_equals(arr_a, arr_b) && !type_equals(arr_a, arr_c);
+}
+
+/* Test: Function and pointer types are interned through their children */
+static bool test_nested_interning(void) {
+    Type *p1 = type_ptr(&types, types.type_u8, TYPE_PTR_VALID);
+    Type *p2 = type_ptr(&types, types.type_u8, TYPE_PTR_VALID);
+    Type *f1 = type_function(&types, pair(p1, types.type_i64), types.type_unit);
+    Type *f2 = type_function(&types, pair(p2, types.type_i64), NULL);
+
+    return p1 == p2 && f1 == f2;
+}
+
+/* Test: Generic parameters are told apart by their bounds */
+static bool test_generic_param_bounds(void) {
+    InternedString name = string_pool_intern(&pool, "T");
+    Type *bare = type_generic_param(&types, name, 0, NULL);
+    Type *bounded = type_generic_param(&types, name, 0, pair(types.type_i32, types.type_bool));
+    Type *same = type_generic_param(&types, name, 0, pair(types.type_i32, types.type_bool));
+    Type *other = type_generic_param(&types, name, 0, pair(types.type_bool, types.type_i32));
+
+    return bare != bounded && bounded == same && bounded != other &&
+           bare == type_generic_param(&types, name, 0, NULL);
+}
+
+/* Test: Permission is part of identity and round-trips */
+static bool test_permission_variants(void) {
+    Type *ptr = type_ptr(&types, types.type_i32, TYPE_PTR_VALID);
+    Type *uniq = type_with_permission(&types, ptr, PERM_UNIQUE);
+    Type *uniq2 = type_with_permission(&types, ptr, PERM_UNIQUE);
+    Type *back = type_with_permission(&types, uniq, PERM_CONST);
+
+    return uniq != ptr && uniq == uniq2 && back == ptr &&
+           type_is_subtype(uniq, ptr) && !type_is_subtype(ptr, uniq);
+}
+
+/* Test: Union members are canonicalized before interning */
+static bool test_union_canonical(void) {
+    Type *a = type_union(&types, pair(types.type_i32, types.type_bool));
+    Type *b = type_union(&types, pair(types.type_bool, types.type_i32));
+    Type *single = type_union(&types, pair(types.type_i32, types.type_i32));
+
+    return a == b && a->kind == TYPE_UNION && single == types.type_i32;
+}
+
+/* Test: Nested unions flatten, and subsets are subtypes */
+static bool test_union_subsets(void) {
+    Type *ib = type_union(&types, pair(types.type_i32, types.type_bool));
+    Type *ibc = type_union(&types, pair(ib, types.type_char));
+    Type *cb = type_union(&types, pair(types.type_char, types.type_bool));
+    Type *flat = type_union(&types, pair(types.type_char,
+        type_union(&types, pair(types.type_bool, types.type_i32))));
+
+    return ibc == flat && vec_len(ibc->union_.members) == 3 &&
+           type_union_contains(ibc, types.type_char) &&
+           !type_union_contains(ib, types.type_char) &&
+           type_is_subtype(ib, ibc) && type_is_subtype(cb, ibc) &&
+           type_is_subtype(types.type_bool, ibc) &&
+           !type_is_subtype(ibc, ib) && !type_is_subtype(types.type_u8, ibc);
+}
+
+/* Test: Literal variables unify through structure, then resolve or default */
+static bool test_inference_classes(void) {
+    InferTable table;
+    infer_init(&table, &types);
+
+    Type *lit = infer_fresh(&table, INFER_INT);
+    Type *other = infer_fresh(&table, INFER_INT);
+    Type *frac = infer_fresh(&table, INFER_FLOAT);
+    Type *any = infer_fresh(&table, INFER_ANY);
+
+    /* (int, any) ~ (int, [float; 2]) joins the integers and binds `any` */
+    Type *left = type_tuple(&types, pair(lit, any));
+    Type *right = type_tuple(&types, pair(other, type_array(&types, frac, 2)));
+    bool ok = infer_unify(&table, left, right) &&
+              infer_shallow(&table, lit) == infer_shallow(&table, other) &&
+              infer_class(&table, any) == INFER_ANY &&
+              !infer_unify(&table, lit, types.type_bool) &&
+              !infer_unify(&table, lit, frac) &&
+              !infer_unify(&table, any, type_array(&types, any, 2)) &&
+              infer_unify(&table, other, types.type_u8);
+
+    /* `lit` was fixed through `other`; the float literal defaults to f64 */
+    ok = ok && infer_resolve(&table, left) ==
+               type_tuple(&types, pair(types.type_u8,
+                                       type_array(&types, types.type_f64, 2)));
+
+    infer_destroy(&table);
+    return ok;
+}
+
+/* Test: Array sizes, discriminants and comptime call procedures */
+static bool test_compile_time_values(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "enum Code { Low = 1, High = width() as i32 }\n"
+        "\n"
+        "procedure width() -> usize {\n"
+        "    var n: usize = 1\n"
+        "    loop i in 0..3 {\n"
+        "        n = n * 2\n"
+        "    }\n"
+        "    result n\n"
+        "}\n"
+        "\n"
+        "procedure test() -> i32 {\n"
+        "    let a: [i32; width()] = [0; width()]\n"
+        "    let b: [i32; 8] = a\n"
+        "    result comptime (width() as i32 * 3)\n"
+        "}\n";
+
+    bool result = analyze_source(source, &diag);
+    diag_destroy(&diag);
+    return result;
+}
+
+/* Test: Overflow during compile-time evaluation is an error */
+static bool test_compile_time_overflow(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "procedure grow(n: i32) -> i32 {\n"
+        "    result n * 65536\n"
+        "}\n"
+        "\n"
+        "procedure test() -> i32 {\n"
+        "    result comptime grow(65536)\n"  /* Error: overflows i32 */
+        "}\n";
+
+    bool result = analyze_source(source, &diag);
+    diag_destroy(&diag);
+
+    /* Should fail - overflow */
+    return !result;
+}
+
+/* Test: Calls to extern functions are checked against their signatures */
+static bool test_extern_calls(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "record Pair { a: i64, b: i64 }\n"
+        "extern \"C\" {\n"
+        "    procedure pair_sum(p: Pair) -> i64\n"
+        "}\n"
+        "procedure test() -> i64 {\n"
+        "    result pair_sum(Pair { a: 1, b: 2 })\n"
+        "}\n";
+    bool ok = analyze_source(source, &diag);
+    diag_destroy(&diag);
+
+    /* Wrong argument type */
+    diag_init(&diag);
+    const char *bad_source =
+        "extern \"C\" {\n"
+        "    procedure abs(x: i32) -> i32\n"
+        "}\n"
+        "procedure test() -> i32 {\n"
+        "    result abs(true)\n"
+        "}\n";
+    ok = ok && !analyze_source(bad_source, &diag);
+    diag_destroy(&diag);
+    return ok;
+}
+
+/* Test: A match missing a variant is rejected */
+static bool test_non_exhaustive_match(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "enum Status {\n"
+        "    Active(i32),\n"
+        "    Paused(i32),\n"
+        "    Inactive\n"
+        "}\n"
+        "\n"
+        "procedure test(move s: Status) -> i32 {\n"
+        "    result match s {\n"
+        "        Status::Active(0..=9) => 1,\n"
+        "        Status::Active(_) => 2,\n"
+        "        Status::Inactive => 0\n"  /* Error: Status::Paused not covered */
+        "    }\n"
+        "}\n";
+
+    bool result = analyze_source(source, &diag);
+    bool non_exhaustive = reported(&diag, E_TYP_2060);
+    diag_destroy(&diag);
+
+    /* Should fail - non-exhaustive match */
+    return !result && non_exhaustive;
+}
+
+/* Test: An arm covered by earlier arms is reported but accepted */
+static bool test_unreachable_match_arm(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "procedure test(n: u8) -> i32 {\n"
+        "    result match n {\n"
+        "        0..=9 => 1,\n"
+        "        5 => 2,\n"  /* Warning: covered by 0..=9 */
+        "        _ => 3\n"
+        "    }\n"
+        "}\n";
+
+    bool result = analyze_source(source, &diag);
+    bool warned = reported(&diag, E_TYP_2061);
+    diag_destroy(&diag);
+    return result && warned;
+}
+
+/* Test: a binding's annotation is its type, whatever the initializer's */
+static bool test_annotated_binding(void) {
+    DiagContext diag;
+    diag_init(&diag);
+
+    const char *source =
+        "procedure test() -> i32 {\n"
+        "    let n: i32 = 7\n"
+        "    let u: i32 | bool = n\n"
+        "    var v: i32 | bool = n\n"
+        "    v = true\n"
+        "    result 0\n"
+        "}\n";
+
+    bool result = analyze_source(source, &diag);
+    diag_destroy(&diag);
+    return result;
+}
+
+int main(void) {
+    arena_init(&arena);
+    string_pool_init(&pool);
+    type_ctx_init(&types, &arena, &pool);
+
+    printf("Running type system tests:\n");
+
+    TEST(structural_interning);
+    TEST(nested_interning);
+    TEST(generic_param_bounds);
+    TEST(permission_variants);
+    TEST(union_canonical);
+    TEST(union_subsets);
+    TEST(inference_classes);
+    TEST(compile_time_values);
+    TEST(compile_time_overflow);
+    TEST(extern_calls);
+    TEST(non_exhaustive_match);
+    TEST(unreachable_match_arm);
+    TEST(annotated_binding);
+
+    printf("\nResults: %d/%d tests passed\n", tests_passed, tests_run);
+
+    arena_destroy(&arena);
+    string_pool_destroy(&pool);
+    return tests_passed == tests_run ? 0 : 1;
+}